@@ -162,6 +162,8 @@ testScripts = [
     'abcd-rpc.py',
     'mempool-accept-txn.py',
     'abcd-replay-protection.py',
+    'txoutset_snapshot.py',
+    'submitrawtransactions.py',
 ]
 if ENABLE_ZMQ:
     testScripts.append('zmq_test.py')
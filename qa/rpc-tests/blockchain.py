@@ -28,6 +28,7 @@ class BlockchainTest(BitcoinTestFramework):
     Test blockchain-related RPC calls:
 
         - gettxoutsetinfo
+        - getdbstats
         - verifychain
 
     """
@@ -36,10 +37,12 @@ class BlockchainTest(BitcoinTestFramework):
         super().__init__()
         self.setup_clean_chain = False
         self.num_nodes = 1
+        self.extra_args = [["-utxocommitment"]]
 
     def run_test(self):
         self._test_gettxoutsetinfo()
         self._test_getblockheader()
+        self._test_getdbstats()
         self.nodes[0].verifychain(4, 0)
 
     def _test_gettxoutsetinfo(self):
@@ -85,6 +88,43 @@ class BlockchainTest(BitcoinTestFramework):
         assert_equal(res['bestblock'], res3['bestblock'])
         assert_equal(res['hash_serialized'], res3['hash_serialized'])
 
+        self.log.info(
+            "Test that gettxoutsetinfo() gives the same statistics with the other hash types")
+        res4 = node.gettxoutsetinfo("muhash")
+        res5 = node.gettxoutsetinfo("none")
+        for r in [res4, res5]:
+            for key in ['total_amount', 'transactions', 'height', 'txouts', 'bogosize', 'bestblock']:
+                assert_equal(res[key], r[key])
+            assert 'hash_serialized' not in r
+        assert_equal(len(res4['muhash']), 64)
+        assert 'muhash' not in res5
+
+        self.log.info(
+            "Test that getutxocommitment() follows the tip")
+        commitment = node.getutxocommitment()
+        assert_equal(commitment['muhash'], res4['muhash'])
+        for key in ['total_amount', 'height', 'txouts', 'bestblock']:
+            assert_equal(res4[key], commitment[key])
+
+        node.invalidateblock(b1hash)
+        res6 = node.gettxoutsetinfo("muhash")
+        assert(res6['muhash'] != res4['muhash'])
+        assert_equal(node.getutxocommitment()['muhash'], res6['muhash'])
+        node.reconsiderblock(b1hash)
+        assert_equal(node.gettxoutsetinfo("muhash")['muhash'], res4['muhash'])
+        assert_equal(node.getutxocommitment(), commitment)
+        assert_raises(JSONRPCException, node.gettxoutsetinfo, "bogus")
+
+    def _test_getdbstats(self):
+        stats = self.nodes[0].getdbstats()
+        for name in ['chainstate', 'blockindex']:
+            db = stats[name]
+            assert_equal(db['bloombits'], 10)
+            assert_equal(db['maxopenfiles'], 64)
+            assert_equal(db['compression'], False)
+            assert_equal(len(db['files_per_level']), 7)
+            assert('Compactions' in db['stats'])
+
     def _test_getblockheader(self):
         node = self.nodes[0]
 
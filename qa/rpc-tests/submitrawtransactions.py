@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 The Title Network developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Test submitrawtransactions.
+#
+# Node 0 signs a chain of transactions without sending them, then submits
+# them in one call with the children first, along with transactions that
+# must not get in. Node 1 should end up with what node 0 accepted.
+#
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_jsonrpc,
+    satoshi_round,
+    sync_mempools,
+)
+from decimal import Decimal
+
+FEE = Decimal("0.0001")
+
+
+class SubmitRawTransactionsTest(BitcoinTestFramework):
+
+    def __init__(self):
+        super().__init__()
+        self.setup_clean_chain = False
+        self.num_nodes = 2
+
+    # Sign a transaction that spends parent_txid:vout, which need not be known
+    # to the node yet. Return the signed hex, its txid and the value sent.
+    def sign_spend(self, node, parent_txid, vout, script_pubkey, value):
+        send_value = satoshi_round(value - FEE)
+        inputs = [{'txid': parent_txid, 'vout': vout}]
+        outputs = {node.getnewaddress(): send_value}
+        rawtx = node.createrawtransaction(inputs, outputs)
+        prevtxs = [{'txid': parent_txid, 'vout': vout,
+                    'scriptPubKey': script_pubkey, 'amount': value}]
+        signed = node.signrawtransaction(rawtx, prevtxs, None, "ALL|FORKID")
+        assert_equal(signed['complete'], True)
+        decoded = node.decoderawtransaction(signed['hex'])
+        return (signed['hex'], decoded['txid'],
+                decoded['vout'][0]['scriptPubKey']['hex'], send_value)
+
+    def run_test(self):
+        node = self.nodes[0]
+        utxos = node.listunspent()
+        assert len(utxos) >= 3
+
+        self.log.info("Submit a chain of three with the children first")
+        u = utxos[0]
+        chain = []
+        txid, vout = u['txid'], u['vout']
+        spk, value = u['scriptPubKey'], u['amount']
+        for _ in range(3):
+            (raw, txid, spk, value) = self.sign_spend(node, txid, vout, spk,
+                                                      value)
+            chain.append((raw, txid))
+            vout = 0
+
+        u = utxos[1]
+        (independent, independent_txid, _, _) = self.sign_spend(
+            node, u['txid'], u['vout'], u['scriptPubKey'], u['amount'])
+
+        # Spends the same coin as the first of the chain, to another address.
+        u = utxos[0]
+        (conflict, conflict_txid, _, _) = self.sign_spend(
+            node, u['txid'], u['vout'], u['scriptPubKey'], u['amount'])
+
+        # Spends an output that does not exist.
+        (orphan, orphan_txid, _, _) = self.sign_spend(
+            node, "aa" * 32, 0, utxos[2]['scriptPubKey'], Decimal("1"))
+
+        res = node.submitrawtransactions(
+            [chain[2][0], chain[1][0], independent, chain[0][0], conflict,
+             orphan])
+        assert_equal([r['txid'] for r in res],
+                     [chain[2][1], chain[1][1], independent_txid,
+                      chain[0][1], conflict_txid, orphan_txid])
+        assert_equal([r['accepted'] for r in res],
+                     [True, True, True, True, False, False])
+        assert_equal(res[4]['error'], "258: txn-mempool-conflict")
+        assert_equal(res[5]['error'], "Missing inputs")
+        assert 'error' not in res[0]
+
+        mempool = node.getrawmempool()
+        assert_equal(sorted(mempool), sorted(
+            [independent_txid] + [txid for (_, txid) in chain]))
+        assert_equal(node.getmempoolentry(chain[2][1])['ancestorcount'], 3)
+
+        self.log.info("Relay what was accepted to node 1")
+        sync_mempools(self.nodes)
+
+        self.log.info("Resubmitting is accepted, as sendrawtransaction is")
+        res = node.submitrawtransactions([chain[0][0]])
+        assert_equal(res[0]['accepted'], True)
+
+        self.log.info("Mined transactions are reported as such")
+        node.generate(1)
+        res = node.submitrawtransactions([independent])
+        assert_equal(res[0]['accepted'], False)
+        assert_equal(res[0]['error'], "transaction already in block chain")
+
+        self.log.info("A transaction that does not decode fails the call")
+        assert_raises_jsonrpc(-22, "TX decode failed at index 1",
+                              node.submitrawtransactions, [orphan, "00"])
+        assert_equal(node.submitrawtransactions([]), [])
+
+
+if __name__ == '__main__':
+    SubmitRawTransactionsTest().main()
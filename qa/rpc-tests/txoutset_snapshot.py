@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 The Title Network developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Test dumptxoutset and loadtxoutset.
+#
+# Node 0 mines a chain and dumps its UTXO set. Node 1 gets the headers of
+# that chain from node 0 while it is pruned, so that no blocks are sent,
+# loads the snapshot and then syncs the blocks above it.
+#
+
+import os
+import time
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_jsonrpc,
+    connect_nodes,
+    start_node,
+    stop_node,
+    sync_blocks,
+)
+
+# Headers needed on top of a snapshot block, MIN_SNAPSHOT_BASE_DEPTH in
+# validation.h
+MIN_SNAPSHOT_BASE_DEPTH = 6
+
+
+class TxOutSetSnapshotTest(BitcoinTestFramework):
+
+    def __init__(self):
+        super().__init__()
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+
+    def setup_network(self):
+        # Node 0 dumps the UTXO set, which needs the commitment.
+        self.extra_args = [["-utxocommitment"], []]
+        self.setup_nodes()
+
+    def wait_for_headers(self, node, height):
+        waitstart = time.time()
+        while node.getblockchaininfo()['headers'] < height:
+            assert time.time() - waitstart < 30, "headers not received"
+            time.sleep(0.1)
+
+    def run_test(self):
+        node0 = self.nodes[0]
+        node0.generate(120)
+        node0.sendtoaddress(node0.getnewaddress(), 1)
+        node0.generate(1)
+        muhash = node0.gettxoutsetinfo("muhash")['muhash']
+
+        self.log.info("Dump the UTXO set of node 0")
+        res = node0.dumptxoutset("utxo.dat")
+        assert_equal(res['base_hash'], node0.getbestblockhash())
+        assert_equal(res['base_height'], 121)
+        assert_equal(res['nchaintx'], 123)
+        assert_equal(res['muhash'], muhash)
+        assert_equal(res['coins_written'],
+                     node0.gettxoutsetinfo()['txouts'])
+        base_hash = res['base_hash']
+        path = res['path']
+        assert os.path.isfile(path)
+        assert_raises_jsonrpc(-8, "already exists",
+                              node0.dumptxoutset, "utxo.dat")
+
+        self.log.info("Check that a snapshot needs its block header")
+        node1 = self.nodes[1]
+        assert_raises_jsonrpc(-8, None, node1.loadtxoutset,
+                              path + ".missing")
+        assert_raises_jsonrpc(-1, "has not been received",
+                              node1.loadtxoutset, path)
+
+        self.log.info("Send node 1 the headers without the blocks")
+        stop_node(node0, 0)
+        self.nodes[0] = node0 = start_node(
+            0, self.options.tmpdir, ["-utxocommitment", "-prune=1"])
+        connect_nodes(node1, 0)
+        # Headers are not synced from a pruned node, but a new block is
+        # announced and the headers below it are then fetched.
+        node0.generate(MIN_SNAPSHOT_BASE_DEPTH - 1)
+        height = 121 + MIN_SNAPSHOT_BASE_DEPTH - 1
+        self.wait_for_headers(node1, height)
+        assert_equal(node1.getblockcount(), 0)
+
+        self.log.info("Check that unpinned snapshots are refused by default")
+        assert_raises_jsonrpc(-1, "not one of the", node1.loadtxoutset, path)
+
+        self.log.info("Check that the snapshot block has to be buried")
+        stop_node(node1, 1)
+        self.nodes[1] = node1 = start_node(
+            1, self.options.tmpdir, ["-allowunpinnedsnapshot"])
+        assert_raises_jsonrpc(-1, "headers on top of it",
+                              node1.loadtxoutset, path)
+        connect_nodes(node1, 0)
+        node0.generate(1)
+        height += 1
+        self.wait_for_headers(node1, height)
+
+        self.log.info("Check that the snapshot block has to be in the best "
+                      "header chain")
+        node0.invalidateblock(base_hash)
+        node0.generate(MIN_SNAPSHOT_BASE_DEPTH + 2)
+        fork_hash = node0.getblockhash(121)
+        self.wait_for_headers(node1, height + 1)
+        assert_raises_jsonrpc(-1, "not in the best header chain",
+                              node1.loadtxoutset, path)
+        node0.reconsiderblock(base_hash)
+        node0.invalidateblock(fork_hash)
+        node0.generate(2)
+        height += 2
+        assert_equal(node0.getblockhash(121), base_hash)
+        self.wait_for_headers(node1, height)
+        assert_equal(node1.getblockcount(), 0)
+
+        self.log.info("Load the snapshot on node 1")
+        assert_equal(int(node1.getnetworkinfo()['localservices'], 16) & 1, 1)
+        res = node1.loadtxoutset(path)
+        assert_equal(res['coins_loaded'], node0.gettxoutsetinfo()['txouts'])
+        assert_equal(res['base_height'], 121)
+        assert_equal(node1.getbestblockhash(), base_hash)
+        assert_equal(node1.gettxoutsetinfo("muhash")['muhash'], muhash)
+        assert_equal(int(node1.getnetworkinfo()['localservices'], 16) & 1, 0)
+        assert_raises_jsonrpc(-1, "already been loaded",
+                              node1.loadtxoutset, path)
+
+        self.log.info("Sync the blocks above the snapshot")
+        stop_node(node0, 0)
+        self.nodes[0] = node0 = start_node(
+            0, self.options.tmpdir, ["-utxocommitment"])
+        node0.sendtoaddress(node0.getnewaddress(), 1)
+        node0.generate(5)
+        height += 5
+        connect_nodes(node1, 0)
+        sync_blocks(self.nodes)
+        assert_equal(node1.getblockcount(), height)
+        assert_equal(node1.gettxoutsetinfo("muhash")['muhash'],
+                     node0.gettxoutsetinfo("muhash")['muhash'])
+
+        self.log.info("Check that the chainstate survives a restart")
+        stop_node(node1, 1)
+        self.nodes[1] = node1 = start_node(1, self.options.tmpdir)
+        assert_equal(node1.getblockcount(), height)
+        assert node1.verifychain(4, 0)
+        assert_equal(int(node1.getnetworkinfo()['localservices'], 16) & 1, 0)
+
+
+if __name__ == '__main__':
+    TxOutSetSnapshotTest().main()
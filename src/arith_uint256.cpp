@@ -103,6 +103,27 @@ base_uint<BITS> &base_uint<BITS>::operator/=(const base_uint &b) {
     return *this;
 }
 
+template <unsigned int BITS>
+uint64_t base_uint<BITS>::DivideBy(uint64_t divisor) {
+    if (divisor == 0) throw uint_error("Division by zero");
+    // Shift-subtract long division, one bit at a time from the top. The
+    // partial remainder is 65 bits wide: `carry` holds the bit shifted out of
+    // `rem`. Quotient bits replace the dividend bits they were derived from.
+    uint64_t rem = 0;
+    for (int i = WIDTH - 1; i >= 0; i--) {
+        uint32_t quotient = 0;
+        for (int bit = 31; bit >= 0; bit--) {
+            uint64_t carry = rem >> 63;
+            rem = (rem << 1) | ((pn[i] >> bit) & 1);
+            uint64_t ge = carry | (rem >= divisor);
+            rem -= divisor & (0 - ge);
+            quotient |= uint32_t(ge) << bit;
+        }
+        pn[i] = quotient;
+    }
+    return rem;
+}
+
 template <unsigned int BITS>
 int base_uint<BITS>::CompareTo(const base_uint<BITS> &b) const {
     for (int i = WIDTH - 1; i >= 0; i--) {
@@ -167,6 +188,7 @@ template base_uint<256> &base_uint<256>::operator>>=(unsigned int);
 template base_uint<256> &base_uint<256>::operator*=(uint32_t b32);
 template base_uint<256> &base_uint<256>::operator*=(const base_uint<256> &b);
 template base_uint<256> &base_uint<256>::operator/=(const base_uint<256> &b);
+template uint64_t base_uint<256>::DivideBy(uint64_t);
 template int base_uint<256>::CompareTo(const base_uint<256> &) const;
 template bool base_uint<256>::EqualTo(uint64_t) const;
 template double base_uint<256>::getdouble() const;
@@ -149,6 +149,14 @@ public:
     base_uint &operator*=(const base_uint &b);
     base_uint &operator/=(const base_uint &b);
 
+    /**
+     * Divide in place by a 64-bit divisor and return the remainder. Unlike
+     * operator/=, this works on the limbs directly: it does not widen the
+     * divisor to a base_uint, and always runs BITS iterations without
+     * data-dependent branches.
+     */
+    uint64_t DivideBy(uint64_t divisor);
+
     base_uint &operator++() {
         // prefix operator
         int i = 0;
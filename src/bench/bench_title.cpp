@@ -4,13 +4,19 @@
 
 #include "bench.h"
 
+#include "chainparams.h"
 #include "key.h"
+#include "script/scriptcache.h"
+#include "script/sigcache.h"
 #include "util.h"
 #include "validation.h"
 
 int main(int argc, char **argv) {
     ECC_Start();
     SetupEnvironment();
+    InitSignatureCache();
+    InitScriptExecutionCache();
+    SelectParams(CBaseChainParams::MAIN);
     fPrintToDebugLog = false; // don't want to write to debug.log file
 
     benchmark::BenchRunner::RunAll();
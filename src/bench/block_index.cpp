@@ -0,0 +1,74 @@
+// Copyright (c) 2018 The Title Network developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "chain.h"
+#include "random.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+/* Length of the chain walked by each benchmark */
+static const int BLOCK_INDEX_CHAIN_LENGTH = 200000;
+
+static void LinkChain(std::vector<CBlockIndex *> &chain) {
+    for (size_t i = 0; i < chain.size(); i++) {
+        chain[i]->nHeight = i;
+        chain[i]->nTime = 1500000000 + 60 * i;
+        chain[i]->pprev = i > 0 ? chain[i - 1] : nullptr;
+        chain[i]->BuildSkip();
+    }
+}
+
+static void WalkChain(benchmark::State &state,
+                      const std::vector<CBlockIndex *> &chain) {
+    FastRandomContext rng(true);
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1000; i++) {
+            const CBlockIndex *pindex =
+                chain[rng.rand32() % BLOCK_INDEX_CHAIN_LENGTH];
+            pindex->GetAncestor(rng.rand32() % (pindex->nHeight + 1));
+            pindex->GetMedianTimePast();
+        }
+    }
+}
+
+// One heap node per entry, allocated in hash rather than height order as
+// the block index used to be loaded.
+static void BlockIndexWalkHeap(benchmark::State &state) {
+    std::vector<std::unique_ptr<CBlockIndex>> nodes(BLOCK_INDEX_CHAIN_LENGTH);
+    std::vector<int> order(BLOCK_INDEX_CHAIN_LENGTH);
+    for (int i = 0; i < BLOCK_INDEX_CHAIN_LENGTH; i++) {
+        order[i] = i;
+    }
+    FastRandomContext rng(true);
+    for (int i = BLOCK_INDEX_CHAIN_LENGTH - 1; i > 0; i--) {
+        std::swap(order[i], order[rng.rand32() % (i + 1)]);
+    }
+    for (int i : order) {
+        nodes[i].reset(new CBlockIndex());
+    }
+
+    std::vector<CBlockIndex *> chain;
+    for (const auto &node : nodes) {
+        chain.push_back(node.get());
+    }
+    LinkChain(chain);
+    WalkChain(state, chain);
+}
+
+static void BlockIndexWalkArena(benchmark::State &state) {
+    CBlockIndexArena arena;
+    std::vector<CBlockIndex *> chain;
+    for (int i = 0; i < BLOCK_INDEX_CHAIN_LENGTH; i++) {
+        chain.push_back(arena.Allocate());
+    }
+    LinkChain(chain);
+    WalkChain(state, chain);
+}
+
+BENCHMARK(BlockIndexWalkHeap);
+BENCHMARK(BlockIndexWalkArena);
@@ -0,0 +1,129 @@
+// Copyright (c) 2018 The Title Network developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "chain.h"
+#include "chainparams.h"
+#include "coins.h"
+#include "config.h"
+#include "miner.h"
+#include "txmempool.h"
+#include "validation.h"
+#include "versionbits.h"
+
+#include <vector>
+
+// Transactions in the mempool before the first template, and transactions
+// that arrive while a pool server keeps asking for templates.
+static const uint32_t BACKGROUND_TXS = 1000;
+static const uint32_t ARRIVING_TXS = 20;
+
+// The genesis block as the tip, and coins that anyone can spend held in
+// memory, which is all that assembling and checking a block needs.
+struct BlockTemplateSetup {
+    CCoinsView viewEmpty;
+    CCoinsViewCache *pcoinsTipOld;
+    uint256 hashGenesis;
+    CBlockIndex index;
+    std::vector<CTransactionRef> vtx;
+
+    BlockTemplateSetup() {
+        SelectParams(CBaseChainParams::REGTEST);
+        const CBlock &genesis = Params().GenesisBlock();
+        hashGenesis = genesis.GetHash();
+        index = CBlockIndex(genesis);
+        index.phashBlock =
+            &mapBlockIndex.emplace(hashGenesis, &index).first->first;
+        chainActive.SetTip(&index);
+
+        pcoinsTipOld = pcoinsTip;
+        pcoinsTip = new CCoinsViewCache(&viewEmpty);
+        pcoinsTip->SetBestBlock(hashGenesis);
+        for (uint32_t n = 0; n < BACKGROUND_TXS + ARRIVING_TXS; n++) {
+            COutPoint prevout(uint256(), n);
+            CTxOut txout(COIN, CScript() << OP_TRUE);
+            pcoinsTip->AddCoin(prevout, Coin(txout, 0, false), false);
+
+            CMutableTransaction tx;
+            tx.vin.resize(1);
+            tx.vin[0].prevout = prevout;
+            tx.vout.resize(1);
+            tx.vout[0].nValue = COIN - GetFee(n);
+            tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+            vtx.push_back(MakeTransactionRef(tx));
+        }
+
+        for (uint32_t n = 0; n < BACKGROUND_TXS; n++) {
+            AddTx(n);
+        }
+    }
+
+    ~BlockTemplateSetup() {
+        mempool.clear();
+        chainActive.SetTip(nullptr);
+        mapBlockIndex.erase(hashGenesis);
+        versionbitscache.Clear();
+        delete pcoinsTip;
+        pcoinsTip = pcoinsTipOld;
+        SelectParams(CBaseChainParams::MAIN);
+    }
+
+    // Spread the fees, so that the order of the block is not trivial.
+    static Amount GetFee(uint32_t n) { return Amount(1000 + 10 * (n % 97)); }
+
+    void AddTx(uint32_t n) {
+        const CTransactionRef &tx = vtx[n];
+        LockPoints lp;
+        mempool.addUnchecked(
+            tx->GetId(), CTxMemPoolEntry(tx, GetFee(n), 0, 10.0, 1,
+                                         tx->GetValueOut().GetSatoshis(),
+                                         false, 1, lp));
+    }
+
+    void RemoveArrived() {
+        for (uint32_t n = BACKGROUND_TXS; n < BACKGROUND_TXS + ARRIVING_TXS;
+             n++) {
+            mempool.removeRecursive(*vtx[n]);
+        }
+    }
+};
+
+// Assemble a new template after every transaction that arrives, as
+// getblocktemplate did.
+static void BlockTemplateRebuild(benchmark::State &state) {
+    BlockTemplateSetup setup;
+    GlobalConfig config;
+    CScript scriptDummy = CScript() << OP_TRUE;
+
+    while (state.KeepRunning()) {
+        for (uint32_t n = BACKGROUND_TXS; n < BACKGROUND_TXS + ARRIVING_TXS;
+             n++) {
+            setup.AddTx(n);
+            BlockAssembler(config, Params()).CreateNewBlock(scriptDummy);
+        }
+        setup.RemoveArrived();
+    }
+}
+
+// Ask the cache for a template after every transaction that arrives. Taking
+// the transactions out again makes the first template of the next round be
+// assembled from scratch.
+static void BlockTemplateIncremental(benchmark::State &state) {
+    BlockTemplateSetup setup;
+    GlobalConfig config;
+    BlockTemplateCache cache(config);
+    LOCK(cs_main);
+
+    while (state.KeepRunning()) {
+        for (uint32_t n = BACKGROUND_TXS; n < BACKGROUND_TXS + ARRIVING_TXS;
+             n++) {
+            setup.AddTx(n);
+            cache.Get();
+        }
+        setup.RemoveArrived();
+    }
+}
+
+BENCHMARK(BlockTemplateRebuild);
+BENCHMARK(BlockTemplateIncremental);
@@ -4,9 +4,15 @@
 
 #include "bench.h"
 #include "coins.h"
+#include "crypto/common.h"
 #include "policy/policy.h"
+#include "random.h"
+#include "undo.h"
+#include "validation.h"
 #include "wallet/crypter.h"
 
+#include <iostream>
+#include <unordered_map>
 #include <vector>
 
 // FIXME: Dedup with SetupDummyInputs in test/transaction_tests.cpp.
@@ -91,3 +97,132 @@ static void CCoinsCaching(benchmark::State &state) {
 }
 
 BENCHMARK(CCoinsCaching);
+
+/* Number of coins held by the maps in the benchmarks below */
+static const size_t COINS_MAP_SIZE = 200000;
+
+//! The map CCoinsMap used to be, for comparison.
+typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher>
+    CCoinsUnorderedMap;
+
+//! Fill map with pay-to-pubkey-hash coins, like most of the UTXO set.
+template <typename Map>
+static std::vector<COutPoint> FillCoinsMap(Map &map, FastRandomContext &rng) {
+    CScript script = CScript() << OP_DUP << OP_HASH160
+                               << std::vector<uint8_t>(20, 1) << OP_EQUALVERIFY
+                               << OP_CHECKSIG;
+    std::vector<COutPoint> outpoints;
+    for (size_t i = 0; i < COINS_MAP_SIZE; i++) {
+        uint256 txid;
+        for (int j = 0; j < 4; j++) {
+            WriteLE64(txid.begin() + 8 * j, rng.rand64());
+        }
+        outpoints.emplace_back(txid, rng.randrange(4));
+        map.emplace(std::piecewise_construct,
+                    std::forward_as_tuple(outpoints.back()),
+                    std::forward_as_tuple(
+                        Coin(CTxOut(Amount(int64_t(i)), script), 1, false)));
+    }
+    return outpoints;
+}
+
+// Random lookups in a map too large for the CPU caches, half of them for
+// missing coins as when a block's inputs are fetched. The memory used per coin
+// is printed along with the timings.
+template <typename Map>
+static void CoinsMapLookup(benchmark::State &state, const char *name) {
+    FastRandomContext rng(true);
+    Map map;
+    std::vector<COutPoint> outpoints = FillCoinsMap(map, rng);
+    std::cout << "# " << name << ": "
+              << memusage::DynamicUsage(map) / COINS_MAP_SIZE
+              << " bytes per coin\n";
+
+    size_t nFound = 0;
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1000; i++) {
+            COutPoint outpoint = outpoints[rng.randrange(COINS_MAP_SIZE)];
+            if (rng.randbool()) {
+                outpoint.n += 4;
+            }
+            nFound += map.find(outpoint) != map.end();
+        }
+    }
+    assert(nFound > 0);
+}
+
+static void CCoinsMapLookup(benchmark::State &state) {
+    CoinsMapLookup<CCoinsMap>(state, "CCoinsMap");
+}
+
+static void CCoinsMapLookupUnordered(benchmark::State &state) {
+    CoinsMapLookup<CCoinsUnorderedMap>(state, "std::unordered_map");
+}
+
+// Fill a cache as connecting a block does, then flush it.
+static void CCoinsCachingFill(benchmark::State &state) {
+    CCoinsView coinsDummy;
+    CScript script = CScript() << OP_DUP << OP_HASH160
+                               << std::vector<uint8_t>(20, 1) << OP_EQUALVERIFY
+                               << OP_CHECKSIG;
+    FastRandomContext rng(true);
+    uint256 txid;
+    while (state.KeepRunning()) {
+        CCoinsViewCache coins(&coinsDummy);
+        for (int i = 0; i < 5000; i++) {
+            WriteLE64(txid.begin(), rng.rand64());
+            coins.AddCoin(COutPoint(txid, 0), Coin(CTxOut(Amount(1), script), 1,
+                                                   false),
+                          false);
+        }
+        coins.Flush();
+    }
+}
+
+// Apply a block of 1000 transactions, each spending two coins and creating two,
+// with and without keeping the UTXO set commitment up to date as ConnectTip
+// does.
+static void UpdateCoinsBlock(benchmark::State &state, bool fCommitment) {
+    CScript script = CScript() << OP_DUP << OP_HASH160
+                               << std::vector<uint8_t>(20, 1) << OP_EQUALVERIFY
+                               << OP_CHECKSIG;
+    FastRandomContext rng(true);
+    CCoinsView coinsDummy;
+    CCoinsViewCache coins(&coinsDummy);
+    std::vector<CTransaction> vtx;
+    for (int i = 0; i < 1000; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(2);
+        for (CTxIn &txin : tx.vin) {
+            WriteLE64(txin.prevout.hash.begin(), rng.rand64());
+            coins.AddCoin(txin.prevout,
+                          Coin(CTxOut(Amount(1000), script), 1, false), false);
+        }
+        tx.vout.assign(2, CTxOut(Amount(400), script));
+        vtx.emplace_back(tx);
+    }
+
+    while (state.KeepRunning()) {
+        CCoinsViewCache view(&coins);
+        CCoinsCommitment commitment;
+        for (const CTransaction &tx : vtx) {
+            CTxUndo txundo;
+            UpdateCoins(tx, view, txundo, 2,
+                        fCommitment ? &commitment : nullptr);
+        }
+    }
+}
+
+static void UpdateCoinsBlockNoCommitment(benchmark::State &state) {
+    UpdateCoinsBlock(state, false);
+}
+
+static void UpdateCoinsBlockCommitment(benchmark::State &state) {
+    UpdateCoinsBlock(state, true);
+}
+
+BENCHMARK(CCoinsMapLookup);
+BENCHMARK(CCoinsMapLookupUnordered);
+BENCHMARK(CCoinsCachingFill);
+BENCHMARK(UpdateCoinsBlockNoCommitment);
+BENCHMARK(UpdateCoinsBlockCommitment);
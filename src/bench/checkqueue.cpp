@@ -4,6 +4,7 @@
 
 #include "checkqueue.h"
 #include "bench.h"
+#include "crypto/sha256.h"
 #include "prevector.h"
 #include "random.h"
 #include "util.h"
@@ -11,6 +12,7 @@
 
 #include <boost/thread/thread.hpp>
 
+#include <cstring>
 #include <vector>
 
 // This Benchmark tests the CheckQueue with the lightest weight Checks, so it
@@ -90,5 +92,53 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State &state) {
     tg.interrupt_all();
     tg.join_all();
 }
+
+// This Benchmark shows how the CheckQueue scales with the number of threads
+// verifying a block, including the master. Every check hashes a little data
+// so that the work, rather than the scheduling, dominates as it does for
+// signature checks.
+static void CCheckQueueScaling(benchmark::State &state, int nThreads) {
+    struct HashJob {
+        uint8_t data[32];
+        HashJob() { memset(data, 0, sizeof(data)); }
+        bool operator()() {
+            for (int i = 0; i < 16; i++) {
+                CSHA256().Write(data, sizeof(data)).Finalize(data);
+            }
+            return true;
+        }
+        void swap(HashJob &x) { std::swap(data, x.data); };
+    };
+    CCheckQueue<HashJob> queue{QUEUE_BATCH_SIZE};
+    boost::thread_group tg;
+    for (auto x = 1; x < nThreads; ++x) {
+        tg.create_thread([&] { queue.Thread(); });
+    }
+    while (state.KeepRunning()) {
+        CCheckQueueControl<HashJob> control(&queue);
+        std::vector<std::vector<HashJob>> vBatches(BATCHES);
+        for (auto &vChecks : vBatches) {
+            vChecks.resize(BATCH_SIZE);
+            control.Add(vChecks);
+        }
+        control.Wait();
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+#define CHECKQUEUE_SCALING_BENCHMARK(n)                                        \
+    static void CCheckQueueScaling_##n##Threads(benchmark::State &state) {     \
+        CCheckQueueScaling(state, n);                                          \
+    }                                                                          \
+    BENCHMARK(CCheckQueueScaling_##n##Threads);
+
 BENCHMARK(CCheckQueueSpeed);
 BENCHMARK(CCheckQueueSpeedPrevectorJob);
+CHECKQUEUE_SCALING_BENCHMARK(1)
+CHECKQUEUE_SCALING_BENCHMARK(2)
+CHECKQUEUE_SCALING_BENCHMARK(4)
+CHECKQUEUE_SCALING_BENCHMARK(8)
+CHECKQUEUE_SCALING_BENCHMARK(16)
+CHECKQUEUE_SCALING_BENCHMARK(32)
+CHECKQUEUE_SCALING_BENCHMARK(64)
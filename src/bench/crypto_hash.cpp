@@ -11,6 +11,7 @@
 #include "crypto/sha256.h"
 #include "crypto/sha512.h"
 #include "hash.h"
+#include "hash_blake2.h"
 #include "random.h"
 #include "uint256.h"
 #include "utiltime.h"
@@ -55,6 +56,27 @@ static void SHA512(benchmark::State &state) {
         CSHA512().Write(in.data(), in.size()).Finalize(hash);
 }
 
+/* Number of independent 80-byte block headers to hash per iteration */
+static const size_t BLAKE2B_HEADERS = 1000;
+
+static void BLAKE2B_80b(benchmark::State &state) {
+    std::vector<uint8_t> in(BLAKE2B_HEADERS * 80, 0);
+    std::vector<uint8_t> out(BLAKE2B_HEADERS * 32);
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < BLAKE2B_HEADERS; i++) {
+            Blake2::hash2b(&out[i * 32], 32, &in[i * 80], 80);
+        }
+    }
+}
+
+static void BLAKE2B_80b_batch(benchmark::State &state) {
+    std::vector<uint8_t> in(BLAKE2B_HEADERS * 80, 0);
+    std::vector<uint8_t> out(BLAKE2B_HEADERS * 32);
+    while (state.KeepRunning()) {
+        Blake2::hash2b_80(out.data(), in.data(), BLAKE2B_HEADERS);
+    }
+}
+
 static void SipHash_32b(benchmark::State &state) {
     uint256 x;
     while (state.KeepRunning()) {
@@ -90,6 +112,8 @@ BENCHMARK(SHA256);
 BENCHMARK(SHA512);
 
 BENCHMARK(SHA256_32b);
+BENCHMARK(BLAKE2B_80b);
+BENCHMARK(BLAKE2B_80b_batch);
 BENCHMARK(SipHash_32b);
 BENCHMARK(FastRandom_32bit);
 BENCHMARK(FastRandom_1bit);
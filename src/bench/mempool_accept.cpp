@@ -0,0 +1,198 @@
+// Copyright (c) 2018 The Title Network developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "chain.h"
+#include "chainparams.h"
+#include "coins.h"
+#include "config.h"
+#include "consensus/validation.h"
+#include "key.h"
+#include "pubkey.h"
+#include "script/sighashtype.h"
+#include "script/sigcache.h"
+#include "txmempool.h"
+#include "util.h"
+#include "validation.h"
+
+#include <boost/thread/thread.hpp>
+
+#include <vector>
+
+// Transactions relayed to the node during one pass of the message handler.
+static const uint32_t RELAYED_TXS = 200;
+
+// The regtest genesis block as the tip, and coins paying to one key held in
+// memory, each spent by one signed transaction.
+struct MempoolAcceptSetup {
+    ECCVerifyHandle verifyHandle;
+    CCoinsView viewEmpty;
+    CCoinsViewCache *pcoinsTipOld;
+    uint256 hashGenesis;
+    CBlockIndex index;
+    std::vector<CTransactionRef> vtx;
+
+    MempoolAcceptSetup() {
+        SelectParams(CBaseChainParams::REGTEST);
+        const CBlock &genesis = Params().GenesisBlock();
+        hashGenesis = genesis.GetHash();
+        index = CBlockIndex(genesis);
+        index.phashBlock =
+            &mapBlockIndex.emplace(hashGenesis, &index).first->first;
+        chainActive.SetTip(&index);
+
+        // Keep the signatures out of the cache, so that every round verifies
+        // them as it would for transactions never seen before. Both benchmarks
+        // then also verify them a second time, for the flags of the tip.
+        gArgs.ForceSetArg("-maxsigcachesize", "0");
+        InitSignatureCache();
+
+        CKey key;
+        key.MakeNewKey(true);
+        CScript scriptPubKey = CScript() << ToByteVector(key.GetPubKey())
+                                         << OP_CHECKSIG;
+
+        pcoinsTipOld = pcoinsTip;
+        pcoinsTip = new CCoinsViewCache(&viewEmpty);
+        pcoinsTip->SetBestBlock(hashGenesis);
+        for (uint32_t n = 0; n < RELAYED_TXS; n++) {
+            COutPoint prevout(uint256(), n);
+            pcoinsTip->AddCoin(prevout,
+                               Coin(CTxOut(COIN, scriptPubKey), 1, false),
+                               false);
+
+            CMutableTransaction tx;
+            tx.vin.resize(1);
+            tx.vin[0].prevout = prevout;
+            tx.vout.resize(1);
+            tx.vout[0].nValue = COIN - Amount(10000);
+            tx.vout[0].scriptPubKey = scriptPubKey;
+
+            std::vector<uint8_t> vchSig;
+            uint256 hash = SignatureHash(scriptPubKey, CTransaction(tx), 0,
+                                         SigHashType().withForkId(), COIN);
+            key.Sign(hash, vchSig);
+            vchSig.push_back(uint8_t(SIGHASH_ALL | SIGHASH_FORKID));
+            tx.vin[0].scriptSig << vchSig;
+            vtx.push_back(MakeTransactionRef(tx));
+        }
+    }
+
+    ~MempoolAcceptSetup() {
+        mempool.clear();
+        chainActive.SetTip(nullptr);
+        mapBlockIndex.erase(hashGenesis);
+        delete pcoinsTip;
+        pcoinsTip = pcoinsTipOld;
+        gArgs.ForceSetArg("-maxsigcachesize",
+                          std::to_string(DEFAULT_MAX_SIG_CACHE_SIZE));
+        InitSignatureCache();
+        SelectParams(CBaseChainParams::MAIN);
+    }
+};
+
+// Accept the transactions one at a time with cs_main held throughout, as the
+// message handler used to.
+static void MempoolAcceptSerial(benchmark::State &state) {
+    MempoolAcceptSetup setup;
+    GlobalConfig config;
+
+    while (state.KeepRunning()) {
+        {
+            LOCK(cs_main);
+            for (const CTransactionRef &tx : setup.vtx) {
+                CValidationState stateTx;
+                AcceptToMemoryPool(config, mempool, stateTx, tx, false,
+                                   nullptr);
+            }
+        }
+        mempool.clear();
+    }
+}
+
+// Start the mempool script check threads of -par=nThreads: the caller checks
+// scripts too, so one fewer is started.
+static void StartMempoolScriptCheckThreads(boost::thread_group &tg,
+                                           int nThreads) {
+    for (int i = 1; i < nThreads; i++) {
+        tg.create_thread(&ThreadMempoolScriptCheck);
+    }
+}
+
+// Accept the same transactions as one batch, with their scripts checked on
+// nThreads threads, including the caller.
+static void MempoolAcceptParallel(benchmark::State &state, int nThreads) {
+    MempoolAcceptSetup setup;
+    GlobalConfig config;
+    boost::thread_group tg;
+    StartMempoolScriptCheckThreads(tg, nThreads);
+
+    while (state.KeepRunning()) {
+        std::vector<MempoolSubmission> vSubmissions;
+        for (const CTransactionRef &tx : setup.vtx) {
+            vSubmissions.emplace_back(tx);
+        }
+        AcceptToMemoryPoolParallel(config, mempool, vSubmissions, false);
+        mempool.clear();
+    }
+
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+// The latency of a single relayed transaction, which is all the message
+// handler has most of the time: one at a time with cs_main held, as before.
+// The transactions take turns, as the smallest signature cache still holds
+// the last ones verified.
+static void MempoolAcceptSingleSerial(benchmark::State &state) {
+    MempoolAcceptSetup setup;
+    GlobalConfig config;
+    size_t n = 0;
+
+    while (state.KeepRunning()) {
+        {
+            LOCK(cs_main);
+            CValidationState stateTx;
+            AcceptToMemoryPool(config, mempool, stateTx,
+                               setup.vtx[n++ % setup.vtx.size()], false,
+                               nullptr);
+        }
+        mempool.clear();
+    }
+}
+
+// And as a batch of one through the mempool check queue, with the threads of
+// the default -par.
+static void MempoolAcceptSingleParallel(benchmark::State &state) {
+    MempoolAcceptSetup setup;
+    GlobalConfig config;
+    boost::thread_group tg;
+    StartMempoolScriptCheckThreads(tg, GetNumCores());
+    size_t n = 0;
+
+    while (state.KeepRunning()) {
+        std::vector<MempoolSubmission> vSubmissions;
+        vSubmissions.emplace_back(setup.vtx[n++ % setup.vtx.size()]);
+        AcceptToMemoryPoolParallel(config, mempool, vSubmissions, false);
+        mempool.clear();
+    }
+
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+#define MEMPOOL_ACCEPT_PARALLEL_BENCHMARK(n)                                   \
+    static void MempoolAcceptParallel_##n##Threads(                            \
+        benchmark::State &state) {                                             \
+        MempoolAcceptParallel(state, n);                                       \
+    }                                                                          \
+    BENCHMARK(MempoolAcceptParallel_##n##Threads);
+
+BENCHMARK(MempoolAcceptSerial);
+BENCHMARK(MempoolAcceptSingleSerial);
+BENCHMARK(MempoolAcceptSingleParallel);
+MEMPOOL_ACCEPT_PARALLEL_BENCHMARK(1)
+MEMPOOL_ACCEPT_PARALLEL_BENCHMARK(2)
+MEMPOOL_ACCEPT_PARALLEL_BENCHMARK(4)
+MEMPOOL_ACCEPT_PARALLEL_BENCHMARK(8)
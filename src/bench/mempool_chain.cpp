@@ -0,0 +1,97 @@
+// Copyright (c) 2018 The Title Network developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "policy/policy.h"
+#include "txmempool.h"
+
+#include <vector>
+
+static void AddTx(const CTransactionRef &tx, const Amount &nFee,
+                  CTxMemPool &pool) {
+    int64_t nTime = 0;
+    double dPriority = 10.0;
+    unsigned int nHeight = 1;
+    bool spendsCoinbase = false;
+    unsigned int sigOpCost = 4;
+    LockPoints lp;
+    pool.addUnchecked(tx->GetId(),
+                      CTxMemPoolEntry(tx, nFee, nTime, dPriority, nHeight,
+                                      tx->GetValueOut().GetSatoshis(),
+                                      spendsCoinbase, sigOpCost, lp));
+}
+
+// A chain of 25 transactions, each spending the one before, which is as long
+// as the default ancestor limit allows. The first one spends outpoint n of the
+// null hash, so that chains made with different n are unrelated.
+static std::vector<CTransactionRef> CreateChain(uint32_t n) {
+    std::vector<CTransactionRef> vtx;
+    COutPoint prevout(uint256(), n);
+    for (int i = 0; i < 25; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = prevout;
+        tx.vin[0].scriptSig = CScript() << OP_1;
+        tx.vout.resize(2);
+        tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        tx.vout[0].nValue = (50 - i) * COIN.GetSatoshis();
+        tx.vout[1].scriptPubKey = CScript() << OP_2 << OP_EQUAL;
+        tx.vout[1].nValue = COIN.GetSatoshis();
+        vtx.push_back(MakeTransactionRef(tx));
+        prevout = COutPoint(vtx.back()->GetId(), 0);
+    }
+    return vtx;
+}
+
+// Fill the mempool with 400 other chains, so that it is not tiny.
+static void FillPool(CTxMemPool &pool) {
+    for (uint32_t n = 1; n <= 400; n++) {
+        for (const CTransactionRef &tx : CreateChain(n)) {
+            AddTx(tx, Amount(2000LL), pool);
+        }
+    }
+}
+
+// Add the chain, so that every transaction walks all of its ancestors, then
+// confirm it one transaction at a time, as the chain would be mined.
+static void MempoolChain(benchmark::State &state) {
+    const std::vector<CTransactionRef> vtx = CreateChain(0);
+    CTxMemPool pool(CFeeRate(1000));
+    FillPool(pool);
+
+    while (state.KeepRunning()) {
+        for (const CTransactionRef &tx : vtx) {
+            AddTx(tx, Amount(1000LL), pool);
+        }
+        for (const CTransactionRef &tx : vtx) {
+            pool.removeForBlock(std::vector<CTransactionRef>(1, tx), 1);
+        }
+    }
+}
+
+// Add the chain, then evict it from the bottom, so that the whole package goes
+// at once.
+static void MempoolChainEviction(benchmark::State &state) {
+    const std::vector<CTransactionRef> vtx = CreateChain(0);
+    CTxMemPool pool(CFeeRate(1000));
+    FillPool(pool);
+    // Add and remove the chain once, so that the usage to trim down to
+    // includes any growth of the containers for it.
+    for (const CTransactionRef &tx : vtx) {
+        AddTx(tx, Amount(1000LL), pool);
+    }
+    pool.removeRecursive(*vtx[0]);
+    const size_t nUsage = pool.DynamicMemoryUsage();
+
+    while (state.KeepRunning()) {
+        for (const CTransactionRef &tx : vtx) {
+            AddTx(tx, Amount(1000LL), pool);
+        }
+        // The chain pays the lowest fees, so it goes first.
+        pool.TrimToSize(nUsage);
+    }
+}
+
+BENCHMARK(MempoolChain);
+BENCHMARK(MempoolChainEviction);
@@ -0,0 +1,75 @@
+// Copyright (c) 2018 The Title Network developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "arith_uint256.h"
+#include "chainparams.h"
+#include "hash_blake2.h"
+#include "primitives/block.h"
+#include "streams.h"
+#include "uint256.h"
+
+// Scaling applied to 0x21000000 Blake2b PoW hashes, via hex strings as it
+// used to be done.
+static void PowHashScaleHex(benchmark::State &state) {
+    uint256 hash = uint256S(
+        "7d1de5eaf9b156d53208f033b5aa8122d2d2355d5e12292b121156cfdb4a529c");
+    while (state.KeepRunning()) {
+        arith_uint256 bnPoW;
+        bnPoW.SetHex(hash.ToString());
+        bnPoW /= 4295032833;
+        uint256 rc;
+        rc.SetHex(bnPoW.GetHex());
+    }
+}
+
+static void PowHashScale(benchmark::State &state) {
+    uint256 hash = uint256S(
+        "7d1de5eaf9b156d53208f033b5aa8122d2d2355d5e12292b121156cfdb4a529c");
+    while (state.KeepRunning()) {
+        arith_uint256 bnPoW = UintToArith256(hash);
+        bnPoW.DivideBy(4295032833);
+        uint256 rc = ArithToUint256(bnPoW);
+    }
+}
+
+static void GetPoWHash_0x21000000(benchmark::State &state) {
+    CBlockHeader header;
+    header.nVersion = 0x21000000;
+    header.nBits = 0x1d00ffff;
+    const int nHeight = Params().GetConsensus().powBlake2Height + 1;
+    while (state.KeepRunning()) {
+        header.nNonce++;
+        header.GetPoWHash(nHeight);
+    }
+}
+
+// Blake2b header hash through a CDataStream and a digest vector, as
+// Blake2::SerializeHash used to do it.
+static void HeaderHashBlake2Stream(benchmark::State &state) {
+    CBlockHeader header;
+    while (state.KeepRunning()) {
+        header.nNonce++;
+        CDataStream ss(SER_GETHASH, PROTOCOL_VERSION);
+        ss << header;
+        uint8_t hash[32];
+        Blake2::hash2b(hash, sizeof(hash), ss.data(), ss.size());
+        uint256 rc(std::vector<uint8_t>(hash, hash + sizeof(hash)));
+    }
+}
+
+static void HeaderHashBlake2Writer(benchmark::State &state) {
+    CBlockHeader header;
+    while (state.KeepRunning()) {
+        header.nNonce++;
+        uint256 rc = Blake2::SerializeHash(header);
+    }
+}
+
+BENCHMARK(PowHashScaleHex);
+BENCHMARK(PowHashScale);
+BENCHMARK(GetPoWHash_0x21000000);
+BENCHMARK(HeaderHashBlake2Stream);
+BENCHMARK(HeaderHashBlake2Writer);
@@ -0,0 +1,109 @@
+// Copyright (c) 2018 The Title Network developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilemap.h"
+
+#include "util.h"
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CMappedFile::~CMappedFile() {
+#ifndef WIN32
+    munmap(const_cast<uint8_t *>(pdata), nSize);
+#endif
+}
+
+std::shared_ptr<const CMappedFile>
+CMappedFile::Open(const boost::filesystem::path &path) {
+#ifndef WIN32
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd == -1) {
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        LogPrintf("Unable to map %s\n", path.string());
+        return nullptr;
+    }
+
+    return std::make_shared<CMappedFile>(static_cast<const uint8_t *>(addr),
+                                         st.st_size);
+#else
+    return nullptr;
+#endif
+}
+
+void CBlockFileMapCache::SetMaxFiles(size_t nMaxFilesIn) {
+    LOCK(cs);
+    nMaxFiles = nMaxFilesIn;
+    if (vFiles.size() > nMaxFiles) {
+        vFiles.resize(nMaxFiles);
+    }
+}
+
+bool CBlockFileMapCache::IsEnabled() const {
+    LOCK(cs);
+    return nMaxFiles > 0;
+}
+
+std::shared_ptr<const CMappedFile>
+CBlockFileMapCache::Get(int nFile, const boost::filesystem::path &path,
+                        uint64_t nMinSize) {
+    LOCK(cs);
+    if (nMaxFiles == 0) {
+        return nullptr;
+    }
+
+    auto it = vFiles.begin();
+    while (it != vFiles.end() && it->first != nFile) {
+        ++it;
+    }
+    if (it != vFiles.end()) {
+        std::pair<int, std::shared_ptr<const CMappedFile>> entry =
+            std::move(*it);
+        vFiles.erase(it);
+        if (entry.second->size() >= nMinSize) {
+            vFiles.insert(vFiles.begin(), std::move(entry));
+            return vFiles.front().second;
+        }
+    }
+
+    std::shared_ptr<const CMappedFile> file = CMappedFile::Open(path);
+    if (!file || file->size() < nMinSize) {
+        return nullptr;
+    }
+    vFiles.insert(vFiles.begin(), std::make_pair(nFile, file));
+    if (vFiles.size() > nMaxFiles) {
+        vFiles.pop_back();
+    }
+    return file;
+}
+
+void CBlockFileMapCache::Invalidate(int nFile) {
+    LOCK(cs);
+    for (auto it = vFiles.begin(); it != vFiles.end(); ++it) {
+        if (it->first == nFile) {
+            vFiles.erase(it);
+            return;
+        }
+    }
+}
+
+void CBlockFileMapCache::Clear() {
+    LOCK(cs);
+    vFiles.clear();
+}
@@ -0,0 +1,75 @@
+// Copyright (c) 2018 The Title Network developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILEMAP_H
+#define BITCOIN_BLOCKFILEMAP_H
+
+#include "sync.h"
+
+#include <boost/filesystem/path.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/** A read-only memory mapping of a whole file. */
+class CMappedFile {
+private:
+    const uint8_t *pdata;
+    size_t nSize;
+
+    CMappedFile(const CMappedFile &);
+    CMappedFile &operator=(const CMappedFile &);
+
+public:
+    CMappedFile(const uint8_t *pdataIn, size_t nSizeIn)
+        : pdata(pdataIn), nSize(nSizeIn) {}
+    ~CMappedFile();
+
+    /** Map the file at path, or return nullptr if it cannot be mapped. */
+    static std::shared_ptr<const CMappedFile>
+    Open(const boost::filesystem::path &path);
+
+    const uint8_t *data() const { return pdata; }
+    size_t size() const { return nSize; }
+};
+
+/**
+ * Keeps the most recently read block files mapped into memory so blocks can be
+ * deserialized straight from the page cache. Mappings are handed out as
+ * shared pointers, so a file evicted or invalidated while a reader still uses
+ * it stays mapped until that reader is done.
+ */
+class CBlockFileMapCache {
+private:
+    mutable CCriticalSection cs;
+
+    //! Most recently used first.
+    std::vector<std::pair<int, std::shared_ptr<const CMappedFile>>> vFiles;
+
+    //! Maximum number of files kept mapped; zero disables mapping.
+    size_t nMaxFiles;
+
+public:
+    CBlockFileMapCache() : nMaxFiles(0) {}
+
+    void SetMaxFiles(size_t nMaxFilesIn);
+    bool IsEnabled() const;
+
+    /**
+     * Return a mapping of file nFile, found at path, that is at least nMinSize
+     * bytes long. The file is mapped again if it has grown since it was last
+     * mapped. Returns nullptr when mapping is disabled or fails.
+     */
+    std::shared_ptr<const CMappedFile>
+    Get(int nFile, const boost::filesystem::path &path, uint64_t nMinSize);
+
+    /** Drop the mapping of a file that is being truncated or removed. */
+    void Invalidate(int nFile);
+
+    void Clear();
+};
+
+#endif // BITCOIN_BLOCKFILEMAP_H
@@ -129,6 +129,21 @@ void CBlockIndex::BuildSkip() {
     }
 }
 
+CBlockIndex *CBlockIndexArena::Allocate(const CBlockHeader &block) {
+    if (nLastChunkUsed == CHUNK_SIZE) {
+        vChunks.emplace_back(new CBlockIndex[CHUNK_SIZE]);
+        nLastChunkUsed = 0;
+    }
+    CBlockIndex *pindex = &vChunks.back()[nLastChunkUsed++];
+    *pindex = CBlockIndex(block);
+    return pindex;
+}
+
+void CBlockIndexArena::Clear() {
+    vChunks.clear();
+    nLastChunkUsed = CHUNK_SIZE;
+}
+
 arith_uint256 GetBlockProof(const CBlockIndex &block) {
     arith_uint256 bnTarget;
     bool fNegative;
@@ -12,6 +12,7 @@
 #include "tinyformat.h"
 #include "uint256.h"
 
+#include <memory>
 #include <vector>
 
 class CBlockFileInfo {
@@ -169,6 +170,10 @@ enum BlockStatus : uint32_t {
  */
 class CBlockIndex {
 public:
+    // Fields read while walking the chain (GetAncestor, GetMedianTimePast,
+    // difficulty and chain work comparisons) come first so they share a cache
+    // line; the rest is only touched when a block is stored or connected.
+
     //! pointer to the hash of the block, if any. Memory is owned by this
     //! CBlockIndex
     const uint256 *phashBlock;
@@ -182,6 +187,20 @@ public:
     //! height of the entry in the chain. The genesis block has height 0
     int nHeight;
 
+    //! block header
+    uint32_t nTime;
+    uint32_t nBits;
+
+    //! Verification status of this block. See enum BlockStatus
+    uint32_t nStatus;
+
+    //! (memory only) Maximum nTime in the chain upto and including this block.
+    unsigned int nTimeMax;
+
+    //! (memory only) Total amount of work (expected number of hashes) in the
+    //! chain up to and including this block
+    arith_uint256 nChainWork;
+
     //! Which # file this block is stored in (blk?????.dat)
     int nFile;
 
@@ -191,10 +210,6 @@ public:
     //! Byte offset within rev?????.dat where this block's undo data is stored
     unsigned int nUndoPos;
 
-    //! (memory only) Total amount of work (expected number of hashes) in the
-    //! chain up to and including this block
-    arith_uint256 nChainWork;
-
     //! Number of transactions in this block.
     //! Note: in a potential headers-first mode, this number cannot be relied
     //! upon
@@ -207,22 +222,21 @@ public:
     //! necessary; won't happen before 2030
     unsigned int nChainTx;
 
-    //! Verification status of this block. See enum BlockStatus
-    uint32_t nStatus;
-
     //! block header
     int32_t nVersion;
     uint256 hashMerkleRoot;
-    uint32_t nTime;
-    uint32_t nBits;
     uint32_t nNonce;
 
     //! (memory only) Sequential id assigned to distinguish order in which
     //! blocks are received.
     int32_t nSequenceId;
 
-    //! (memory only) Maximum nTime in the chain upto and including this block.
-    unsigned int nTimeMax;
+    //! (memory only) GetNextCoreWorkRequired for the child of this block,
+    //! valid when pNextWorkParams points to the consensus parameters it was
+    //! computed with. It only depends on this block's ancestry, which never
+    //! changes. Protected by cs_main.
+    mutable uint32_t nNextWorkRequired;
+    mutable const Consensus::Params *pNextWorkParams;
 
     void SetNull() {
         phashBlock = nullptr;
@@ -238,6 +252,8 @@ public:
         nStatus = 0;
         nSequenceId = 0;
         nTimeMax = 0;
+        nNextWorkRequired = 0;
+        pNextWorkParams = nullptr;
 
         nVersion = 0;
         hashMerkleRoot = uint256();
@@ -356,6 +372,46 @@ public:
     const CBlockIndex *GetAncestor(int height) const;
 };
 
+/**
+ * Owns block index entries, handing them out from large contiguous chunks
+ * instead of one heap node each. Entries are never freed individually, so
+ * pointers to them stay valid until Clear(). Entries allocated one after the
+ * other (for instance while loading the index in height order) sit next to
+ * each other in memory, which keeps chain walks within a few cache lines.
+ */
+class CBlockIndexArena {
+public:
+    //! Number of entries in each chunk.
+    static const size_t CHUNK_SIZE = 4096;
+
+private:
+    std::vector<std::unique_ptr<CBlockIndex[]>> vChunks;
+
+    //! Entries handed out from the last chunk.
+    size_t nLastChunkUsed;
+
+public:
+    CBlockIndexArena() : nLastChunkUsed(CHUNK_SIZE) {}
+
+    /** Return a new entry initialized from the given header. */
+    CBlockIndex *Allocate(const CBlockHeader &block = CBlockHeader());
+
+    /** Release every entry at once. */
+    void Clear();
+
+    //! Number of entries handed out since the last Clear().
+    size_t Size() const {
+        return vChunks.empty()
+                   ? 0
+                   : (vChunks.size() - 1) * CHUNK_SIZE + nLastChunkUsed;
+    }
+
+    //! Memory held by the chunks, including entries not handed out yet.
+    size_t DynamicMemoryUsage() const {
+        return vChunks.size() * CHUNK_SIZE * sizeof(CBlockIndex);
+    }
+};
+
 arith_uint256 GetBlockProof(const CBlockIndex &block);
 
 /**
@@ -410,7 +466,7 @@ public:
         READWRITE(nNonce);
     }
 
-    uint256 GetBlockHash() const {
+    CBlockHeader GetBlockHeader() const {
         CBlockHeader block;
         block.nVersion = nVersion;
         block.hashPrevBlock = hashPrev;
@@ -418,9 +474,11 @@ public:
         block.nTime = nTime;
         block.nBits = nBits;
         block.nNonce = nNonce;
-        return block.GetHash();
+        return block;
     }
 
+    uint256 GetBlockHash() const { return GetBlockHeader().GetHash(); }
+
     std::string ToString() const {
         std::string str = "CDiskBlockIndex(";
         str += CBlockIndex::ToString();
@@ -289,6 +289,9 @@ public:
             245734254,
             // Estimated number of transactions per second after that timestamp.
             0.01};
+
+        // UTXO set snapshots, by block hash. None have been published yet.
+        mapSnapshots = {};
     }
 };
 static CMainParams mainParams;
@@ -428,6 +431,8 @@ public:
         // 02b4614f9a5ddb8937835e4b871fccda4bcdd9741f349005444e8c84a8cfbcc8
         // (height 421382)
         chainTxData = ChainTxData{1531625001, 421382, 1.09};
+
+        mapSnapshots = {};
     }
 };
 static CTestNetParams testNetParams;
@@ -440,6 +445,7 @@ public:
     CRegTestParams() {
         strNetworkID = "regtest";
         consensus.nSubsidyHalvingInterval = 150;
+        consensus.nSubsidyHalvingIntervalOneMinute = 150 * 10;
         // BIP34 has not activated on regtest (far in the future so block v1 are
         // not rejected in tests)
         consensus.BIP34Height = 100000000;
@@ -528,6 +534,8 @@ public:
 
         chainTxData = ChainTxData{0, 0, 0};
 
+        mapSnapshots = {};
+
         base58Prefixes[PUBKEY_ADDRESS] = std::vector<uint8_t>(1, 111);
         base58Prefixes[SCRIPT_ADDRESS] = std::vector<uint8_t>(1, 196);
         base58Prefixes[SECRET_KEY] = std::vector<uint8_t>(1, 239);
@@ -11,6 +11,7 @@
 #include "primitives/block.h"
 #include "protocol.h"
 
+#include <map>
 #include <vector>
 
 struct CDNSSeedData {
@@ -39,6 +40,19 @@ struct ChainTxData {
     double dTxRate;
 };
 
+/**
+ * A UTXO set snapshot, keyed by the hash of the block it was taken at, that
+ * nodes may load instead of connecting the blocks up to it.
+ */
+struct SnapshotData {
+    //! MuHash of the UTXO set as of the block.
+    uint256 hashUTXOSet;
+    //! Number of transactions from genesis up to and including the block.
+    int64_t nChainTx;
+};
+
+typedef std::map<uint256, SnapshotData> MapSnapshots;
+
 /**
  * CChainParams defines various tweakable parameters of a given instance of the
  * Bitcoin system. There are three: the main network on which people trade goods
@@ -90,6 +104,7 @@ public:
     const std::vector<SeedSpec6> &FixedSeeds() const { return vFixedSeeds; }
     const CCheckpointData &Checkpoints() const { return checkpointData; }
     const ChainTxData &TxData() const { return chainTxData; }
+    const MapSnapshots &Snapshots() const { return mapSnapshots; }
 
 protected:
     CChainParams() {}
@@ -111,6 +126,7 @@ protected:
     bool fMineBlocksOnDemand;
     CCheckpointData checkpointData;
     ChainTxData chainTxData;
+    MapSnapshots mapSnapshots;
 };
 
 /**
@@ -27,4 +27,12 @@ CBlockIndex *GetLastCheckpoint(const CCheckpointData &data) {
     return nullptr;
 }
 
+int GetLastCheckpointHeight(const CCheckpointData &data) {
+    const MapCheckpoints &checkpoints = data.mapCheckpoints;
+    if (checkpoints.empty()) {
+        return -1;
+    }
+    return checkpoints.rbegin()->first;
+}
+
 } // namespace Checkpoints
@@ -21,6 +21,9 @@ namespace Checkpoints {
 //! Returns last CBlockIndex* in mapBlockIndex that is a checkpoint
 CBlockIndex *GetLastCheckpoint(const CCheckpointData &data);
 
+//! Returns the height of the last checkpoint, or -1 if there are none
+int GetLastCheckpointHeight(const CCheckpointData &data);
+
 } // namespace Checkpoints
 
 #endif // BITCOIN_CHECKPOINTS_H
@@ -6,6 +6,8 @@
 #define BITCOIN_CHECKQUEUE_H
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
 #include <vector>
 
 #include <boost/thread/condition_variable.hpp>
@@ -23,10 +25,37 @@ template <typename T> class CCheckQueueControl;
  * queue, where they are processed by N-1 worker threads. When the master is
  * done adding work, it temporarily joins the worker pool as an N'th worker,
  * until all jobs are done.
+ *
+ * Every worker owns a deque of pending checks. The master deals each batch it
+ * adds to one of them in turn; a worker takes checks from the back of its own
+ * deque and, once that is empty, steals from the front of the others. Each
+ * deque has its own lock, so workers only contend when they touch the same
+ * deque, and the shared mutex is only taken to put idle threads to sleep or
+ * wake them up. A failed check is seen by all workers at once, which then
+ * drop their remaining checks without running them.
  */
 template <typename T> class CCheckQueue {
 private:
-    //! Mutex to protect the inner state
+    //! Number of per-worker deques. Slot 0 belongs to the master; workers
+    //! beyond the last slot share deques with earlier ones.
+    static const unsigned int MAX_QUEUES = 64;
+
+    struct WorkQueue {
+        boost::mutex mutex;
+        //! Checks waiting to run; the owner pops at the back, thieves at the
+        //! front.
+        std::deque<T> checks;
+        //! Size of checks, readable without taking mutex.
+        std::atomic<size_t> nSize;
+        //! Keep neighbouring deques on separate cache lines.
+        char padding[64];
+
+        WorkQueue() : nSize(0) {}
+    };
+
+    WorkQueue queues[MAX_QUEUES];
+
+    //! Mutex protecting the sleep and wake-up of idle threads.
     boost::mutex mutex;
 
     //! Worker threads block on this when out of work
@@ -35,131 +64,194 @@ private:
     //! Master thread blocks on this when out of work
     boost::condition_variable condMaster;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
+    //! The number of worker threads that are asleep on condWorker.
+    std::atomic<int> nIdle;
 
-    //! The number of workers (including the master) that are idle.
-    int nIdle;
+    //! The number of worker threads that have started.
+    std::atomic<unsigned int> nWorkers;
 
-    //! The total number of workers (including the master).
-    int nTotal;
+    //! The deque the next batch from Add goes to.
+    std::atomic<unsigned int> nNextQueue;
 
     //! The temporary evaluation result.
-    bool fAllOk;
+    std::atomic<bool> fAllOk;
 
     /**
      * Number of verifications that haven't completed yet.
      * This includes elements that are no longer queued, but still in the
      * worker's own batches.
      */
-    unsigned int nTodo;
+    std::atomic<unsigned int> nTodo;
 
-    //! Whether we're shutting down.
-    bool fQuit;
+    //! Number of verifications still sitting in a deque.
+    std::atomic<unsigned int> nQueued;
 
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
-    /** Internal function that does bulk of the verification work. */
-    bool Loop(bool fMaster = false) {
-        boost::condition_variable &cond = fMaster ? condMaster : condWorker;
-        std::vector<T> vChecks;
-        vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
-        do {
-            {
-                boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us
-                // to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master it
-                        // can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
-                    nTotal++;
-                }
-                // logically, the do loop starts here
-                while (queue.empty()) {
-                    if ((fMaster || fQuit) && nTodo == 0) {
-                        nTotal--;
-                        bool fRet = fAllOk;
-                        // reset the status for new work later
-                        if (fMaster) fAllOk = true;
-                        // return the current status
-                        return fRet;
-                    }
-                    nIdle++;
-                    cond.wait(lock); // wait
-                    nIdle--;
-                }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for
-                // increasingly smaller batches so all workers finish
-                // approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start
-                // helping.
-                // * Don't do batches smaller than 1 (duh), or larger than
-                // nBatchSize.
-                nNow = std::max(
-                    1U, std::min(nBatchSize, (unsigned int)queue.size() /
-                                                 (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible,
-                    // so swap jobs from the global queue to the local batch
-                    // vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
-                }
-                // Check whether we need to do work at all
-                fOk = fAllOk;
+    unsigned int ActiveQueues() const {
+        unsigned int nActive = nWorkers.load() + 1;
+        return nActive < MAX_QUEUES ? nActive : MAX_QUEUES;
+    }
+
+    /**
+     * Move up to nBatchSize checks from queue nQueue into vChecks, leaving at
+     * least half of them behind for other workers to steal.
+     */
+    bool TakeFrom(unsigned int nQueue, bool fOwner, std::vector<T> &vChecks) {
+        WorkQueue &wq = queues[nQueue];
+        if (wq.nSize.load(std::memory_order_relaxed) == 0) {
+            return false;
+        }
+        boost::unique_lock<boost::mutex> lock(wq.mutex);
+        size_t nSize = wq.checks.size();
+        if (nSize == 0) {
+            return false;
+        }
+        size_t nNow = std::max<size_t>(1, std::min<size_t>(nBatchSize,
+                                                           nSize / 2));
+        vChecks.resize(nNow);
+        for (size_t i = 0; i < nNow; i++) {
+            // Swap jobs out of the deque to keep the lock as short as possible.
+            if (fOwner) {
+                vChecks[i].swap(wq.checks.back());
+                wq.checks.pop_back();
+            } else {
+                vChecks[i].swap(wq.checks.front());
+                wq.checks.pop_front();
             }
-            // execute work
-            for (T &check : vChecks) {
-                if (fOk) fOk = check();
+        }
+        wq.nSize.store(wq.checks.size(), std::memory_order_relaxed);
+        nQueued -= nNow;
+        return true;
+    }
+
+    /** Take a batch from our own deque, or failing that, steal one. */
+    bool Take(unsigned int nQueue, std::vector<T> &vChecks) {
+        if (TakeFrom(nQueue, true, vChecks)) {
+            return true;
+        }
+        unsigned int nActive = ActiveQueues();
+        for (unsigned int i = 1; i < nActive; i++) {
+            if (TakeFrom((nQueue + i) % nActive, false, vChecks)) {
+                return true;
             }
-            vChecks.clear();
-        } while (true);
+        }
+        return false;
+    }
+
+    /** Run a batch and account for it once it is done. */
+    void Run(std::vector<T> &vChecks, bool fMaster) {
+        unsigned int nNow = vChecks.size();
+        for (T &check : vChecks) {
+            // Skip the rest as soon as any worker has seen a failure.
+            if (!fAllOk.load(std::memory_order_relaxed)) {
+                break;
+            }
+            if (!check()) {
+                fAllOk = false;
+                break;
+            }
+        }
+        // Checks may refer to data owned by the master, so they must be gone
+        // before it can see the batch as completed.
+        vChecks.clear();
+        if ((nTodo -= nNow) == 0 && !fMaster) {
+            // We processed the last element; inform the master it can exit
+            // and return the result
+            boost::unique_lock<boost::mutex> lock(mutex);
+            condMaster.notify_one();
+        }
     }
 
 public:
     //! Create a new check queue
     CCheckQueue(unsigned int nBatchSizeIn)
-        : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), fQuit(false),
-          nBatchSize(nBatchSizeIn) {}
+        : nIdle(0), nWorkers(0), nNextQueue(0), fAllOk(true), nTodo(0),
+          nQueued(0), nBatchSize(nBatchSizeIn) {}
 
     //! Worker thread
-    void Thread() { Loop(); }
+    void Thread() {
+        unsigned int nQueue = 1 + nWorkers++ % (MAX_QUEUES - 1);
+        std::vector<T> vChecks;
+        vChecks.reserve(nBatchSize);
+        while (true) {
+            if (Take(nQueue, vChecks)) {
+                Run(vChecks, false);
+                continue;
+            }
+            boost::unique_lock<boost::mutex> lock(mutex);
+            // Announce that we are about to sleep before looking at nQueued
+            // one last time; Add does the opposite, so one of us always sees
+            // the other.
+            nIdle++;
+            if (nQueued == 0) {
+                // Interruption point; this is how worker threads exit.
+                try {
+                    condWorker.wait(lock);
+                } catch (...) {
+                    nIdle--;
+                    throw;
+                }
+            }
+            nIdle--;
+        }
+    }
 
     //! Wait until execution finishes, and return whether all evaluations were
     //! successful.
-    bool Wait() { return Loop(true); }
+    bool Wait() {
+        std::vector<T> vChecks;
+        vChecks.reserve(nBatchSize);
+        while (nTodo != 0) {
+            if (Take(0, vChecks)) {
+                Run(vChecks, true);
+                continue;
+            }
+            // Everything left is being run by the workers.
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (nTodo != 0 && nQueued == 0) {
+                condMaster.wait(lock);
+            }
+        }
+        // reset the status for new work later
+        return fAllOk.exchange(true);
+    }
 
     //! Add a batch of checks to the queue
     void Add(std::vector<T> &vChecks) {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        for (T &check : vChecks) {
-            queue.push_back(std::move(check));
+        if (vChecks.empty()) {
+            return;
+        }
+        if (!fAllOk.load(std::memory_order_relaxed)) {
+            // The result is already known to be a failure.
+            return;
         }
+        unsigned int nQueue = nNextQueue++ % ActiveQueues();
         nTodo += vChecks.size();
-        if (vChecks.size() == 1) {
-            condWorker.notify_one();
-        } else if (vChecks.size() > 1) {
-            condWorker.notify_all();
+        {
+            WorkQueue &wq = queues[nQueue];
+            boost::unique_lock<boost::mutex> lock(wq.mutex);
+            for (T &check : vChecks) {
+                wq.checks.push_back(std::move(check));
+            }
+            wq.nSize.store(wq.checks.size(), std::memory_order_relaxed);
+            nQueued += vChecks.size();
+        }
+        if (nIdle > 0) {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (vChecks.size() == 1) {
+                condWorker.notify_one();
+            } else {
+                condWorker.notify_all();
+            }
         }
     }
 
     ~CCheckQueue() {}
 
     bool IsIdle() {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        return (nTotal == nIdle && nTodo == 0 && fAllOk == true);
+        return nTodo == 0 && nQueued == 0 && fAllOk;
     }
 };
 
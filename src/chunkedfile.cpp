@@ -0,0 +1,89 @@
+// Copyright (c) 2018 The Title Network developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chunkedfile.h"
+
+#include "crypto/common.h"
+#include "util.h"
+
+#include <boost/filesystem/operations.hpp>
+
+CChunkedFileWriter::CChunkedFileWriter(
+    const boost::filesystem::path &pathIn,
+    const boost::filesystem::path &pathTempIn, uint32_t nMaxChunkRecordsIn)
+    : path(pathIn), pathTemp(pathTempIn),
+      file(fopen(pathTemp.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION),
+      nMaxChunkRecords(nMaxChunkRecordsIn), nChunkRecords(0), nWritten(0),
+      fFinished(false) {
+    if (file.IsNull()) {
+        throw std::ios_base::failure("Unable to open " + pathTemp.string());
+    }
+    // Room for the number of records, which is filled in by WriteChunk.
+    vChunk.resize(sizeof(uint32_t));
+}
+
+CChunkedFileWriter::~CChunkedFileWriter() {
+    if (!fFinished) {
+        file.fclose();
+        boost::system::error_code ec;
+        boost::filesystem::remove(pathTemp, ec);
+    }
+}
+
+void CChunkedFileWriter::WriteChunk() {
+    WriteLE32(vChunk.data(), nChunkRecords);
+    CHashWriter hasher(SER_GETHASH, 0);
+    hasher << hashChecksum;
+    hasher.write((const char *)vChunk.data(), vChunk.size());
+    hashChecksum = hasher.GetHash();
+
+    file.write((const char *)vChunk.data(), vChunk.size());
+    file << hashChecksum;
+    vChunk.resize(sizeof(uint32_t));
+    nChunkRecords = 0;
+}
+
+void CChunkedFileWriter::Commit() {
+    FileCommit(file.Get());
+    file.fclose();
+    if (!RenameOver(pathTemp, path)) {
+        throw std::ios_base::failure("Unable to rename " + pathTemp.string() +
+                                     " to " + path.string());
+    }
+    fFinished = true;
+}
+
+CChunkedFileReader::CChunkedFileReader(FILE *filestr,
+                                       uint32_t nMaxChunkRecordsIn,
+                                       const std::string &strNameIn)
+    : file(filestr, SER_DISK, CLIENT_VERSION),
+      nMaxChunkRecords(nMaxChunkRecordsIn), strName(strNameIn), nRead(0),
+      fDone(false) {
+    if (file.IsNull()) {
+        throw std::ios_base::failure("Unable to open " + strName);
+    }
+}
+
+void CChunkedFileReader::Rewind() {
+    if (fseek(file.Get(), 0, SEEK_SET) != 0) {
+        throw std::ios_base::failure("Unable to rewind " + strName);
+    }
+}
+
+void CChunkedFileReader::CheckChunkSize(uint32_t nCount) const {
+    if (nCount > nMaxChunkRecords) {
+        throw std::ios_base::failure("Oversized chunk in " + strName);
+    }
+}
+
+void CChunkedFileReader::CheckChunk(const uint256 &hashExpected,
+                                    uint32_t nCount, uint64_t nTotal) {
+    file >> hashChecksum;
+    if (hashChecksum != hashExpected) {
+        throw std::ios_base::failure("Checksum mismatch in " + strName);
+    }
+    if (nCount == 0 && nTotal != nRead) {
+        throw std::ios_base::failure("Record count mismatch in " + strName);
+    }
+}
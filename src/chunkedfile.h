@@ -0,0 +1,174 @@
+// Copyright (c) 2018 The Title Network developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CHUNKEDFILE_H
+#define BITCOIN_CHUNKEDFILE_H
+
+#include "clientversion.h"
+#include "hash.h"
+#include "serialize.h"
+#include "streams.h"
+#include "uint256.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+/**
+ * Writes a file made up of a header followed by chunks of records, as UTXO
+ * snapshots and mempool.dat are.
+ *
+ * Each chunk is made up of its number of records, the records and a checksum.
+ * The last chunk is empty and holds the total number of records and a trailer
+ * instead. The checksum of a chunk is the hash of the checksum before it (the
+ * hash of the header, for the first) and of the chunk, so that a reader
+ * notices corruption, truncation and reordering as soon as it gets to the
+ * chunk involved, and can still use every chunk before it.
+ *
+ * The file is written to a temporary path and only moved to its final path by
+ * Finish, so that an interrupted write leaves nothing behind. Errors are
+ * thrown as std::ios_base::failure.
+ */
+class CChunkedFileWriter {
+private:
+    boost::filesystem::path path;
+    boost::filesystem::path pathTemp;
+    CAutoFile file;
+    const uint32_t nMaxChunkRecords;
+    uint256 hashChecksum;
+    std::vector<uint8_t> vChunk;
+    uint32_t nChunkRecords;
+    uint64_t nWritten;
+    bool fFinished;
+
+    CChunkedFileWriter(const boost::filesystem::path &pathIn,
+                       const boost::filesystem::path &pathTempIn,
+                       uint32_t nMaxChunkRecordsIn);
+
+    void WriteChunk();
+    //! Sync the file and move it into place.
+    void Commit();
+
+public:
+    template <typename Header>
+    CChunkedFileWriter(const boost::filesystem::path &pathIn,
+                       const boost::filesystem::path &pathTempIn,
+                       uint32_t nMaxChunkRecordsIn, const Header &header)
+        : CChunkedFileWriter(pathIn, pathTempIn, nMaxChunkRecordsIn) {
+        file << header;
+        hashChecksum = SerializeHash(header);
+    }
+    ~CChunkedFileWriter();
+
+    //! Add a record made up of args, serialized one after the other.
+    template <typename... Args> void Add(const Args &... args) {
+        CVectorWriter(SER_DISK, CLIENT_VERSION, vChunk, vChunk.size(),
+                      args...);
+        nWritten++;
+        if (++nChunkRecords == nMaxChunkRecords) {
+            WriteChunk();
+        }
+    }
+
+    //! Write the last chunk, holding trailer, and move the file into place.
+    template <typename Trailer> void Finish(const Trailer &trailer) {
+        if (nChunkRecords > 0) {
+            WriteChunk();
+        }
+        CVectorWriter(SER_DISK, CLIENT_VERSION, vChunk, vChunk.size(),
+                      nWritten, trailer);
+        WriteChunk();
+        Commit();
+    }
+
+    uint64_t GetRecordsWritten() const { return nWritten; }
+};
+
+/**
+ * Reads a file written by CChunkedFileWriter a chunk at a time. The records
+ * of a chunk are only handed out once its checksum is verified. Errors,
+ * including corruption, are thrown as std::ios_base::failure, with strName
+ * saying what the file holds.
+ */
+class CChunkedFileReader {
+private:
+    CAutoFile file;
+    const uint32_t nMaxChunkRecords;
+    const std::string strName;
+    uint256 hashChecksum;
+    uint64_t nRead;
+    bool fDone;
+
+    void CheckChunkSize(uint32_t nCount) const;
+    //! Read the checksum after a chunk and compare it with hashExpected, and
+    //! for the last chunk, nTotal with the number of records read.
+    void CheckChunk(const uint256 &hashExpected, uint32_t nCount,
+                    uint64_t nTotal);
+
+public:
+    //! Takes ownership of filestr.
+    CChunkedFileReader(FILE *filestr, uint32_t nMaxChunkRecordsIn,
+                       const std::string &strNameIn);
+
+    //! Read the header, which the chunks start from.
+    template <typename Header> void ReadHeader(Header &header) {
+        file >> header;
+        hashChecksum = SerializeHash(header);
+        nRead = 0;
+        fDone = false;
+    }
+    //! Go back to the start of the file, where the header is read again.
+    void Rewind();
+
+    /**
+     * Read the next chunk into vRecords. Returns false at the end of the file,
+     * once the trailer is read into trailer.
+     */
+    template <typename Record, typename Trailer>
+    bool ReadChunk(std::vector<Record> &vRecords, Trailer &trailer) {
+        vRecords.clear();
+        if (fDone) {
+            return false;
+        }
+
+        CHashVerifier<CAutoFile> verifier(&file);
+        verifier << hashChecksum;
+        uint32_t nCount;
+        verifier >> nCount;
+        CheckChunkSize(nCount);
+        uint64_t nTotal = 0;
+        Trailer trailerRead;
+        std::vector<Record> vRead(nCount);
+        if (nCount == 0) {
+            verifier >> nTotal >> trailerRead;
+        } else {
+            for (Record &record : vRead) {
+                verifier >> record;
+            }
+        }
+        CheckChunk(verifier.GetHash(), nCount, nTotal);
+
+        if (nCount == 0) {
+            trailer = std::move(trailerRead);
+            fDone = true;
+            return false;
+        }
+        nRead += nCount;
+        vRecords.swap(vRead);
+        return true;
+    }
+
+    //! The file, for anything read from it around the chunks.
+    CAutoFile &GetFile() { return file; }
+
+    uint64_t GetRecordsRead() const { return nRead; }
+    //! The checksum of the last chunk read, which covers all before it.
+    const uint256 &GetChecksum() const { return hashChecksum; }
+};
+
+#endif // BITCOIN_CHUNKEDFILE_H
@@ -7,9 +7,51 @@
 #include "consensus/consensus.h"
 #include "memusage.h"
 #include "random.h"
+#include "streams.h"
+#include "version.h"
 
 #include <cassert>
 
+/**
+ * Hash a coin as its outpoint, height and coinbase flag, and output, so that
+ * the commitment only depends on the set and not on how it is stored.
+ */
+static void CommitmentElement(CDataStream &ss, const COutPoint &outpoint,
+                              const Coin &coin) {
+    ss << outpoint;
+    ss << uint32_t(coin.GetHeight() * 2 + coin.IsCoinBase());
+    ss << coin.GetTxOut();
+}
+
+void CCoinsCommitment::Add(const COutPoint &outpoint, const Coin &coin) {
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    CommitmentElement(ss, outpoint, coin);
+    muhash.Insert((const uint8_t *)ss.data(), ss.size());
+    nTransactionOutputs++;
+    nTotalAmount += coin.GetTxOut().nValue;
+}
+
+void CCoinsCommitment::Remove(const COutPoint &outpoint, const Coin &coin) {
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    CommitmentElement(ss, outpoint, coin);
+    muhash.Remove((const uint8_t *)ss.data(), ss.size());
+    nTransactionOutputs--;
+    nTotalAmount -= coin.GetTxOut().nValue;
+}
+
+void CCoinsCommitment::Combine(const CCoinsCommitment &delta) {
+    muhash *= delta.muhash;
+    nTransactionOutputs += delta.nTransactionOutputs;
+    nTotalAmount += delta.nTotalAmount;
+}
+
+uint256 CCoinsCommitment::GetHash() const {
+    MuHash3072 copy = muhash;
+    uint256 hash;
+    copy.Finalize(hash.begin());
+    return hash;
+}
+
 bool CCoinsView::GetCoin(const COutPoint &outpoint, Coin &coin) const {
     return false;
 }
@@ -22,9 +64,23 @@ uint256 CCoinsView::GetBestBlock() const {
 bool CCoinsView::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     return false;
 }
+bool CCoinsView::BatchWriteSnapshot(const CCoinsMap &mapCoins,
+                                    const uint256 &hashBlock) {
+    return false;
+}
 CCoinsViewCursor *CCoinsView::Cursor() const {
     return nullptr;
 }
+std::vector<std::unique_ptr<CCoinsViewCursor>>
+CCoinsView::RangeCursors(size_t nRanges) const {
+    return std::vector<std::unique_ptr<CCoinsViewCursor>>();
+}
+
+void CCoinsView::SetCommitment(const uint256 &hashBlock,
+                               const CCoinsCommitment &commitment) {}
+bool CCoinsView::GetCommitment(CCoinsCommitment &commitment) const {
+    return false;
+}
 
 CCoinsViewBacked::CCoinsViewBacked(CCoinsView *viewIn) : base(viewIn) {}
 bool CCoinsViewBacked::GetCoin(const COutPoint &outpoint, Coin &coin) const {
@@ -43,9 +99,24 @@ bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins,
                                   const uint256 &hashBlock) {
     return base->BatchWrite(mapCoins, hashBlock);
 }
+bool CCoinsViewBacked::BatchWriteSnapshot(const CCoinsMap &mapCoins,
+                                          const uint256 &hashBlock) {
+    return base->BatchWriteSnapshot(mapCoins, hashBlock);
+}
 CCoinsViewCursor *CCoinsViewBacked::Cursor() const {
     return base->Cursor();
 }
+std::vector<std::unique_ptr<CCoinsViewCursor>>
+CCoinsViewBacked::RangeCursors(size_t nRanges) const {
+    return base->RangeCursors(nRanges);
+}
+void CCoinsViewBacked::SetCommitment(const uint256 &hashBlock,
+                                     const CCoinsCommitment &commitment) {
+    base->SetCommitment(hashBlock, commitment);
+}
+bool CCoinsViewBacked::GetCommitment(CCoinsCommitment &commitment) const {
+    return base->GetCommitment(commitment);
+}
 size_t CCoinsViewBacked::EstimateSize() const {
     return base->EstimateSize();
 }
@@ -172,6 +243,16 @@ bool CCoinsViewCache::HaveCoinInCache(const COutPoint &outpoint) const {
     return it != cacheCoins.end();
 }
 
+void CCoinsViewCache::AddFetchedCoin(const COutPoint &outpoint, Coin &&coin) {
+    assert(!coin.IsSpent());
+    auto inserted = cacheCoins.emplace(std::piecewise_construct,
+                                       std::forward_as_tuple(outpoint),
+                                       std::forward_as_tuple(std::move(coin)));
+    if (inserted.second) {
+        cachedCoinsUsage += inserted.first->second.coin.DynamicMemoryUsage();
+    }
+}
+
 uint256 CCoinsViewCache::GetBestBlock() const {
     if (hashBlock.IsNull()) {
         hashBlock = base->GetBestBlock();
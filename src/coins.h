@@ -8,13 +8,16 @@
 
 #include "compressor.h"
 #include "core_memusage.h"
+#include "crypto/muhash.h"
 #include "hash.h"
 #include "memusage.h"
+#include "poolmap.h"
 #include "serialize.h"
 #include "uint256.h"
 
 #include <cassert>
 #include <cstdint>
+#include <memory>
 
 #include <unordered_map>
 
@@ -70,6 +73,43 @@ public:
     }
 };
 
+/**
+ * A rolling commitment to a set of coins: the MuHash of the set together with
+ * its size and total value. Coins can be added and removed in any order, so
+ * the commitment to the UTXO set can be kept up to date block by block, and
+ * the commitment to the changes of a block can be combined into it later.
+ * Counts are signed because a set of changes may remove more than it adds.
+ */
+class CCoinsCommitment {
+private:
+    MuHash3072 muhash;
+    int64_t nTransactionOutputs;
+    Amount nTotalAmount;
+
+public:
+    CCoinsCommitment() : nTransactionOutputs(0), nTotalAmount(0) {}
+
+    void Add(const COutPoint &outpoint, const Coin &coin);
+    void Remove(const COutPoint &outpoint, const Coin &coin);
+
+    //! Apply a commitment to a set of changes on top of this one.
+    void Combine(const CCoinsCommitment &delta);
+
+    //! The MuHash digest of the committed set.
+    uint256 GetHash() const;
+    int64_t GetTransactionOutputs() const { return nTransactionOutputs; }
+    Amount GetTotalAmount() const { return nTotalAmount; }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream &s, Operation ser_action) {
+        READWRITE(muhash);
+        READWRITE(nTransactionOutputs);
+        READWRITE(nTotalAmount);
+    }
+};
+
 class SaltedOutpointHasher {
 private:
     /** Salt */
@@ -113,8 +153,7 @@ struct CCoinsCacheEntry {
         : coin(std::move(coinIn)), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher>
-    CCoinsMap;
+typedef poolmap<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor {
@@ -153,9 +192,28 @@ public:
     //! The passed mapCoins can be modified.
     virtual bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
 
+    //! Like BatchWrite, but leave mapCoins untouched so that other threads
+    //! can keep reading it meanwhile. Returns false if not implemented.
+    virtual bool BatchWriteSnapshot(const CCoinsMap &mapCoins,
+                                    const uint256 &hashBlock);
+
     //! Get a cursor to iterate over the whole state
     virtual CCoinsViewCursor *Cursor() const;
 
+    //! Get cursors over nRanges disjoint parts of the state that together
+    //! cover all of it and read the same snapshot, so that it can be walked
+    //! by several threads. Empty if not implemented.
+    virtual std::vector<std::unique_ptr<CCoinsViewCursor>>
+    RangeCursors(size_t nRanges) const;
+
+    //! Stage the commitment to the coins as of hashBlock, to be written
+    //! together with the coins once hashBlock becomes the best block.
+    virtual void SetCommitment(const uint256 &hashBlock,
+                               const CCoinsCommitment &commitment);
+
+    //! Retrieve the stored commitment, if it matches the best block.
+    virtual bool GetCommitment(CCoinsCommitment &commitment) const;
+
     //! As we use CCoinsViews polymorphically, have a virtual destructor
     virtual ~CCoinsView() {}
 
@@ -175,7 +233,14 @@ public:
     uint256 GetBestBlock() const override;
     void SetBackend(CCoinsView &viewIn);
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool BatchWriteSnapshot(const CCoinsMap &mapCoins,
+                            const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
+    std::vector<std::unique_ptr<CCoinsViewCursor>>
+    RangeCursors(size_t nRanges) const override;
+    void SetCommitment(const uint256 &hashBlock,
+                       const CCoinsCommitment &commitment) override;
+    bool GetCommitment(CCoinsCommitment &commitment) const override;
     size_t EstimateSize() const override;
 };
 
@@ -211,6 +276,13 @@ public:
      */
     bool HaveCoinInCache(const COutPoint &outpoint) const;
 
+    /**
+     * Cache a coin that was read from the backing CCoinsView, unless there is
+     * an entry for the outpoint already. The backing view must not have been
+     * written to since the coin was read.
+     */
+    void AddFetchedCoin(const COutPoint &outpoint, Coin &&coin);
+
     /**
      * Return a reference to a Coin in the cache, or a pruned one if not found.
      * This is more efficient than GetCoin. Modifications to other cache entries
@@ -0,0 +1,142 @@
+// Copyright (c) 2018 The Title Network developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// This is a 2-way transposed Blake2b-256 for 80-byte block headers. Each
+// 128-bit register holds the same state word for two independent inputs; the
+// 4-way entry point runs it over two pairs.
+
+#ifdef ENABLE_SSE41
+
+#include "crypto/common.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <immintrin.h>
+
+namespace blake2b_sse41 {
+namespace {
+
+const uint64_t IV[8] = {0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+                        0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+                        0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+                        0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL};
+
+const uint8_t SIGMA[12][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+    {11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4},
+    {7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8},
+    {9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13},
+    {2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9},
+    {12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11},
+    {13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10},
+    {6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5},
+    {10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0},
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3}};
+
+inline __m128i Add(__m128i x, __m128i y) {
+    return _mm_add_epi64(x, y);
+}
+inline __m128i Xor(__m128i x, __m128i y) {
+    return _mm_xor_si128(x, y);
+}
+inline __m128i K(uint64_t x) {
+    return _mm_set1_epi64x(x);
+}
+
+inline __m128i Ror32(__m128i x) {
+    return _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1));
+}
+inline __m128i Ror24(__m128i x) {
+    const __m128i mask =
+        _mm_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10);
+    return _mm_shuffle_epi8(x, mask);
+}
+inline __m128i Ror16(__m128i x) {
+    const __m128i mask =
+        _mm_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9);
+    return _mm_shuffle_epi8(x, mask);
+}
+inline __m128i Ror63(__m128i x) {
+    return _mm_or_si128(_mm_srli_epi64(x, 63), _mm_add_epi64(x, x));
+}
+
+inline void G(__m128i &a, __m128i &b, __m128i &c, __m128i &d, __m128i x,
+              __m128i y) {
+    a = Add(Add(a, b), x);
+    d = Ror32(Xor(d, a));
+    c = Add(c, d);
+    b = Ror24(Xor(b, c));
+    a = Add(Add(a, b), y);
+    d = Ror16(Xor(d, a));
+    c = Add(c, d);
+    b = Ror63(Xor(b, c));
+}
+
+inline __m128i Load(const uint8_t *in, size_t offset) {
+    return _mm_set_epi64x(ReadLE64(in + 80 + offset), ReadLE64(in + offset));
+}
+
+void Hash80_2way(uint8_t *out, const uint8_t *in) {
+    // An 80-byte message fits in a single 128-byte block; the tail is zero.
+    __m128i m[16];
+    for (int i = 0; i < 10; i++) {
+        m[i] = Load(in, 8 * i);
+    }
+    for (int i = 10; i < 16; i++) {
+        m[i] = _mm_setzero_si128();
+    }
+
+    // Parameter block: digest length 32, no key, fanout 1, depth 1.
+    __m128i h[8];
+    h[0] = K(IV[0] ^ 0x01010020ULL);
+    for (int i = 1; i < 8; i++) {
+        h[i] = K(IV[i]);
+    }
+
+    __m128i v[16];
+    for (int i = 0; i < 8; i++) {
+        v[i] = h[i];
+        v[i + 8] = K(IV[i]);
+    }
+    // Byte counter t0 = 80, final block flag f0 = ~0.
+    v[12] = K(IV[4] ^ 80);
+    v[14] = K(~IV[6]);
+
+    for (int r = 0; r < 12; r++) {
+        const uint8_t *s = SIGMA[r];
+        G(v[0], v[4], v[8], v[12], m[s[0]], m[s[1]]);
+        G(v[1], v[5], v[9], v[13], m[s[2]], m[s[3]]);
+        G(v[2], v[6], v[10], v[14], m[s[4]], m[s[5]]);
+        G(v[3], v[7], v[11], v[15], m[s[6]], m[s[7]]);
+        G(v[0], v[5], v[10], v[15], m[s[8]], m[s[9]]);
+        G(v[1], v[6], v[11], v[12], m[s[10]], m[s[11]]);
+        G(v[2], v[7], v[8], v[13], m[s[12]], m[s[13]]);
+        G(v[3], v[4], v[9], v[14], m[s[14]], m[s[15]]);
+    }
+
+    for (int i = 0; i < 4; i++) {
+        alignas(16) uint64_t lanes[2];
+        _mm_store_si128((__m128i *)lanes, Xor(Xor(h[i], v[i]), v[i + 8]));
+        for (int j = 0; j < 2; j++) {
+            WriteLE64(out + 32 * j + 8 * i, lanes[j]);
+        }
+    }
+}
+
+} // namespace
+
+/**
+ * Blake2b-256 (unkeyed) of four consecutive 80-byte inputs in `in`, writing
+ * four consecutive 32-byte digests to `out`.
+ */
+void Hash80_4way(uint8_t *out, const uint8_t *in) {
+    Hash80_2way(out, in);
+    Hash80_2way(out + 64, in + 160);
+}
+
+} // namespace blake2b_sse41
+
+#endif
@@ -0,0 +1,178 @@
+// Copyright (c) 2018 The Title Network developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/muhash.h"
+
+#include "crypto/chacha20.h"
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+
+#include <limits>
+
+namespace {
+
+typedef Num3072::limb_t limb_t;
+typedef Num3072::double_limb_t double_limb_t;
+
+/** The modulus is 2^3072 - MAX_PRIME_DIFF. */
+const limb_t MAX_PRIME_DIFF = 1103717;
+
+inline limb_t ReadLimb(const uint8_t *ptr) {
+#if defined(__SIZEOF_INT128__)
+    return ReadLE64(ptr);
+#else
+    return ReadLE32(ptr);
+#endif
+}
+
+inline void WriteLimb(uint8_t *ptr, limb_t x) {
+#if defined(__SIZEOF_INT128__)
+    WriteLE64(ptr, x);
+#else
+    WriteLE32(ptr, x);
+#endif
+}
+
+} // namespace
+
+Num3072::Num3072(const uint8_t (&data)[BYTE_SIZE]) {
+    for (int i = 0; i < LIMBS; i++) {
+        limbs[i] = ReadLimb(data + i * (LIMB_SIZE / 8));
+    }
+}
+
+void Num3072::SetToOne() {
+    limbs[0] = 1;
+    for (int i = 1; i < LIMBS; i++) {
+        limbs[i] = 0;
+    }
+}
+
+bool Num3072::IsOverflow() const {
+    if (limbs[0] <= std::numeric_limits<limb_t>::max() - MAX_PRIME_DIFF) {
+        return false;
+    }
+    for (int i = 1; i < LIMBS; i++) {
+        if (limbs[i] != std::numeric_limits<limb_t>::max()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Num3072::FullReduce() {
+    if (!IsOverflow()) {
+        return;
+    }
+    // Subtracting the modulus is adding MAX_PRIME_DIFF and dropping 2^3072.
+    double_limb_t carry = MAX_PRIME_DIFF;
+    for (int i = 0; i < LIMBS; i++) {
+        carry += limbs[i];
+        limbs[i] = limb_t(carry);
+        carry >>= LIMB_SIZE;
+    }
+}
+
+void Num3072::Multiply(const Num3072 &a) {
+    // Schoolbook product into 2 * LIMBS limbs.
+    limb_t tmp[2 * LIMBS] = {};
+    for (int i = 0; i < LIMBS; i++) {
+        double_limb_t carry = 0;
+        for (int j = 0; j < LIMBS; j++) {
+            double_limb_t t = double_limb_t(limbs[i]) * a.limbs[j] +
+                              tmp[i + j] + carry;
+            tmp[i + j] = limb_t(t);
+            carry = t >> LIMB_SIZE;
+        }
+        tmp[i + LIMBS] = limb_t(carry);
+    }
+
+    // Reduce using 2^3072 = MAX_PRIME_DIFF: low + high * MAX_PRIME_DIFF.
+    double_limb_t carry = 0;
+    for (int i = 0; i < LIMBS; i++) {
+        double_limb_t t = double_limb_t(tmp[LIMBS + i]) * MAX_PRIME_DIFF +
+                          tmp[i] + carry;
+        limbs[i] = limb_t(t);
+        carry = t >> LIMB_SIZE;
+    }
+    // Fold whatever is still above 2^3072 back in the same way. This runs at
+    // most twice, as the second fold can only carry out of a tiny value.
+    while (carry != 0) {
+        double_limb_t t = carry * MAX_PRIME_DIFF;
+        int i = 0;
+        for (; i < LIMBS && t != 0; i++) {
+            t += limbs[i];
+            limbs[i] = limb_t(t);
+            t >>= LIMB_SIZE;
+        }
+        carry = t;
+    }
+}
+
+Num3072 Num3072::GetInverse() const {
+    // By Fermat, a^-1 = a^(p - 2). The exponent p - 2 = 2^3072 -
+    // (MAX_PRIME_DIFF + 2) has every bit set except in its lowest limb.
+    const limb_t low = ~limb_t(MAX_PRIME_DIFF + 1);
+    Num3072 result;
+    for (int i = LIMBS - 1; i >= 0; i--) {
+        limb_t e = i == 0 ? low : std::numeric_limits<limb_t>::max();
+        for (int b = LIMB_SIZE - 1; b >= 0; b--) {
+            result.Multiply(result);
+            if ((e >> b) & 1) {
+                result.Multiply(*this);
+            }
+        }
+    }
+    return result;
+}
+
+void Num3072::Divide(const Num3072 &a) {
+    Multiply(a.GetInverse());
+}
+
+void Num3072::ToBytes(uint8_t (&out)[BYTE_SIZE]) {
+    FullReduce();
+    for (int i = 0; i < LIMBS; i++) {
+        WriteLimb(out + i * (LIMB_SIZE / 8), limbs[i]);
+    }
+}
+
+Num3072 MuHash3072::ToNum3072(const uint8_t *data, size_t len) {
+    uint8_t key[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(data, len).Finalize(key);
+    uint8_t tmp[Num3072::BYTE_SIZE];
+    ChaCha20(key, sizeof(key)).Output(tmp, sizeof(tmp));
+    return Num3072(tmp);
+}
+
+MuHash3072 &MuHash3072::Insert(const uint8_t *data, size_t len) {
+    numerator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072 &MuHash3072::Remove(const uint8_t *data, size_t len) {
+    denominator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072 &MuHash3072::operator*=(const MuHash3072 &mul) {
+    numerator.Multiply(mul.numerator);
+    denominator.Multiply(mul.denominator);
+    return *this;
+}
+
+MuHash3072 &MuHash3072::operator/=(const MuHash3072 &div) {
+    numerator.Multiply(div.denominator);
+    denominator.Multiply(div.numerator);
+    return *this;
+}
+
+void MuHash3072::Finalize(uint8_t hash[OUTPUT_SIZE]) {
+    numerator.Divide(denominator);
+    denominator.SetToOne();
+
+    uint8_t data[Num3072::BYTE_SIZE];
+    numerator.ToBytes(data);
+    CSHA256().Write(data, sizeof(data)).Finalize(hash);
+}
@@ -0,0 +1,100 @@
+// Copyright (c) 2018 The Title Network developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_MUHASH_H
+#define BITCOIN_CRYPTO_MUHASH_H
+
+#include "serialize.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/** An integer modulo the prime 2^3072 - 1103717. */
+class Num3072 {
+public:
+    static const size_t BYTE_SIZE = 384;
+
+#if defined(__SIZEOF_INT128__)
+    typedef unsigned __int128 double_limb_t;
+    typedef uint64_t limb_t;
+    static const int LIMBS = 48;
+    static const int LIMB_SIZE = 64;
+#else
+    typedef uint64_t double_limb_t;
+    typedef uint32_t limb_t;
+    static const int LIMBS = 96;
+    static const int LIMB_SIZE = 32;
+#endif
+
+    Num3072() { SetToOne(); }
+    explicit Num3072(const uint8_t (&data)[BYTE_SIZE]);
+
+    void SetToOne();
+    void Multiply(const Num3072 &a);
+    void Divide(const Num3072 &a);
+    Num3072 GetInverse() const;
+
+    //! Write the fully reduced value, little endian.
+    void ToBytes(uint8_t (&out)[BYTE_SIZE]);
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream &s, Operation ser_action) {
+        // Either limb size gives the same little endian bytes.
+        for (int i = 0; i < LIMBS; i++) {
+            READWRITE(limbs[i]);
+        }
+    }
+
+private:
+    //! Limbs of the value, least significant first. The value is kept below
+    //! 2^3072 but not necessarily below the modulus.
+    limb_t limbs[LIMBS];
+
+    bool IsOverflow() const;
+    void FullReduce();
+};
+
+/**
+ * A multiplicative hash of a set of byte strings. Every element is mapped to
+ * a number modulo a 3072-bit prime and the hash is their product, so elements
+ * can be added and removed in any order and hashes of disjoint sets can be
+ * combined, which lets a large set be hashed in parallel pieces. Removals are
+ * tracked in a separate denominator so that only Finalize needs an inverse.
+ */
+class MuHash3072 {
+private:
+    Num3072 numerator;
+    Num3072 denominator;
+
+    static Num3072 ToNum3072(const uint8_t *data, size_t len);
+
+public:
+    static const size_t OUTPUT_SIZE = 32;
+
+    //! The hash of the empty set.
+    MuHash3072() {}
+
+    MuHash3072 &Insert(const uint8_t *data, size_t len);
+    MuHash3072 &Remove(const uint8_t *data, size_t len);
+
+    //! Combine with the hash of a disjoint set.
+    MuHash3072 &operator*=(const MuHash3072 &mul);
+    //! Take out the hash of a subset.
+    MuHash3072 &operator/=(const MuHash3072 &div);
+
+    //! Compute the 256-bit digest of the set.
+    void Finalize(uint8_t hash[OUTPUT_SIZE]);
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream &s, Operation ser_action) {
+        READWRITE(numerator);
+        READWRITE(denominator);
+    }
+};
+
+#endif // BITCOIN_CRYPTO_MUHASH_H
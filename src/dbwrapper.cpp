@@ -9,20 +9,28 @@
 
 #include <boost/filesystem.hpp>
 
+#include <algorithm>
 #include <cstdint>
 #include <leveldb/cache.h>
 #include <leveldb/env.h>
 #include <leveldb/filter_policy.h>
 #include <memenv.h>
 
-static leveldb::Options GetOptions(size_t nCacheSize) {
+static leveldb::Options GetOptions(size_t nCacheSize,
+                                   const DBOptions &dboptions) {
     leveldb::Options options;
     options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
     // up to two write buffers may be held in memory simultaneously
     options.write_buffer_size = nCacheSize / 4;
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
-    options.compression = leveldb::kNoCompression;
-    options.max_open_files = 64;
+    options.filter_policy =
+        dboptions.nBloomBits > 0
+            ? leveldb::NewBloomFilterPolicy(dboptions.nBloomBits)
+            : nullptr;
+    options.compression = dboptions.fCompression ? leveldb::kSnappyCompression
+                                                 : leveldb::kNoCompression;
+    options.max_open_files = dboptions.nMaxOpenFiles;
+    options.block_size = dboptions.nBlockSize;
+    options.max_file_size = dboptions.nMaxFileSize;
     if (leveldb::kMajorVersion > 1 ||
         (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption.
@@ -32,14 +40,88 @@ static leveldb::Options GetOptions(size_t nCacheSize) {
     return options;
 }
 
+bool DBCompressionSupported() {
+    // LevelDB built without Snappy stores blocks as they are, whatever the
+    // options say, so see how much a compressible table takes.
+    static const bool fSupported = []() {
+        leveldb::Env *penv = leveldb::NewMemEnv(leveldb::Env::Default());
+        leveldb::Options options;
+        options.env = penv;
+        options.create_if_missing = true;
+        options.compression = leveldb::kSnappyCompression;
+        leveldb::DB *pdb = nullptr;
+        bool fCompressed = false;
+        if (leveldb::DB::Open(options, "compression", &pdb).ok()) {
+            const std::string strValue(1 << 16, '\0');
+            if (pdb->Put(leveldb::WriteOptions(), "a", strValue).ok()) {
+                // Move the value from the memtable into a table file.
+                pdb->CompactRange(nullptr, nullptr);
+                const leveldb::Range range("a", "b");
+                uint64_t nSize = 0;
+                pdb->GetApproximateSizes(&range, 1, &nSize);
+                fCompressed = nSize < strValue.size() / 2;
+            }
+        }
+        delete pdb;
+        delete penv;
+        return fCompressed;
+    }();
+    return fSupported;
+}
+
+int64_t GetDBArg(const std::string &strName, const std::string &strArg,
+                        int64_t nDefault) {
+    // A bare -dbcompression means 1, as with GetBoolArg.
+    auto parse = [](const std::string &str) {
+        return str.empty() ? 1 : atoi64(str);
+    };
+    if (!gArgs.IsArgSet(strArg)) {
+        return nDefault;
+    }
+    int64_t nValue = nDefault;
+    for (const std::string &strValue : gArgs.GetArgs(strArg)) {
+        size_t nColon = strValue.find(':');
+        if (nColon == std::string::npos) {
+            nValue = parse(strValue);
+        } else if (strValue.substr(0, nColon) == strName) {
+            return parse(strValue.substr(nColon + 1));
+        }
+    }
+    return nValue;
+}
+
+DBOptions GetDBOptions(const std::string &strName) {
+    // Out of range sizes and file counts are clipped by LevelDB itself.
+    DBOptions dboptions;
+    dboptions.nBloomBits = std::max<int64_t>(
+        0, std::min<int64_t>(64, GetDBArg(strName, "-dbbloombits",
+                                          DEFAULT_DB_BLOOM_BITS)));
+    dboptions.nMaxOpenFiles = std::max<int64_t>(
+        0, std::min<int64_t>(1 << 20, GetDBArg(strName, "-dbmaxopenfiles",
+                                               DEFAULT_DB_MAX_OPEN_FILES)));
+    dboptions.nBlockSize = std::max<int64_t>(
+        0, GetDBArg(strName, "-dbblocksize", DEFAULT_DB_BLOCK_SIZE));
+    dboptions.fCompression =
+        GetDBArg(strName, "-dbcompression", DEFAULT_DB_COMPRESSION) != 0 &&
+        DBCompressionSupported();
+    dboptions.nMaxFileSize = std::max<int64_t>(
+        0, GetDBArg(strName, "-dbmaxfilesize", DEFAULT_DB_MAX_FILE_SIZE));
+    return dboptions;
+}
+
 CDBWrapper::CDBWrapper(const boost::filesystem::path &path, size_t nCacheSize,
-                       bool fMemory, bool fWipe, bool obfuscate) {
+                       bool fMemory, bool fWipe, bool obfuscate,
+                       const DBOptions &dboptionsIn)
+    : dboptions(dboptionsIn) {
+    // Report the compression actually in effect.
+    dboptions.fCompression =
+        dboptions.fCompression && DBCompressionSupported();
     penv = nullptr;
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(nCacheSize, dboptions);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -17,9 +17,61 @@
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
 
+#include <memory>
+#include <string>
+
 static const size_t DBWRAPPER_PREALLOC_KEY_SIZE = 64;
 static const size_t DBWRAPPER_PREALLOC_VALUE_SIZE = 1024;
 
+//! -dbbloombits default
+static const int DEFAULT_DB_BLOOM_BITS = 10;
+//! -dbmaxopenfiles default
+static const int DEFAULT_DB_MAX_OPEN_FILES = 64;
+//! -dbblocksize default (bytes), the LevelDB default
+static const int64_t DEFAULT_DB_BLOCK_SIZE = 4096;
+//! -dbcompression default
+static const bool DEFAULT_DB_COMPRESSION = false;
+//! -dbmaxfilesize default (bytes), the LevelDB default
+static const int64_t DEFAULT_DB_MAX_FILE_SIZE = 2 * 1024 * 1024;
+
+/** LevelDB settings that can be tuned separately for each database. */
+struct DBOptions {
+    //! Bits per key of the bloom filter, or 0 for none.
+    int nBloomBits;
+    int nMaxOpenFiles;
+    //! Approximate size of the uncompressed data in a table block.
+    size_t nBlockSize;
+    //! Compress blocks with Snappy. Only set when LevelDB was built with it.
+    bool fCompression;
+    //! Size at which a table file is closed. Compactions work on whole
+    //! files, so this sets how much is rewritten at a time.
+    size_t nMaxFileSize;
+
+    DBOptions()
+        : nBloomBits(DEFAULT_DB_BLOOM_BITS),
+          nMaxOpenFiles(DEFAULT_DB_MAX_OPEN_FILES),
+          nBlockSize(DEFAULT_DB_BLOCK_SIZE),
+          fCompression(DEFAULT_DB_COMPRESSION),
+          nMaxFileSize(DEFAULT_DB_MAX_FILE_SIZE) {}
+};
+
+/**
+ * Get the options of the database strName. Each -db* argument can be given as
+ * <n>, for all databases, or as strName:<n>, which takes precedence.
+ */
+DBOptions GetDBOptions(const std::string &strName);
+
+/**
+ * Get the value of the -db* argument strArg for the database strName, as
+ * described at GetDBOptions.
+ */
+int64_t GetDBArg(const std::string &strName, const std::string &strArg,
+                 int64_t nDefault);
+
+//! Whether LevelDB compresses tables, which it only does when built with
+//! Snappy.
+bool DBCompressionSupported();
+
 class dbwrapper_error : public std::runtime_error {
 public:
     dbwrapper_error(const std::string &msg) : std::runtime_error(msg) {}
@@ -183,6 +235,9 @@ private:
     //! database options used
     leveldb::Options options;
 
+    //! the tunables options was built from
+    DBOptions dboptions;
+
     //! options used when reading from the database
     leveldb::ReadOptions readoptions;
 
@@ -219,20 +274,30 @@ public:
      * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If
      * false, XOR
      *                        with a zero'd byte array.
+     * @param[in] dboptionsIn Bloom filter, file and block settings.
      */
     CDBWrapper(const boost::filesystem::path &path, size_t nCacheSize,
                bool fMemory = false, bool fWipe = false,
-               bool obfuscate = false);
+               bool obfuscate = false,
+               const DBOptions &dboptionsIn = DBOptions());
     ~CDBWrapper();
 
-    template <typename K, typename V> bool Read(const K &key, V &value) const {
+    /**
+     * Read the value of key, as of snapshot if one is given (see GetSnapshot)
+     * and otherwise as of now.
+     */
+    template <typename K, typename V>
+    bool Read(const K &key, V &value,
+              const leveldb::Snapshot *snapshot = nullptr) const {
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey << key;
         leveldb::Slice slKey(ssKey.data(), ssKey.size());
 
+        leveldb::ReadOptions options = readoptions;
+        options.snapshot = snapshot;
         std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+        leveldb::Status status = pdb->Get(options, slKey, &strValue);
         if (!status.ok()) {
             if (status.IsNotFound()) return false;
             LogPrintf("LevelDB read failure: %s\n", status.ToString());
@@ -293,11 +358,41 @@ public:
         return new CDBIterator(*this, pdb->NewIterator(iteroptions));
     }
 
+    /**
+     * Take a snapshot of the current state of the database, released once the
+     * last reference to it is dropped. Iterators opened on the same snapshot
+     * all see the same data, however the database changes meanwhile.
+     */
+    std::shared_ptr<const leveldb::Snapshot> GetSnapshot() {
+        leveldb::DB *db = pdb;
+        return std::shared_ptr<const leveldb::Snapshot>(
+            pdb->GetSnapshot(), [db](const leveldb::Snapshot *snapshot) {
+                db->ReleaseSnapshot(snapshot);
+            });
+    }
+
+    CDBIterator *NewIterator(const leveldb::Snapshot *snapshot) {
+        leveldb::ReadOptions snapshotoptions = iteroptions;
+        snapshotoptions.snapshot = snapshot;
+        return new CDBIterator(*this, pdb->NewIterator(snapshotoptions));
+    }
+
     /**
      * Return true if the database managed by this class contains no entries.
      */
     bool IsEmpty();
 
+    const DBOptions &GetDBOptions() const { return dboptions; }
+
+    /**
+     * Read one of LevelDB's internal properties, such as "leveldb.stats".
+     * Returns false if the property is unknown.
+     */
+    bool GetProperty(const std::string &strProperty,
+                     std::string &strValue) const {
+        return pdb->GetProperty(strProperty, &strValue);
+    }
+
     template <typename K>
     size_t EstimateSize(const K &key_begin, const K &key_end) const {
         CDataStream ssKey1(SER_DISK, CLIENT_VERSION),
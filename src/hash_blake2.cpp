@@ -1,10 +1,139 @@
+#if defined(HAVE_CONFIG_H)
+#include "config/bitcoin-config.h"
+#endif
+
 #include "hash_blake2.h"
 
+#if defined(__x86_64__) || defined(__amd64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
 extern "C" {
 #include "crypto/cblake2/blake2b-ref.c"
 }
 
+#if defined(ENABLE_SSE41) && !defined(BUILD_BITCOIN_INTERNAL)
+namespace blake2b_sse41 {
+void Hash80_4way(uint8_t *out, const uint8_t *in);
+}
+#endif
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+namespace blake2b_avx2 {
+void Hash80_4way(uint8_t *out, const uint8_t *in);
+}
+#endif
+
+namespace {
+
+typedef void (*Hash80_4wayFn)(uint8_t *out, const uint8_t *in);
+
+void Hash80_4wayRef(uint8_t *out, const uint8_t *in)
+{
+    for (int i = 0; i < 4; i++) {
+        blake2b(out + 32 * i, 32, in + 80 * i, 80, nullptr, 0);
+    }
+}
+
+struct Backend {
+    Hash80_4wayFn hash80_4way;
+    const char *name;
+};
+
+#if (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+/** Check that the OS saves the YMM registers across context switches. */
+bool AVXEnabledByOS()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
+
+Backend SelectBackend()
+{
+    Backend backend = {Hash80_4wayRef, "standard"};
+
+#if (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+    uint32_t eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return backend;
+    }
+    bool have_sse41 = (ecx >> 19) & 1;
+    bool have_avx = ((ecx >> 27) & 1) && ((ecx >> 28) & 1) && AVXEnabledByOS();
+    bool have_avx2 = false;
+    if (have_avx && __get_cpuid_max(0, nullptr) >= 7) {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        have_avx2 = (ebx >> 5) & 1;
+    }
+
+#if defined(ENABLE_SSE41) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_sse41) {
+        backend = {blake2b_sse41::Hash80_4way, "sse4.1(2way)"};
+    }
+#endif
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_avx2) {
+        backend = {blake2b_avx2::Hash80_4way, "avx2(4way)"};
+    }
+#endif
+
+    (void)have_sse41;
+    (void)have_avx2;
+#endif
+
+    return backend;
+}
+
+const Backend &GetBackend()
+{
+    static const Backend backend = SelectBackend();
+    return backend;
+}
+
+} // namespace
+
 int Blake2::hash2b(void *out, size_t outlen, const void *in, size_t inlen)
 {
     return blake2(out, outlen, in, inlen, nullptr, 0);
-}
\ No newline at end of file
+}
+
+void Blake2::hash2b_80(uint8_t *out, const uint8_t *in, size_t count)
+{
+    const Backend &backend = GetBackend();
+    while (count >= 4) {
+        backend.hash80_4way(out, in);
+        out += 4 * 32;
+        in += 4 * 80;
+        count -= 4;
+    }
+    for (; count > 0; count--) {
+        blake2b(out, 32, in, 80, nullptr, 0);
+        out += 32;
+        in += 80;
+    }
+}
+
+std::string Blake2::Implementation()
+{
+    return GetBackend().name;
+}
+
+CBlake2bWriter::CBlake2bWriter(int nTypeIn, int nVersionIn)
+    : nType(nTypeIn), nVersion(nVersionIn)
+{
+    blake2b_init(&state, OUTPUT_SIZE);
+}
+
+void CBlake2bWriter::write(const char *pch, size_t size)
+{
+    blake2b_update(&state, pch, size);
+}
+
+uint256 CBlake2bWriter::GetHash()
+{
+    uint256 result;
+    blake2b_final(&state, result.begin(), OUTPUT_SIZE);
+    return result;
+}
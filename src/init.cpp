@@ -162,7 +162,6 @@ public:
     // the caller.
 };
 
-static CCoinsViewDB *pcoinsdbview = nullptr;
 static CCoinsViewErrorCatcher *pcoinscatcher = nullptr;
 static std::unique_ptr<ECCVerifyHandle> globalVerifyHandle;
 
@@ -200,6 +199,7 @@ void Shutdown() {
     UnregisterValidationInterface(peerLogic.get());
     peerLogic.reset();
     g_connman.reset();
+    g_blocktemplatecache.reset();
 
     StopTorControl();
     UnregisterNodeSignals(GetNodeSignals());
@@ -225,6 +225,8 @@ void Shutdown() {
         }
         delete pcoinsTip;
         pcoinsTip = nullptr;
+        delete pcoinsFlusher;
+        pcoinsFlusher = nullptr;
         delete pcoinscatcher;
         pcoinscatcher = nullptr;
         delete pcoinsdbview;
@@ -319,6 +321,13 @@ std::string HelpMessage(HelpMessageMode mode) {
     strUsage += HelpMessageOpt("-blocknotify=<cmd>",
                                _("Execute command when the best block changes "
                                  "(%s in cmd is replaced by block hash)"));
+    if (showDebug)
+        strUsage += HelpMessageOpt(
+            "-blockmmapfiles=<n>",
+            strprintf("Keep up to <n> block files memory mapped to read "
+                      "blocks from, 0 to read them through stdio "
+                      "(default: %u)",
+                      DEFAULT_BLOCK_MMAP_FILES));
     if (showDebug)
         strUsage += HelpMessageOpt(
             "-blocksonly",
@@ -352,6 +361,33 @@ std::string HelpMessage(HelpMessageMode mode) {
         strprintf(
             _("Set database cache size in megabytes (%d to %d, default: %d)"),
             nMinDbCache, nMaxDbCache, nDefaultDbCache));
+    if (showDebug) {
+        strUsage += HelpMessageOpt(
+            "-dbbloombits=[<db>:]<n>",
+            strprintf("Bits per key of the LevelDB bloom filters, 0 for none "
+                      "(default: %u). This and the other -db* options apply "
+                      "to all databases, or with <db>: to only chainstate or "
+                      "blockindex, and can be given once for each.",
+                      DEFAULT_DB_BLOOM_BITS));
+        strUsage += HelpMessageOpt(
+            "-dbmaxopenfiles=[<db>:]<n>",
+            strprintf("Number of files LevelDB may keep open (default: %u)",
+                      DEFAULT_DB_MAX_OPEN_FILES));
+        strUsage += HelpMessageOpt(
+            "-dbblocksize=[<db>:]<n>",
+            strprintf("Size of LevelDB table blocks in bytes (default: %u)",
+                      DEFAULT_DB_BLOCK_SIZE));
+        strUsage += HelpMessageOpt(
+            "-dbcompression=[<db>:]<n>",
+            strprintf("Compress LevelDB tables with Snappy, ignored unless "
+                      "LevelDB was built with it (default: %u)",
+                      DEFAULT_DB_COMPRESSION));
+        strUsage += HelpMessageOpt(
+            "-dbmaxfilesize=[<db>:]<n>",
+            strprintf("Size of LevelDB table files in bytes, which sets how "
+                      "much each compaction rewrites (default: %u)",
+                      DEFAULT_DB_MAX_FILE_SIZE));
+    }
     if (showDebug)
         strUsage += HelpMessageOpt(
             "-feefilter", strprintf("Tell other nodes to filter invs to us by "
@@ -373,6 +409,12 @@ std::string HelpMessage(HelpMessageMode mode) {
                        strprintf(_("Do not keep transactions in the mempool "
                                    "longer than <n> hours (default: %u)"),
                                  DEFAULT_MEMPOOL_EXPIRY));
+    strUsage += HelpMessageOpt(
+        "-mempooldumpinterval=<n>",
+        strprintf(_("Save the mempool to disk every <n> minutes, so that it "
+                    "survives a crash (0 to only save it at shutdown, "
+                    "default: %u)"),
+                  DEFAULT_MEMPOOL_DUMP_INTERVAL));
     strUsage += HelpMessageOpt(
         "-blockreconstructionextratxn=<n>",
         strprintf(_("Extra transactions to keep in memory for compact block "
@@ -419,6 +461,11 @@ std::string HelpMessage(HelpMessageMode mode) {
         "-txindex", strprintf(_("Maintain a full transaction index, used by "
                                 "the getrawtransaction rpc call (default: %u)"),
                               DEFAULT_TXINDEX));
+    strUsage += HelpMessageOpt(
+        "-utxocommitment",
+        strprintf(_("Maintain a commitment to the UTXO set at the chain tip, "
+                    "used by getutxocommitment and dumptxoutset (default: %u)"),
+                  DEFAULT_UTXO_COMMITMENT));
 
     strUsage += HelpMessageGroup(_("Connection options:"));
     strUsage += HelpMessageOpt(
@@ -586,6 +633,12 @@ std::string HelpMessage(HelpMessageMode mode) {
     strUsage += HelpMessageOpt("-uacomment=<cmt>",
                                _("Append comment to the user agent string"));
     if (showDebug) {
+        strUsage += HelpMessageOpt(
+            "-allowunpinnedsnapshot",
+            strprintf("Let loadtxoutset load UTXO snapshots of blocks that "
+                      "are not pinned in the chain parameters, checking them "
+                      "only against the hash in the file (default: %u)",
+                      DEFAULT_ALLOW_UNPINNED_SNAPSHOT));
         strUsage += HelpMessageOpt(
             "-checkblocks=<n>",
             strprintf(
@@ -603,6 +656,12 @@ std::string HelpMessage(HelpMessageMode mode) {
                 "setBlockIndexCandidates, chainActive and mapBlocksUnlinked "
                 "occasionally. Also sets -checkmempool (default: %u)",
                 Params(CBaseChainParams::MAIN).DefaultConsistencyChecks()));
+        strUsage += HelpMessageOpt(
+            "-checkblockindexpow",
+            strprintf("Check proof of work for every block index entry at "
+                      "startup, including those below the last checkpoint "
+                      "(default: %u)",
+                      DEFAULT_CHECKBLOCKINDEXPOW));
         strUsage += HelpMessageOpt(
             "-checkmempool=<n>",
             strprintf(
@@ -1037,6 +1096,11 @@ void ThreadImport(const Config &config,
     fDumpMempoolLater = !fRequestShutdown;
 }
 
+/** Save the mempool, unless it has not been loaded from disk yet. */
+static void DumpMempoolIfLoaded() {
+    if (fDumpMempoolLater) DumpMempool();
+}
+
 /** Sanity checks
  *  Ensure that Title Network is running in a usable environment with all
  *  necessary library support.
@@ -1354,6 +1418,15 @@ bool AppInitParameterInteraction(Config &config) {
     if (IsArgSet("-blockminsize"))
         InitWarning("Unsupported argument -blockminsize ignored.");
 
+    for (const std::string strName : {"chainstate", "blockindex"}) {
+        if (GetDBArg(strName, "-dbcompression", DEFAULT_DB_COMPRESSION) != 0 &&
+            !DBCompressionSupported()) {
+            InitWarning(_("LevelDB was built without Snappy, -dbcompression "
+                          "ignored."));
+            break;
+        }
+    }
+
     // Checkmempool and checkblockindex default to true in regtest mode
     int ratio = std::min<int>(
         std::max<int>(GetArg("-checkmempool",
@@ -1367,6 +1440,11 @@ bool AppInitParameterInteraction(Config &config) {
         GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
     fCheckpointsEnabled =
         GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
+    fCoinsCommitment = GetBoolArg("-utxocommitment", DEFAULT_UTXO_COMMITMENT);
+    fCheckBlockIndexPoW =
+        GetBoolArg("-checkblockindexpow", DEFAULT_CHECKBLOCKINDEXPOW);
+    InitBlockFileMapping(
+        std::max<int64_t>(0, GetArg("-blockmmapfiles", DEFAULT_BLOCK_MMAP_FILES)));
 
     hashAssumeValid = uint256S(
         GetArg("-assumevalid",
@@ -1669,6 +1747,8 @@ bool AppInitMain(Config &config, boost::thread_group &threadGroup,
     if (nScriptCheckThreads) {
         for (int i = 0; i < nScriptCheckThreads - 1; i++) {
             threadGroup.create_thread(&ThreadScriptCheck);
+            threadGroup.create_thread(&ThreadHeaderCheck);
+            threadGroup.create_thread(&ThreadMempoolScriptCheck);
         }
     }
 
@@ -1935,16 +2015,31 @@ bool AppInitMain(Config &config, boost::thread_group &threadGroup,
             try {
                 UnloadBlockIndex();
                 delete pcoinsTip;
+                delete pcoinsFlusher;
                 delete pcoinsdbview;
                 delete pcoinscatcher;
                 delete pblocktree;
 
                 pblocktree =
                     new CBlockTreeDB(nBlockTreeDBCache, false, fReindex);
+
+                // The blocks below a UTXO snapshot are not there to rebuild
+                // the chainstate from.
+                uint256 hashSnapshotBase;
+                if (fReindexChainState && !fReindex &&
+                    pblocktree->ReadSnapshotBase(hashSnapshotBase)) {
+                    strLoadError =
+                        _("The chainstate was loaded from a UTXO snapshot. "
+                          "You need to rebuild the database using -reindex "
+                          "instead of -reindex-chainstate");
+                    break;
+                }
+
                 pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false,
                                                 fReindex || fReindexChainState);
                 pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
-                pcoinsTip = new CCoinsViewCache(pcoinscatcher);
+                pcoinsFlusher = new CCoinsViewBackgroundFlush(pcoinscatcher);
+                pcoinsTip = new CCoinsViewCache(pcoinsFlusher);
 
                 if (fReindex) {
                     pblocktree->WriteReindexing(true);
@@ -1958,6 +2053,19 @@ bool AppInitMain(Config &config, boost::thread_group &threadGroup,
                     break;
                 }
 
+                if (pcoinsdbview->IsLoadingSnapshot()) {
+                    strLoadError =
+                        _("The chainstate database holds a partly loaded UTXO "
+                          "snapshot. You need to rebuild the database using "
+                          "-reindex");
+                    break;
+                }
+
+                if (!LoadCoinsCommitment()) {
+                    strLoadError = _("Error loading UTXO set commitment");
+                    break;
+                }
+
                 if (!LoadBlockIndex(chainparams)) {
                     strLoadError = _("Error loading block database");
                     break;
@@ -2108,6 +2216,15 @@ bool AppInitMain(Config &config, boost::thread_group &threadGroup,
         }
     }
 
+    // Likewise, a node started from a UTXO snapshot lacks the blocks below it.
+    {
+        LOCK(cs_main);
+        if (pindexSnapshotBase) {
+            LogPrintf("Unsetting NODE_NETWORK for UTXO snapshot\n");
+            nLocalServices = ServiceFlags(nLocalServices & ~NODE_NETWORK);
+        }
+    }
+
     // Step 10: import blocks
 
     if (!CheckDiskSpace()) return false;
@@ -2146,6 +2263,8 @@ bool AppInitMain(Config &config, boost::thread_group &threadGroup,
 
     // Step 11: start node
 
+    g_blocktemplatecache.reset(new BlockTemplateCache(config));
+
     //// debug print
     LogPrintf("mapBlockIndex.size() = %u\n", mapBlockIndex.size());
     LogPrintf("nBestHeight = %d\n", chainActive.Height());
@@ -2179,6 +2298,12 @@ bool AppInitMain(Config &config, boost::thread_group &threadGroup,
     if (!connman.Start(scheduler, strNodeError, connOptions))
         return InitError(strNodeError);
 
+    int64_t nMempoolDumpInterval =
+        GetArg("-mempooldumpinterval", DEFAULT_MEMPOOL_DUMP_INTERVAL) * 60;
+    if (nMempoolDumpInterval > 0) {
+        scheduler.scheduleEvery(&DumpMempoolIfLoaded, nMempoolDumpInterval);
+    }
+
     // Step 12: finished
 
     SetRPCWarmupFinished();
@@ -0,0 +1,51 @@
+// Copyright (c) 2018 The Title Network developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "mempooldump.h"
+
+#include <algorithm>
+
+CMempoolDumpWriter::CMempoolDumpWriter(const boost::filesystem::path &pathIn)
+    : writer(pathIn, pathIn.string() + ".new", MEMPOOL_DUMP_CHUNK_TXS,
+             MEMPOOL_DUMP_VERSION_CHUNKED) {}
+
+CMempoolDumpReader::CMempoolDumpReader(FILE *filestr)
+    : reader(filestr, MEMPOOL_DUMP_CHUNK_TXS, "mempool file"), nSerialLeft(0),
+      nSerialRead(0), fSerialDone(false) {
+    reader.ReadHeader(nVersion);
+    if (nVersion == MEMPOOL_DUMP_VERSION_SERIAL) {
+        reader.GetFile() >> nSerialLeft;
+    } else if (nVersion != MEMPOOL_DUMP_VERSION_CHUNKED) {
+        throw std::ios_base::failure("Unsupported mempool file version");
+    }
+}
+
+bool CMempoolDumpReader::ReadSerialChunk(
+    std::vector<MempoolDumpEntry> &vEntries) {
+    vEntries.clear();
+    if (fSerialDone) {
+        return false;
+    }
+    if (nSerialLeft == 0) {
+        reader.GetFile() >> mapDeltas;
+        fSerialDone = true;
+        return false;
+    }
+    std::vector<MempoolDumpEntry> vRead(
+        std::min<uint64_t>(nSerialLeft, MEMPOOL_DUMP_CHUNK_TXS));
+    for (MempoolDumpEntry &entry : vRead) {
+        reader.GetFile() >> entry;
+    }
+    nSerialLeft -= vRead.size();
+    nSerialRead += vRead.size();
+    vEntries.swap(vRead);
+    return true;
+}
+
+bool CMempoolDumpReader::ReadChunk(std::vector<MempoolDumpEntry> &vEntries) {
+    if (nVersion == MEMPOOL_DUMP_VERSION_SERIAL) {
+        return ReadSerialChunk(vEntries);
+    }
+    return reader.ReadChunk(vEntries, mapDeltas);
+}
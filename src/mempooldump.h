@@ -0,0 +1,118 @@
+// Copyright (c) 2018 The Title Network developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_MEMPOOLDUMP_H
+#define BITCOIN_MEMPOOLDUMP_H
+
+#include "amount.h"
+#include "chunkedfile.h"
+#include "primitives/transaction.h"
+#include "serialize.h"
+#include "streams.h"
+#include "uint256.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+/** Transactions per chunk of mempool.dat. */
+static const uint32_t MEMPOOL_DUMP_CHUNK_TXS = 1000;
+
+/** The original mempool.dat: all transactions in one stream, no checksums. */
+static const uint64_t MEMPOOL_DUMP_VERSION_SERIAL = 1;
+/** mempool.dat in checksummed chunks. */
+static const uint64_t MEMPOOL_DUMP_VERSION_CHUNKED = 2;
+
+/** A transaction in mempool.dat. */
+struct MempoolDumpEntry {
+    CTransactionRef tx;
+    //! When the transaction entered the mempool.
+    int64_t nTime;
+    //! Fee delta from prioritisetransaction.
+    int64_t nFeeDelta;
+
+    MempoolDumpEntry() : nTime(0), nFeeDelta(0) {}
+    MempoolDumpEntry(const CTransactionRef &txIn, int64_t nTimeIn,
+                     int64_t nFeeDeltaIn)
+        : tx(txIn), nTime(nTimeIn), nFeeDelta(nFeeDeltaIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream &s, Operation ser_action) {
+        READWRITE(tx);
+        READWRITE(nTime);
+        READWRITE(nFeeDelta);
+    }
+};
+
+/**
+ * Writes mempool.dat in the chunked format: the version, then the transactions
+ * in chunks of up to MEMPOOL_DUMP_CHUNK_TXS as written by CChunkedFileWriter,
+ * with the fee deltas of transactions not in the file as the trailer. A reader
+ * can load every chunk before a damaged one.
+ *
+ * The file is written next to its final path and only moved there by Finish.
+ * Errors are thrown as std::ios_base::failure.
+ */
+class CMempoolDumpWriter {
+private:
+    CChunkedFileWriter writer;
+
+public:
+    explicit CMempoolDumpWriter(const boost::filesystem::path &pathIn);
+
+    void Add(const MempoolDumpEntry &entry) { writer.Add(entry); }
+    //! Write the last chunk and move the file into place.
+    void Finish(const std::map<uint256, Amount> &mapDeltas) {
+        writer.Finish(mapDeltas);
+    }
+
+    uint64_t GetTransactionsWritten() const {
+        return writer.GetRecordsWritten();
+    }
+};
+
+/**
+ * Reads mempool.dat in either format, a chunk at a time, verifying the
+ * checksum of each chunk before handing it out. Files in the serial format are
+ * cut into chunks of the same size. Errors, including corruption, are thrown
+ * as std::ios_base::failure.
+ */
+class CMempoolDumpReader {
+private:
+    CChunkedFileReader reader;
+    uint64_t nVersion;
+    //! Transactions left in a file in the serial format.
+    uint64_t nSerialLeft;
+    uint64_t nSerialRead;
+    bool fSerialDone;
+    std::map<uint256, Amount> mapDeltas;
+
+    bool ReadSerialChunk(std::vector<MempoolDumpEntry> &vEntries);
+
+public:
+    //! Takes ownership of filestr.
+    explicit CMempoolDumpReader(FILE *filestr);
+
+    uint64_t GetVersion() const { return nVersion; }
+
+    //! Read the next chunk into vEntries. Returns false at the end of the
+    //! file.
+    bool ReadChunk(std::vector<MempoolDumpEntry> &vEntries);
+
+    uint64_t GetTransactionsRead() const {
+        return nVersion == MEMPOOL_DUMP_VERSION_SERIAL
+                   ? nSerialRead
+                   : reader.GetRecordsRead();
+    }
+    //! Fee deltas of transactions not in the file, once ReadChunk has
+    //! returned false.
+    const std::map<uint256, Amount> &GetDeltas() const { return mapDeltas; }
+};
+
+#endif // BITCOIN_MEMPOOLDUMP_H
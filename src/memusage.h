@@ -6,7 +6,10 @@
 #define BITCOIN_MEMUSAGE_H
 
 #include "indirectmap.h"
+#include "poolmap.h"
+#include "prevector.h"
 
+#include <cassert>
 #include <cstdlib>
 
 #include <map>
@@ -178,6 +181,18 @@ static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z> &m) {
                m.size() +
            MallocUsage(sizeof(void *) * m.bucket_count());
 }
+
+// poolmap allocates its table, free list and entry chunks separately
+
+template <typename X, typename Y, typename Z>
+static inline size_t DynamicUsage(const poolmap<X, Y, Z> &m) {
+    size_t usage =
+        MallocUsage(m.slot_bytes()) + MallocUsage(m.free_list_bytes());
+    for (size_t i = 0; i < m.chunk_count(); i++) {
+        usage += MallocUsage(m.chunk_bytes(i));
+    }
+    return usage;
+}
 }
 
 #endif // BITCOIN_MEMUSAGE_H
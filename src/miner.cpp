@@ -6,6 +6,7 @@
 #include "miner.h"
 
 #include "amount.h"
+#include "arith_uint256.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "coins.h"
@@ -13,12 +14,15 @@
 #include "consensus/consensus.h"
 #include "consensus/merkle.h"
 #include "consensus/validation.h"
+#include "crypto/common.h"
 #include "hash.h"
+#include "hash_blake2.h"
 #include "net.h"
 #include "policy/policy.h"
 #include "pow.h"
 #include "primitives/transaction.h"
 #include "script/standard.h"
+#include "streams.h"
 #include "timedata.h"
 #include "txmempool.h"
 #include "util.h"
@@ -27,9 +31,12 @@
 #include "validationinterface.h"
 
 #include <algorithm>
+#include <atomic>
 #include <queue>
+#include <thread>
 #include <utility>
 
+#include <boost/bind.hpp>
 #include <boost/thread.hpp>
 #include <boost/tuple/tuple.hpp>
 
@@ -235,8 +242,8 @@ BlockAssembler::CreateNewBlock(const CScript &scriptPubKeyIn) {
 }
 
 bool BlockAssembler::isStillDependent(CTxMemPool::txiter iter) {
-    for (CTxMemPool::txiter parent : mempool.GetMemPoolParents(iter)) {
-        if (!inBlock.count(parent)) {
+    for (const CTxMemPoolEntry *parent : mempool.GetMemPoolParents(iter)) {
+        if (!inBlock.count(mempool.GetIter(parent))) {
             return true;
         }
     }
@@ -623,7 +630,9 @@ void BlockAssembler::addPriorityTxs() {
 
             // This tx was successfully added, so add transactions that depend
             // on this one to the priority queue to try again.
-            for (CTxMemPool::txiter child : mempool.GetMemPoolChildren(iter)) {
+            for (const CTxMemPoolEntry *entry :
+                 mempool.GetMemPoolChildren(iter)) {
+                CTxMemPool::txiter child = mempool.GetIter(entry);
                 waitPriIter wpiter = waitPriMap.find(child);
                 if (wpiter != waitPriMap.end()) {
                     vecPriority.push_back(
@@ -637,6 +646,162 @@ void BlockAssembler::addPriorityTxs() {
     }
 }
 
+std::unique_ptr<BlockTemplateCache> g_blocktemplatecache;
+
+BlockTemplateCache::BlockTemplateCache(const Config &_config)
+    : config(_config), pindexPrev(nullptr), nTimeAssembled(0), fStale(false),
+      fBehind(false), nTemplatesAssembled(0), nTransactionsAppended(0) {
+    mempool.NotifyEntryAdded.connect(boost::bind(
+        &BlockTemplateCache::TransactionAddedToMempool, this, _1));
+    mempool.NotifyEntryRemoved.connect(boost::bind(
+        &BlockTemplateCache::TransactionRemovedFromMempool, this, _1, _2));
+}
+
+BlockTemplateCache::~BlockTemplateCache() {
+    mempool.NotifyEntryAdded.disconnect(boost::bind(
+        &BlockTemplateCache::TransactionAddedToMempool, this, _1));
+    mempool.NotifyEntryRemoved.disconnect(boost::bind(
+        &BlockTemplateCache::TransactionRemovedFromMempool, this, _1, _2));
+}
+
+std::unique_ptr<CBlockTemplate> BlockTemplateCache::Get() {
+    AssertLockHeld(cs_main);
+    LOCK(mempool.cs);
+    if (!pblocktemplate || fStale || pindexPrev != chainActive.Tip() ||
+        (fBehind &&
+         GetTime() - nTimeAssembled > BLOCK_TEMPLATE_REFRESH_INTERVAL)) {
+        if (!Assemble()) {
+            return nullptr;
+        }
+    }
+    return std::unique_ptr<CBlockTemplate>(
+        new CBlockTemplate(*pblocktemplate));
+}
+
+void BlockTemplateCache::SetBehind() {
+    LOCK(mempool.cs);
+    fBehind = true;
+}
+
+uint64_t BlockTemplateCache::GetTemplatesAssembled() const {
+    LOCK(mempool.cs);
+    return nTemplatesAssembled;
+}
+
+uint64_t BlockTemplateCache::GetTransactionsAppended() const {
+    LOCK(mempool.cs);
+    return nTransactionsAppended;
+}
+
+bool BlockTemplateCache::Assemble() {
+    // Forget the old template first, so that nothing is appended to it if
+    // assembling the new one fails.
+    pblocktemplate.reset();
+    setInBlock.clear();
+
+    BlockAssembler assembler(config, Params());
+    CScript scriptDummy = CScript() << OP_TRUE;
+    std::unique_ptr<CBlockTemplate> pnew =
+        assembler.CreateNewBlock(scriptDummy);
+    if (!pnew) {
+        return false;
+    }
+
+    pindexPrev = chainActive.Tip();
+    nHeight = pindexPrev->nHeight + 1;
+    nLockTimeCutoff =
+        (STANDARD_LOCKTIME_VERIFY_FLAGS & LOCKTIME_MEDIAN_TIME_PAST)
+            ? pindexPrev->GetMedianTimePast()
+            : pnew->block.GetBlockTime();
+    nMaxGeneratedBlockSize = assembler.GetMaxGeneratedBlockSize();
+    blockMinFeeRate = assembler.GetBlockMinFeeRate();
+
+    // Account for the coinbase as BlockAssembler does.
+    nBlockSize = 1000;
+    nBlockSigOps = 100;
+    for (size_t i = 1; i < pnew->block.vtx.size(); i++) {
+        const CTransaction &tx = *pnew->block.vtx[i];
+        nBlockSize += ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+        nBlockSigOps += pnew->vTxSigOpsCount[i];
+        setInBlock.insert(tx.GetId());
+    }
+
+    pblocktemplate = std::move(pnew);
+    nTimeAssembled = GetTime();
+    fStale = false;
+    fBehind = false;
+    ++nTemplatesAssembled;
+    return true;
+}
+
+bool BlockTemplateCache::Append(const CTxMemPoolEntry &entry) {
+    // Parents in the mempool have to come first.
+    for (const CTxMemPoolEntry *parent : entry.GetMemPoolParents()) {
+        if (!setInBlock.count(parent->GetTx().GetId())) {
+            return false;
+        }
+    }
+
+    // A new template would not take it either, unless part of the block is
+    // kept for high priority transactions.
+    if (entry.GetModifiedFee() < blockMinFeeRate.GetFee(entry.GetTxSize())) {
+        return config.GetBlockPriorityPercentage() == 0;
+    }
+
+    uint64_t nNewBlockSize = nBlockSize + entry.GetTxSize();
+    if (nNewBlockSize >= nMaxGeneratedBlockSize ||
+        nBlockSigOps + entry.GetSigOpCount() >=
+            GetMaxBlockSigOpsCount(nNewBlockSize)) {
+        return false;
+    }
+
+    CValidationState state;
+    if (!ContextualCheckTransaction(config, entry.GetTx(), state, nHeight,
+                                    nLockTimeCutoff)) {
+        return false;
+    }
+
+    CBlock &block = pblocktemplate->block;
+    block.vtx.push_back(entry.GetSharedTx());
+    pblocktemplate->vTxFees.push_back(entry.GetFee());
+    pblocktemplate->vTxSigOpsCount.push_back(entry.GetSigOpCount());
+
+    // The coinbase collects the fee.
+    CMutableTransaction coinbaseTx(*block.vtx[0]);
+    coinbaseTx.vout[0].nValue += entry.GetFee();
+    block.vtx[0] = MakeTransactionRef(std::move(coinbaseTx));
+    pblocktemplate->vTxFees[0] -= entry.GetFee();
+
+    nBlockSize = nNewBlockSize;
+    nBlockSigOps += entry.GetSigOpCount();
+    setInBlock.insert(entry.GetTx().GetId());
+
+    nLastBlockTx = block.vtx.size() - 1;
+    nLastBlockSize = nBlockSize;
+    ++nTransactionsAppended;
+    return true;
+}
+
+void BlockTemplateCache::TransactionAddedToMempool(CTransactionRef tx) {
+    AssertLockHeld(mempool.cs);
+    if (!pblocktemplate || fStale) {
+        return;
+    }
+
+    CTxMemPool::txiter it = mempool.mapTx.find(tx->GetId());
+    if (it != mempool.mapTx.end() && !Append(*it)) {
+        fBehind = true;
+    }
+}
+
+void BlockTemplateCache::TransactionRemovedFromMempool(
+    CTransactionRef tx, MemPoolRemovalReason reason) {
+    AssertLockHeld(mempool.cs);
+    if (setInBlock.count(tx->GetId())) {
+        fStale = true;
+    }
+}
+
 void IncrementExtraNonce(const Config &config, CBlock *pblock,
                          const CBlockIndex *pindexPrev,
                          unsigned int &nExtraNonce) {
@@ -659,3 +824,114 @@ void IncrementExtraNonce(const Config &config, CBlock *pblock,
     pblock->vtx[0] = MakeTransactionRef(std::move(txCoinbase));
     pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
 }
+
+namespace {
+
+//! Nonces tried per batch by each GrindNonce thread; a multiple of 4 so that
+//! Blake2b headers can be hashed four at a time.
+const uint32_t GRIND_CHUNK_SIZE = 64;
+
+struct GrindJob {
+    //! The serialized header; only the nonce bytes change between attempts.
+    std::vector<uint8_t> header;
+    bool fBlake2;
+    //! Largest raw hash that satisfies the target.
+    arith_uint256 bnLimit;
+    uint32_t nBegin;
+    uint32_t nEnd;
+    int nThreads;
+};
+
+void GrindNonceThread(const GrindJob &job, int nThread,
+                      std::atomic<uint32_t> &nBest) {
+    static const size_t HEADER_SIZE = 80;
+    static const size_t NONCE_OFFSET = 76;
+
+    std::vector<uint8_t> headers(GRIND_CHUNK_SIZE * HEADER_SIZE);
+    for (uint32_t i = 0; i < GRIND_CHUNK_SIZE; i++) {
+        memcpy(&headers[i * HEADER_SIZE], job.header.data(), HEADER_SIZE);
+    }
+    std::vector<uint8_t> digests(GRIND_CHUNK_SIZE * 32);
+
+    // Threads take chunks in turn, so every nonce below the best one found
+    // has been tried by the time all of them stop.
+    const uint64_t nStride = uint64_t(job.nThreads) * GRIND_CHUNK_SIZE;
+    for (uint64_t nChunk = job.nBegin + uint64_t(nThread) * GRIND_CHUNK_SIZE;
+         nChunk < job.nEnd && nChunk < nBest; nChunk += nStride) {
+        uint32_t nCount = std::min<uint64_t>(GRIND_CHUNK_SIZE, job.nEnd - nChunk);
+        for (uint32_t i = 0; i < nCount; i++) {
+            WriteLE32(&headers[i * HEADER_SIZE + NONCE_OFFSET], nChunk + i);
+        }
+        if (job.fBlake2) {
+            Blake2::hash2b_80(digests.data(), headers.data(), nCount);
+        } else {
+            for (uint32_t i = 0; i < nCount; i++) {
+                CHash256()
+                    .Write(&headers[i * HEADER_SIZE], HEADER_SIZE)
+                    .Finalize(&digests[i * 32]);
+            }
+        }
+
+        for (uint32_t i = 0; i < nCount; i++) {
+            uint256 hash;
+            memcpy(hash.begin(), &digests[i * 32], 32);
+            if (UintToArith256(hash) <= job.bnLimit) {
+                uint32_t nNonce = nChunk + i;
+                uint32_t nCurrent = nBest;
+                while (nNonce < nCurrent &&
+                       !nBest.compare_exchange_weak(nCurrent, nNonce)) {
+                }
+                return;
+            }
+        }
+    }
+}
+
+} // namespace
+
+uint32_t GrindNonce(const CBlockHeader &header, int nHeight, uint32_t nBegin,
+                    uint32_t nEnd, int nThreads,
+                    const Consensus::Params &consensusParams) {
+    bool fNegative;
+    bool fOverflow;
+    arith_uint256 bnTarget;
+    bnTarget.SetCompact(header.nBits, &fNegative, &fOverflow);
+    if (fNegative || bnTarget == 0 || fOverflow ||
+        bnTarget > UintToArith256(consensusParams.powLimit)) {
+        return nEnd;
+    }
+
+    GrindJob job;
+    CVectorWriter(SER_GETHASH, PROTOCOL_VERSION, job.header, 0, header);
+    job.fBlake2 = nHeight > consensusParams.powBlake2Height;
+    job.bnLimit = bnTarget;
+    if (job.fBlake2 && header.nVersion == CBlockHeader::SCALED_POW_VERSION) {
+        // The scaled hash floor(hash / divisor) is within the target exactly
+        // when hash < (target + 1) * divisor, which may not fit in 256 bits.
+        arith_uint256 bnMaxTarget = ~arith_uint256();
+        bnMaxTarget.DivideBy(CBlockHeader::SCALED_POW_DIVISOR);
+        if (bnTarget >= bnMaxTarget) {
+            job.bnLimit = ~arith_uint256();
+        } else {
+            job.bnLimit =
+                (bnTarget + 1) *
+                    arith_uint256(CBlockHeader::SCALED_POW_DIVISOR) -
+                1;
+        }
+    }
+    job.nBegin = nBegin;
+    job.nEnd = nEnd;
+    job.nThreads = std::max(1, nThreads);
+
+    std::atomic<uint32_t> nBest(nEnd);
+    std::vector<std::thread> threads;
+    for (int i = 1; i < job.nThreads; i++) {
+        threads.emplace_back(GrindNonceThread, std::cref(job), i,
+                             std::ref(nBest));
+    }
+    GrindNonceThread(job, 0, nBest);
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    return nBest;
+}
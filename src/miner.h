@@ -14,6 +14,7 @@
 
 #include <cstdint>
 #include <memory>
+#include <set>
 
 class CBlockIndex;
 class CChainParams;
@@ -27,6 +28,11 @@ struct Params;
 };
 
 static const bool DEFAULT_PRINTPRIORITY = false;
+/**
+ * Seconds a cached block template that has passed over transactions is kept
+ * before it is assembled again.
+ */
+static const int64_t BLOCK_TEMPLATE_REFRESH_INTERVAL = 5;
 
 struct CBlockTemplate {
     CBlock block;
@@ -166,6 +172,7 @@ public:
     CreateNewBlock(const CScript &scriptPubKeyIn);
 
     uint64_t GetMaxGeneratedBlockSize() const { return nMaxGeneratedBlockSize; }
+    CFeeRate GetBlockMinFeeRate() const { return blockMinFeeRate; }
 
 private:
     // utility functions
@@ -214,6 +221,82 @@ private:
                                indexed_modified_transaction_set &mapModifiedTx);
 };
 
+/**
+ * A block template on the current tip that is kept up to date as transactions
+ * enter and leave the mempool, so that getblocktemplate does not assemble a new
+ * block on every call.
+ *
+ * A transaction that enters the mempool is appended to the template when all
+ * of its in-mempool parents are already in it and it fits, which is all that a
+ * new template would do unless the block is full. A template that loses one of
+ * its transactions, or whose tip is no longer the best, is assembled again on
+ * the next call. One that passed over a transaction it could not append is
+ * assembled again once it is BLOCK_TEMPLATE_REFRESH_INTERVAL seconds old.
+ *
+ * The template is guarded by the mempool's cs, which is held whenever the
+ * mempool signals fire.
+ */
+class BlockTemplateCache {
+public:
+    BlockTemplateCache(const Config &config);
+    ~BlockTemplateCache();
+
+    /**
+     * Return a copy of the template for the current tip, with a coinbase
+     * paying to OP_TRUE, or nullptr if no template could be assembled.
+     * Requires cs_main.
+     */
+    std::unique_ptr<CBlockTemplate> Get();
+
+    /**
+     * Have the template assembled again once it is old enough, for changes
+     * that the mempool does not signal, like prioritisetransaction.
+     */
+    void SetBehind();
+
+    /** Number of templates assembled from scratch so far */
+    uint64_t GetTemplatesAssembled() const;
+    /** Number of transactions appended to templates so far */
+    uint64_t GetTransactionsAppended() const;
+
+private:
+    const Config &config;
+
+    std::unique_ptr<CBlockTemplate> pblocktemplate;
+    const CBlockIndex *pindexPrev;
+    int64_t nTimeAssembled;
+    //! Whether a transaction in the template has left the mempool
+    bool fStale;
+    //! Whether a transaction was passed over
+    bool fBehind;
+
+    // State of the template, as BlockAssembler keeps it
+    std::set<uint256> setInBlock;
+    uint64_t nBlockSize;
+    uint64_t nBlockSigOps;
+    int nHeight;
+    int64_t nLockTimeCutoff;
+    uint64_t nMaxGeneratedBlockSize;
+    CFeeRate blockMinFeeRate;
+
+    uint64_t nTemplatesAssembled;
+    uint64_t nTransactionsAppended;
+
+    /** Assemble a new template from the whole mempool */
+    bool Assemble();
+    /**
+     * Append the entry to the template if it fits. Return false if it was
+     * passed over where a new template might include it.
+     */
+    bool Append(const CTxMemPoolEntry &entry);
+    void TransactionAddedToMempool(CTransactionRef tx);
+    void TransactionRemovedFromMempool(CTransactionRef tx,
+                                       MemPoolRemovalReason reason);
+};
+
+/** The template getblocktemplate serves, if the node has been started */
+extern std::unique_ptr<BlockTemplateCache> g_blocktemplatecache;
+
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(const Config &config, CBlock *pblock,
                          const CBlockIndex *pindexPrev,
@@ -221,4 +304,12 @@ void IncrementExtraNonce(const Config &config, CBlock *pblock,
 int64_t UpdateTime(CBlockHeader *pblock,
                    const Consensus::Params &consensusParams,
                    const CBlockIndex *pindexPrev);
+/**
+ * Return the lowest nonce in [nBegin, nEnd) that gives header, mined at
+ * nHeight, a valid proof of work, or nEnd if there is none. The search is
+ * spread over nThreads threads and finds the same nonce for any thread count.
+ */
+uint32_t GrindNonce(const CBlockHeader &header, int nHeight, uint32_t nBegin,
+                    uint32_t nEnd, int nThreads,
+                    const Consensus::Params &consensusParams);
 #endif // BITCOIN_MINER_H
@@ -2113,6 +2113,8 @@ void CConnman::ThreadMessageHandler() {
             }
         }
 
+        GetNodeSignals().ProcessQueued(*config, *this);
+
         {
             LOCK(cs_vNodes);
             for (CNode *pnode : vNodesCopy) {
@@ -2776,6 +2778,10 @@ ServiceFlags CConnman::GetLocalServices() const {
     return nLocalServices;
 }
 
+void CConnman::RemoveLocalServices(ServiceFlags services) {
+    nLocalServices = ServiceFlags(nLocalServices & ~services);
+}
+
 void CConnman::SetBestHeight(int height) {
     nBestHeight.store(height, std::memory_order_release);
 }
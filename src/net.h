@@ -252,6 +252,8 @@ public:
     void AddWhitelistedRange(const CSubNet &subnet);
 
     ServiceFlags GetLocalServices() const;
+    //! Stop offering services to peers that connect from now on.
+    void RemoveLocalServices(ServiceFlags services);
 
     //! set the max outbound target in bytes.
     void SetMaxOutboundTarget(uint64_t limit);
@@ -378,7 +380,7 @@ private:
     std::atomic<NodeId> nLastNodeId;
 
     /** Services this instance offers */
-    ServiceFlags nLocalServices;
+    std::atomic<ServiceFlags> nLocalServices;
 
     /** Services this instance cares about */
     ServiceFlags nRelevantServices;
@@ -444,6 +446,8 @@ struct CNodeSignals {
     boost::signals2::signal<void(const Config &, CNode *, CConnman &)>
         InitializeNode;
     boost::signals2::signal<void(NodeId, bool &)> FinalizeNode;
+    //! Once per pass of the message handler, after every node had its turn.
+    boost::signals2::signal<void(const Config &, CConnman &)> ProcessQueued;
 };
 
 CNodeSignals &GetNodeSignals();
@@ -129,6 +129,12 @@ MapRelay mapRelay;
 /** Expiration-time ordered list of (expire time, relay map entry) pairs,
  * protected by cs_main). */
 std::deque<std::pair<int64_t, MapRelay::iterator>> vRelayExpiration;
+
+/**
+ * Transactions received during the current pass of the message handler, with
+ * the peer that sent them. Protected by cs_main.
+ */
+std::vector<std::pair<NodeId, CTransactionRef>> vQueuedTransactions;
 } // namespace
 
 //////////////////////////////////////////////////////////////////////////////
@@ -694,6 +700,7 @@ void RegisterNodeSignals(CNodeSignals &nodeSignals) {
     nodeSignals.SendMessages.connect(&SendMessages);
     nodeSignals.InitializeNode.connect(&InitializeNode);
     nodeSignals.FinalizeNode.connect(&FinalizeNode);
+    nodeSignals.ProcessQueued.connect(&ProcessQueuedTransactions);
 }
 
 void UnregisterNodeSignals(CNodeSignals &nodeSignals) {
@@ -701,6 +708,7 @@ void UnregisterNodeSignals(CNodeSignals &nodeSignals) {
     nodeSignals.SendMessages.disconnect(&SendMessages);
     nodeSignals.InitializeNode.disconnect(&InitializeNode);
     nodeSignals.FinalizeNode.disconnect(&FinalizeNode);
+    nodeSignals.ProcessQueued.disconnect(&ProcessQueuedTransactions);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1391,6 +1399,298 @@ inline static void SendBlockTransactions(const CBlock &block,
                         msgMaker.Make(nSendFlags, NetMsgType::BLOCKTXN, resp));
 }
 
+/**
+ * Add the orphans that spend the outputs of tx, which just got into the
+ * mempool, and in turn the orphans that spend theirs.
+ */
+static void ProcessOrphanTransactions(const Config &config,
+                                      const CTransaction &tx,
+                                      CConnman &connman,
+                                      std::list<CTransactionRef> &lRemovedTxn) {
+    AssertLockHeld(cs_main);
+
+    std::deque<COutPoint> vWorkQueue;
+    std::vector<uint256> vEraseQueue;
+    for (size_t i = 0; i < tx.vout.size(); i++) {
+        vWorkQueue.emplace_back(tx.GetId(), i);
+    }
+
+    std::set<NodeId> setMisbehaving;
+    while (!vWorkQueue.empty()) {
+        auto itByPrev = mapOrphanTransactionsByPrev.find(vWorkQueue.front());
+        vWorkQueue.pop_front();
+        if (itByPrev == mapOrphanTransactionsByPrev.end()) {
+            continue;
+        }
+        for (auto mi = itByPrev->second.begin(); mi != itByPrev->second.end();
+             ++mi) {
+            const CTransactionRef &porphanTx = (*mi)->second.tx;
+            const CTransaction &orphanTx = *porphanTx;
+            const uint256 &orphanId = orphanTx.GetId();
+            NodeId fromPeer = (*mi)->second.fromPeer;
+            bool fMissingInputs2 = false;
+            // Use a dummy CValidationState so someone can't setup nodes to
+            // counter-DoS based on orphan resolution (that is, feeding people
+            // an invalid transaction based on LegitTxX in order to get anyone
+            // relaying LegitTxX banned)
+            CValidationState stateDummy;
+
+            if (setMisbehaving.count(fromPeer)) {
+                continue;
+            }
+            if (AcceptToMemoryPool(config, mempool, stateDummy, porphanTx,
+                                   true, &fMissingInputs2, &lRemovedTxn)) {
+                LogPrint(BCLog::MEMPOOL, "   accepted orphan tx %s\n",
+                         orphanId.ToString());
+                RelayTransaction(orphanTx, connman);
+                for (size_t i = 0; i < orphanTx.vout.size(); i++) {
+                    vWorkQueue.emplace_back(orphanId, i);
+                }
+                vEraseQueue.push_back(orphanId);
+            } else if (!fMissingInputs2) {
+                int nDos = 0;
+                if (stateDummy.IsInvalid(nDos) && nDos > 0) {
+                    // Punish peer that gave us an invalid orphan tx
+                    Misbehaving(fromPeer, nDos, "invalid-orphan-tx");
+                    setMisbehaving.insert(fromPeer);
+                    LogPrint(BCLog::MEMPOOL, "   invalid orphan tx %s\n",
+                             orphanId.ToString());
+                }
+                // Has inputs but not accepted to mempool
+                // Probably non-standard or insufficient fee/priority
+                LogPrint(BCLog::MEMPOOL, "   removed orphan tx %s\n",
+                         orphanId.ToString());
+                vEraseQueue.push_back(orphanId);
+                if (!stateDummy.CorruptionPossible()) {
+                    // Do not use rejection cache for witness transactions or
+                    // witness-stripped transactions, as they can have been
+                    // malleated. See
+                    // https://github.com/bitcoin/bitcoin/issues/8279 for
+                    // details.
+                    assert(recentRejects);
+                    recentRejects->insert(orphanId);
+                }
+            }
+            mempool.check(pcoinsTip);
+        }
+    }
+
+    for (uint256 hash : vEraseQueue) {
+        EraseOrphanTx(hash);
+    }
+}
+
+/**
+ * Act on what AcceptToMemoryPool made of a transaction that pfrom sent: relay
+ * it, keep it as an orphan, or reject it. A transaction we already had is
+ * neither accepted nor missing inputs, with a valid state.
+ */
+static void ProcessTransactionResult(const Config &config, CNode *pfrom,
+                                     CConnman &connman,
+                                     const CTransactionRef &ptx,
+                                     bool fAccepted, bool fMissingInputs,
+                                     const CValidationState &state) {
+    AssertLockHeld(cs_main);
+
+    const CTransaction &tx = *ptx;
+    std::list<CTransactionRef> lRemovedTxn;
+
+    if (fAccepted) {
+        mempool.check(pcoinsTip);
+        RelayTransaction(tx, connman);
+
+        pfrom->nLastTXTime = GetTime();
+
+        LogPrint(BCLog::MEMPOOL, "AcceptToMemoryPool: peer=%d: accepted %s "
+                                 "(poolsz %u txn, %u kB)\n",
+                 pfrom->id, tx.GetId().ToString(), mempool.size(),
+                 mempool.DynamicMemoryUsage() / 1000);
+
+        // Recursively process any orphan transactions that depended on this
+        // one
+        ProcessOrphanTransactions(config, tx, connman, lRemovedTxn);
+    } else if (fMissingInputs) {
+        // It may be the case that the orphans parents have all been
+        // rejected.
+        bool fRejectedParents = false;
+        for (const CTxIn &txin : tx.vin) {
+            if (recentRejects->contains(txin.prevout.hash)) {
+                fRejectedParents = true;
+                break;
+            }
+        }
+        if (!fRejectedParents) {
+            uint32_t nFetchFlags =
+                GetFetchFlags(pfrom, chainActive.Tip(),
+                              config.GetChainParams().GetConsensus());
+            for (const CTxIn &txin : tx.vin) {
+                CInv _inv(MSG_TX | nFetchFlags, txin.prevout.hash);
+                pfrom->AddInventoryKnown(_inv);
+                if (!AlreadyHave(_inv)) {
+                    pfrom->AskFor(_inv);
+                }
+            }
+            AddOrphanTx(ptx, pfrom->GetId());
+
+            // DoS prevention: do not allow mapOrphanTransactions to grow
+            // unbounded
+            unsigned int nMaxOrphanTx = (unsigned int)std::max(
+                int64_t(0),
+                GetArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
+            unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx);
+            if (nEvicted > 0) {
+                LogPrint(BCLog::MEMPOOL,
+                         "mapOrphan overflow, removed %u tx\n", nEvicted);
+            }
+        } else {
+            LogPrint(BCLog::MEMPOOL,
+                     "not keeping orphan with rejected parents %s\n",
+                     tx.GetId().ToString());
+            // We will continue to reject this tx since it has rejected
+            // parents so avoid re-requesting it from other peers.
+            recentRejects->insert(tx.GetId());
+        }
+    } else {
+        if (!state.CorruptionPossible()) {
+            // Do not use rejection cache for witness transactions or
+            // witness-stripped transactions, as they can have been
+            // malleated. See https://github.com/bitcoin/bitcoin/issues/8279
+            // for details.
+            assert(recentRejects);
+            recentRejects->insert(tx.GetId());
+            if (RecursiveDynamicUsage(*ptx) < 100000) {
+                AddToCompactExtraTransactions(ptx);
+            }
+        }
+
+        if (pfrom->fWhitelisted &&
+            GetBoolArg("-whitelistforcerelay", DEFAULT_WHITELISTFORCERELAY)) {
+            // Always relay transactions received from whitelisted peers,
+            // even if they were already in the mempool or rejected from it
+            // due to policy, allowing the node to function as a gateway for
+            // nodes hidden behind it.
+            //
+            // Never relay transactions that we would assign a non-zero DoS
+            // score for, as we expect peers to do the same with us in that
+            // case.
+            int nDoS = 0;
+            if (!state.IsInvalid(nDoS) || nDoS == 0) {
+                LogPrintf("Force relaying tx %s from whitelisted peer=%d\n",
+                          tx.GetId().ToString(), pfrom->id);
+                RelayTransaction(tx, connman);
+            } else {
+                LogPrintf("Not relaying invalid transaction %s from "
+                          "whitelisted peer=%d (%s)\n",
+                          tx.GetId().ToString(), pfrom->id,
+                          FormatStateMessage(state));
+            }
+        }
+    }
+
+    for (const CTransactionRef &removedTx : lRemovedTxn) {
+        AddToCompactExtraTransactions(removedTx);
+    }
+
+    int nDoS = 0;
+    if (state.IsInvalid(nDoS)) {
+        LogPrint(BCLog::MEMPOOLREJ, "%s from peer=%d was not accepted: %s\n",
+                 tx.GetId().ToString(), pfrom->id, FormatStateMessage(state));
+        // Never send AcceptToMemoryPool's internal codes over P2P.
+        if (state.GetRejectCode() < REJECT_INTERNAL) {
+            const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+            connman.PushMessage(
+                pfrom,
+                msgMaker.Make(NetMsgType::REJECT, std::string(NetMsgType::TX),
+                              uint8_t(state.GetRejectCode()),
+                              state.GetRejectReason().substr(
+                                  0, MAX_REJECT_MESSAGE_LENGTH),
+                              tx.GetId()));
+        }
+        if (nDoS > 0) {
+            Misbehaving(pfrom, nDoS, state.GetRejectReason());
+        }
+    }
+}
+
+void ProcessQueuedTransactions(const Config &config, CConnman &connman) {
+    std::vector<std::pair<NodeId, CTransactionRef>> vQueued;
+    {
+        LOCK(cs_main);
+        vQueued.swap(vQueuedTransactions);
+    }
+    if (vQueued.empty()) {
+        return;
+    }
+
+    // Do the disk reads for the inputs before taking cs_main.
+    std::vector<CTransactionRef> vtx;
+    for (const auto &queued : vQueued) {
+        vtx.push_back(queued.second);
+    }
+    std::vector<COutPoint> vPrefetched;
+    PrefetchCoins(vtx, vPrefetched);
+
+    // Transactions we already have, including a second copy from another
+    // peer, are not submitted; index -1 in vSubmission.
+    std::vector<MempoolSubmission> vSubmissions;
+    std::vector<int> vSubmission(vQueued.size(), -1);
+    {
+        LOCK(cs_main);
+        std::set<uint256> setSubmitted;
+        for (size_t i = 0; i < vQueued.size(); i++) {
+            const CTransactionRef &ptx = vQueued[i].second;
+            if (!AlreadyHave(CInv(MSG_TX, ptx->GetId())) &&
+                setSubmitted.insert(ptx->GetId()).second) {
+                vSubmission[i] = vSubmissions.size();
+                vSubmissions.emplace_back(ptx);
+            }
+        }
+    }
+
+    AcceptToMemoryPoolParallel(config, mempool, vSubmissions, true);
+
+    LOCK(cs_main);
+    const CValidationState stateAlreadyHave;
+    for (size_t i = 0; i < vQueued.size(); i++) {
+        const CTransactionRef &ptx = vQueued[i].second;
+        bool fAccepted = false;
+        bool fMissingInputs = false;
+        const CValidationState *pstate = &stateAlreadyHave;
+        if (vSubmission[i] >= 0) {
+            const MempoolSubmission &sub = vSubmissions[vSubmission[i]];
+            fAccepted = sub.fAccepted;
+            fMissingInputs = sub.fMissingInputs;
+            pstate = &sub.state;
+        }
+
+        bool fFound = connman.ForNode(vQueued[i].first, [&](CNode *pfrom) {
+            ProcessTransactionResult(config, pfrom, connman, ptx, fAccepted,
+                                     fMissingInputs, *pstate);
+            return true;
+        });
+        if (!fFound && fAccepted) {
+            // The peer is gone, but the transaction is good.
+            RelayTransaction(*ptx, connman);
+            std::list<CTransactionRef> lRemovedTxn;
+            ProcessOrphanTransactions(config, *ptx, connman, lRemovedTxn);
+        }
+    }
+
+    // Like AcceptToMemoryPool, do not let transactions that did not make it in
+    // fill the coins cache.
+    std::set<COutPoint> setPrefetched(vPrefetched.begin(), vPrefetched.end());
+    for (const CTransactionRef &ptx : vtx) {
+        if (mempool.exists(ptx->GetId())) {
+            continue;
+        }
+        for (const CTxIn &txin : ptx->vin) {
+            if (setPrefetched.count(txin.prevout)) {
+                pcoinsTip->Uncache(txin.prevout);
+            }
+        }
+    }
+}
+
 static bool ProcessMessage(const Config &config, CNode *pfrom,
                            const std::string &strCommand, CDataStream &vRecv,
                            int64_t nTimeReceived,
@@ -2072,209 +2372,20 @@ static bool ProcessMessage(const Config &config, CNode *pfrom,
             return true;
         }
 
-        std::deque<COutPoint> vWorkQueue;
-        std::vector<uint256> vEraseQueue;
         CTransactionRef ptx;
         vRecv >> ptx;
-        const CTransaction &tx = *ptx;
 
-        CInv inv(MSG_TX, tx.GetId());
+        CInv inv(MSG_TX, ptx->GetId());
         pfrom->AddInventoryKnown(inv);
 
         LOCK(cs_main);
 
-        bool fMissingInputs = false;
-        CValidationState state;
-
         pfrom->setAskFor.erase(inv.hash);
         mapAlreadyAskedFor.erase(inv.hash);
 
-        std::list<CTransactionRef> lRemovedTxn;
-
-        if (!AlreadyHave(inv) &&
-            AcceptToMemoryPool(config, mempool, state, ptx, true,
-                               &fMissingInputs, &lRemovedTxn)) {
-            mempool.check(pcoinsTip);
-            RelayTransaction(tx, connman);
-            for (size_t i = 0; i < tx.vout.size(); i++) {
-                vWorkQueue.emplace_back(inv.hash, i);
-            }
-
-            pfrom->nLastTXTime = GetTime();
-
-            LogPrint(BCLog::MEMPOOL, "AcceptToMemoryPool: peer=%d: accepted %s "
-                                "(poolsz %u txn, %u kB)\n",
-                     pfrom->id, tx.GetId().ToString(), mempool.size(),
-                     mempool.DynamicMemoryUsage() / 1000);
-
-            // Recursively process any orphan transactions that depended on this
-            // one
-            std::set<NodeId> setMisbehaving;
-            while (!vWorkQueue.empty()) {
-                auto itByPrev =
-                    mapOrphanTransactionsByPrev.find(vWorkQueue.front());
-                vWorkQueue.pop_front();
-                if (itByPrev == mapOrphanTransactionsByPrev.end()) {
-                    continue;
-                }
-                for (auto mi = itByPrev->second.begin();
-                     mi != itByPrev->second.end(); ++mi) {
-                    const CTransactionRef &porphanTx = (*mi)->second.tx;
-                    const CTransaction &orphanTx = *porphanTx;
-                    const uint256 &orphanId = orphanTx.GetId();
-                    NodeId fromPeer = (*mi)->second.fromPeer;
-                    bool fMissingInputs2 = false;
-                    // Use a dummy CValidationState so someone can't setup nodes
-                    // to counter-DoS based on orphan resolution (that is,
-                    // feeding people an invalid transaction based on LegitTxX
-                    // in order to get anyone relaying LegitTxX banned)
-                    CValidationState stateDummy;
-
-                    if (setMisbehaving.count(fromPeer)) {
-                        continue;
-                    }
-                    if (AcceptToMemoryPool(config, mempool, stateDummy,
-                                           porphanTx, true, &fMissingInputs2,
-                                           &lRemovedTxn)) {
-                        LogPrint(BCLog::MEMPOOL, "   accepted orphan tx %s\n",
-                                 orphanId.ToString());
-                        RelayTransaction(orphanTx, connman);
-                        for (size_t i = 0; i < orphanTx.vout.size(); i++) {
-                            vWorkQueue.emplace_back(orphanId, i);
-                        }
-                        vEraseQueue.push_back(orphanId);
-                    } else if (!fMissingInputs2) {
-                        int nDos = 0;
-                        if (stateDummy.IsInvalid(nDos) && nDos > 0) {
-                            // Punish peer that gave us an invalid orphan tx
-                            Misbehaving(fromPeer, nDos, "invalid-orphan-tx");
-                            setMisbehaving.insert(fromPeer);
-                            LogPrint(BCLog::MEMPOOL,
-                                     "   invalid orphan tx %s\n",
-                                     orphanId.ToString());
-                        }
-                        // Has inputs but not accepted to mempool
-                        // Probably non-standard or insufficient fee/priority
-                        LogPrint(BCLog::MEMPOOL, "   removed orphan tx %s\n",
-                                 orphanId.ToString());
-                        vEraseQueue.push_back(orphanId);
-                        if (!stateDummy.CorruptionPossible()) {
-                            // Do not use rejection cache for witness
-                            // transactions or witness-stripped transactions, as
-                            // they can have been malleated. See
-                            // https://github.com/bitcoin/bitcoin/issues/8279
-                            // for details.
-                            assert(recentRejects);
-                            recentRejects->insert(orphanId);
-                        }
-                    }
-                    mempool.check(pcoinsTip);
-                }
-            }
-
-            for (uint256 hash : vEraseQueue) {
-                EraseOrphanTx(hash);
-            }
-        } else if (fMissingInputs) {
-            // It may be the case that the orphans parents have all been
-            // rejected.
-            bool fRejectedParents = false;
-            for (const CTxIn &txin : tx.vin) {
-                if (recentRejects->contains(txin.prevout.hash)) {
-                    fRejectedParents = true;
-                    break;
-                }
-            }
-            if (!fRejectedParents) {
-                uint32_t nFetchFlags = GetFetchFlags(
-                    pfrom, chainActive.Tip(), chainparams.GetConsensus());
-                for (const CTxIn &txin : tx.vin) {
-                    CInv _inv(MSG_TX | nFetchFlags, txin.prevout.hash);
-                    pfrom->AddInventoryKnown(_inv);
-                    if (!AlreadyHave(_inv)) {
-                        pfrom->AskFor(_inv);
-                    }
-                }
-                AddOrphanTx(ptx, pfrom->GetId());
-
-                // DoS prevention: do not allow mapOrphanTransactions to grow
-                // unbounded
-                unsigned int nMaxOrphanTx = (unsigned int)std::max(
-                    int64_t(0),
-                    GetArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
-                unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx);
-                if (nEvicted > 0) {
-                    LogPrint(BCLog::MEMPOOL,
-                             "mapOrphan overflow, removed %u tx\n", nEvicted);
-                }
-            } else {
-                LogPrint(BCLog::MEMPOOL,
-                         "not keeping orphan with rejected parents %s\n",
-                         tx.GetId().ToString());
-                // We will continue to reject this tx since it has rejected
-                // parents so avoid re-requesting it from other peers.
-                recentRejects->insert(tx.GetId());
-            }
-        } else {
-            if (!state.CorruptionPossible()) {
-                // Do not use rejection cache for witness transactions or
-                // witness-stripped transactions, as they can have been
-                // malleated. See https://github.com/bitcoin/bitcoin/issues/8279
-                // for details.
-                assert(recentRejects);
-                recentRejects->insert(tx.GetId());
-                if (RecursiveDynamicUsage(*ptx) < 100000) {
-                    AddToCompactExtraTransactions(ptx);
-                }
-            }
-
-            if (pfrom->fWhitelisted &&
-                GetBoolArg("-whitelistforcerelay",
-                           DEFAULT_WHITELISTFORCERELAY)) {
-                // Always relay transactions received from whitelisted peers,
-                // even if they were already in the mempool or rejected from it
-                // due to policy, allowing the node to function as a gateway for
-                // nodes hidden behind it.
-                //
-                // Never relay transactions that we would assign a non-zero DoS
-                // score for, as we expect peers to do the same with us in that
-                // case.
-                int nDoS = 0;
-                if (!state.IsInvalid(nDoS) || nDoS == 0) {
-                    LogPrintf("Force relaying tx %s from whitelisted peer=%d\n",
-                              tx.GetId().ToString(), pfrom->id);
-                    RelayTransaction(tx, connman);
-                } else {
-                    LogPrintf("Not relaying invalid transaction %s from "
-                              "whitelisted peer=%d (%s)\n",
-                              tx.GetId().ToString(), pfrom->id,
-                              FormatStateMessage(state));
-                }
-            }
-        }
-
-        for (const CTransactionRef &removedTx : lRemovedTxn) {
-            AddToCompactExtraTransactions(removedTx);
-        }
-
-        int nDoS = 0;
-        if (state.IsInvalid(nDoS)) {
-            LogPrint(
-                BCLog::MEMPOOLREJ, "%s from peer=%d was not accepted: %s\n",
-                tx.GetId().ToString(), pfrom->id, FormatStateMessage(state));
-            // Never send AcceptToMemoryPool's internal codes over P2P.
-            if (state.GetRejectCode() < REJECT_INTERNAL) {
-                connman.PushMessage(
-                    pfrom, msgMaker.Make(NetMsgType::REJECT, strCommand,
-                                         uint8_t(state.GetRejectCode()),
-                                         state.GetRejectReason().substr(
-                                             0, MAX_REJECT_MESSAGE_LENGTH),
-                                         inv.hash));
-            }
-            if (nDoS > 0) {
-                Misbehaving(pfrom, nDoS, state.GetRejectReason());
-            }
-        }
+        // Accepted together with the transactions other peers sent during
+        // this pass of the message handler, see ProcessQueuedTransactions.
+        vQueuedTransactions.emplace_back(pfrom->GetId(), ptx);
     }
 
     // Ignore blocks received while importing
@@ -60,6 +60,12 @@ void Misbehaving(NodeId nodeid, int howmuch, const std::string &reason);
 /** Process protocol messages received from a given node */
 bool ProcessMessages(const Config &config, CNode *pfrom, CConnman &connman,
                      const std::atomic<bool> &interrupt);
+/**
+ * Accept the transactions that ProcessMessages received from all peers during
+ * one pass of the message handler to the mempool together, then relay or
+ * reject each of them as if it had come alone.
+ */
+void ProcessQueuedTransactions(const Config &config, CConnman &connman);
 /**
  * Send queued protocol messages to be sent to a give node.
  *
@@ -0,0 +1,342 @@
+// Copyright (c) 2018 The Title Network developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_POOLMAP_H
+#define BITCOIN_POOLMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Hash map with open addressing whose entries are kept in a pool.
+ *
+ * The table is an array of 8 byte slots, each holding 32 bits of the hash of
+ * its key and the index of its entry in the pool. It is probed linearly, and
+ * the stored hash bits let most mismatches be skipped without touching the
+ * entry. Entries are allocated in chunks and recycled through a free list, so
+ * there is no allocation per entry as with std::unordered_map.
+ *
+ * Growing the table only moves slots, so references to entries stay valid
+ * until that entry is erased. Iterators stay valid when other entries are
+ * erased, which keeps the erase(it++) idiom working, but not across inserts.
+ */
+template <typename K, typename V, typename Hash> class poolmap {
+public:
+    typedef K key_type;
+    typedef V mapped_type;
+    typedef std::pair<const K, V> value_type;
+    typedef size_t size_type;
+
+private:
+    struct Slot {
+        uint32_t tag;
+        uint32_t index;
+    };
+
+    static const uint32_t EMPTY = 0xffffffff;
+    static const uint32_t DELETED = 0xfffffffe;
+
+    //! Chunks double in size from 2^MIN_CHUNK_SHIFT up to 2^MAX_CHUNK_SHIFT
+    //! entries, so that small, short lived maps stay cheap.
+    static const uint32_t MIN_CHUNK_SHIFT = 4;
+    static const uint32_t MAX_CHUNK_SHIFT = 12;
+    //! Number of entries in the chunks that are still growing.
+    static const uint32_t GROWING_ENTRIES =
+        ((1U << (MAX_CHUNK_SHIFT - MIN_CHUNK_SHIFT)) - 1) << MIN_CHUNK_SHIFT;
+
+    typedef typename std::aligned_storage<sizeof(value_type),
+                                          alignof(value_type)>::type Storage;
+
+    Hash hasher;
+    //! Empty, or a power of two in size.
+    std::vector<Slot> table;
+    std::vector<std::unique_ptr<Storage[]>> chunks;
+    std::vector<uint32_t> vFree;
+    //! Pool indexes handed out so far, free or not.
+    uint32_t nAllocated;
+    //! Entries the chunks have room for.
+    uint32_t nCapacity;
+    size_t nSize;
+    size_t nDeleted;
+
+    static uint32_t ChunkSize(size_t nChunk) {
+        size_t nShift = MIN_CHUNK_SHIFT + nChunk;
+        return 1U << (nShift < MAX_CHUNK_SHIFT ? nShift : MAX_CHUNK_SHIFT);
+    }
+
+    value_type *Entry(uint32_t index) const {
+        size_t nChunk = 0;
+        uint32_t nOffset;
+        if (index < GROWING_ENTRIES) {
+            uint32_t q = (index >> MIN_CHUNK_SHIFT) + 1;
+            while (q >>= 1) {
+                nChunk++;
+            }
+            nOffset = index - (((1U << nChunk) - 1) << MIN_CHUNK_SHIFT);
+        } else {
+            index -= GROWING_ENTRIES;
+            nChunk = (MAX_CHUNK_SHIFT - MIN_CHUNK_SHIFT) +
+                     (index >> MAX_CHUNK_SHIFT);
+            nOffset = index & ((1U << MAX_CHUNK_SHIFT) - 1);
+        }
+        return reinterpret_cast<value_type *>(&chunks[nChunk][nOffset]);
+    }
+
+    uint32_t AllocateIndex() {
+        if (!vFree.empty()) {
+            uint32_t index = vFree.back();
+            vFree.pop_back();
+            return index;
+        }
+        if (nAllocated == nCapacity) {
+            uint32_t nChunkSize = ChunkSize(chunks.size());
+            chunks.emplace_back(new Storage[nChunkSize]);
+            nCapacity += nChunkSize;
+        }
+        return nAllocated++;
+    }
+
+    static uint32_t Tag(size_t hash) { return uint64_t(hash) >> 32; }
+
+    /**
+     * Find the slot of key, or if it is missing, the slot it would be
+     * inserted at. The table must not be empty.
+     */
+    size_t Probe(const K &key, size_t hash, bool &fFound) const {
+        const size_t mask = table.size() - 1;
+        const uint32_t tag = Tag(hash);
+        size_t pos = hash & mask;
+        size_t posInsert = table.size();
+        while (true) {
+            const Slot &slot = table[pos];
+            if (slot.index == EMPTY) {
+                fFound = false;
+                return posInsert < table.size() ? posInsert : pos;
+            }
+            if (slot.index == DELETED) {
+                if (posInsert == table.size()) {
+                    posInsert = pos;
+                }
+            } else if (slot.tag == tag && Entry(slot.index)->first == key) {
+                fFound = true;
+                return pos;
+            }
+            pos = (pos + 1) & mask;
+        }
+    }
+
+    void Rehash(size_t nSlots) {
+        std::vector<Slot> vOld(nSlots, Slot{0, EMPTY});
+        vOld.swap(table);
+        const size_t mask = table.size() - 1;
+        for (const Slot &slot : vOld) {
+            if (slot.index == EMPTY || slot.index == DELETED) {
+                continue;
+            }
+            size_t pos = hasher(Entry(slot.index)->first) & mask;
+            while (table[pos].index != EMPTY) {
+                pos = (pos + 1) & mask;
+            }
+            table[pos] = slot;
+        }
+        nDeleted = 0;
+    }
+
+    //! Make room for one more entry, keeping the table at most 3/4 full.
+    void Reserve() {
+        if ((nSize + nDeleted + 1) * 4 <= table.size() * 3) {
+            return;
+        }
+        size_t nSlots = table.empty() ? 16 : table.size();
+        // Leave the table half empty, unless it was mostly tombstones.
+        while (nSlots < (nSize + 1) * 2) {
+            nSlots *= 2;
+        }
+        Rehash(nSlots);
+    }
+
+    size_t NextUsed(size_t pos) const {
+        while (pos < table.size() && (table[pos].index == EMPTY ||
+                                      table[pos].index == DELETED)) {
+            pos++;
+        }
+        return pos;
+    }
+
+    template <bool fConst> class iterator_base {
+        friend class poolmap;
+        template <bool> friend class iterator_base;
+        typedef typename std::conditional<fConst, const poolmap *,
+                                          poolmap *>::type map_pointer;
+        map_pointer map;
+        size_t pos;
+
+        iterator_base(map_pointer mapIn, size_t posIn)
+            : map(mapIn), pos(posIn) {}
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef typename poolmap::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef typename std::conditional<fConst, const value_type *,
+                                          value_type *>::type pointer;
+        typedef typename std::conditional<fConst, const value_type &,
+                                          value_type &>::type reference;
+
+        iterator_base() : map(nullptr), pos(0) {}
+        template <bool fOtherConst,
+                  typename = typename std::enable_if<fConst ||
+                                                     !fOtherConst>::type>
+        iterator_base(const iterator_base<fOtherConst> &other)
+            : map(other.map), pos(other.pos) {}
+
+        reference operator*() const {
+            return *map->Entry(map->table[pos].index);
+        }
+        pointer operator->() const { return map->Entry(map->table[pos].index); }
+
+        iterator_base &operator++() {
+            pos = map->NextUsed(pos + 1);
+            return *this;
+        }
+        iterator_base operator++(int) {
+            iterator_base copy(*this);
+            ++*this;
+            return copy;
+        }
+
+        friend bool operator==(const iterator_base &a, const iterator_base &b) {
+            return a.pos == b.pos;
+        }
+        friend bool operator!=(const iterator_base &a, const iterator_base &b) {
+            return a.pos != b.pos;
+        }
+    };
+
+public:
+    typedef iterator_base<false> iterator;
+    typedef iterator_base<true> const_iterator;
+
+    poolmap() : nAllocated(0), nCapacity(0), nSize(0), nDeleted(0) {}
+    ~poolmap() { clear(); }
+
+    //! Take over the entries of other, leaving it empty. The hasher is
+    //! copied, as the table was built with its salt.
+    poolmap(poolmap &&other)
+        : hasher(other.hasher), table(std::move(other.table)),
+          chunks(std::move(other.chunks)), vFree(std::move(other.vFree)),
+          nAllocated(other.nAllocated), nCapacity(other.nCapacity),
+          nSize(other.nSize), nDeleted(other.nDeleted) {
+        other.clear();
+    }
+    poolmap(const poolmap &) = delete;
+    poolmap &operator=(const poolmap &) = delete;
+
+    iterator begin() { return iterator(this, NextUsed(0)); }
+    iterator end() { return iterator(this, table.size()); }
+    const_iterator begin() const { return const_iterator(this, NextUsed(0)); }
+    const_iterator end() const { return const_iterator(this, table.size()); }
+
+    size_type size() const { return nSize; }
+    bool empty() const { return nSize == 0; }
+
+    iterator find(const K &key) {
+        if (nSize == 0) {
+            return end();
+        }
+        bool fFound;
+        size_t pos = Probe(key, hasher(key), fFound);
+        return fFound ? iterator(this, pos) : end();
+    }
+    const_iterator find(const K &key) const {
+        if (nSize == 0) {
+            return end();
+        }
+        bool fFound;
+        size_t pos = Probe(key, hasher(key), fFound);
+        return fFound ? const_iterator(this, pos) : end();
+    }
+    size_type count(const K &key) const { return find(key) != end(); }
+
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args &&... args) {
+        Reserve();
+        uint32_t index = AllocateIndex();
+        value_type *entry = Entry(index);
+        try {
+            new (entry) value_type(std::forward<Args>(args)...);
+        } catch (...) {
+            vFree.push_back(index);
+            throw;
+        }
+        size_t hash = hasher(entry->first);
+        bool fFound;
+        size_t pos = Probe(entry->first, hash, fFound);
+        if (fFound) {
+            entry->~value_type();
+            vFree.push_back(index);
+            return std::make_pair(iterator(this, pos), false);
+        }
+        if (table[pos].index == DELETED) {
+            nDeleted--;
+        }
+        table[pos] = Slot{Tag(hash), index};
+        nSize++;
+        return std::make_pair(iterator(this, pos), true);
+    }
+
+    V &operator[](const K &key) {
+        iterator it = find(key);
+        if (it == end()) {
+            it = emplace(std::piecewise_construct, std::forward_as_tuple(key),
+                         std::forward_as_tuple())
+                     .first;
+        }
+        return it->second;
+    }
+
+    iterator erase(const_iterator it) {
+        Slot &slot = table[it.pos];
+        Entry(slot.index)->~value_type();
+        vFree.push_back(slot.index);
+        slot.index = DELETED;
+        nSize--;
+        nDeleted++;
+        return iterator(this, NextUsed(it.pos + 1));
+    }
+
+    //! Destroy all entries and release all memory.
+    void clear() {
+        for (const Slot &slot : table) {
+            if (slot.index != EMPTY && slot.index != DELETED) {
+                Entry(slot.index)->~value_type();
+            }
+        }
+        std::vector<Slot>().swap(table);
+        std::vector<std::unique_ptr<Storage[]>>().swap(chunks);
+        std::vector<uint32_t>().swap(vFree);
+        nAllocated = 0;
+        nCapacity = 0;
+        nSize = 0;
+        nDeleted = 0;
+    }
+
+    //! Sizes of the heap allocations, for memory accounting.
+    size_t slot_bytes() const { return table.capacity() * sizeof(Slot); }
+    size_t chunk_count() const { return chunks.size(); }
+    size_t chunk_bytes(size_t nChunk) const {
+        return ChunkSize(nChunk) * sizeof(Storage);
+    }
+    size_t free_list_bytes() const {
+        return vFree.capacity() * sizeof(uint32_t);
+    }
+};
+
+#endif // BITCOIN_POOLMAP_H
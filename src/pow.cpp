@@ -265,9 +265,8 @@ static const CBlockIndex *GetSuitableBlock(const CBlockIndex *pindex) {
  * block. Because timestamps are the least trustworthy information we have as
  * input, this ensures the algorithm is more resistant to malicious inputs.+
  */
-uint32_t GetNextCoreWorkRequired(const CBlockIndex *pindexPrev,
-                                 const CBlockHeader *pblock,
-                                 const Consensus::Params &params) {
+static uint32_t ComputeNextCoreWorkRequired(const CBlockIndex *pindexPrev,
+                                            const Consensus::Params &params) {
 
     // Factor Target Spacing and difficulty adjustment based on 144 or 30 period DAA
     const int nHeight = pindexPrev->nHeight;
@@ -315,3 +314,18 @@ uint32_t GetNextCoreWorkRequired(const CBlockIndex *pindexPrev,
 
     return nextTarget.GetCompact();
 }
+
+uint32_t GetNextCoreWorkRequired(const CBlockIndex *pindexPrev,
+                                 const CBlockHeader *pblock,
+                                 const Consensus::Params &params) {
+    // The result depends on nothing but pindexPrev and its ancestors, so it is
+    // worked out once per block and reused by every later header check and
+    // block template built on top of it.
+    if (pindexPrev->pNextWorkParams != &params) {
+        pindexPrev->nNextWorkRequired =
+            ComputeNextCoreWorkRequired(pindexPrev, params);
+        pindexPrev->pNextWorkParams = &params;
+    }
+
+    return pindexPrev->nNextWorkRequired;
+}
@@ -18,22 +18,61 @@ uint256 CBlockHeader::GetHash() const {
     return SerializeHash(*this);
 }
 
+static void ScalePoWHash(int32_t nVersion, uint256 &rc) {
+    if (nVersion == CBlockHeader::SCALED_POW_VERSION) {
+        arith_uint256 bnPoW = UintToArith256(rc);
+        bnPoW.DivideBy(CBlockHeader::SCALED_POW_DIVISOR);
+        rc = ArithToUint256(bnPoW);
+    }
+}
+
 uint256 CBlockHeader::GetPoWHash(const int nHeight) const {
    if (nHeight > Params().GetConsensus().powBlake2Height) {
        uint256 rc = Blake2::SerializeHash(*this);
-       if (nVersion == 0x21000000) {
-           arith_uint256 bnPoW;
-           bnPoW.SetHex(rc.ToString());
-           bnPoW /= 4295032833;
-           rc.SetHex(bnPoW.GetHex());
-        }
-
-        return rc;
+       ScalePoWHash(nVersion, rc);
+       return rc;
    }
 
    return GetHash();
 }
 
+std::vector<uint256>
+CBlockHeader::GetPoWHashes(const std::vector<CBlockHeader> &headers,
+                           const std::vector<int> &heights) {
+    assert(headers.size() == heights.size());
+    static const size_t HEADER_SIZE = 80;
+
+    const int powBlake2Height = Params().GetConsensus().powBlake2Height;
+    std::vector<uint256> hashes(headers.size());
+
+    // Lay the Blake2b headers out back to back so they can be hashed in
+    // groups; anything before the fork keeps using double SHA-256.
+    std::vector<size_t> blake2;
+    std::vector<uint8_t> serialized;
+    blake2.reserve(headers.size());
+    serialized.reserve(headers.size() * HEADER_SIZE);
+    for (size_t i = 0; i < headers.size(); i++) {
+        if (heights[i] > powBlake2Height) {
+            CVectorWriter(SER_GETHASH, PROTOCOL_VERSION, serialized,
+                          serialized.size(), headers[i]);
+            blake2.push_back(i);
+        } else {
+            hashes[i] = headers[i].GetHash();
+        }
+    }
+    assert(serialized.size() == blake2.size() * HEADER_SIZE);
+
+    std::vector<uint8_t> digests(blake2.size() * 32);
+    Blake2::hash2b_80(digests.data(), serialized.data(), blake2.size());
+    for (size_t j = 0; j < blake2.size(); j++) {
+        uint256 &rc = hashes[blake2[j]];
+        memcpy(rc.begin(), &digests[j * 32], 32);
+        ScalePoWHash(headers[blake2[j]].nVersion, rc);
+    }
+
+    return hashes;
+}
+
 std::string CBlock::ToString() const {
     std::stringstream s;
     s << strprintf("CBlock(hash=%s, ver=0x%08x, hashPrevBlock=%s, "
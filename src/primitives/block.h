@@ -55,8 +55,24 @@ public:
 
     uint256 GetHash() const;
 
+    /**
+     * Blocks of this version divide their Blake2b proof of work hash by
+     * SCALED_POW_DIVISOR before it is compared with the target.
+     */
+    static const int32_t SCALED_POW_VERSION = 0x21000000;
+    static const uint64_t SCALED_POW_DIVISOR = 4295032833ULL;
+
     uint256 GetPoWHash(const int nHeight) const;
 
+    /**
+     * Compute GetPoWHash(heights[i]) for every headers[i]. Blake2b headers are
+     * hashed several at a time, which is considerably faster than calling
+     * GetPoWHash in a loop.
+     */
+    static std::vector<uint256>
+    GetPoWHashes(const std::vector<CBlockHeader> &headers,
+                 const std::vector<int> &heights);
+
     int64_t GetBlockTime() const { return (int64_t)nTime; }
 };
 
@@ -13,22 +13,28 @@
 #include "config.h"
 #include "consensus/validation.h"
 #include "hash.h"
+#include "net.h"
 #include "policy/policy.h"
 #include "primitives/transaction.h"
 #include "rpc/server.h"
 #include "streams.h"
 #include "sync.h"
+#include "txdb.h"
 #include "txmempool.h"
 #include "util.h"
 #include "utilstrencodings.h"
+#include "utxosnapshot.h"
 #include "validation.h"
 
 #include <cstdint>
 
+#include <boost/filesystem/operations.hpp>
 #include <boost/thread/thread.hpp> // boost::thread::interrupt
 
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
+#include <thread>
 
 struct CUpdatedBlock {
     uint256 hash;
@@ -854,6 +860,16 @@ UniValue getblock(const Config &config, const JSONRPCRequest &request) {
     return blockToJSON(block, pblockindex);
 }
 
+//! Digest of the UTXO set computed by GetUTXOStats
+enum class CoinStatsHashType {
+    //! Order dependent hash of the serialized set; needs a serial scan
+    HASH_SERIALIZED,
+    //! MuHash3072 of the outputs; computed in parallel
+    MUHASH,
+    //! Statistics only; computed in parallel
+    NONE,
+};
+
 struct CCoinsStats {
     int nHeight;
     uint256 hashBlock;
@@ -861,14 +877,28 @@ struct CCoinsStats {
     uint64_t nTransactionOutputs;
     uint64_t nBogoSize;
     uint256 hashSerialized;
+    uint256 hashMuHash;
     uint64_t nDiskSize;
     CAmount nTotalAmount;
 
     CCoinsStats()
         : nHeight(0), nTransactions(0), nTransactionOutputs(0), nBogoSize(0),
           nDiskSize(0), nTotalAmount(0) {}
+
+    void Add(const CCoinsStats &other) {
+        nTransactions += other.nTransactions;
+        nTransactionOutputs += other.nTransactionOutputs;
+        nBogoSize += other.nBogoSize;
+        nTotalAmount += other.nTotalAmount;
+    }
 };
 
+static uint64_t GetBogoSize(const CTxOut &txout) {
+    return 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ +
+           8 /* amount */ + 2 /* scriptPubKey len */ +
+           txout.scriptPubKey.size() /* scriptPubKey */;
+}
+
 static void ApplyStats(CCoinsStats &stats, CHashWriter &ss, const uint256 &hash,
                        const std::map<uint32_t, Coin> &outputs) {
     assert(!outputs.empty());
@@ -882,16 +912,112 @@ static void ApplyStats(CCoinsStats &stats, CHashWriter &ss, const uint256 &hash,
         ss << VARINT(output.second.GetTxOut().nValue.GetSatoshis());
         stats.nTransactionOutputs++;
         stats.nTotalAmount += output.second.GetTxOut().nValue.GetSatoshis();
-        stats.nBogoSize +=
-            32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ +
-            8 /* amount */ + 2 /* scriptPubKey len */ +
-            output.second.GetTxOut().scriptPubKey.size() /* scriptPubKey */;
+        stats.nBogoSize += GetBogoSize(output.second.GetTxOut());
     }
     ss << VARINT(0);
 }
 
+/**
+ * Walk the coins of one range cursor, adding them to stats and, if
+ * pcommitment is set, to the commitment to the set.
+ */
+static bool ApplyRangeStats(CCoinsViewCursor &cursor, CCoinsStats &stats,
+                            CCoinsCommitment *pcommitment,
+                            const std::atomic<bool> &fAbort) {
+    uint256 prevkey;
+    bool fFirst = true;
+    while (cursor.Valid() && !fAbort) {
+        COutPoint key;
+        Coin coin;
+        if (!cursor.GetKey(key) || !cursor.GetValue(coin)) {
+            return false;
+        }
+        // Ranges never split a transaction, so its outputs are adjacent.
+        if (fFirst || key.hash != prevkey) {
+            stats.nTransactions++;
+            prevkey = key.hash;
+            fFirst = false;
+        }
+        const CTxOut &txout = coin.GetTxOut();
+        stats.nTransactionOutputs++;
+        stats.nTotalAmount += txout.nValue.GetSatoshis();
+        stats.nBogoSize += GetBogoSize(txout);
+        if (pcommitment) {
+            pcommitment->Add(key, coin);
+        }
+        cursor.Next();
+    }
+    return true;
+}
+
+/**
+ * Calculate statistics about the unspent transaction output set by walking
+ * slices of the key space on all cores. The MuHash of the set, being order
+ * independent, is the product of those of the slices.
+ */
+static bool GetUTXOStatsParallel(CCoinsView *view, CCoinsStats &stats,
+                                 bool fMuHash) {
+    int nThreads = std::max(1, GetNumCores());
+    // A few slices per thread even out the uneven ones.
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors =
+        view->RangeCursors(8 * nThreads);
+    if (cursors.empty()) {
+        return false;
+    }
+    nThreads = std::min<int>(nThreads, cursors.size());
+
+    stats.hashBlock = cursors[0]->GetBestBlock();
+    {
+        LOCK(cs_main);
+        stats.nHeight = mapBlockIndex.find(stats.hashBlock)->second->nHeight;
+    }
+
+    std::vector<CCoinsStats> vStats(nThreads);
+    std::vector<CCoinsCommitment> vCommitment(nThreads);
+    std::atomic<size_t> nNextRange(0);
+    std::atomic<bool> fAbort(false);
+    auto worker = [&](int nThread) {
+        size_t nRange;
+        while ((nRange = nNextRange++) < cursors.size()) {
+            if (!ApplyRangeStats(*cursors[nRange], vStats[nThread],
+                                 fMuHash ? &vCommitment[nThread] : nullptr,
+                                 fAbort)) {
+                fAbort = true;
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < nThreads; i++) {
+        threads.emplace_back(worker, i);
+    }
+    worker(0);
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    if (fAbort) {
+        return error("%s: unable to read value", __func__);
+    }
+
+    CCoinsCommitment commitment;
+    for (int i = 0; i < nThreads; i++) {
+        stats.Add(vStats[i]);
+        commitment.Combine(vCommitment[i]);
+    }
+    if (fMuHash) {
+        stats.hashMuHash = commitment.GetHash();
+    }
+    stats.nDiskSize = view->EstimateSize();
+    return true;
+}
+
 //! Calculate statistics about the unspent transaction output set
-static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats) {
+static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats,
+                         CoinStatsHashType hashType) {
+    if (hashType != CoinStatsHashType::HASH_SERIALIZED) {
+        return GetUTXOStatsParallel(view, stats,
+                                    hashType == CoinStatsHashType::MUHASH);
+    }
+
     std::unique_ptr<CCoinsViewCursor> pcursor(view->Cursor());
 
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
@@ -991,11 +1117,20 @@ UniValue pruneblockchain(const Config &config, const JSONRPCRequest &request) {
 }
 
 UniValue gettxoutsetinfo(const Config &config, const JSONRPCRequest &request) {
-    if (request.fHelp || request.params.size() != 0) {
+    if (request.fHelp || request.params.size() > 1) {
         throw std::runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( \"hash_type\" )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
             "Note this call may take some time.\n"
+            "\nArguments:\n"
+            "1. \"hash_type\"    (string, optional, default=hash_serialized) "
+            "Which UTXO set hash to compute:\n"
+            "                   \"hash_serialized\" hashes the serialized set "
+            "on one thread,\n"
+            "                   \"muhash\" computes an order independent "
+            "MuHash3072 digest on all cores,\n"
+            "                   \"none\" skips hashing and only collects "
+            "the statistics, on all cores\n"
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
@@ -1005,27 +1140,49 @@ UniValue gettxoutsetinfo(const Config &config, const JSONRPCRequest &request) {
             "transactions\n"
             "  \"bogosize\": n,          (numeric) A database-independent "
             "metric for UTXO set size\n"
-            "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
+            "  \"hash_serialized\": \"hash\",   (string) The serialized hash "
+            "(only for hash_type hash_serialized)\n"
+            "  \"muhash\": \"hash\",    (string) The MuHash3072 digest of "
+            "the set (only for hash_type muhash)\n"
             "  \"disk_size\": n,         (numeric) The estimated size of the "
             "chainstate on disk\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
             "\nExamples:\n" +
             HelpExampleCli("gettxoutsetinfo", "") +
-            HelpExampleRpc("gettxoutsetinfo", ""));
+            HelpExampleCli("gettxoutsetinfo", "muhash") +
+            HelpExampleRpc("gettxoutsetinfo", "\"muhash\""));
+    }
+
+    CoinStatsHashType hashType = CoinStatsHashType::HASH_SERIALIZED;
+    if (request.params.size() > 0 && !request.params[0].isNull()) {
+        const std::string strHashType = request.params[0].get_str();
+        if (strHashType == "muhash") {
+            hashType = CoinStatsHashType::MUHASH;
+        } else if (strHashType == "none") {
+            hashType = CoinStatsHashType::NONE;
+        } else if (strHashType != "hash_serialized") {
+            throw JSONRPCError(RPC_INVALID_PARAMETER,
+                               "Unknown hash_type " + strHashType);
+        }
     }
 
     UniValue ret(UniValue::VOBJ);
 
     CCoinsStats stats;
     FlushStateToDisk();
-    if (GetUTXOStats(pcoinsTip, stats)) {
+    if (GetUTXOStats(pcoinsTip, stats, hashType)) {
         ret.push_back(Pair("height", int64_t(stats.nHeight)));
         ret.push_back(Pair("bestblock", stats.hashBlock.GetHex()));
         ret.push_back(Pair("transactions", int64_t(stats.nTransactions)));
         ret.push_back(Pair("txouts", int64_t(stats.nTransactionOutputs)));
         ret.push_back(Pair("bogosize", int64_t(stats.nBogoSize)));
-        ret.push_back(Pair("hash_serialized", stats.hashSerialized.GetHex()));
+        if (hashType == CoinStatsHashType::HASH_SERIALIZED) {
+            ret.push_back(
+                Pair("hash_serialized", stats.hashSerialized.GetHex()));
+        } else if (hashType == CoinStatsHashType::MUHASH) {
+            ret.push_back(Pair("muhash", stats.hashMuHash.GetHex()));
+        }
         ret.push_back(Pair("disk_size", stats.nDiskSize));
         ret.push_back(
             Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
@@ -1035,6 +1192,302 @@ UniValue gettxoutsetinfo(const Config &config, const JSONRPCRequest &request) {
     return ret;
 }
 
+UniValue getutxocommitment(const Config &config,
+                           const JSONRPCRequest &request) {
+    if (request.fHelp || request.params.size() != 0) {
+        throw std::runtime_error(
+            "getutxocommitment\n"
+            "\nReturns the commitment to the unspent transaction output set "
+            "at the chain tip,\nwhich is kept up to date as blocks are "
+            "connected and disconnected.\n"
+            "The muhash matches that of gettxoutsetinfo \"muhash\".\n"
+            "Needs -utxocommitment.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"height\":n,     (numeric) The current block height (index)\n"
+            "  \"bestblock\": \"hex\",   (string) the best block hash hex\n"
+            "  \"muhash\": \"hash\",    (string) The MuHash3072 digest of "
+            "the set\n"
+            "  \"txouts\": n,            (numeric) The number of output "
+            "transactions\n"
+            "  \"total_amount\": x.xxx          (numeric) The total amount\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getutxocommitment", "") +
+            HelpExampleRpc("getutxocommitment", ""));
+    }
+
+    CCoinsCommitment commitment;
+    int nHeight;
+    uint256 hashBlock;
+    {
+        LOCK(cs_main);
+        if (!GetCoinsTipCommitment(commitment)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR,
+                               fCoinsCommitment
+                                   ? "UTXO set commitment not loaded"
+                                   : "UTXO set commitment is disabled, "
+                                     "start with -utxocommitment");
+        }
+        nHeight = chainActive.Height();
+        hashBlock = chainActive.Tip()->GetBlockHash();
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("height", nHeight));
+    ret.push_back(Pair("bestblock", hashBlock.GetHex()));
+    // Finalizing takes a modular inverse, so keep it out of cs_main.
+    ret.push_back(Pair("muhash", commitment.GetHash().GetHex()));
+    ret.push_back(Pair("txouts", commitment.GetTransactionOutputs()));
+    ret.push_back(
+        Pair("total_amount", ValueFromAmount(commitment.GetTotalAmount())));
+    return ret;
+}
+
+//! Resolve the path of a UTXO snapshot file against the data directory.
+static boost::filesystem::path GetSnapshotPath(const UniValue &param) {
+    boost::filesystem::path path(param.get_str());
+    if (!path.is_complete()) {
+        path = GetDataDir() / path;
+    }
+    return path;
+}
+
+UniValue dumptxoutset(const Config &config, const JSONRPCRequest &request) {
+    if (request.fHelp || request.params.size() != 1) {
+        throw std::runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrites the unspent transaction output set at the chain tip to "
+            "a snapshot file,\nwhich loadtxoutset can start a new node "
+            "from. Needs -utxocommitment.\n"
+            "\nArguments:\n"
+            "1. \"path\"    (string, required) The file to write, relative to "
+            "the data directory\n"
+            "                unless absolute. It must not exist yet.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_written\": n,   (numeric) The number of coins written\n"
+            "  \"base_hash\": \"hex\",  (string) The block the snapshot was "
+            "taken at\n"
+            "  \"base_height\": n,     (numeric) The height of that block\n"
+            "  \"nchaintx\": n,        (numeric) The number of transactions "
+            "up to that block\n"
+            "  \"muhash\": \"hash\",    (string) The MuHash3072 digest of "
+            "the set\n"
+            "  \"path\": \"path\",      (string) The file written\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("dumptxoutset", "\"utxo.dat\"") +
+            HelpExampleRpc("dumptxoutset", "\"utxo.dat\""));
+    }
+
+    const boost::filesystem::path path = GetSnapshotPath(request.params[0]);
+    if (boost::filesystem::exists(path)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER,
+                           path.string() + " already exists");
+    }
+
+    CSnapshotMetadata metadata;
+    CCoinsCommitment commitment;
+    std::unique_ptr<CCoinsViewCursor> pcursor;
+    int nHeight;
+    {
+        LOCK(cs_main);
+        FlushStateToDisk();
+        if (!GetCoinsTipCommitment(commitment)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR,
+                               fCoinsCommitment
+                                   ? "UTXO set commitment not loaded"
+                                   : "UTXO set commitment is disabled, "
+                                     "start with -utxocommitment");
+        }
+        // The cursor sees the database as of now, so the coins can be written
+        // out without holding cs_main.
+        pcursor.reset(pcoinsdbview->Cursor());
+        const CBlockIndex *tip = chainActive.Tip();
+        if (pcursor->GetBestBlock() != tip->GetBlockHash()) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR,
+                               "Coin database is not at the chain tip");
+        }
+        memcpy(metadata.pchMessageStart,
+               config.GetChainParams().MessageStart(),
+               sizeof(metadata.pchMessageStart));
+        metadata.hashBlock = tip->GetBlockHash();
+        metadata.nChainTx = tip->nChainTx;
+        nHeight = tip->nHeight;
+    }
+
+    const uint256 hashUTXOSet = commitment.GetHash();
+    uint64_t nCoins;
+    try {
+        CSnapshotWriter writer(path, metadata);
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            COutPoint key;
+            Coin coin;
+            if (!pcursor->GetKey(key) || !pcursor->GetValue(coin)) {
+                throw JSONRPCError(RPC_INTERNAL_ERROR,
+                                   "Unable to read UTXO set");
+            }
+            writer.Add(key, coin);
+            pcursor->Next();
+        }
+        nCoins = writer.GetCoinsWritten();
+        if (int64_t(nCoins) != commitment.GetTransactionOutputs()) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR,
+                               "UTXO set does not match its commitment");
+        }
+        writer.Finish(hashUTXOSet);
+    } catch (const std::ios_base::failure &e) {
+        throw JSONRPCError(RPC_MISC_ERROR, e.what());
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("coins_written", nCoins));
+    ret.push_back(Pair("base_hash", metadata.hashBlock.GetHex()));
+    ret.push_back(Pair("base_height", nHeight));
+    ret.push_back(Pair("nchaintx", metadata.nChainTx));
+    ret.push_back(Pair("muhash", hashUTXOSet.GetHex()));
+    ret.push_back(Pair("path", path.string()));
+    return ret;
+}
+
+UniValue loadtxoutset(const Config &config, const JSONRPCRequest &request) {
+    if (request.fHelp || request.params.size() != 1) {
+        throw std::runtime_error(
+            "loadtxoutset \"path\"\n"
+            "\nLoads a UTXO set snapshot written by dumptxoutset, making its "
+            "block the chain tip.\n"
+            "The chain tip must still be the genesis block, and the header of "
+            "the snapshot\nblock must be in the best header chain, with at "
+            "least " +
+            strprintf("%d", MIN_SNAPSHOT_BASE_DEPTH) +
+            " headers on top of it.\nThe snapshot must be pinned in the chain "
+            "parameters, unless\n-allowunpinnedsnapshot is set. The blocks "
+            "below it are not downloaded, as if\npruned, and NODE_NETWORK is "
+            "no longer offered.\n"
+            "\nArguments:\n"
+            "1. \"path\"    (string, required) The file to load, relative to "
+            "the data directory\n"
+            "                unless absolute\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_loaded\": n,    (numeric) The number of coins loaded\n"
+            "  \"base_hash\": \"hex\",  (string) The block the snapshot was "
+            "taken at\n"
+            "  \"base_height\": n,     (numeric) The height of that block\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("loadtxoutset", "\"utxo.dat\"") +
+            HelpExampleRpc("loadtxoutset", "\"utxo.dat\""));
+    }
+
+    const boost::filesystem::path path = GetSnapshotPath(request.params[0]);
+    std::unique_ptr<CSnapshotReader> preader;
+    try {
+        preader.reset(new CSnapshotReader(path));
+    } catch (const std::ios_base::failure &e) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, e.what());
+    }
+
+    CValidationState state;
+    if (!LoadUTXOSnapshot(config.GetChainParams(), *preader, state)) {
+        throw JSONRPCError(RPC_MISC_ERROR, state.GetRejectReason());
+    }
+    // The blocks below the snapshot are missing, as on a node started from
+    // one.
+    if (g_connman) {
+        LogPrintf("Unsetting NODE_NETWORK for UTXO snapshot\n");
+        g_connman->RemoveLocalServices(NODE_NETWORK);
+    }
+    // Connect any blocks already received on top of the snapshot.
+    ActivateBestChain(config, state);
+    if (!state.IsValid()) {
+        throw JSONRPCError(RPC_DATABASE_ERROR, state.GetRejectReason());
+    }
+
+    const uint256 &hashBase = preader->GetMetadata().hashBlock;
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("coins_loaded", preader->GetCoinsRead()));
+    ret.push_back(Pair("base_hash", hashBase.GetHex()));
+    {
+        LOCK(cs_main);
+        ret.push_back(Pair("base_height", mapBlockIndex[hashBase]->nHeight));
+    }
+    return ret;
+}
+
+static UniValue DBStatsToJSON(const CDBWrapper &db) {
+    const DBOptions &dboptions = db.GetDBOptions();
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("bloombits", dboptions.nBloomBits));
+    ret.push_back(Pair("maxopenfiles", dboptions.nMaxOpenFiles));
+    ret.push_back(Pair("blocksize", uint64_t(dboptions.nBlockSize)));
+    ret.push_back(Pair("compression", dboptions.fCompression));
+    ret.push_back(Pair("maxfilesize", uint64_t(dboptions.nMaxFileSize)));
+
+    std::string strValue;
+    if (db.GetProperty("leveldb.approximate-memory-usage", strValue)) {
+        ret.push_back(Pair("memory_usage", atoi64(strValue)));
+    }
+    UniValue files(UniValue::VARR);
+    for (int nLevel = 0;
+         db.GetProperty(strprintf("leveldb.num-files-at-level%d", nLevel),
+                        strValue);
+         nLevel++) {
+        files.push_back(atoi64(strValue));
+    }
+    ret.push_back(Pair("files_per_level", files));
+    if (db.GetProperty("leveldb.stats", strValue)) {
+        ret.push_back(Pair("stats", strValue));
+    }
+    return ret;
+}
+
+UniValue getdbstats(const Config &config, const JSONRPCRequest &request) {
+    if (request.fHelp || request.params.size() != 0) {
+        throw std::runtime_error(
+            "getdbstats\n"
+            "\nReturns the settings and internal statistics of the LevelDB "
+            "databases.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"chainstate\": {     (json object) The coins database\n"
+            "    \"bloombits\": n,     (numeric) Bits per key of the bloom "
+            "filter, 0 for none\n"
+            "    \"maxopenfiles\": n,  (numeric) Number of files that may be "
+            "kept open\n"
+            "    \"blocksize\": n,     (numeric) Size of table blocks in "
+            "bytes\n"
+            "    \"compression\": xx,  (boolean) Whether tables are "
+            "compressed\n"
+            "    \"maxfilesize\": n,   (numeric) Size of table files in "
+            "bytes\n"
+            "    \"memory_usage\": n,  (numeric) Approximate memory used by "
+            "LevelDB\n"
+            "    \"files_per_level\": [n, ...], (array) Number of table "
+            "files at each level\n"
+            "    \"stats\": \"xxxx\"     (string) Compaction statistics, as "
+            "reported by LevelDB\n"
+            "  },\n"
+            "  \"blockindex\": {...}   (json object) The block index "
+            "database, as above\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getdbstats", "") +
+            HelpExampleRpc("getdbstats", ""));
+    }
+
+    LOCK(cs_main);
+    if (!pcoinsdbview || !pblocktree) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Databases not loaded");
+    }
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("chainstate", DBStatsToJSON(pcoinsdbview->GetDB())));
+    ret.push_back(Pair("blockindex", DBStatsToJSON(*pblocktree)));
+    return ret;
+}
+
 UniValue gettxout(const Config &config, const JSONRPCRequest &request) {
     if (request.fHelp || request.params.size() < 2 ||
         request.params.size() > 3) {
@@ -1631,6 +2084,7 @@ UniValue reconsiderblock(const Config &config, const JSONRPCRequest &request) {
 static const CRPCCommand commands[] = {
     //  category            name                      actor (function)        okSafe argNames
     //  ------------------- ------------------------  ----------------------  ------ ----------
+    { "blockchain",         "dumptxoutset",           dumptxoutset,           true,  {"path"} },
     { "blockchain",         "getblockchaininfo",      getblockchaininfo,      true,  {} },
     { "blockchain",         "getbestblockhash",       getbestblockhash,       true,  {} },
     { "blockchain",         "getblockcount",          getblockcount,          true,  {} },
@@ -1638,6 +2092,7 @@ static const CRPCCommand commands[] = {
     { "blockchain",         "getblockhash",           getblockhash,           true,  {"height"} },
     { "blockchain",         "getblockheader",         getblockheader,         true,  {"blockhash","verbose"} },
     { "blockchain",         "getchaintips",           getchaintips,           true,  {} },
+    { "blockchain",         "getdbstats",             getdbstats,             true,  {} },
     { "blockchain",         "getdifficulty",          getdifficulty,          true,  {} },
     { "blockchain",         "getmempoolancestors",    getmempoolancestors,    true,  {"txid","verbose"} },
     { "blockchain",         "getmempooldescendants",  getmempooldescendants,  true,  {"txid","verbose"} },
@@ -1645,7 +2100,9 @@ static const CRPCCommand commands[] = {
     { "blockchain",         "getmempoolinfo",         getmempoolinfo,         true,  {} },
     { "blockchain",         "getrawmempool",          getrawmempool,          true,  {"verbose"} },
     { "blockchain",         "gettxout",               gettxout,               true,  {"txid","n","include_mempool"} },
-    { "blockchain",         "gettxoutsetinfo",        gettxoutsetinfo,        true,  {} },
+    { "blockchain",         "gettxoutsetinfo",        gettxoutsetinfo,        true,  {"hash_type"} },
+    { "blockchain",         "getutxocommitment",      getutxocommitment,      true,  {} },
+    { "blockchain",         "loadtxoutset",           loadtxoutset,           true,  {"path"} },
     { "blockchain",         "pruneblockchain",        pruneblockchain,        true,  {"height"} },
     { "blockchain",         "verifychain",            verifychain,            true,  {"checklevel","nblocks"} },
     { "blockchain",         "preciousblock",          preciousblock,          true,  {"blockhash"} },
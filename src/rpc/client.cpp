@@ -30,8 +30,10 @@ static const CRPCConvertParam vRPCConvertParams[] = {
     {"setmocktime", 0, "timestamp"},
     {"generate", 0, "nblocks"},
     {"generate", 1, "maxtries"},
+    {"generate", 2, "nthreads"},
     {"generatetoaddress", 0, "nblocks"},
     {"generatetoaddress", 2, "maxtries"},
+    {"generatetoaddress", 3, "nthreads"},
     {"getnetworkhashps", 0, "nblocks"},
     {"getnetworkhashps", 1, "height"},
     {"sendtoaddress", 1, "amount"},
@@ -85,6 +87,8 @@ static const CRPCConvertParam vRPCConvertParams[] = {
     {"signrawtransaction", 1, "prevtxs"},
     {"signrawtransaction", 2, "privkeys"},
     {"sendrawtransaction", 1, "allowhighfees"},
+    {"submitrawtransactions", 0, "hexstrings"},
+    {"submitrawtransactions", 1, "allowhighfees"},
     {"fundrawtransaction", 1, "options"},
     {"gettxout", 1, "n"},
     {"gettxout", 2, "include_mempool"},
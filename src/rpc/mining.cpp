@@ -112,7 +112,7 @@ static UniValue getnetworkhashps(const Config &config,
 static UniValue generateBlocks(const Config &config,
                                std::shared_ptr<CReserveScript> coinbaseScript,
                                int nGenerate, uint64_t nMaxTries,
-                               bool keepScript) {
+                               bool keepScript, int nThreads) {
     static const int nInnerLoopCount = 0x100000;
     int nHeightStart = 0;
     int nHeightEnd = 0;
@@ -126,6 +126,7 @@ static UniValue generateBlocks(const Config &config,
         nHeightEnd = nHeightStart + nGenerate;
     }
 
+    const Consensus::Params &consensusParams = Params().GetConsensus();
     unsigned int nExtraNonce = 0;
     UniValue blockHashes(UniValue::VARR);
     while (nHeight < nHeightEnd) {
@@ -140,12 +141,13 @@ static UniValue generateBlocks(const Config &config,
             LOCK(cs_main);
             IncrementExtraNonce(config, pblock, chainActive.Tip(), nExtraNonce);
         }
-        while (nMaxTries > 0 && pblock->nNonce < nInnerLoopCount &&
-               !CheckProofOfWork(pblock->GetPoWHash(nHeight+1), pblock->nBits,
-                                 Params().GetConsensus())) {
-            ++pblock->nNonce;
-            --nMaxTries;
-        }
+        uint32_t nNonceEnd =
+            pblock->nNonce +
+            std::min<uint64_t>(nInnerLoopCount - pblock->nNonce, nMaxTries);
+        uint32_t nNonce = GrindNonce(*pblock, nHeight + 1, pblock->nNonce,
+                                     nNonceEnd, nThreads, consensusParams);
+        nMaxTries -= nNonce - pblock->nNonce;
+        pblock->nNonce = nNonce;
         if (nMaxTries == 0) {
             break;
         }
@@ -171,11 +173,23 @@ static UniValue generateBlocks(const Config &config,
     return blockHashes;
 }
 
+static int ParseGenerateThreads(const UniValue &param) {
+    if (param.isNull()) {
+        return std::max(1, GetNumCores());
+    }
+    int nThreads = param.get_int();
+    if (nThreads < 1) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER,
+                           "Invalid nthreads, must be at least 1");
+    }
+    return nThreads;
+}
+
 static UniValue generate(const Config &config, const JSONRPCRequest &request) {
     if (request.fHelp || request.params.size() < 1 ||
-        request.params.size() > 2) {
+        request.params.size() > 3) {
         throw std::runtime_error(
-            "generate nblocks ( maxtries )\n"
+            "generate nblocks ( maxtries nthreads )\n"
             "\nMine up to nblocks blocks immediately (before the RPC call "
             "returns)\n"
             "\nArguments:\n"
@@ -183,6 +197,8 @@ static UniValue generate(const Config &config, const JSONRPCRequest &request) {
             "immediately.\n"
             "2. maxtries     (numeric, optional) How many iterations to try "
             "(default = 1000000).\n"
+            "3. nthreads     (numeric, optional) How many threads to search "
+            "nonces with (default = number of cores).\n"
             "\nResult:\n"
             "[ blockhashes ]     (array) hashes of blocks generated\n"
             "\nExamples:\n"
@@ -195,6 +211,8 @@ static UniValue generate(const Config &config, const JSONRPCRequest &request) {
     if (request.params.size() > 1) {
         nMaxTries = request.params[1].get_int();
     }
+    int nThreads = ParseGenerateThreads(
+        request.params.size() > 2 ? request.params[2] : NullUniValue);
 
     std::shared_ptr<CReserveScript> coinbaseScript;
     GetMainSignals().ScriptForMining(coinbaseScript);
@@ -213,15 +231,16 @@ static UniValue generate(const Config &config, const JSONRPCRequest &request) {
             "No coinbase script available (mining requires a wallet)");
     }
 
-    return generateBlocks(config, coinbaseScript, nGenerate, nMaxTries, true);
+    return generateBlocks(config, coinbaseScript, nGenerate, nMaxTries, true,
+                          nThreads);
 }
 
 static UniValue generatetoaddress(const Config &config,
                                   const JSONRPCRequest &request) {
     if (request.fHelp || request.params.size() < 2 ||
-        request.params.size() > 3) {
+        request.params.size() > 4) {
         throw std::runtime_error(
-            "generatetoaddress nblocks address (maxtries)\n"
+            "generatetoaddress nblocks address (maxtries nthreads)\n"
             "\nMine blocks immediately to a specified address (before the RPC "
             "call returns)\n"
             "\nArguments:\n"
@@ -231,6 +250,8 @@ static UniValue generatetoaddress(const Config &config,
             "generated bitcoin to.\n"
             "3. maxtries     (numeric, optional) How many iterations to try "
             "(default = 1000000).\n"
+            "4. nthreads     (numeric, optional) How many threads to search "
+            "nonces with (default = number of cores).\n"
             "\nResult:\n"
             "[ blockhashes ]     (array) hashes of blocks generated\n"
             "\nExamples:\n"
@@ -243,6 +264,8 @@ static UniValue generatetoaddress(const Config &config,
     if (request.params.size() > 2) {
         nMaxTries = request.params[2].get_int();
     }
+    int nThreads = ParseGenerateThreads(
+        request.params.size() > 3 ? request.params[3] : NullUniValue);
 
     CTxDestination destination = DecodeDestination(request.params[1].get_str());
     if (!IsValidDestination(destination)) {
@@ -253,7 +276,8 @@ static UniValue generatetoaddress(const Config &config,
     std::shared_ptr<CReserveScript> coinbaseScript(new CReserveScript());
     coinbaseScript->reserveScript = GetScriptForDestination(destination);
 
-    return generateBlocks(config, coinbaseScript, nGenerate, nMaxTries, false);
+    return generateBlocks(config, coinbaseScript, nGenerate, nMaxTries, false,
+                          nThreads);
 }
 
 static UniValue getmininginfo(const Config &config,
@@ -335,6 +359,9 @@ static UniValue prioritisetransaction(const Config &config,
 
     mempool.PrioritiseTransaction(hash, request.params[0].get_str(),
                                   request.params[1].get_real(), nAmount);
+    if (g_blocktemplatecache) {
+        g_blocktemplatecache->SetBehind();
+    }
     return true;
 }
 
@@ -643,32 +670,17 @@ static UniValue getblocktemplate(const Config &config,
         // expires-immediately template to stop miners?
     }
 
-    // Update block
-    static CBlockIndex *pindexPrev;
-    static int64_t nStart;
-    static std::unique_ptr<CBlockTemplate> pblocktemplate;
-    if (pindexPrev != chainActive.Tip() ||
-        (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast &&
-         GetTime() - nStart > 5)) {
-        // Clear pindexPrev so future calls make a new block, despite any
-        // failures from here on
-        pindexPrev = nullptr;
-
-        // Store the pindexBest used before CreateNewBlock, to avoid races
-        nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
-        CBlockIndex *pindexPrevNew = chainActive.Tip();
-        nStart = GetTime();
-
-        // Create new block
-        CScript scriptDummy = CScript() << OP_TRUE;
-        pblocktemplate =
-            BlockAssembler(config, Params()).CreateNewBlock(scriptDummy);
-        if (!pblocktemplate) {
-            throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
-        }
-
-        // Need to update only after we know CreateNewBlock succeeded
-        pindexPrev = pindexPrevNew;
+    // Update block. The cached template follows the mempool and the tip, so
+    // this only assembles a new block when it has fallen behind.
+    if (!g_blocktemplatecache) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Block templates not available");
+    }
+    nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
+    CBlockIndex *pindexPrev = chainActive.Tip();
+    std::unique_ptr<CBlockTemplate> pblocktemplate =
+        g_blocktemplatecache->Get();
+    if (!pblocktemplate) {
+        throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
     }
     CBlock *pblock = &pblocktemplate->block; // pointer for convenience
     const Consensus::Params &consensusParams = Params().GetConsensus();
@@ -1081,8 +1093,8 @@ static const CRPCCommand commands[] = {
     {"mining",     "getblocktemplate",      getblocktemplate,      true, {"template_request"}},
     {"mining",     "submitblock",           submitblock,           true, {"hexdata", "parameters"}},
 
-    {"generating", "generate",              generate,              true, {"nblocks", "maxtries"}},
-    {"generating", "generatetoaddress",     generatetoaddress,     true, {"nblocks", "address", "maxtries"}},
+    {"generating", "generate",              generate,              true, {"nblocks", "maxtries", "nthreads"}},
+    {"generating", "generatetoaddress",     generatetoaddress,     true, {"nblocks", "address", "maxtries", "nthreads"}},
 
     {"util",       "estimatefee",           estimatefee,           true, {"nblocks"}},
     {"util",       "estimatepriority",      estimatepriority,      true, {"nblocks"}},
@@ -1158,6 +1158,137 @@ static UniValue sendrawtransaction(const Config &config,
     return txid.GetHex();
 }
 
+static UniValue submitrawtransactions(const Config &config,
+                                      const JSONRPCRequest &request) {
+    if (request.fHelp || request.params.size() < 1 ||
+        request.params.size() > 2) {
+        throw std::runtime_error(
+            "submitrawtransactions [\"hexstring\",...] ( allowhighfees )\n"
+            "\nSubmits several raw transactions (serialized, hex-encoded) to "
+            "local node and network at once.\n"
+            "The transactions may spend from each other in any order; parents "
+            "are accepted before their children.\n"
+            "\nArguments:\n"
+            "1. \"hexstrings\"   (string, required) A json array of raw "
+            "transactions\n"
+            "    [\n"
+            "      \"hexstring\" (string) The hex string of a raw "
+            "transaction\n"
+            "      ,...\n"
+            "    ]\n"
+            "2. allowhighfees    (boolean, optional, default=false) Allow high "
+            "fees\n"
+            "\nResult:\n"
+            "[                   (json array) One entry per transaction, in "
+            "the order given\n"
+            "  {\n"
+            "    \"txid\" : \"hash\",   (string) The transaction hash in hex\n"
+            "    \"accepted\" : true|false, (boolean) Whether the transaction "
+            "is in the mempool\n"
+            "    \"error\" : \"text\"   (string, optional) Why it was not "
+            "accepted, as sendrawtransaction would report it\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n" +
+            HelpExampleCli("submitrawtransactions",
+                           "\"[\\\"signedhex\\\",\\\"signedhex\\\"]\"") +
+            "\nAs a json rpc call\n" +
+            HelpExampleRpc("submitrawtransactions",
+                           "[\"signedhex\",\"signedhex\"]"));
+    }
+
+    RPCTypeCheck(request.params, {UniValue::VARR, UniValue::VBOOL});
+
+    // parse hex strings from parameter
+    std::vector<CTransactionRef> vtx;
+    UniValue hexstrings = request.params[0].get_array();
+    for (unsigned int idx = 0; idx < hexstrings.size(); idx++) {
+        CMutableTransaction mtx;
+        if (!DecodeHexTx(mtx, hexstrings[idx].get_str())) {
+            throw JSONRPCError(RPC_DESERIALIZATION_ERROR,
+                               strprintf("TX decode failed at index %u", idx));
+        }
+        vtx.push_back(MakeTransactionRef(std::move(mtx)));
+    }
+
+    bool fLimitFree = false;
+    CAmount nMaxRawTxFee = maxTxFee.GetSatoshis();
+    if (request.params.size() > 1 && request.params[1].get_bool()) {
+        nMaxRawTxFee = 0;
+    }
+
+    // Leave out what is already known, as sendrawtransaction would.
+    std::vector<std::string> vError(vtx.size());
+    std::vector<bool> vAccepted(vtx.size(), false);
+    std::vector<MempoolSubmission> vSubmissions;
+    std::vector<size_t> vIndex;
+    {
+        LOCK(cs_main);
+        CCoinsViewCache &view = *pcoinsTip;
+        for (size_t i = 0; i < vtx.size(); i++) {
+            const uint256 &txid = vtx[i]->GetId();
+            bool fHaveChain = false;
+            for (size_t o = 0; !fHaveChain && o < vtx[i]->vout.size(); o++) {
+                const Coin &existingCoin = view.AccessCoin(COutPoint(txid, o));
+                fHaveChain = !existingCoin.IsSpent();
+            }
+
+            if (fHaveChain) {
+                vError[i] = "transaction already in block chain";
+            } else if (mempool.exists(txid)) {
+                vAccepted[i] = true;
+            } else {
+                vSubmissions.emplace_back(vtx[i]);
+                vIndex.push_back(i);
+            }
+        }
+    }
+
+    // Push to local node and sync with wallets.
+    AcceptToMemoryPoolBatch(config, mempool, vSubmissions, fLimitFree,
+                            nMaxRawTxFee);
+    for (size_t n = 0; n < vSubmissions.size(); n++) {
+        const MempoolSubmission &sub = vSubmissions[n];
+        size_t i = vIndex[n];
+        vAccepted[i] = sub.fAccepted;
+        if (sub.fAccepted) {
+            continue;
+        }
+        if (sub.state.IsInvalid()) {
+            vError[i] = strprintf("%i: %s", sub.state.GetRejectCode(),
+                                  sub.state.GetRejectReason());
+        } else if (sub.fMissingInputs) {
+            vError[i] = "Missing inputs";
+        } else {
+            vError[i] = sub.state.GetRejectReason();
+        }
+    }
+
+    if (!g_connman) {
+        throw JSONRPCError(
+            RPC_CLIENT_P2P_DISABLED,
+            "Error: Peer-to-peer functionality missing or disabled");
+    }
+
+    UniValue result(UniValue::VARR);
+    for (size_t i = 0; i < vtx.size(); i++) {
+        const uint256 &txid = vtx[i]->GetId();
+        UniValue entry(UniValue::VOBJ);
+        entry.push_back(Pair("txid", txid.GetHex()));
+        entry.push_back(Pair("accepted", bool(vAccepted[i])));
+        if (vAccepted[i]) {
+            CInv inv(MSG_TX, txid);
+            g_connman->ForEachNode(
+                [&inv](CNode *pnode) { pnode->PushInventory(inv); });
+        } else {
+            entry.push_back(Pair("error", vError[i]));
+        }
+        result.push_back(entry);
+    }
+    return result;
+}
+
 // clang-format off
 static const CRPCCommand commands[] = {
     //  category            name                      actor (function)        okSafeMode
@@ -1167,6 +1298,7 @@ static const CRPCCommand commands[] = {
     { "rawtransactions",    "decoderawtransaction",   decoderawtransaction,   true,  {"hexstring"} },
     { "rawtransactions",    "decodescript",           decodescript,           true,  {"hexstring"} },
     { "rawtransactions",    "sendrawtransaction",     sendrawtransaction,     false, {"hexstring","allowhighfees"} },
+    { "rawtransactions",    "submitrawtransactions",  submitrawtransactions,  false, {"hexstrings","allowhighfees"} },
     { "rawtransactions",    "signrawtransaction",     signrawtransaction,     false, {"hexstring","prevtxs","privkeys","sighashtype"} }, /* uses wallet if enabled */
 
     { "blockchain",         "gettxoutproof",          gettxoutproof,          true,  {"txids", "blockhash"} },
@@ -120,6 +120,58 @@ private:
     size_t nPos;
 };
 
+/**
+ * Minimal stream for reading from a range of bytes owned by the caller, which
+ * must outlive the reader.
+ */
+class CBufferReader {
+public:
+    /**
+     * @param[in]  nTypeIn Serialization Type
+     * @param[in]  nVersionIn Serialization Version (including any flags)
+     * @param[in]  pbeginIn, pendIn  The bytes to read
+     */
+    CBufferReader(int nTypeIn, int nVersionIn, const uint8_t *pbeginIn,
+                  const uint8_t *pendIn)
+        : nType(nTypeIn), nVersion(nVersionIn), pbegin(pbeginIn),
+          pend(pendIn) {}
+
+    template <typename T> CBufferReader &operator>>(T &obj) {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+
+    int GetVersion() const { return nVersion; }
+    int GetType() const { return nType; }
+
+    size_t size() const { return pend - pbegin; }
+    bool empty() const { return pbegin == pend; }
+
+    void read(char *pch, size_t nSize) {
+        if (nSize > size()) {
+            throw std::ios_base::failure(
+                "CBufferReader::read(): end of data");
+        }
+        memcpy(pch, pbegin, nSize);
+        pbegin += nSize;
+    }
+
+    void ignore(size_t nSize) {
+        if (nSize > size()) {
+            throw std::ios_base::failure(
+                "CBufferReader::ignore(): end of data");
+        }
+        pbegin += nSize;
+    }
+
+private:
+    const int nType;
+    const int nVersion;
+    const uint8_t *pbegin;
+    const uint8_t *pend;
+};
+
 /**
  * Double ended buffer combining vector and stream-like interfaces.
  *
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "arith_uint256.h"
+#include "random.h"
 #include "test/test_title.h"
 #include "uint256.h"
 #include "version.h"
@@ -426,6 +427,44 @@ BOOST_AUTO_TEST_CASE(divide) {
     BOOST_CHECK_THROW(R2L / ZeroL, uint_error);
 }
 
+BOOST_AUTO_TEST_CASE(divideBy) {
+    const uint64_t divisors[] = {1, 3, 0xECD751716ULL, 4295032833ULL,
+                                 std::numeric_limits<uint64_t>::max()};
+    const arith_uint256 nums[] = {ZeroL, OneL, R1L, R2L, MaxL};
+    for (const arith_uint256 &num : nums) {
+        for (uint64_t divisor : divisors) {
+            arith_uint256 quotient = num;
+            uint64_t remainder = quotient.DivideBy(divisor);
+            BOOST_CHECK(quotient == num / arith_uint256(divisor));
+            BOOST_CHECK(remainder < divisor);
+            BOOST_CHECK(quotient * arith_uint256(divisor) +
+                            arith_uint256(remainder) ==
+                        num);
+        }
+    }
+
+    arith_uint256 num = R1L;
+    BOOST_CHECK_THROW(num.DivideBy(0), uint_error);
+}
+
+BOOST_AUTO_TEST_CASE(divideBy_pow_hash_scaling) {
+    // The 0x21000000 PoW hash scaling used to round trip through hex strings;
+    // the direct path must give bit-identical results.
+    for (int i = 0; i < 1000; i++) {
+        const uint256 hash = GetRandHash();
+
+        uint256 legacy = hash;
+        arith_uint256 bnLegacy;
+        bnLegacy.SetHex(legacy.ToString());
+        bnLegacy /= 4295032833;
+        legacy.SetHex(bnLegacy.GetHex());
+
+        arith_uint256 bnPoW = UintToArith256(hash);
+        bnPoW.DivideBy(4295032833);
+        BOOST_CHECK(ArithToUint256(bnPoW) == legacy);
+    }
+}
+
 bool almostEqual(double d1, double d2) {
     return fabs(d1 - d2) <=
            4 * fabs(d1) * std::numeric_limits<double>::epsilon();
@@ -0,0 +1,73 @@
+// Copyright (c) 2018 The Title Network developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilemap.h"
+
+#include "test/test_title.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+
+BOOST_FIXTURE_TEST_SUITE(blockfilemap_tests, TestingSetup)
+
+#ifndef WIN32
+static void AppendBytes(const boost::filesystem::path &path, size_t nBytes,
+                        char c) {
+    FILE *file = fopen(path.string().c_str(), "ab");
+    BOOST_REQUIRE(file != nullptr);
+    std::vector<char> buf(nBytes, c);
+    BOOST_REQUIRE_EQUAL(fwrite(buf.data(), 1, buf.size(), file), buf.size());
+    fclose(file);
+}
+
+BOOST_AUTO_TEST_CASE(blockfilemap_get) {
+    boost::filesystem::path path0 = pathTemp / "blk00000.dat";
+    boost::filesystem::path path1 = pathTemp / "blk00001.dat";
+    AppendBytes(path0, 100, 'a');
+    AppendBytes(path1, 100, 'b');
+
+    CBlockFileMapCache cache;
+    // Disabled by default.
+    BOOST_CHECK(!cache.IsEnabled());
+    BOOST_CHECK(!cache.Get(0, path0, 100));
+
+    cache.SetMaxFiles(1);
+    BOOST_CHECK(cache.IsEnabled());
+    std::shared_ptr<const CMappedFile> file0 = cache.Get(0, path0, 100);
+    BOOST_REQUIRE(file0);
+    BOOST_CHECK_EQUAL(file0->size(), 100U);
+    BOOST_CHECK_EQUAL(file0->data()[99], 'a');
+    BOOST_CHECK(cache.Get(0, path0, 50) == file0);
+
+    // Asking for more than the file holds fails.
+    BOOST_CHECK(!cache.Get(1, path1, 101));
+
+    // A grown file is mapped again.
+    AppendBytes(path0, 100, 'c');
+    std::shared_ptr<const CMappedFile> grown = cache.Get(0, path0, 200);
+    BOOST_REQUIRE(grown);
+    BOOST_CHECK(grown != file0);
+    BOOST_CHECK_EQUAL(grown->data()[199], 'c');
+    // The old mapping stays valid while it is referenced.
+    BOOST_CHECK_EQUAL(file0->data()[0], 'a');
+
+    // Only one file is kept, so mapping the second evicts the first.
+    std::shared_ptr<const CMappedFile> file1 = cache.Get(1, path1, 100);
+    BOOST_REQUIRE(file1);
+    BOOST_CHECK(cache.Get(1, path1, 100) == file1);
+    BOOST_CHECK(cache.Get(0, path0, 200) != grown);
+
+    cache.Invalidate(0);
+    std::shared_ptr<const CMappedFile> remapped = cache.Get(0, path0, 200);
+    BOOST_REQUIRE(remapped);
+    BOOST_CHECK_EQUAL(remapped->data()[0], 'a');
+
+    cache.SetMaxFiles(0);
+    BOOST_CHECK(!cache.Get(0, path0, 200));
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
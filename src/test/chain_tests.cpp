@@ -0,0 +1,80 @@
+// Copyright (c) 2018 The Title Network developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chain.h"
+
+#include "test/test_title.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <set>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(chain_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(chain_arena_allocate) {
+    CBlockIndexArena arena;
+    BOOST_CHECK_EQUAL(arena.Size(), 0U);
+    BOOST_CHECK_EQUAL(arena.DynamicMemoryUsage(), 0U);
+
+    CBlockHeader header;
+    header.nVersion = 4;
+    header.nTime = 1234;
+    header.nBits = 0x207fffff;
+    header.nNonce = 42;
+    CBlockIndex *pindex = arena.Allocate(header);
+    BOOST_CHECK(pindex->pprev == nullptr);
+    BOOST_CHECK(pindex->phashBlock == nullptr);
+    BOOST_CHECK_EQUAL(pindex->nHeight, 0);
+    BOOST_CHECK_EQUAL(pindex->nVersion, 4);
+    BOOST_CHECK_EQUAL(pindex->nTime, 1234U);
+    BOOST_CHECK_EQUAL(pindex->nBits, 0x207fffffU);
+    BOOST_CHECK_EQUAL(pindex->nNonce, 42U);
+    BOOST_CHECK_EQUAL(arena.Size(), 1U);
+    BOOST_CHECK_EQUAL(arena.DynamicMemoryUsage(),
+                      size_t(CBlockIndexArena::CHUNK_SIZE) *
+                          sizeof(CBlockIndex));
+}
+
+BOOST_AUTO_TEST_CASE(chain_arena_growth) {
+    const size_t nChunk = CBlockIndexArena::CHUNK_SIZE;
+    const size_t nCount = 3 * nChunk + 10;
+    CBlockIndexArena arena;
+    std::vector<CBlockIndex *> vIndex;
+    for (size_t i = 0; i < nCount; i++) {
+        vIndex.push_back(arena.Allocate());
+        vIndex.back()->nHeight = i;
+        vIndex.back()->pprev = i > 0 ? vIndex[i - 1] : nullptr;
+    }
+    BOOST_CHECK_EQUAL(arena.Size(), nCount);
+    BOOST_CHECK_EQUAL(arena.DynamicMemoryUsage(),
+                      4 * nChunk * sizeof(CBlockIndex));
+
+    // Entries handed out before the arena grew are where they were, and
+    // still hold what was written to them.
+    BOOST_CHECK_EQUAL(std::set<CBlockIndex *>(vIndex.begin(), vIndex.end())
+                          .size(),
+                      nCount);
+    for (size_t i = 0; i < nCount; i++) {
+        BOOST_CHECK_EQUAL(vIndex[i]->nHeight, int(i));
+        BOOST_CHECK(vIndex[i]->pprev == (i > 0 ? vIndex[i - 1] : nullptr));
+    }
+    BOOST_CHECK(vIndex[nCount - 1]->GetAncestor(0) == vIndex[0]);
+
+    // Entries allocated one after the other sit next to each other within a
+    // chunk.
+    for (size_t i = 1; i < nCount; i++) {
+        if (i % nChunk != 0) {
+            BOOST_CHECK(vIndex[i] == vIndex[i - 1] + 1);
+        }
+    }
+
+    arena.Clear();
+    BOOST_CHECK_EQUAL(arena.Size(), 0U);
+    BOOST_CHECK_EQUAL(arena.DynamicMemoryUsage(), 0U);
+    BOOST_CHECK(arena.Allocate() != nullptr);
+    BOOST_CHECK_EQUAL(arena.Size(), 1U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
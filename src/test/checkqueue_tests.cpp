@@ -0,0 +1,93 @@
+// Copyright (c) 2018 The Title Network developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "checkqueue.h"
+
+#include "test/test_title.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <atomic>
+
+BOOST_FIXTURE_TEST_SUITE(checkqueue_tests, BasicTestingSetup)
+
+namespace {
+
+struct CountingCheck {
+    std::atomic<int> *pnRun;
+    bool fOk;
+
+    CountingCheck() : pnRun(nullptr), fOk(true) {}
+    CountingCheck(std::atomic<int> *pnRunIn, bool fOkIn)
+        : pnRun(pnRunIn), fOk(fOkIn) {}
+
+    bool operator()() {
+        ++*pnRun;
+        return fOk;
+    }
+    void swap(CountingCheck &x) {
+        std::swap(pnRun, x.pnRun);
+        std::swap(fOk, x.fOk);
+    }
+};
+
+void RunChecks(int nThreads) {
+    CCheckQueue<CountingCheck> queue(16);
+    boost::thread_group tg;
+    for (int i = 1; i < nThreads; i++) {
+        tg.create_thread([&] { queue.Thread(); });
+    }
+
+    for (int nRound = 0; nRound < 20; nRound++) {
+        std::atomic<int> nRun(0);
+        int nAdded = 0;
+        {
+            CCheckQueueControl<CountingCheck> control(&queue);
+            for (int i = 0; i < 100; i++) {
+                std::vector<CountingCheck> vChecks(i % 7,
+                                                   CountingCheck(&nRun, true));
+                nAdded += vChecks.size();
+                control.Add(vChecks);
+            }
+            BOOST_CHECK(control.Wait());
+        }
+        BOOST_CHECK_EQUAL(nRun, nAdded);
+
+        // A single failure fails the whole round, and work added after the
+        // failure is seen does not have to run.
+        nRun = 0;
+        {
+            CCheckQueueControl<CountingCheck> control(&queue);
+            for (int i = 0; i < 100; i++) {
+                std::vector<CountingCheck> vChecks(10,
+                                                   CountingCheck(&nRun, true));
+                if (i == nRound) {
+                    vChecks[5] = CountingCheck(&nRun, false);
+                }
+                control.Add(vChecks);
+            }
+            BOOST_CHECK(!control.Wait());
+        }
+        BOOST_CHECK(nRun > 0 && nRun <= 1000);
+    }
+
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(checkqueue_master_only) {
+    RunChecks(1);
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_workers) {
+    RunChecks(3);
+    RunChecks(16);
+    // More workers than per-worker deques.
+    RunChecks(80);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
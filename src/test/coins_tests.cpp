@@ -7,6 +7,7 @@
 #include "script/standard.h"
 #include "test/test_title.h"
 #include "test/test_random.h"
+#include "txdb.h"
 #include "uint256.h"
 #include "undo.h"
 #include "utilstrencodings.h"
@@ -895,4 +896,53 @@ BOOST_AUTO_TEST_CASE(coin_write) {
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(coins_background_flush, TestingSetup) {
+    CCoinsViewDB db(1 << 20, true);
+    CCoinsViewBackgroundFlush flusher(&db);
+    CCoinsViewCache cache(&flusher);
+
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 1000; i++) {
+        outpoints.emplace_back(GetRandHash(), i % 3);
+        CTxOut txout(Amount(1000 + i), CScript() << OP_TRUE);
+        cache.AddCoin(outpoints.back(), Coin(txout, i, false), false);
+    }
+    uint256 hashBlock1 = GetRandHash();
+    cache.SetBestBlock(hashBlock1);
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+
+    // Whether or not the batch is on disk yet, it reads the same.
+    BOOST_CHECK(flusher.GetBestBlock() == hashBlock1);
+    for (const COutPoint &outpoint : outpoints) {
+        BOOST_CHECK(flusher.HaveCoin(outpoint));
+    }
+
+    // Spend half of the coins and flush again, which waits for the first
+    // batch before handing over the second.
+    for (size_t i = 0; i < outpoints.size(); i += 2) {
+        BOOST_CHECK(cache.SpendCoin(outpoints[i]));
+    }
+    uint256 hashBlock2 = GetRandHash();
+    cache.SetBestBlock(hashBlock2);
+    BOOST_CHECK(cache.Flush());
+    for (size_t i = 0; i < outpoints.size(); i++) {
+        Coin coin;
+        BOOST_CHECK_EQUAL(flusher.GetCoin(outpoints[i], coin), i % 2 == 1);
+        BOOST_CHECK_EQUAL(cache.HaveCoin(outpoints[i]), i % 2 == 1);
+    }
+
+    BOOST_CHECK(flusher.Sync());
+    BOOST_CHECK_EQUAL(flusher.PendingMemoryUsage(), 0U);
+    BOOST_CHECK(db.GetBestBlock() == hashBlock2);
+    for (size_t i = 0; i < outpoints.size(); i++) {
+        Coin coin;
+        BOOST_CHECK_EQUAL(db.GetCoin(outpoints[i], coin), i % 2 == 1);
+        if (i % 2 == 1) {
+            BOOST_CHECK_EQUAL(coin.GetHeight(), i);
+            BOOST_CHECK(coin.GetTxOut().nValue == Amount(1000 + int64_t(i)));
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -6,6 +6,7 @@
 #include "crypto/chacha20.h"
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
+#include "crypto/muhash.h"
 #include "crypto/ripemd160.h"
 #include "crypto/sha1.h"
 #include "crypto/sha256.h"
@@ -607,6 +608,67 @@ BOOST_AUTO_TEST_CASE(chacha20_testvector) {
         "38407a6deb3ab78fab78c9");
 }
 
+static MuHash3072 MuHashFromInt(uint8_t i) {
+    uint8_t tmp[32] = {i, 0};
+    return MuHash3072().Insert(tmp, sizeof(tmp));
+}
+
+static uint256 MuHashFinalize(MuHash3072 muhash) {
+    uint256 out;
+    muhash.Finalize(out.begin());
+    return out;
+}
+
+BOOST_AUTO_TEST_CASE(muhash_tests) {
+    // Any order of the same insertions and removals gives the same digest.
+    for (int iter = 0; iter < 10; ++iter) {
+        uint256 res;
+        int table[4];
+        for (int i = 0; i < 4; ++i) {
+            table[i] = insecure_rand_ctx.randbits(3);
+        }
+        for (int order = 0; order < 4; ++order) {
+            MuHash3072 acc;
+            for (int i = 0; i < 4; ++i) {
+                int t = table[i ^ order];
+                if (t & 4) {
+                    acc /= MuHashFromInt(t & 3);
+                } else {
+                    acc *= MuHashFromInt(t & 3);
+                }
+            }
+            uint256 out = MuHashFinalize(acc);
+            if (order == 0) {
+                res = out;
+            } else {
+                BOOST_CHECK(res == out);
+            }
+        }
+    }
+
+    // Removing what was inserted gives the hash of the empty set.
+    uint8_t data[32] = {7};
+    MuHash3072 acc;
+    acc.Insert(data, sizeof(data));
+    acc.Remove(data, sizeof(data));
+    BOOST_CHECK(MuHashFinalize(acc) == MuHashFinalize(MuHash3072()));
+
+    // Test vector shared with other MuHash3072 implementations.
+    acc = MuHashFromInt(0);
+    acc *= MuHashFromInt(1);
+    acc /= MuHashFromInt(2);
+    BOOST_CHECK_EQUAL(MuHashFinalize(acc).GetHex(),
+                      "10d312b100cbd32ada024a6646e40d3482fcff103668d2625f10002a"
+                      "607d5863");
+
+    MuHash3072 acc2 = MuHashFromInt(0);
+    uint8_t tmp[32] = {1, 0};
+    acc2.Insert(tmp, sizeof(tmp));
+    uint8_t tmp2[32] = {2, 0};
+    acc2.Remove(tmp2, sizeof(tmp2));
+    BOOST_CHECK(MuHashFinalize(acc) == MuHashFinalize(acc2));
+}
+
 BOOST_AUTO_TEST_CASE(countbits_tests) {
     FastRandomContext ctx;
     for (int i = 0; i <= 64; ++i) {
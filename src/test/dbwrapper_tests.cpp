@@ -328,4 +328,51 @@ BOOST_AUTO_TEST_CASE(iterator_string_ordering) {
     }
 }
 
+BOOST_AUTO_TEST_CASE(dbwrapper_options) {
+    DBOptions defaults = GetDBOptions("chainstate");
+    BOOST_CHECK_EQUAL(defaults.nBloomBits, DEFAULT_DB_BLOOM_BITS);
+    BOOST_CHECK_EQUAL(defaults.nMaxOpenFiles, DEFAULT_DB_MAX_OPEN_FILES);
+    BOOST_CHECK_EQUAL(defaults.fCompression, DEFAULT_DB_COMPRESSION);
+
+    // Options for one database take precedence, in any order.
+    ForceSetMultiArg("-dbmaxopenfiles", "chainstate:1000");
+    ForceSetMultiArg("-dbmaxopenfiles", "200");
+    ForceSetMultiArg("-dbbloombits", "blockindex:0");
+    ForceSetMultiArg("-dbcompression", "");
+    DBOptions chainstate = GetDBOptions("chainstate");
+    DBOptions blockindex = GetDBOptions("blockindex");
+    ClearArg("-dbmaxopenfiles");
+    ClearArg("-dbbloombits");
+    ClearArg("-dbcompression");
+    BOOST_CHECK_EQUAL(chainstate.nMaxOpenFiles, 1000);
+    BOOST_CHECK_EQUAL(blockindex.nMaxOpenFiles, 200);
+    BOOST_CHECK_EQUAL(chainstate.nBloomBits, DEFAULT_DB_BLOOM_BITS);
+    BOOST_CHECK_EQUAL(blockindex.nBloomBits, 0);
+    // Compression is only turned on where LevelDB can do it.
+    BOOST_CHECK_EQUAL(chainstate.fCompression, DBCompressionSupported());
+    BOOST_CHECK_EQUAL(blockindex.fCompression, DBCompressionSupported());
+
+    // A database without a bloom filter and with other block and file sizes
+    // reads back what it wrote.
+    blockindex.nBlockSize = 16384;
+    blockindex.nMaxFileSize = 8 << 20;
+    boost::filesystem::path ph = boost::filesystem::temp_directory_path() /
+                                 boost::filesystem::unique_path();
+    CDBWrapper dbw(ph, (1 << 20), true, false, false, blockindex);
+    BOOST_CHECK_EQUAL(dbw.GetDBOptions().nBlockSize, 16384U);
+    for (int i = 0; i < 1000; i++) {
+        BOOST_CHECK(dbw.Write(i, i * 2));
+    }
+    for (int i = 0; i < 1000; i++) {
+        int res;
+        BOOST_CHECK(dbw.Read(i, res));
+        BOOST_CHECK_EQUAL(res, i * 2);
+    }
+
+    std::string strValue;
+    BOOST_CHECK(dbw.GetProperty("leveldb.stats", strValue));
+    BOOST_CHECK(dbw.GetProperty("leveldb.num-files-at-level0", strValue));
+    BOOST_CHECK(!dbw.GetProperty("leveldb.bogus", strValue));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
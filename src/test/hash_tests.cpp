@@ -2,7 +2,11 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "chainparams.h"
 #include "hash.h"
+#include "hash_blake2.h"
+#include "primitives/block.h"
+#include "test/test_random.h"
 #include "test/test_title.h"
 #include "utilstrencodings.h"
 
@@ -199,4 +203,102 @@ BOOST_AUTO_TEST_CASE(hashverifier_tests) {
     BOOST_CHECK(h1.GetHash() != checksum);
 }
 
+static std::string Blake2b256Hex(const std::vector<uint8_t> &in) {
+    uint8_t hash[32];
+    Blake2::hash2b(hash, sizeof(hash), in.data(), in.size());
+    return HexStr(hash, hash + sizeof(hash));
+}
+
+BOOST_AUTO_TEST_CASE(blake2b_tests) {
+    BOOST_CHECK_EQUAL(
+        Blake2b256Hex({}),
+        "0e5751c026e543b2e8ab2eb06099daa1d1e5df47778f7787faab45cdf12fe3a8");
+    BOOST_CHECK_EQUAL(
+        Blake2b256Hex({'a', 'b', 'c'}),
+        "bddd813c634239723171ef3fee98579b94964e3bb1cb3e427262c8c068d52319");
+
+    std::vector<uint8_t> in(80);
+    for (size_t i = 0; i < in.size(); i++) {
+        in[i] = i;
+    }
+    BOOST_CHECK_EQUAL(
+        Blake2b256Hex(in),
+        "066de1009daca2b8390a9dc734bce547ac4e3cc4531645bb8b9cbc0070941d88");
+}
+
+BOOST_AUTO_TEST_CASE(blake2b_writer_tests) {
+    // Writes split across Blake2b block boundaries match a one-shot hash.
+    std::vector<uint8_t> in(300);
+    for (size_t i = 0; i < in.size(); i++) {
+        in[i] = i * 7;
+    }
+    for (size_t split : {0, 1, 80, 127, 128, 129, 256, 300}) {
+        CBlake2bWriter writer(SER_GETHASH, PROTOCOL_VERSION);
+        writer.write((const char *)in.data(), split);
+        writer.write((const char *)in.data() + split, in.size() - split);
+        uint256 hash = writer.GetHash();
+        BOOST_CHECK_EQUAL(HexStr(hash.begin(), hash.end()),
+                          Blake2b256Hex(in));
+    }
+
+    CBlockHeader header;
+    header.nVersion = 0x21000000;
+    header.hashPrevBlock = GetRandHash();
+    header.hashMerkleRoot = GetRandHash();
+    header.nTime = 1500000000;
+    header.nBits = 0x1d00ffff;
+    header.nNonce = 42;
+    CDataStream ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << header;
+    uint256 hash = Blake2::SerializeHash(header);
+    BOOST_CHECK_EQUAL(HexStr(hash.begin(), hash.end()),
+                      Blake2b256Hex(std::vector<uint8_t>(ss.begin(), ss.end())));
+}
+
+BOOST_AUTO_TEST_CASE(blake2b_batch_tests) {
+    BOOST_TEST_MESSAGE("Blake2b backend: " << Blake2::Implementation());
+
+    // Cover every remainder around the 4-way groups.
+    for (size_t count = 0; count <= 13; count++) {
+        std::vector<uint8_t> in(count * 80);
+        for (uint8_t &b : in) {
+            b = insecure_rand();
+        }
+
+        std::vector<uint8_t> out(count * 32);
+        Blake2::hash2b_80(out.data(), in.data(), count);
+
+        for (size_t i = 0; i < count; i++) {
+            uint8_t expected[32];
+            Blake2::hash2b(expected, sizeof(expected), &in[i * 80], 80);
+            BOOST_CHECK(memcmp(expected, &out[i * 32], 32) == 0);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(pow_hash_batch_tests) {
+    const int powBlake2Height = Params().GetConsensus().powBlake2Height;
+
+    std::vector<CBlockHeader> headers;
+    std::vector<int> heights;
+    for (int i = 0; i < 50; i++) {
+        CBlockHeader header;
+        header.nVersion = (i % 3 == 0) ? 0x21000000 : 0x20000000;
+        header.hashPrevBlock = GetRandHash();
+        header.hashMerkleRoot = GetRandHash();
+        header.nTime = insecure_rand();
+        header.nBits = insecure_rand();
+        header.nNonce = insecure_rand();
+        headers.push_back(header);
+        // Straddle the Blake2b fork height.
+        heights.push_back(powBlake2Height - 10 + i);
+    }
+
+    std::vector<uint256> hashes = CBlockHeader::GetPoWHashes(headers, heights);
+    BOOST_CHECK_EQUAL(hashes.size(), headers.size());
+    for (size_t i = 0; i < headers.size(); i++) {
+        BOOST_CHECK(hashes[i] == headers[i].GetPoWHash(heights[i]));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
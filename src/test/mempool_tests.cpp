@@ -136,6 +136,99 @@ BOOST_AUTO_TEST_CASE(MempoolClearTest) {
     BOOST_CHECK_EQUAL(testPool.vTxHashes.size(), 0);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolLinksTest) {
+    // Test the parent and child links kept in each entry
+
+    TestMemPoolEntryHelper entry;
+    CTxMemPool testPool(CFeeRate(0));
+    const size_t nEmptyUsage = testPool.DynamicMemoryUsage();
+
+    // Six independent transactions, which is more parents than fit inline...
+    std::vector<CMutableTransaction> txParents(6);
+    for (size_t i = 0; i < txParents.size(); i++) {
+        txParents[i].vin.resize(1);
+        txParents[i].vin[0].scriptSig = CScript() << OP_11 << int64_t(i);
+        txParents[i].vout.resize(2);
+        for (int j = 0; j < 2; j++) {
+            txParents[i].vout[j].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+            txParents[i].vout[j].nValue = 33000LL;
+        }
+        testPool.addUnchecked(txParents[i].GetId(),
+                              entry.FromTx(txParents[i]));
+    }
+    // ... a transaction spending both outputs of each ...
+    CMutableTransaction txChild;
+    for (const CMutableTransaction &txParent : txParents) {
+        for (uint32_t j = 0; j < 2; j++) {
+            txChild.vin.push_back(CTxIn(COutPoint(txParent.GetId(), j),
+                                        CScript() << OP_11));
+        }
+    }
+    txChild.vout.resize(1);
+    txChild.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txChild.vout[0].nValue = 11000LL;
+    testPool.addUnchecked(txChild.GetId(), entry.FromTx(txChild));
+    // ... and a chain of ten on top of it.
+    std::vector<CMutableTransaction> txChain(10);
+    uint256 prevId = txChild.GetId();
+    for (CMutableTransaction &tx : txChain) {
+        tx.vin.resize(1);
+        tx.vin[0].scriptSig = CScript() << OP_11;
+        tx.vin[0].prevout = COutPoint(prevId, 0);
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        tx.vout[0].nValue = 11000LL;
+        testPool.addUnchecked(tx.GetId(), entry.FromTx(tx));
+        prevId = tx.GetId();
+    }
+
+    CTxMemPool::txiter childIt = testPool.mapTx.find(txChild.GetId());
+    BOOST_CHECK_EQUAL(testPool.GetMemPoolParents(childIt).size(), 6U);
+    BOOST_CHECK_EQUAL(testPool.GetMemPoolChildren(childIt).size(), 1U);
+    for (const CTxMemPoolEntry *parent : testPool.GetMemPoolParents(childIt)) {
+        CTxMemPool::txiter parentIt = testPool.GetIter(parent);
+        BOOST_CHECK(testPool.GetMemPoolChildren(parentIt).size() == 1 &&
+                    testPool.GetMemPoolChildren(parentIt)[0] == &*childIt);
+        BOOST_CHECK_EQUAL(parentIt->GetCountWithDescendants(), 12U);
+    }
+    CTxMemPool::txiter lastIt = testPool.mapTx.find(txChain.back().GetId());
+    BOOST_CHECK_EQUAL(lastIt->GetCountWithAncestors(), 17U);
+    CTxMemPool::setEntries setDescendants;
+    testPool.CalculateDescendants(childIt, setDescendants);
+    BOOST_CHECK_EQUAL(setDescendants.size(), 11U);
+
+    // Confirming two of the parents unlinks them from the child.
+    std::vector<CTransactionRef> vtx;
+    vtx.push_back(MakeTransactionRef(txParents[0]));
+    vtx.push_back(MakeTransactionRef(txParents[3]));
+    testPool.removeForBlock(vtx, 1);
+    BOOST_CHECK_EQUAL(testPool.GetMemPoolParents(childIt).size(), 4U);
+    for (const CTxMemPoolEntry *parent : testPool.GetMemPoolParents(childIt)) {
+        BOOST_CHECK(parent->GetTx().GetId() != txParents[0].GetId() &&
+                    parent->GetTx().GetId() != txParents[3].GetId());
+    }
+    BOOST_CHECK_EQUAL(childIt->GetCountWithAncestors(), 5U);
+    BOOST_CHECK_EQUAL(lastIt->GetCountWithAncestors(), 15U);
+
+    // Removing the middle of the chain takes the rest of it along.
+    testPool.removeRecursive(CTransaction(txChain[5]));
+    BOOST_CHECK_EQUAL(testPool.size(), 10U);
+    CTxMemPool::txiter tailIt = testPool.mapTx.find(txChain[4].GetId());
+    BOOST_CHECK(testPool.GetMemPoolChildren(tailIt).empty());
+    BOOST_CHECK_EQUAL(childIt->GetCountWithDescendants(), 6U);
+
+    // Once everything is gone, so is the memory used by the links. Only
+    // vTxHashes keeps its capacity.
+    testPool.removeRecursive(CTransaction(txChild));
+    for (const CMutableTransaction &txParent : txParents) {
+        testPool.removeRecursive(CTransaction(txParent));
+    }
+    BOOST_CHECK_EQUAL(testPool.size(), 0U);
+    BOOST_CHECK_EQUAL(testPool.DynamicMemoryUsage(),
+                      nEmptyUsage +
+                          memusage::DynamicUsage(testPool.vTxHashes));
+}
+
 template <typename name>
 void CheckSort(CTxMemPool &pool, std::vector<std::string> &sortedOrder) {
     BOOST_CHECK_EQUAL(pool.size(), sortedOrder.size());
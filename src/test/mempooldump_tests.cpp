@@ -0,0 +1,192 @@
+// Copyright (c) 2018 The Title Network developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "mempooldump.h"
+
+#include "clientversion.h"
+#include "coins.h"
+#include "config.h"
+#include "key.h"
+#include "random.h"
+#include "txmempool.h"
+#include "util.h"
+#include "validation.h"
+
+#include "test/test_title.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+
+BOOST_FIXTURE_TEST_SUITE(mempooldump_tests, TestingSetup)
+
+// The chunks and checksums mempool.dat shares with UTXO snapshots are tested
+// in utxosnapshot_tests.
+
+static CTransactionRef RandomTransaction(FastRandomContext &rng) {
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(GetRandHash(), rng.randrange(10));
+    tx.vout.resize(1);
+    tx.vout[0].nValue = Amount(int64_t(rng.randrange(COIN.GetSatoshis())));
+    return MakeTransactionRef(tx);
+}
+
+BOOST_AUTO_TEST_CASE(mempooldump_deltas) {
+    FastRandomContext rng(true);
+    std::vector<MempoolDumpEntry> vEntries;
+    for (int i = 0; i < 10; i++) {
+        vEntries.emplace_back(RandomTransaction(rng), rng.rand32(), i - 5);
+    }
+    // Deltas of transactions that are not in the mempool are kept too.
+    std::map<uint256, Amount> mapDeltas;
+    mapDeltas[GetRandHash()] = Amount(1234);
+    mapDeltas[GetRandHash()] = Amount(-5678);
+    boost::filesystem::path path = pathTemp / "mempool.dat";
+    {
+        CMempoolDumpWriter writer(path);
+        for (const MempoolDumpEntry &entry : vEntries) {
+            writer.Add(entry);
+        }
+        writer.Finish(mapDeltas);
+    }
+    BOOST_CHECK(!boost::filesystem::exists(pathTemp / "mempool.dat.new"));
+
+    CMempoolDumpReader reader(fopen(path.string().c_str(), "rb"));
+    BOOST_CHECK_EQUAL(reader.GetVersion(), MEMPOOL_DUMP_VERSION_CHUNKED);
+    std::vector<MempoolDumpEntry> vChunk;
+    BOOST_REQUIRE(reader.ReadChunk(vChunk));
+    BOOST_REQUIRE_EQUAL(vChunk.size(), vEntries.size());
+    for (size_t i = 0; i < vChunk.size(); i++) {
+        BOOST_CHECK(*vChunk[i].tx == *vEntries[i].tx);
+        BOOST_CHECK_EQUAL(vChunk[i].nTime, vEntries[i].nTime);
+        BOOST_CHECK_EQUAL(vChunk[i].nFeeDelta, vEntries[i].nFeeDelta);
+    }
+    // The deltas are only there once the last chunk is read.
+    BOOST_CHECK(reader.GetDeltas().empty());
+    BOOST_CHECK(!reader.ReadChunk(vChunk));
+    BOOST_CHECK(reader.GetDeltas() == mapDeltas);
+    BOOST_CHECK_EQUAL(reader.GetTransactionsRead(), vEntries.size());
+
+    // A version from the future is refused.
+    {
+        CAutoFile file(fopen(path.string().c_str(), "wb"), SER_DISK,
+                       CLIENT_VERSION);
+        file << uint64_t(MEMPOOL_DUMP_VERSION_CHUNKED + 1);
+    }
+    BOOST_CHECK_THROW(CMempoolDumpReader(fopen(path.string().c_str(), "rb")),
+                      std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_CASE(mempooldump_serial) {
+    // A file in the format from before chunks reads the same, cut into chunks.
+    FastRandomContext rng(true);
+    std::vector<MempoolDumpEntry> vEntries;
+    for (uint32_t i = 0; i < MEMPOOL_DUMP_CHUNK_TXS + 10; i++) {
+        vEntries.emplace_back(RandomTransaction(rng), rng.rand32(),
+                              int64_t(rng.randrange(1000)) - 500);
+    }
+    std::map<uint256, Amount> mapDeltas;
+    mapDeltas[GetRandHash()] = Amount(42);
+    boost::filesystem::path path = pathTemp / "mempool.dat";
+    {
+        CAutoFile file(fopen(path.string().c_str(), "wb"), SER_DISK,
+                       CLIENT_VERSION);
+        file << MEMPOOL_DUMP_VERSION_SERIAL;
+        file << uint64_t(vEntries.size());
+        for (const MempoolDumpEntry &entry : vEntries) {
+            file << *entry.tx << entry.nTime << entry.nFeeDelta;
+        }
+        file << mapDeltas;
+    }
+
+    CMempoolDumpReader reader(fopen(path.string().c_str(), "rb"));
+    BOOST_CHECK_EQUAL(reader.GetVersion(), MEMPOOL_DUMP_VERSION_SERIAL);
+    std::vector<MempoolDumpEntry> vChunk;
+    std::vector<size_t> vSizes;
+    size_t nEntry = 0;
+    while (reader.ReadChunk(vChunk)) {
+        vSizes.push_back(vChunk.size());
+        for (const MempoolDumpEntry &entry : vChunk) {
+            BOOST_REQUIRE(nEntry < vEntries.size());
+            BOOST_CHECK(*entry.tx == *vEntries[nEntry].tx);
+            BOOST_CHECK_EQUAL(entry.nTime, vEntries[nEntry].nTime);
+            BOOST_CHECK_EQUAL(entry.nFeeDelta, vEntries[nEntry].nFeeDelta);
+            nEntry++;
+        }
+    }
+    BOOST_REQUIRE_EQUAL(vSizes.size(), 2U);
+    BOOST_CHECK_EQUAL(vSizes[0], MEMPOOL_DUMP_CHUNK_TXS);
+    BOOST_CHECK_EQUAL(vSizes[1], 10U);
+    BOOST_CHECK_EQUAL(reader.GetTransactionsRead(), vEntries.size());
+    BOOST_CHECK(reader.GetDeltas() == mapDeltas);
+}
+
+BOOST_FIXTURE_TEST_CASE(mempooldump_load, RegTestingSetup) {
+    CKey key;
+    key.MakeNewKey(true);
+    CScript scriptPubKey = CScript() << ToByteVector(key.GetPubKey())
+                                     << OP_CHECKSIG;
+    COutPoint prevout(GetRandHash(), 0);
+    {
+        LOCK(cs_main);
+        pcoinsTip->AddCoin(prevout, Coin(CTxOut(COIN, scriptPubKey), 1, false),
+                           false);
+    }
+
+    // A chain longer than a chunk, so that parents are in earlier chunks.
+    std::vector<CTransactionRef> vtx;
+    Amount nValue = COIN;
+    for (uint32_t i = 0; i < MEMPOOL_DUMP_CHUNK_TXS + 5; i++) {
+        vtx.push_back(
+            CreateSpend(key, prevout, nValue, scriptPubKey, Amount(1000)));
+        prevout = COutPoint(vtx.back()->GetId(), 0);
+        nValue = vtx.back()->vout[0].nValue;
+    }
+
+    // Bypass the ancestor limits, which a real mempool would not allow this
+    // chain past, by adding the entries directly.
+    int64_t nTime = GetTime() - 60;
+    for (const CTransactionRef &ptx : vtx) {
+        LockPoints lp;
+        mempool.addUnchecked(ptx->GetId(),
+                             CTxMemPoolEntry(ptx, 1000, nTime, 0, 1, 0, false,
+                                             1, lp));
+    }
+    double dPriorityDummy = 0;
+    mempool.PrioritiseTransaction(vtx[1]->GetId(), vtx[1]->GetId().ToString(),
+                                  dPriorityDummy, Amount(500));
+
+    DumpMempool();
+    // As after a restart.
+    mempool.clear();
+    mempool.ClearPrioritisation(vtx[1]->GetId());
+    ForceSetArg("-limitancestorcount", std::to_string(vtx.size()));
+    ForceSetArg("-limitdescendantcount", std::to_string(vtx.size()));
+    ForceSetArg("-limitancestorsize", "1000000");
+    ForceSetArg("-limitdescendantsize", "1000000");
+    BOOST_CHECK(LoadMempool(GetConfig()));
+
+    BOOST_CHECK_EQUAL(mempool.size(), vtx.size());
+    for (const CTransactionRef &ptx : vtx) {
+        BOOST_CHECK(mempool.exists(ptx->GetId()));
+    }
+    TxMempoolInfo info = mempool.info(vtx[1]->GetId());
+    BOOST_CHECK_EQUAL(info.nTime, nTime);
+    BOOST_CHECK(info.nFeeDelta == Amount(500));
+
+    ForceSetArg("-limitancestorcount",
+                std::to_string(DEFAULT_ANCESTOR_LIMIT));
+    ForceSetArg("-limitdescendantcount",
+                std::to_string(DEFAULT_DESCENDANT_LIMIT));
+    ForceSetArg("-limitancestorsize",
+                std::to_string(DEFAULT_ANCESTOR_SIZE_LIMIT));
+    ForceSetArg("-limitdescendantsize",
+                std::to_string(DEFAULT_DESCENDANT_SIZE_LIMIT));
+    mempool.clear();
+    mempool.ClearPrioritisation(vtx[1]->GetId());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
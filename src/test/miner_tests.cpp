@@ -4,6 +4,7 @@
 
 #include "miner.h"
 
+#include "arith_uint256.h"
 #include "chainparams.h"
 #include "coins.h"
 #include "config.h"
@@ -11,7 +12,9 @@
 #include "consensus/merkle.h"
 #include "consensus/validation.h"
 #include "policy/policy.h"
+#include "pow.h"
 #include "pubkey.h"
+#include "random.h"
 #include "script/standard.h"
 #include "txmempool.h"
 #include "uint256.h"
@@ -776,4 +779,179 @@ BOOST_AUTO_TEST_CASE(BlockAssembler_construction) {
     }
 }
 
+// Spend output 0 of prevout's transaction to OP_TRUE.
+static CMutableTransaction SpendToTrue(const COutPoint &prevout,
+                                       Amount nValue) {
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = prevout;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = nValue;
+    tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    return tx;
+}
+
+static std::vector<uint256> GetTxIds(const CBlock &block) {
+    std::vector<uint256> vTxIds;
+    for (size_t i = 1; i < block.vtx.size(); i++) {
+        vTxIds.push_back(block.vtx[i]->GetId());
+    }
+    return vTxIds;
+}
+
+BOOST_AUTO_TEST_CASE(BlockTemplateCache_follows_mempool) {
+    GlobalConfig config;
+    config.SetBlockPriorityPercentage(0);
+    TestMemPoolEntryHelper entry;
+    LOCK(cs_main);
+
+    // Coins that anyone can spend.
+    const Amount nValue = 50 * COIN;
+    for (uint32_t n = 0; n < 2; n++) {
+        pcoinsTip->AddCoin(COutPoint(uint256(), n),
+                           Coin(CTxOut(nValue, CScript() << OP_TRUE), 0,
+                                false),
+                           false);
+    }
+
+    BlockTemplateCache cache(config);
+
+    // The first template is assembled, and has just the coinbase.
+    std::unique_ptr<CBlockTemplate> pblocktemplate = cache.Get();
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 1U);
+    BOOST_CHECK_EQUAL(cache.GetTemplatesAssembled(), 1U);
+    const Amount nSubsidy = pblocktemplate->block.vtx[0]->vout[0].nValue;
+
+    // A spend of a confirmed coin and a spend of that are appended.
+    CMutableTransaction parent =
+        SpendToTrue(COutPoint(uint256(), 0), nValue - Amount(10000));
+    mempool.addUnchecked(parent.GetId(), entry.Fee(10000).FromTx(parent));
+    CMutableTransaction child = SpendToTrue(
+        COutPoint(parent.GetId(), 0), nValue - Amount(10000 + 20000));
+    mempool.addUnchecked(child.GetId(), entry.Fee(20000).FromTx(child));
+    pblocktemplate = cache.Get();
+    BOOST_CHECK_EQUAL(cache.GetTemplatesAssembled(), 1U);
+    BOOST_CHECK_EQUAL(cache.GetTransactionsAppended(), 2U);
+    BOOST_REQUIRE_EQUAL(pblocktemplate->block.vtx.size(), 3U);
+    BOOST_CHECK(pblocktemplate->block.vtx[1]->GetId() == parent.GetId());
+    BOOST_CHECK(pblocktemplate->block.vtx[2]->GetId() == child.GetId());
+    BOOST_CHECK(pblocktemplate->block.vtx[0]->vout[0].nValue ==
+                nSubsidy + Amount(30000));
+    BOOST_CHECK(pblocktemplate->vTxFees[0] == Amount(-30000));
+    BOOST_CHECK(pblocktemplate->vTxFees[2] == Amount(20000));
+
+    // It is the block that would be assembled from scratch, and it is valid.
+    CScript scriptDummy = CScript() << OP_TRUE;
+    std::unique_ptr<CBlockTemplate> pnew =
+        BlockAssembler(config, Params()).CreateNewBlock(scriptDummy);
+    BOOST_CHECK(GetTxIds(pblocktemplate->block) == GetTxIds(pnew->block));
+    BOOST_CHECK(*pblocktemplate->block.vtx[0] == *pnew->block.vtx[0]);
+    CValidationState state;
+    BOOST_CHECK(TestBlockValidity(config, state, Params(),
+                                  pblocktemplate->block, chainActive.Tip(),
+                                  false, false));
+
+    // A transaction below the minimum fee is left out, as it would be from
+    // scratch. A child that pays for it cannot be appended without it, so the
+    // template is assembled again once it is old enough.
+    CMutableTransaction lowfee =
+        SpendToTrue(COutPoint(uint256(), 1), nValue);
+    mempool.addUnchecked(lowfee.GetId(), entry.Fee(0).FromTx(lowfee));
+    cache.Get();
+    CMutableTransaction payer = SpendToTrue(COutPoint(lowfee.GetId(), 0),
+                                            nValue - Amount(100000));
+    mempool.addUnchecked(payer.GetId(), entry.Fee(100000).FromTx(payer));
+    pblocktemplate = cache.Get();
+    BOOST_CHECK_EQUAL(cache.GetTemplatesAssembled(), 1U);
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 3U);
+    SetMockTime(GetTime() + BLOCK_TEMPLATE_REFRESH_INTERVAL + 1);
+    pblocktemplate = cache.Get();
+    BOOST_CHECK_EQUAL(cache.GetTemplatesAssembled(), 2U);
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 5U);
+
+    // So is one with changes that the mempool does not signal.
+    cache.SetBehind();
+    cache.Get();
+    BOOST_CHECK_EQUAL(cache.GetTemplatesAssembled(), 2U);
+    SetMockTime(GetTime() + BLOCK_TEMPLATE_REFRESH_INTERVAL + 1);
+    cache.Get();
+    BOOST_CHECK_EQUAL(cache.GetTemplatesAssembled(), 3U);
+    SetMockTime(0);
+
+    // A transaction that leaves the mempool makes the template stale.
+    mempool.removeRecursive(CTransaction(child));
+    pblocktemplate = cache.Get();
+    BOOST_CHECK_EQUAL(cache.GetTemplatesAssembled(), 4U);
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 4U);
+
+    // So does a new tip, which here is a copy of the old one.
+    CBlockIndex *pindexPrev = chainActive.Tip();
+    CBlockIndex indexCopy = *pindexPrev;
+    chainActive.SetTip(&indexCopy);
+    pblocktemplate = cache.Get();
+    BOOST_CHECK_EQUAL(cache.GetTemplatesAssembled(), 5U);
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 4U);
+    chainActive.SetTip(pindexPrev);
+
+    mempool.clear();
+    config.SetBlockPriorityPercentage(DEFAULT_BLOCK_PRIORITY_PERCENTAGE);
+}
+
+static uint32_t GrindNonceSerial(CBlockHeader header, int nHeight,
+                                 uint32_t nBegin, uint32_t nEnd,
+                                 const Consensus::Params &params) {
+    for (header.nNonce = nBegin; header.nNonce < nEnd; header.nNonce++) {
+        if (CheckProofOfWork(header.GetPoWHash(nHeight), header.nBits,
+                             params)) {
+            break;
+        }
+    }
+    return header.nNonce;
+}
+
+BOOST_AUTO_TEST_CASE(GrindNonce_matches_serial_search) {
+    Consensus::Params params = Params().GetConsensus();
+    params.powLimit = ArithToUint256(~arith_uint256());
+
+    // Roughly one nonce in 512 succeeds for each of these, and the last one
+    // accepts every hash once scaled.
+    const struct {
+        int32_t nVersion;
+        int nHeight;
+        int nTargetBits;
+    } cases[] = {
+        {4, 1, 247},
+        {4, params.powBlake2Height + 1, 247},
+        {CBlockHeader::SCALED_POW_VERSION, params.powBlake2Height + 1, 215},
+        {CBlockHeader::SCALED_POW_VERSION, params.powBlake2Height + 1, 250},
+    };
+
+    for (const auto &c : cases) {
+        CBlockHeader header;
+        header.nVersion = c.nVersion;
+        header.hashPrevBlock = GetRandHash();
+        header.hashMerkleRoot = GetRandHash();
+        header.nTime = 1500000000;
+        arith_uint256 bnTarget = arith_uint256(1) << c.nTargetBits;
+        header.nBits = bnTarget.GetCompact();
+
+        for (uint32_t nBegin : {0, 100, 5000}) {
+            uint32_t nEnd = nBegin + 8000;
+            uint32_t nExpected =
+                GrindNonceSerial(header, c.nHeight, nBegin, nEnd, params);
+            for (int nThreads : {1, 2, 3, 8}) {
+                BOOST_CHECK_EQUAL(GrindNonce(header, c.nHeight, nBegin, nEnd,
+                                             nThreads, params),
+                                  nExpected);
+            }
+        }
+    }
+
+    // An invalid target is never met.
+    CBlockHeader header;
+    header.nVersion = 4;
+    header.nBits = 0;
+    BOOST_CHECK_EQUAL(GrindNonce(header, 1, 0, 1000, 4, params), 1000U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
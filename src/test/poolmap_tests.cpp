@@ -0,0 +1,164 @@
+// Copyright (c) 2018 The Title Network developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "poolmap.h"
+
+#include "memusage.h"
+#include "random.h"
+
+#include "test/test_title.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+BOOST_FIXTURE_TEST_SUITE(poolmap_tests, BasicTestingSetup)
+
+namespace {
+//! Few distinct hashes, so that probe sequences get long and overlap.
+struct CollidingHasher {
+    size_t operator()(uint32_t key) const { return key % 7; }
+};
+} // namespace
+
+template <typename Hash> static void CheckRandomOperations() {
+    // std::string values have a destructor, so leaks and double destruction
+    // show up under the sanitizers.
+    poolmap<uint32_t, std::string, Hash> map;
+    std::unordered_map<uint32_t, std::string> expected;
+    FastRandomContext rng(true);
+
+    for (int i = 0; i < 20000; i++) {
+        uint32_t key = rng.randrange(500);
+        switch (rng.randrange(4)) {
+            case 0: {
+                auto ret = map.emplace(key, std::to_string(i));
+                auto ret2 = expected.emplace(key, std::to_string(i));
+                BOOST_CHECK_EQUAL(ret.second, ret2.second);
+                BOOST_CHECK_EQUAL(ret.first->second, ret2.first->second);
+                break;
+            }
+            case 1: {
+                auto it = map.find(key);
+                if (it != map.end()) {
+                    map.erase(it);
+                }
+                expected.erase(key);
+                break;
+            }
+            case 2:
+                map[key] += "x";
+                expected[key] += "x";
+                break;
+            case 3:
+                BOOST_CHECK_EQUAL(map.count(key), expected.count(key));
+                break;
+        }
+        BOOST_CHECK_EQUAL(map.size(), expected.size());
+        if (rng.randrange(2000) == 0) {
+            map.clear();
+            expected.clear();
+        }
+    }
+
+    size_t count = 0;
+    for (const auto &entry : map) {
+        BOOST_CHECK_EQUAL(entry.second, expected.at(entry.first));
+        count++;
+    }
+    BOOST_CHECK_EQUAL(count, expected.size());
+}
+
+BOOST_AUTO_TEST_CASE(poolmap_random) {
+    CheckRandomOperations<std::hash<uint32_t>>();
+    CheckRandomOperations<CollidingHasher>();
+}
+
+BOOST_AUTO_TEST_CASE(poolmap_stable_references) {
+    poolmap<uint32_t, uint32_t, std::hash<uint32_t>> map;
+    const uint32_t *first = &map[0];
+    map[0] = 42;
+    // Growing the table many times over does not move entries.
+    for (uint32_t i = 1; i < 100000; i++) {
+        map[i] = i;
+    }
+    BOOST_CHECK_EQUAL(*first, 42U);
+    BOOST_CHECK(&map.find(0)->second == first);
+
+    // Freed entries are reused.
+    map.erase(map.find(0));
+    BOOST_CHECK(&map[100000] == first);
+}
+
+BOOST_AUTO_TEST_CASE(poolmap_erase_while_iterating) {
+    poolmap<uint32_t, uint32_t, CollidingHasher> map;
+    for (uint32_t i = 0; i < 1000; i++) {
+        map.emplace(i, i);
+    }
+    size_t visited = 0;
+    for (auto it = map.begin(); it != map.end();) {
+        BOOST_CHECK_EQUAL(it->first, it->second);
+        visited++;
+        if (it->first % 2) {
+            map.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+    BOOST_CHECK_EQUAL(visited, 1000U);
+    BOOST_CHECK_EQUAL(map.size(), 500U);
+    for (uint32_t i = 0; i < 1000; i++) {
+        BOOST_CHECK_EQUAL(map.count(i), size_t(i % 2 == 0));
+    }
+
+    // Tombstones are cleaned up rather than filling the table.
+    for (int round = 0; round < 100; round++) {
+        for (uint32_t i = 1000; i < 1100; i++) {
+            map.emplace(i, i);
+        }
+        for (uint32_t i = 1000; i < 1100; i++) {
+            map.erase(map.find(i));
+        }
+    }
+    BOOST_CHECK_EQUAL(map.size(), 500U);
+    BOOST_CHECK(map.slot_bytes() <= 2048 * 8);
+}
+
+BOOST_AUTO_TEST_CASE(poolmap_move) {
+    poolmap<uint32_t, std::string, std::hash<uint32_t>> map;
+    for (uint32_t i = 0; i < 1000; i++) {
+        map.emplace(i, std::to_string(i));
+    }
+    const std::string *entry = &map.find(7)->second;
+    poolmap<uint32_t, std::string, std::hash<uint32_t>> moved(std::move(map));
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), 0U);
+    BOOST_CHECK_EQUAL(moved.size(), 1000U);
+    // Entries do not move along with the map.
+    BOOST_CHECK(&moved.find(7)->second == entry);
+    for (uint32_t i = 0; i < 1000; i++) {
+        BOOST_CHECK_EQUAL(moved.find(i)->second, std::to_string(i));
+    }
+    // The emptied map is still usable.
+    map[1] = "one";
+    BOOST_CHECK_EQUAL(map.size(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(poolmap_memusage) {
+    poolmap<uint32_t, uint32_t, std::hash<uint32_t>> map;
+    BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), 0U);
+    for (uint32_t i = 0; i < 10000; i++) {
+        map.emplace(i, i);
+    }
+    size_t usage = memusage::DynamicUsage(map);
+    // Pairs of 4 byte integers and 8 byte slots, with some slack.
+    BOOST_CHECK(usage > 10000 * 16);
+    BOOST_CHECK(usage < 10000 * 48);
+    map.clear();
+    BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -367,5 +367,47 @@ BOOST_AUTO_TEST_CASE(cash_difficulty_test) {
     }
 }
 
+BOOST_AUTO_TEST_CASE(next_work_memo_test) {
+    SelectParams(CBaseChainParams::MAIN);
+    const Consensus::Params &params = Params().GetConsensus();
+
+    std::vector<CBlockIndex> blocks(200);
+    const arith_uint256 initialPow = UintToArith256(params.powLimit) >> 4;
+    const uint32_t initialBits = initialPow.GetCompact();
+    blocks[0].nTime = 1269211443;
+    blocks[0].nBits = initialBits;
+    blocks[0].nChainWork = GetBlockProof(blocks[0]);
+    for (size_t i = 1; i < blocks.size(); i++) {
+        blocks[i] = GetBlockIndex(&blocks[i - 1], 500 + i % 200, initialBits);
+    }
+
+    CBlockHeader blkHeaderDummy;
+    CBlockIndex &tip = blocks.back();
+    const uint32_t nBits =
+        GetNextCoreWorkRequired(&tip, &blkHeaderDummy, params);
+    BOOST_CHECK(tip.pNextWorkParams == &params);
+    BOOST_CHECK_EQUAL(tip.nNextWorkRequired, nBits);
+    BOOST_CHECK_EQUAL(
+        GetNextCoreWorkRequired(&tip, &blkHeaderDummy, params), nBits);
+
+    // The memo belongs to the parameters it was computed with.
+    Consensus::Params lowLimitParams = params;
+    arith_uint256 lowLimit;
+    lowLimit.SetCompact(nBits);
+    lowLimit >>= 8;
+    lowLimitParams.powLimit = ArithToUint256(lowLimit);
+    BOOST_CHECK_EQUAL(
+        GetNextCoreWorkRequired(&tip, &blkHeaderDummy, lowLimitParams),
+        lowLimit.GetCompact());
+    BOOST_CHECK_EQUAL(
+        GetNextCoreWorkRequired(&tip, &blkHeaderDummy, params), nBits);
+
+    // A fresh index over the same ancestry computes the same value.
+    CBlockIndex copy = GetBlockIndex(tip.pprev, tip.nTime - tip.pprev->nTime,
+                                     tip.nBits);
+    BOOST_CHECK(copy.pNextWorkParams == nullptr);
+    BOOST_CHECK_EQUAL(
+        GetNextCoreWorkRequired(&copy, &blkHeaderDummy, params), nBits);
+}
 
 BOOST_AUTO_TEST_SUITE_END()
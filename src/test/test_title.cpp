@@ -19,6 +19,8 @@
 #include "rpc/server.h"
 #include "script/scriptcache.h"
 #include "script/sigcache.h"
+#include "script/sighashtype.h"
+#include "script/sign.h"
 #include "txdb.h"
 #include "txmempool.h"
 #include "ui_interface.h"
@@ -86,7 +88,9 @@ TestingSetup::TestingSetup(const std::string &chainName)
     mempool.setSanityCheck(1.0);
     pblocktree = new CBlockTreeDB(1 << 20, true);
     pcoinsdbview = new CCoinsViewDB(1 << 23, true);
-    pcoinsTip = new CCoinsViewCache(pcoinsdbview);
+    pcoinsFlusher = new CCoinsViewBackgroundFlush(pcoinsdbview);
+    pcoinsTip = new CCoinsViewCache(pcoinsFlusher);
+    LoadCoinsCommitment();
     InitBlockIndex(config);
     {
         CValidationState state;
@@ -96,6 +100,8 @@ TestingSetup::TestingSetup(const std::string &chainName)
     nScriptCheckThreads = 3;
     for (int i = 0; i < nScriptCheckThreads - 1; i++) {
         threadGroup.create_thread(&ThreadScriptCheck);
+        threadGroup.create_thread(&ThreadHeaderCheck);
+        threadGroup.create_thread(&ThreadMempoolScriptCheck);
     }
 
     // Deterministic randomness for tests.
@@ -110,6 +116,8 @@ TestingSetup::~TestingSetup() {
     threadGroup.join_all();
     UnloadBlockIndex();
     delete pcoinsTip;
+    delete pcoinsFlusher;
+    pcoinsFlusher = nullptr;
     delete pcoinsdbview;
     delete pblocktree;
     boost::filesystem::remove_all(pathTemp);
@@ -164,6 +172,27 @@ CBlock TestChain100Setup::CreateAndProcessBlock(
 
 TestChain100Setup::~TestChain100Setup() {}
 
+CTransactionRef CreateSpend(const CKey &key, const COutPoint &prevout,
+                            const Amount nValueIn, const CScript &scriptPubKey,
+                            const Amount nFee) {
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = prevout;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = nValueIn - nFee;
+    tx.vout[0].scriptPubKey = scriptPubKey;
+
+    std::vector<uint8_t> vchSig;
+    CScript scriptCode = CScript() << ToByteVector(key.GetPubKey())
+                                   << OP_CHECKSIG;
+    uint256 hash = SignatureHash(scriptCode, CTransaction(tx), 0,
+                                 SigHashType().withForkId(), nValueIn);
+    BOOST_CHECK(key.Sign(hash, vchSig));
+    vchSig.push_back(uint8_t(SIGHASH_ALL | SIGHASH_FORKID));
+    tx.vin[0].scriptSig << vchSig;
+    return MakeTransactionRef(tx);
+}
+
 CTxMemPoolEntry TestMemPoolEntryHelper::FromTx(const CMutableTransaction &tx,
                                                CTxMemPool *pool) {
     CTransaction txn(tx);
@@ -62,6 +62,22 @@ struct TestChain100Setup : public TestingSetup {
     CKey coinbaseKey;
 };
 
+/**
+ * Testing setup on REGTEST, for tests that accept transactions to the mempool.
+ * The standard script flags ask for SIGHASH_FORKID, which blocks on top of the
+ * main genesis block do not allow yet.
+ */
+struct RegTestingSetup : public TestingSetup {
+    RegTestingSetup() : TestingSetup(CBaseChainParams::REGTEST) {}
+};
+
+/**
+ * Spend a coin paying to key back to scriptPubKey, signed with SIGHASH_FORKID.
+ */
+CTransactionRef CreateSpend(const CKey &key, const COutPoint &prevout,
+                            const Amount nValueIn, const CScript &scriptPubKey,
+                            const Amount nFee);
+
 class CTxMemPoolEntry;
 class CTxMemPool;
 
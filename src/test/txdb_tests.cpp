@@ -0,0 +1,154 @@
+// Copyright (c) 2018 The Title Network developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txdb.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "checkpoints.h"
+#include "coins.h"
+#include "random.h"
+#include "validation.h"
+
+#include "test/test_title.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <map>
+#include <memory>
+
+BOOST_FIXTURE_TEST_SUITE(txdb_tests, BasicTestingSetup)
+
+/**
+ * Write a chain of nCount block index entries whose proof of work can never
+ * be valid, as their target is zero.
+ */
+static void WriteBadPoWChain(CBlockTreeDB &db, int nCount) {
+    std::vector<uint256> vHashes(nCount);
+    std::vector<CBlockIndex> vIndex(nCount);
+    std::vector<const CBlockIndex *> vWrite;
+    for (int i = 0; i < nCount; i++) {
+        CBlockHeader header;
+        header.hashPrevBlock = i > 0 ? vHashes[i - 1] : uint256();
+        header.nTime = 1500000000 + i;
+        header.nBits = 0;
+        header.nNonce = i;
+        vHashes[i] = header.GetHash();
+        vIndex[i] = CBlockIndex(header);
+        vIndex[i].phashBlock = &vHashes[i];
+        vIndex[i].pprev = i > 0 ? &vIndex[i - 1] : nullptr;
+        vIndex[i].nHeight = i;
+        vWrite.push_back(&vIndex[i]);
+    }
+    BOOST_REQUIRE(db.WriteBatchSync({}, 0, vWrite));
+}
+
+//! Load the block index from db, returning whether it was accepted.
+static bool LoadIndex(CBlockTreeDB &db, int nPoWTrustedHeight, int nThreads,
+                      size_t &nLoaded) {
+    std::map<uint256, std::unique_ptr<CBlockIndex>> mapIndex;
+    bool fOk = db.LoadBlockIndexGuts(
+        [&mapIndex](const uint256 &hash) -> CBlockIndex * {
+            if (hash.IsNull()) {
+                return nullptr;
+            }
+            std::unique_ptr<CBlockIndex> &pindex = mapIndex[hash];
+            if (!pindex) {
+                pindex.reset(new CBlockIndex());
+            }
+            return pindex.get();
+        },
+        nPoWTrustedHeight, nThreads);
+    nLoaded = mapIndex.size();
+    return fOk;
+}
+
+BOOST_AUTO_TEST_CASE(txdb_block_index_pow_trusted_height) {
+    CBlockTreeDB db(1 << 20, true);
+    WriteBadPoWChain(db, 50);
+
+    for (int nThreads : {1, 4}) {
+        size_t nLoaded = 0;
+        // Entries up to the trusted height are not checked again.
+        BOOST_CHECK(LoadIndex(db, 49, nThreads, nLoaded));
+        BOOST_CHECK_EQUAL(nLoaded, 50U);
+        BOOST_CHECK(LoadIndex(db, 1000, nThreads, nLoaded));
+        // A single entry above it is.
+        BOOST_CHECK(!LoadIndex(db, 48, nThreads, nLoaded));
+        BOOST_CHECK(!LoadIndex(db, 10, nThreads, nLoaded));
+        // And all of them without a trusted height.
+        BOOST_CHECK(!LoadIndex(db, -1, nThreads, nLoaded));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(txdb_block_index_pow_options) {
+    const CChainParams &chainparams = Params();
+    const int nLastCheckpoint =
+        Checkpoints::GetLastCheckpointHeight(chainparams.Checkpoints());
+    BOOST_REQUIRE(nLastCheckpoint > 0);
+
+    BOOST_CHECK_EQUAL(GetBlockIndexPoWTrustedHeight(chainparams),
+                      nLastCheckpoint);
+
+    // -checkblockindexpow checks every entry.
+    fCheckBlockIndexPoW = true;
+    BOOST_CHECK_EQUAL(GetBlockIndexPoWTrustedHeight(chainparams), -1);
+    fCheckBlockIndexPoW = DEFAULT_CHECKBLOCKINDEXPOW;
+
+    // So does -checkpoints=0.
+    fCheckpointsEnabled = false;
+    BOOST_CHECK_EQUAL(GetBlockIndexPoWTrustedHeight(chainparams), -1);
+    fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
+
+    // With the option set, an index that is only bad below the last
+    // checkpoint is refused.
+    CBlockTreeDB db(1 << 20, true);
+    WriteBadPoWChain(db, 50);
+    size_t nLoaded = 0;
+    BOOST_CHECK(LoadIndex(db, GetBlockIndexPoWTrustedHeight(chainparams), 2,
+                          nLoaded));
+    fCheckBlockIndexPoW = true;
+    BOOST_CHECK(!LoadIndex(db, GetBlockIndexPoWTrustedHeight(chainparams), 2,
+                           nLoaded));
+    fCheckBlockIndexPoW = DEFAULT_CHECKBLOCKINDEXPOW;
+}
+
+BOOST_AUTO_TEST_CASE(txdb_range_cursors_snapshot) {
+    CCoinsViewDB db(1 << 20, true);
+    const uint256 hashFirst = GetRandHash();
+    const uint256 hashSecond = GetRandHash();
+    CTxOut txout;
+    txout.nValue = 1 * COIN;
+
+    CCoinsViewCache cache(&db);
+    const COutPoint first(GetRandHash(), 0);
+    cache.AddCoin(first, Coin(txout, 1, false), false);
+    cache.SetBestBlock(hashFirst);
+    BOOST_REQUIRE(cache.Flush());
+
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors =
+        db.RangeCursors(4);
+    BOOST_REQUIRE_EQUAL(cursors.size(), 4U);
+
+    // A flush after the cursors are opened changes neither the best block
+    // they report nor the coins they see.
+    cache.AddCoin(COutPoint(GetRandHash(), 0), Coin(txout, 2, false), false);
+    cache.SetBestBlock(hashSecond);
+    BOOST_REQUIRE(cache.Flush());
+    BOOST_CHECK(db.GetBestBlock() == hashSecond);
+
+    size_t nCoins = 0;
+    for (const std::unique_ptr<CCoinsViewCursor> &cursor : cursors) {
+        BOOST_CHECK(cursor->GetBestBlock() == hashFirst);
+        for (; cursor->Valid(); cursor->Next()) {
+            COutPoint key;
+            BOOST_CHECK(cursor->GetKey(key));
+            BOOST_CHECK(key == first);
+            nCoins++;
+        }
+    }
+    BOOST_CHECK_EQUAL(nCoins, 1U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
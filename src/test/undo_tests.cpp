@@ -15,17 +15,19 @@ BOOST_FIXTURE_TEST_SUITE(undo_tests, BasicTestingSetup)
 
 static void UpdateUTXOSet(const CBlock &block, CCoinsViewCache &view,
                           CBlockUndo &blockundo,
-                          const CChainParams &chainparams, uint32_t nHeight) {
+                          const CChainParams &chainparams, uint32_t nHeight,
+                          CCoinsCommitment *pcommitment = nullptr) {
     CValidationState state;
 
     auto &coinbaseTx = *block.vtx[0];
-    UpdateCoins(coinbaseTx, view, nHeight);
+    CTxUndo undoDummy;
+    UpdateCoins(coinbaseTx, view, undoDummy, nHeight, pcommitment);
 
     for (size_t i = 1; i < block.vtx.size(); i++) {
         auto &tx = *block.vtx[1];
 
         blockundo.vtxundo.push_back(CTxUndo());
-        UpdateCoins(tx, view, blockundo.vtxundo.back(), nHeight);
+        UpdateCoins(tx, view, blockundo.vtxundo.back(), nHeight, pcommitment);
     }
 
     view.SetBestBlock(block.GetHash());
@@ -33,10 +35,11 @@ static void UpdateUTXOSet(const CBlock &block, CCoinsViewCache &view,
 
 static void UndoBlock(const CBlock &block, CCoinsViewCache &view,
                       const CBlockUndo &blockUndo,
-                      const CChainParams &chainparams, uint32_t nHeight) {
+                      const CChainParams &chainparams, uint32_t nHeight,
+                      CCoinsCommitment *pcommitment = nullptr) {
     CBlockIndex pindex;
     pindex.nHeight = nHeight;
-    ApplyBlockUndo(blockUndo, block, &pindex, view);
+    ApplyBlockUndo(blockUndo, block, &pindex, view, pcommitment);
 }
 
 static bool HasSpendableCoin(const CCoinsViewCache &view, const uint256 &txid) {
@@ -97,4 +100,140 @@ BOOST_AUTO_TEST_CASE(connect_utxo_extblock) {
     BOOST_CHECK(HasSpendableCoin(view, prevTx0.GetId()));
 }
 
+BOOST_AUTO_TEST_CASE(utxo_commitment) {
+    SelectParams(CBaseChainParams::MAIN);
+    const CChainParams &chainparams = Params();
+
+    CBlock block;
+    CMutableTransaction tx;
+
+    CCoinsView coinsDummy;
+    CCoinsViewCache view(&coinsDummy);
+
+    block.hashPrevBlock = GetRandHash();
+    view.SetBestBlock(block.hashPrevBlock);
+
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig.resize(10);
+    tx.vout.resize(2);
+    tx.vout[0].nValue = 42;
+    // Unspendable outputs never enter the UTXO set, nor the commitment.
+    tx.vout[1].nValue = 0;
+    tx.vout[1].scriptPubKey = CScript() << OP_RETURN;
+    auto coinbaseTx = CTransaction(tx);
+
+    block.vtx.resize(2);
+    block.vtx[0] = MakeTransactionRef(tx);
+
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 100;
+    tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    tx.vin[0].prevout.hash = GetRandHash();
+    tx.vin[0].prevout.n = 0;
+    tx.vin[0].scriptSig.resize(0);
+
+    auto prevTx0 = CTransaction(tx);
+    COutPoint prevOut(prevTx0.GetId(), 0);
+    AddCoins(view, prevTx0, 100);
+
+    CCoinsCommitment commitment;
+    commitment.Add(prevOut, view.AccessCoin(prevOut));
+    const uint256 hashBefore = commitment.GetHash();
+
+    tx.vin[0].prevout = prevOut;
+    tx.vout[0].nValue = 90;
+    auto tx0 = CTransaction(tx);
+    block.vtx[1] = MakeTransactionRef(tx0);
+
+    CBlockUndo blockundo;
+    CCoinsCommitment connectDelta;
+    UpdateUTXOSet(block, view, blockundo, chainparams, 123456,
+                  &connectDelta);
+    commitment.Combine(connectDelta);
+
+    // The updated commitment matches one built from the resulting set.
+    CCoinsCommitment expected;
+    COutPoint coinbaseOut(coinbaseTx.GetId(), 0);
+    COutPoint tx0Out(tx0.GetId(), 0);
+    expected.Add(tx0Out, view.AccessCoin(tx0Out));
+    expected.Add(coinbaseOut, view.AccessCoin(coinbaseOut));
+    BOOST_CHECK(commitment.GetHash() == expected.GetHash());
+    BOOST_CHECK_EQUAL(commitment.GetTransactionOutputs(), 2);
+    BOOST_CHECK(commitment.GetTotalAmount() == Amount(132));
+    BOOST_CHECK_EQUAL(connectDelta.GetTransactionOutputs(), 1);
+
+    CCoinsCommitment undoDelta;
+    UndoBlock(block, view, blockundo, chainparams, 123456, &undoDelta);
+    commitment.Combine(undoDelta);
+
+    BOOST_CHECK(commitment.GetHash() == hashBefore);
+    BOOST_CHECK_EQUAL(commitment.GetTransactionOutputs(), 1);
+    BOOST_CHECK(commitment.GetTotalAmount() == Amount(100));
+
+    // The commitment survives a round trip through serialization.
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << commitment;
+    CCoinsCommitment read;
+    ss >> read;
+    BOOST_CHECK(read.GetHash() == hashBefore);
+    BOOST_CHECK_EQUAL(read.GetTransactionOutputs(), 1);
+}
+
+static void CheckSameUndo(const CBlockUndo &a, const CBlockUndo &b) {
+    BOOST_REQUIRE_EQUAL(a.vtxundo.size(), b.vtxundo.size());
+    for (size_t i = 0; i < a.vtxundo.size(); i++) {
+        const std::vector<Coin> &va = a.vtxundo[i].vprevout;
+        const std::vector<Coin> &vb = b.vtxundo[i].vprevout;
+        BOOST_REQUIRE_EQUAL(va.size(), vb.size());
+        for (size_t j = 0; j < va.size(); j++) {
+            BOOST_CHECK_EQUAL(va[j].GetHeight(), vb[j].GetHeight());
+            BOOST_CHECK_EQUAL(va[j].IsCoinBase(), vb[j].IsCoinBase());
+            BOOST_CHECK(va[j].GetTxOut() == vb[j].GetTxOut());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(undo_format) {
+    CBlockUndo blockundo;
+    blockundo.vtxundo.resize(3);
+    CTxOut txout;
+    txout.scriptPubKey = CScript() << OP_TRUE;
+    for (uint32_t i = 0; i < 10; i++) {
+        txout.nValue = 1000 * i;
+        blockundo.vtxundo[i % 3].vprevout.emplace_back(txout, i * 1000,
+                                                       i % 2);
+    }
+
+    std::vector<uint8_t> vData;
+    SerializeBlockUndo(blockundo, vData);
+    BOOST_CHECK_EQUAL(vData.size(), GetBlockUndoSize(blockundo));
+    BOOST_CHECK_EQUAL(vData[0], UNDO_FORMAT_MARKER);
+    BOOST_CHECK_EQUAL(vData[1], UNDO_FORMAT_VERSION);
+
+    CBlockUndo read;
+    UnserializeBlockUndo(read, vData.data(), vData.data() + vData.size());
+    CheckSameUndo(blockundo, read);
+
+    // Undo data in the original format can still be read. The compact format
+    // saves a byte for every coin above height zero.
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << blockundo;
+    BOOST_CHECK_EQUAL(ss.size(), vData.size() - 2 + 9);
+    read.vtxundo.clear();
+    UnserializeBlockUndo(read, (const uint8_t *)ss.data(),
+                         (const uint8_t *)ss.data() + ss.size());
+    CheckSameUndo(blockundo, read);
+
+    // An unknown version or trailing data is rejected.
+    vData[1]++;
+    BOOST_CHECK_THROW(UnserializeBlockUndo(read, vData.data(),
+                                           vData.data() + vData.size()),
+                      std::ios_base::failure);
+    vData[1]--;
+    vData.push_back(0);
+    BOOST_CHECK_THROW(UnserializeBlockUndo(read, vData.data(),
+                                           vData.data() + vData.size()),
+                      std::ios_base::failure);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,227 @@
+// Copyright (c) 2018 The Title Network developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "utxosnapshot.h"
+
+#include "chainparams.h"
+#include "crypto/common.h"
+#include "random.h"
+
+#include "test/test_title.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+
+BOOST_FIXTURE_TEST_SUITE(utxosnapshot_tests, TestingSetup)
+
+static uint256 RandomHash(FastRandomContext &rng) {
+    uint256 hash;
+    for (int i = 0; i < 4; i++) {
+        WriteLE64(hash.begin() + 8 * i, rng.rand64());
+    }
+    return hash;
+}
+
+static SnapshotChunk RandomCoins(FastRandomContext &rng, size_t nCoins) {
+    SnapshotChunk vCoins;
+    for (size_t i = 0; i < nCoins; i++) {
+        CScript script;
+        script << std::vector<uint8_t>(rng.randrange(40), uint8_t(i));
+        Coin coin(CTxOut(Amount(int64_t(rng.randrange(50 * COIN.GetSatoshis()))),
+                         script),
+                  rng.randrange(1000), rng.randbits(1));
+        vCoins.emplace_back(COutPoint(RandomHash(rng), rng.randrange(10)),
+                            coin);
+    }
+    return vCoins;
+}
+
+static CSnapshotMetadata TestMetadata() {
+    CSnapshotMetadata metadata;
+    memcpy(metadata.pchMessageStart, Params().MessageStart(),
+           sizeof(metadata.pchMessageStart));
+    metadata.hashBlock = uint256S("0123456789abcdef");
+    metadata.nChainTx = 12345;
+    return metadata;
+}
+
+static void WriteSnapshot(const boost::filesystem::path &path,
+                          const SnapshotChunk &vCoins,
+                          const uint256 &hashUTXOSet) {
+    CSnapshotWriter writer(path, TestMetadata());
+    for (const auto &entry : vCoins) {
+        writer.Add(entry.first, entry.second);
+    }
+    BOOST_CHECK_EQUAL(writer.GetCoinsWritten(), vCoins.size());
+    writer.Finish(hashUTXOSet);
+}
+
+static void CheckSameCoins(const SnapshotChunk &a, const SnapshotChunk &b) {
+    BOOST_REQUIRE_EQUAL(a.size(), b.size());
+    for (size_t i = 0; i < a.size(); i++) {
+        BOOST_CHECK(a[i].first == b[i].first);
+        BOOST_CHECK(a[i].second.GetTxOut() == b[i].second.GetTxOut());
+        BOOST_CHECK_EQUAL(a[i].second.GetHeight(), b[i].second.GetHeight());
+        BOOST_CHECK_EQUAL(a[i].second.IsCoinBase(), b[i].second.IsCoinBase());
+    }
+}
+
+//! Read all coins, returning false if the file is rejected.
+static bool ReadAll(const boost::filesystem::path &path,
+                    SnapshotChunk &vCoins) {
+    vCoins.clear();
+    try {
+        CSnapshotReader reader(path);
+        SnapshotChunk vChunk;
+        while (reader.ReadChunk(vChunk)) {
+            vCoins.insert(vCoins.end(), vChunk.begin(), vChunk.end());
+        }
+    } catch (const std::ios_base::failure &) {
+        return false;
+    }
+    return true;
+}
+
+// The roundtrip, corruption and unfinished cases also cover CChunkedFileWriter
+// and CChunkedFileReader, which mempool.dat is written and read with as well.
+BOOST_AUTO_TEST_CASE(utxosnapshot_roundtrip) {
+    FastRandomContext rng(true);
+    SnapshotChunk vCoins = RandomCoins(rng, 2 * SNAPSHOT_CHUNK_COINS + 10);
+    const uint256 hashUTXOSet = RandomHash(rng);
+    boost::filesystem::path path = pathTemp / "utxo.dat";
+    WriteSnapshot(path, vCoins, hashUTXOSet);
+    BOOST_CHECK(!boost::filesystem::exists(pathTemp / "utxo.dat.incomplete"));
+
+    CSnapshotReader reader(path);
+    const CSnapshotMetadata &metadata = reader.GetMetadata();
+    BOOST_CHECK(metadata.nVersion == CSnapshotMetadata::CURRENT_VERSION);
+    BOOST_CHECK(memcmp(metadata.pchMessageStart, Params().MessageStart(),
+                       sizeof(metadata.pchMessageStart)) == 0);
+    BOOST_CHECK(metadata.hashBlock == TestMetadata().hashBlock);
+    BOOST_CHECK_EQUAL(metadata.nChainTx, 12345);
+
+    // Full chunks, then the rest.
+    SnapshotChunk vChunk;
+    SnapshotChunk vRead;
+    std::vector<size_t> vSizes;
+    while (reader.ReadChunk(vChunk)) {
+        vSizes.push_back(vChunk.size());
+        vRead.insert(vRead.end(), vChunk.begin(), vChunk.end());
+    }
+    BOOST_CHECK(vChunk.empty());
+    BOOST_REQUIRE_EQUAL(vSizes.size(), 3U);
+    BOOST_CHECK_EQUAL(vSizes[0], SNAPSHOT_CHUNK_COINS);
+    BOOST_CHECK_EQUAL(vSizes[1], SNAPSHOT_CHUNK_COINS);
+    BOOST_CHECK_EQUAL(vSizes[2], 10U);
+    CheckSameCoins(vRead, vCoins);
+    BOOST_CHECK(reader.GetUTXOSetHash() == hashUTXOSet);
+    BOOST_CHECK_EQUAL(reader.GetCoinsRead(), vCoins.size());
+    // Reading past the end keeps returning false.
+    BOOST_CHECK(!reader.ReadChunk(vChunk));
+
+    // Rewinding starts over with the same checksums.
+    const uint256 hashChecksum = reader.GetChecksum();
+    reader.Rewind();
+    BOOST_CHECK_EQUAL(reader.GetCoinsRead(), 0U);
+    BOOST_REQUIRE(reader.ReadChunk(vChunk));
+    CheckSameCoins(vChunk, SnapshotChunk(vCoins.begin(),
+                                         vCoins.begin() + SNAPSHOT_CHUNK_COINS));
+    while (reader.ReadChunk(vChunk)) {
+    }
+    BOOST_CHECK(reader.GetChecksum() == hashChecksum);
+
+    // An empty set is a valid snapshot too.
+    boost::filesystem::path pathEmpty = pathTemp / "empty.dat";
+    WriteSnapshot(pathEmpty, SnapshotChunk(), hashUTXOSet);
+    BOOST_CHECK(ReadAll(pathEmpty, vRead));
+    BOOST_CHECK(vRead.empty());
+}
+
+BOOST_AUTO_TEST_CASE(utxosnapshot_corruption) {
+    FastRandomContext rng(true);
+    SnapshotChunk vCoins = RandomCoins(rng, 100);
+    boost::filesystem::path path = pathTemp / "utxo.dat";
+    WriteSnapshot(path, vCoins, uint256());
+    SnapshotChunk vRead;
+    BOOST_CHECK(ReadAll(path, vRead));
+    CheckSameCoins(vRead, vCoins);
+
+    std::vector<char> vData(boost::filesystem::file_size(path));
+    FILE *file = fopen(path.string().c_str(), "rb");
+    BOOST_REQUIRE(file != nullptr);
+    BOOST_REQUIRE_EQUAL(fread(vData.data(), 1, vData.size(), file),
+                        vData.size());
+    fclose(file);
+    auto writeData = [&](const std::vector<char> &vNew) {
+        FILE *out = fopen(path.string().c_str(), "wb");
+        BOOST_REQUIRE(out != nullptr);
+        BOOST_REQUIRE_EQUAL(fwrite(vNew.data(), 1, vNew.size(), out),
+                            vNew.size());
+        fclose(out);
+    };
+
+    // Any flipped bit past the magic and version is caught by a checksum, or
+    // by the checks on the header.
+    for (size_t nPos = 7; nPos < vData.size(); nPos += 97) {
+        std::vector<char> vCorrupt(vData);
+        vCorrupt[nPos] ^= 0x10;
+        writeData(vCorrupt);
+        BOOST_CHECK(!ReadAll(path, vRead));
+    }
+
+    // So is a truncated file.
+    writeData(std::vector<char>(vData.begin(), vData.end() - 40));
+    BOOST_CHECK(!ReadAll(path, vRead));
+
+    // And a file that is not a snapshot at all.
+    std::vector<char> vBadMagic(vData);
+    vBadMagic[0] = 'x';
+    writeData(vBadMagic);
+    BOOST_CHECK(!ReadAll(path, vRead));
+
+    writeData(vData);
+    BOOST_CHECK(ReadAll(path, vRead));
+}
+
+BOOST_AUTO_TEST_CASE(utxosnapshot_unfinished) {
+    FastRandomContext rng(true);
+    SnapshotChunk vCoins = RandomCoins(rng, 100);
+    boost::filesystem::path path = pathTemp / "utxo.dat";
+    {
+        CSnapshotWriter writer(path, TestMetadata());
+        for (const auto &entry : vCoins) {
+            writer.Add(entry.first, entry.second);
+        }
+    }
+    // Nothing is left behind by a writer that was not finished.
+    BOOST_CHECK(!boost::filesystem::exists(path));
+    BOOST_CHECK(!boost::filesystem::exists(pathTemp / "utxo.dat.incomplete"));
+}
+
+BOOST_AUTO_TEST_CASE(utxosnapshot_commitment) {
+    FastRandomContext rng(true);
+    SnapshotChunk vCoins = RandomCoins(rng, 5000);
+    CCoinsCommitment expected;
+    for (const auto &entry : vCoins) {
+        expected.Add(entry.first, entry.second);
+    }
+
+    for (int nThreads : {1, 3, 8}) {
+        CCoinsCommitment commitment;
+        AddSnapshotChunk(commitment, SnapshotChunk(vCoins.begin(),
+                                                   vCoins.begin() + 2000),
+                         nThreads);
+        AddSnapshotChunk(commitment,
+                         SnapshotChunk(vCoins.begin() + 2000, vCoins.end()),
+                         nThreads);
+        BOOST_CHECK(commitment.GetHash() == expected.GetHash());
+        BOOST_CHECK_EQUAL(commitment.GetTransactionOutputs(),
+                          expected.GetTransactionOutputs());
+        BOOST_CHECK(commitment.GetTotalAmount() == expected.GetTotalAmount());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
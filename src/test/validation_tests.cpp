@@ -7,7 +7,13 @@
 #include "chainparams.h"
 #include "config.h"
 #include "consensus/consensus.h"
+#include "consensus/merkle.h"
+#include "key.h"
+#include "pow.h"
+#include "policy/policy.h"
 #include "primitives/transaction.h"
+#include "random.h"
+#include "txmempool.h"
 #include "test/test_title.h"
 #include "util.h"
 
@@ -76,4 +82,298 @@ BOOST_AUTO_TEST_CASE(validation_load_external_block_file) {
     BOOST_CHECK_NO_THROW({ LoadExternalBlockFile(config, fp, 0); });
 }
 
+BOOST_AUTO_TEST_CASE(validation_prefetch_coins) {
+    CTxOut txout;
+    txout.nValue = 50 * COIN;
+    const COutPoint outpoint(GetRandHash(), 0);
+    {
+        LOCK(cs_main);
+        pcoinsTip->AddCoin(outpoint, Coin(txout, 1, false), false);
+    }
+    // Get the coin out of the cache and onto disk.
+    FlushStateToDisk();
+
+    CMutableTransaction spend;
+    spend.vin.resize(2);
+    spend.vin[0].prevout = outpoint;
+    // Not in the UTXO set.
+    spend.vin[1].prevout = COutPoint(GetRandHash(), 0);
+    spend.vout.resize(1);
+    std::vector<CTransactionRef> vtx{MakeTransactionRef(spend)};
+
+    std::vector<COutPoint> vAdded;
+    PrefetchCoins(vtx, vAdded);
+    BOOST_CHECK_EQUAL(vAdded.size(), 1U);
+    BOOST_CHECK(vAdded[0] == outpoint);
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(pcoinsTip->HaveCoinInCache(outpoint));
+        BOOST_CHECK(!pcoinsTip->HaveCoinInCache(spend.vin[1].prevout));
+        BOOST_CHECK(pcoinsTip->AccessCoin(outpoint).GetTxOut() == txout);
+    }
+
+    // Coins already in the cache are not read again.
+    vAdded.clear();
+    PrefetchCoins(vtx, vAdded);
+    BOOST_CHECK(vAdded.empty());
+}
+
+BOOST_AUTO_TEST_CASE(validation_prefetch_next_block) {
+    CTxOut txout;
+    txout.nValue = 50 * COIN;
+    const COutPoint outpoint(GetRandHash(), 0);
+    {
+        LOCK(cs_main);
+        pcoinsTip->AddCoin(outpoint, Coin(txout, 1, false), false);
+    }
+    FlushStateToDisk();
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vout.resize(1);
+    CMutableTransaction spend;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = outpoint;
+    spend.vout.resize(1);
+    CBlock block;
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+    block.vtx.push_back(MakeTransactionRef(spend));
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    const uint256 hash = block.GetHash();
+    // The block is not on disk.
+    CBlockIndex index(block);
+    index.phashBlock = &hash;
+
+    LOCK(cs_main);
+    // Some other block in memory does not stand in for it.
+    CBlock other;
+    other.vtx.push_back(MakeTransactionRef(coinbase));
+    other.hashMerkleRoot = BlockMerkleRoot(other);
+    PrefetchNextBlock(&index, std::make_shared<const CBlock>(other),
+                      Params().GetConsensus());
+    BOOST_CHECK(!pcoinsTip->HaveCoinInCache(outpoint));
+
+    // The block itself does, and the coins it spends are then in the cache.
+    PrefetchNextBlock(&index, std::make_shared<const CBlock>(block),
+                      Params().GetConsensus());
+    BOOST_CHECK(pcoinsTip->HaveCoinInCache(outpoint));
+    BOOST_CHECK(pcoinsTip->AccessCoin(outpoint).GetTxOut() == txout);
+}
+
+/**
+ * Build nCount headers on top of pindexPrev, each with a nonce that makes its
+ * proof of work pass, except for the header at nBad.
+ */
+static std::vector<CBlockHeader> MineHeaders(const CBlockIndex *pindexPrev,
+                                             size_t nCount, size_t nBad) {
+    const Consensus::Params &params = Params().GetConsensus();
+    std::vector<CBlockHeader> headers;
+    uint256 hashPrev = pindexPrev->GetBlockHash();
+    // Regtest keeps the same target for its first blocks.
+    CBlockHeader dummy;
+    const uint32_t nBits = GetNextWorkRequired(pindexPrev, &dummy, params);
+    for (size_t i = 0; i < nCount; i++) {
+        CBlockHeader header;
+        header.nVersion = 4;
+        header.hashPrevBlock = hashPrev;
+        header.hashMerkleRoot = GetRandHash();
+        header.nTime = pindexPrev->GetBlockTime() + 60 * (i + 1);
+        header.nBits = nBits;
+        const int nHeight = pindexPrev->nHeight + 1 + i;
+        while (CheckProofOfWork(header.GetPoWHash(nHeight), header.nBits,
+                                params) == (i == nBad)) {
+            header.nNonce++;
+        }
+        headers.push_back(header);
+        hashPrev = header.GetHash();
+    }
+    return headers;
+}
+
+BOOST_FIXTURE_TEST_CASE(validation_headers_pow, RegTestingSetup) {
+    const CBlockIndex *pindexTip;
+    {
+        LOCK(cs_main);
+        pindexTip = chainActive.Tip();
+    }
+
+    // Enough headers for several runs on the header check threads.
+    std::vector<CBlockHeader> headers = MineHeaders(pindexTip, 40, 40);
+    CValidationState state;
+    const CBlockIndex *pindex = nullptr;
+    BOOST_CHECK(ProcessNewBlockHeaders(GetConfig(), headers, state, &pindex));
+    BOOST_CHECK(state.IsValid());
+    BOOST_REQUIRE(pindex != nullptr);
+    BOOST_CHECK(pindex->GetBlockHash() == headers.back().GetHash());
+    BOOST_CHECK_EQUAL(pindex->nHeight, pindexTip->nHeight + 40);
+
+    // One bad header rejects the batch. The headers before it are accepted,
+    // and neither it nor those after it are.
+    headers = MineHeaders(pindex, 40, 25);
+    pindex = nullptr;
+    BOOST_CHECK(!ProcessNewBlockHeaders(GetConfig(), headers, state, &pindex));
+    int nDoS = 0;
+    BOOST_CHECK(state.IsInvalid(nDoS));
+    BOOST_CHECK_EQUAL(nDoS, 50);
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "high-hash");
+    BOOST_REQUIRE(pindex != nullptr);
+    BOOST_CHECK(pindex->GetBlockHash() == headers[24].GetHash());
+    {
+        LOCK(cs_main);
+        for (size_t i = 0; i < headers.size(); i++) {
+            BOOST_CHECK_EQUAL(mapBlockIndex.count(headers[i].GetHash()),
+                              i < 25 ? 1U : 0U);
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(validation_accept_parallel, RegTestingSetup) {
+    CKey key, keyOther;
+    key.MakeNewKey(true);
+    keyOther.MakeNewKey(true);
+    CScript scriptPubKey = CScript() << ToByteVector(key.GetPubKey())
+                                     << OP_CHECKSIG;
+
+    std::vector<COutPoint> vOutpoints;
+    {
+        LOCK(cs_main);
+        for (int i = 0; i < 17; i++) {
+            vOutpoints.emplace_back(GetRandHash(), 0);
+            pcoinsTip->AddCoin(vOutpoints.back(),
+                               Coin(CTxOut(COIN, scriptPubKey), 1, false),
+                               false);
+        }
+    }
+
+    std::vector<CTransactionRef> vtx;
+    for (int i = 0; i < 16; i++) {
+        vtx.push_back(
+            CreateSpend(key, vOutpoints[i], COIN, scriptPubKey, 10000));
+    }
+    CTransactionRef child =
+        CreateSpend(key, COutPoint(vtx[0]->GetId(), 0),
+                    vtx[0]->vout[0].nValue, scriptPubKey, 10000);
+    CTransactionRef grandchild =
+        CreateSpend(key, COutPoint(child->GetId(), 0), child->vout[0].nValue,
+                    scriptPubKey, 10000);
+    CTransactionRef doubleSpend =
+        CreateSpend(key, vOutpoints[1], COIN, scriptPubKey, 20000);
+    CTransactionRef badSig =
+        CreateSpend(keyOther, vOutpoints[16], COIN, scriptPubKey, 10000);
+    CTransactionRef orphan = CreateSpend(key, COutPoint(GetRandHash(), 0),
+                                         COIN, scriptPubKey, 10000);
+
+    // Descendants come before their ancestors, and so need later rounds.
+    std::vector<MempoolSubmission> vSubmissions;
+    vSubmissions.emplace_back(grandchild);
+    vSubmissions.emplace_back(child);
+    for (const CTransactionRef &tx : vtx) {
+        vSubmissions.emplace_back(tx);
+    }
+    vSubmissions.emplace_back(doubleSpend);
+    vSubmissions.emplace_back(badSig);
+    vSubmissions.emplace_back(orphan);
+    vSubmissions.emplace_back(vtx[2]);
+
+    AcceptToMemoryPoolParallel(GetConfig(), mempool, vSubmissions, false);
+
+    for (size_t i = 0; i < 18; i++) {
+        BOOST_CHECK(vSubmissions[i].fAccepted);
+        BOOST_CHECK(vSubmissions[i].state.IsValid());
+        BOOST_CHECK(mempool.exists(vSubmissions[i].tx->GetId()));
+    }
+    BOOST_CHECK_EQUAL(mempool.size(), 18U);
+
+    BOOST_CHECK(!vSubmissions[18].fAccepted);
+    BOOST_CHECK_EQUAL(vSubmissions[18].state.GetRejectReason(),
+                      "txn-mempool-conflict");
+
+    int nDoS = 0;
+    BOOST_CHECK(!vSubmissions[19].fAccepted);
+    BOOST_CHECK(vSubmissions[19].state.IsInvalid(nDoS));
+    BOOST_CHECK_EQUAL(nDoS, 100);
+
+    BOOST_CHECK(!vSubmissions[20].fAccepted);
+    BOOST_CHECK(vSubmissions[20].fMissingInputs);
+    BOOST_CHECK(vSubmissions[20].state.IsValid());
+
+    BOOST_CHECK(!vSubmissions[21].fAccepted);
+    BOOST_CHECK_EQUAL(vSubmissions[21].state.GetRejectReason(),
+                      "txn-already-in-mempool");
+
+    // Nothing is accepted twice, and what was refused stays out.
+    AcceptToMemoryPoolParallel(GetConfig(), mempool, vSubmissions, false);
+    for (const MempoolSubmission &sub : vSubmissions) {
+        BOOST_CHECK(!sub.fAccepted);
+    }
+    BOOST_CHECK_EQUAL(mempool.size(), 18U);
+
+    mempool.clear();
+}
+
+BOOST_FIXTURE_TEST_CASE(validation_accept_batch, RegTestingSetup) {
+    CKey key;
+    key.MakeNewKey(true);
+    CScript scriptPubKey = CScript() << ToByteVector(key.GetPubKey())
+                                     << OP_CHECKSIG;
+
+    std::vector<COutPoint> vOutpoints;
+    {
+        LOCK(cs_main);
+        for (int i = 0; i < 2; i++) {
+            vOutpoints.emplace_back(GetRandHash(), 0);
+            pcoinsTip->AddCoin(vOutpoints.back(),
+                               Coin(CTxOut(COIN, scriptPubKey), 1, false),
+                               false);
+        }
+    }
+
+    CTransactionRef parent =
+        CreateSpend(key, vOutpoints[0], COIN, scriptPubKey, 10000);
+    CTransactionRef child =
+        CreateSpend(key, COutPoint(parent->GetId(), 0),
+                    parent->vout[0].nValue, scriptPubKey, 10000);
+    CTransactionRef grandchild =
+        CreateSpend(key, COutPoint(child->GetId(), 0), child->vout[0].nValue,
+                    scriptPubKey, 10000);
+    CTransactionRef highFee =
+        CreateSpend(key, vOutpoints[1], COIN, scriptPubKey, COIN / 2);
+
+    // Sorted, the chain goes in one level at a time, so the children are not
+    // left missing inputs.
+    std::vector<MempoolSubmission> vSubmissions;
+    vSubmissions.emplace_back(grandchild);
+    vSubmissions.emplace_back(highFee);
+    vSubmissions.emplace_back(child);
+    vSubmissions.emplace_back(parent);
+    AcceptToMemoryPoolBatch(GetConfig(), mempool, vSubmissions, false,
+                            COIN / 10);
+
+    for (size_t i : {0, 2, 3}) {
+        BOOST_CHECK(vSubmissions[i].fAccepted);
+        BOOST_CHECK(!vSubmissions[i].fMissingInputs);
+        BOOST_CHECK(mempool.exists(vSubmissions[i].tx->GetId()));
+    }
+    BOOST_CHECK(!vSubmissions[1].fAccepted);
+    BOOST_CHECK_EQUAL(vSubmissions[1].state.GetRejectReason(),
+                      "absurdly-high-fee");
+    BOOST_CHECK_EQUAL(mempool.size(), 3U);
+
+    // What the single trim at the end evicts is reported as not accepted.
+    mempool.clear();
+    gArgs.ForceSetArg("-maxmempool", "0");
+    vSubmissions.clear();
+    vSubmissions.emplace_back(child);
+    vSubmissions.emplace_back(parent);
+    AcceptToMemoryPoolBatch(GetConfig(), mempool, vSubmissions, false);
+    for (const MempoolSubmission &sub : vSubmissions) {
+        BOOST_CHECK(!sub.fAccepted);
+        BOOST_CHECK_EQUAL(sub.state.GetRejectReason(), "mempool full");
+    }
+    BOOST_CHECK_EQUAL(mempool.size(), 0U);
+
+    gArgs.ForceSetArg("-maxmempool", std::to_string(DEFAULT_MAX_MEMPOOL_SIZE));
+    mempool.clear();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -7,10 +7,15 @@
 
 #include "chainparams.h"
 #include "hash.h"
+#include "memusage.h"
 #include "pow.h"
 #include "uint256.h"
+#include "util.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <thread>
 
 #include <boost/thread.hpp>
 
@@ -21,9 +26,12 @@ static const char DB_TXINDEX = 't';
 static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_BEST_BLOCK = 'B';
+static const char DB_COINS_COMMITMENT = 'M';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_SNAPSHOT_BASE = 'S';
+static const char DB_SNAPSHOT_LOADING = 'L';
 
 namespace {
 
@@ -48,7 +56,8 @@ struct CoinEntry {
 }
 
 CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe)
-    : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) {}
+    : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true,
+         GetDBOptions("chainstate")) {}
 
 bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
     return db.Read(CoinEntry(&outpoint), coin);
@@ -64,11 +73,35 @@ uint256 CCoinsViewDB::GetBestBlock() const {
     return hashBestChain;
 }
 
+void CCoinsViewDB::SetCommitment(const uint256 &hashBlock,
+                                 const CCoinsCommitment &commitmentIn) {
+    hashCommitment = hashBlock;
+    commitment = commitmentIn;
+}
+
+bool CCoinsViewDB::GetCommitment(CCoinsCommitment &commitmentOut) const {
+    std::pair<uint256, CCoinsCommitment> stored;
+    if (!db.Read(DB_COINS_COMMITMENT, stored) ||
+        stored.first != GetBestBlock()) {
+        return false;
+    }
+    commitmentOut = stored.second;
+    return true;
+}
+
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    bool ret = BatchWriteSnapshot(mapCoins, hashBlock);
+    mapCoins.clear();
+    return ret;
+}
+
+bool CCoinsViewDB::BatchWriteSnapshot(const CCoinsMap &mapCoins,
+                                      const uint256 &hashBlock) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end();
+         ++it) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
             CoinEntry entry(&it->first);
             if (it->second.coin.IsSpent()) {
@@ -79,11 +112,17 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
     }
     if (!hashBlock.IsNull()) {
         batch.Write(DB_BEST_BLOCK, hashBlock);
+        // Keep the commitment in step with the best block, or drop it so
+        // that a stale one is never mistaken for the current one.
+        if (hashBlock == hashCommitment) {
+            batch.Write(DB_COINS_COMMITMENT,
+                        std::make_pair(hashCommitment, commitment));
+        } else {
+            batch.Erase(DB_COINS_COMMITMENT);
+        }
     }
 
     bool ret = db.WriteBatch(batch);
@@ -93,13 +132,219 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     return ret;
 }
 
+bool CCoinsViewDB::WriteSnapshotCoins(
+    const uint256 &hashBlock, std::vector<std::pair<COutPoint, Coin>> &vCoins) {
+    // Snapshots are dumped in key order, so this rarely has to sort. Keys
+    // that arrive in order make for cheaper memtable inserts and compactions.
+    auto keyOrder = [](const std::pair<COutPoint, Coin> &a,
+                       const std::pair<COutPoint, Coin> &b) {
+        return a.first < b.first;
+    };
+    if (!std::is_sorted(vCoins.begin(), vCoins.end(), keyOrder)) {
+        std::sort(vCoins.begin(), vCoins.end(), keyOrder);
+    }
+
+    CDBBatch batch(db);
+    batch.Write(DB_SNAPSHOT_LOADING, hashBlock);
+    for (const auto &entry : vCoins) {
+        batch.Write(CoinEntry(&entry.first), entry.second);
+    }
+    bool ret = db.WriteBatch(batch);
+    LogPrint(BCLog::COINDB, "Wrote %u snapshot transaction outputs to coin "
+                            "database...\n",
+             (unsigned int)vCoins.size());
+    return ret;
+}
+
+bool CCoinsViewDB::FinishSnapshot(const uint256 &hashBlock,
+                                  const CCoinsCommitment &commitmentIn) {
+    CDBBatch batch(db);
+    batch.Write(DB_BEST_BLOCK, hashBlock);
+    batch.Write(DB_COINS_COMMITMENT, std::make_pair(hashBlock, commitmentIn));
+    batch.Erase(DB_SNAPSHOT_LOADING);
+    return db.WriteBatch(batch, true);
+}
+
+bool CCoinsViewDB::IsLoadingSnapshot() const {
+    return db.Exists(DB_SNAPSHOT_LOADING);
+}
+
 size_t CCoinsViewDB::EstimateSize() const {
     return db.EstimateSize(DB_COIN, char(DB_COIN + 1));
 }
 
+CCoinsViewBackgroundFlush::CCoinsViewBackgroundFlush(CCoinsView *viewIn)
+    : CCoinsViewBacked(viewIn), nPendingUsage(0), nWrites(0), fFailed(false),
+      fStop(false) {
+    thread = std::thread([this]() {
+        RenameThread("bitcoin-coinsflush");
+        ThreadFlush();
+    });
+}
+
+CCoinsViewBackgroundFlush::~CCoinsViewBackgroundFlush() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fStop = true;
+    }
+    cond.notify_all();
+    // The thread writes out what is pending before it exits.
+    thread.join();
+}
+
+void CCoinsViewBackgroundFlush::ThreadFlush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        cond.wait(lock, [this]() { return (pending && !fFailed) || fStop; });
+        if (!pending || fFailed) {
+            return;
+        }
+        // Only BatchWrite replaces pending, and it waits for us first, so the
+        // batch can be read without the lock, alongside GetCoin.
+        lock.unlock();
+        int64_t nStart = GetTimeMicros();
+        bool fOk;
+        try {
+            fOk = base->BatchWriteSnapshot(*pending, hashPending);
+        } catch (const std::exception &e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+            fOk = false;
+        }
+        LogPrint(BCLog::BENCH, "    - Background coins flush: %.2fms\n",
+                 (GetTimeMicros() - nStart) * 0.001);
+        std::unique_ptr<CCoinsMap> written;
+        lock.lock();
+        if (fOk) {
+            written.swap(pending);
+            nPendingUsage = 0;
+        } else {
+            LogPrintf("%s: failed to write to coin database\n", __func__);
+            fFailed = true;
+        }
+        cond.notify_all();
+        // Free the batch without holding up readers.
+        lock.unlock();
+        written.reset();
+        lock.lock();
+    }
+}
+
+void CCoinsViewBackgroundFlush::WaitForPending(
+    std::unique_lock<std::mutex> &lock) const {
+    cond.wait(lock, [this]() { return !pending || fFailed; });
+}
+
+bool CCoinsViewBackgroundFlush::GetCoin(const COutPoint &outpoint,
+                                        Coin &coin) const {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending) {
+            CCoinsMap::const_iterator it = pending->find(outpoint);
+            if (it != pending->end()) {
+                if (it->second.coin.IsSpent()) {
+                    return false;
+                }
+                coin = it->second.coin;
+                return true;
+            }
+        }
+    }
+    return base->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewBackgroundFlush::HaveCoin(const COutPoint &outpoint) const {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending) {
+            CCoinsMap::const_iterator it = pending->find(outpoint);
+            if (it != pending->end()) {
+                return !it->second.coin.IsSpent();
+            }
+        }
+    }
+    return base->HaveCoin(outpoint);
+}
+
+uint256 CCoinsViewBackgroundFlush::GetBestBlock() const {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending && !hashPending.IsNull()) {
+            return hashPending;
+        }
+    }
+    return base->GetBestBlock();
+}
+
+bool CCoinsViewBackgroundFlush::BatchWrite(CCoinsMap &mapCoins,
+                                           const uint256 &hashBlock) {
+    std::unique_lock<std::mutex> lock(mutex);
+    WaitForPending(lock);
+    if (fFailed) {
+        return false;
+    }
+    pending.reset(new CCoinsMap(std::move(mapCoins)));
+    hashPending = hashBlock;
+    nWrites++;
+    nPendingUsage = memusage::DynamicUsage(*pending);
+    cond.notify_all();
+    return true;
+}
+
+bool CCoinsViewBackgroundFlush::BatchWriteSnapshot(const CCoinsMap &mapCoins,
+                                                   const uint256 &hashBlock) {
+    if (!Sync()) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        nWrites++;
+    }
+    return base->BatchWriteSnapshot(mapCoins, hashBlock);
+}
+
+CCoinsViewCursor *CCoinsViewBackgroundFlush::Cursor() const {
+    Sync();
+    return base->Cursor();
+}
+
+std::vector<std::unique_ptr<CCoinsViewCursor>>
+CCoinsViewBackgroundFlush::RangeCursors(size_t nRanges) const {
+    Sync();
+    return base->RangeCursors(nRanges);
+}
+
+void CCoinsViewBackgroundFlush::SetCommitment(
+    const uint256 &hashBlock, const CCoinsCommitment &commitment) {
+    // The batch being written carries the commitment staged before it.
+    std::unique_lock<std::mutex> lock(mutex);
+    WaitForPending(lock);
+    base->SetCommitment(hashBlock, commitment);
+}
+
+bool CCoinsViewBackgroundFlush::GetCommitment(
+    CCoinsCommitment &commitment) const {
+    return Sync() && base->GetCommitment(commitment);
+}
+
+bool CCoinsViewBackgroundFlush::Sync() const {
+    std::unique_lock<std::mutex> lock(mutex);
+    WaitForPending(lock);
+    return !fFailed;
+}
+
+size_t CCoinsViewBackgroundFlush::PendingMemoryUsage() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return nPendingUsage;
+}
+
+uint64_t CCoinsViewBackgroundFlush::GetWriteCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return nWrites;
+}
+
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe)
     : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory,
-                 fWipe) {}
+                 fWipe, false, ::GetDBOptions("blockindex")) {}
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
     return Read(std::make_pair(DB_BLOCK_FILES, nFile), info);
@@ -131,17 +376,41 @@ CCoinsViewCursor *CCoinsViewDB::Cursor() const {
      */
     i->pcursor->Seek(DB_COIN);
     // Cache key of first record
-    if (i->pcursor->Valid()) {
-        CoinEntry entry(&i->keyTmp.second);
-        i->pcursor->GetKey(entry);
-        i->keyTmp.first = entry.key;
-    } else {
-        // Make sure Valid() and GetKey() return false
-        i->keyTmp.first = 0;
-    }
+    i->CacheKey();
     return i;
 }
 
+std::vector<std::unique_ptr<CCoinsViewCursor>>
+CCoinsViewDB::RangeCursors(size_t nRanges) const {
+    // Split on the first byte of the txid, which is the first byte of the key
+    // after its prefix, so that all outputs of a transaction stay together.
+    nRanges = std::max<size_t>(1, std::min<size_t>(nRanges, 256));
+    CDBWrapper &dbw = const_cast<CDBWrapper &>(db);
+    std::shared_ptr<const leveldb::Snapshot> snapshot = dbw.GetSnapshot();
+    // Read the best block through the snapshot too, so that it is the one the
+    // coins the cursors see belong to, even if a flush lands in between.
+    uint256 hashBestBlock;
+    if (!db.Read(DB_BEST_BLOCK, hashBestBlock, snapshot.get())) {
+        hashBestBlock.SetNull();
+    }
+
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
+    for (size_t n = 0; n < nRanges; n++) {
+        int nBeginByte = 256 * n / nRanges;
+        int nEndByte = 256 * (n + 1) / nRanges;
+        CCoinsViewDBCursor *i =
+            new CCoinsViewDBCursor(dbw.NewIterator(snapshot.get()),
+                                   hashBestBlock, snapshot, nEndByte);
+        cursors.emplace_back(i);
+
+        COutPoint start(uint256(), 0);
+        *start.hash.begin() = nBeginByte;
+        i->pcursor->Seek(CoinEntry(&start));
+        i->CacheKey();
+    }
+    return cursors;
+}
+
 bool CCoinsViewDBCursor::GetKey(COutPoint &key) const {
     // Return cached key
     if (keyTmp.first == DB_COIN) {
@@ -165,8 +434,13 @@ bool CCoinsViewDBCursor::Valid() const {
 
 void CCoinsViewDBCursor::Next() {
     pcursor->Next();
+    CacheKey();
+}
+
+void CCoinsViewDBCursor::CacheKey() {
     CoinEntry entry(&keyTmp.second);
-    if (!pcursor->Valid() || !pcursor->GetKey(entry)) {
+    if (!pcursor->Valid() || !pcursor->GetKey(entry) ||
+        (entry.key == DB_COIN && *keyTmp.second.hash.begin() >= nEndByte)) {
         // Invalidate cached key after last record so that Valid() and GetKey()
         // return false
         keyTmp.first = 0;
@@ -219,27 +493,163 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts(
-    std::function<CBlockIndex *(const uint256 &)> insertBlockIndex) {
-    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+bool CBlockTreeDB::WriteSnapshotBase(const uint256 &hash) {
+    return Write(DB_SNAPSHOT_BASE, hash, true);
+}
 
-    pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256()));
+bool CBlockTreeDB::ReadSnapshotBase(uint256 &hash) {
+    return Read(DB_SNAPSHOT_BASE, hash);
+}
 
-    // Load mapBlockIndex
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char, uint256> key;
-        if (!pcursor->GetKey(key) || key.first != DB_BLOCK_INDEX) {
-            break;
+namespace {
+
+/** Block index entries decoded from one slice of the DB_BLOCK_INDEX keys. */
+struct BlockIndexSlice {
+    std::vector<CDiskBlockIndex> entries;
+    std::vector<uint256> hashes;
+    int nPoWChecked = 0;
+    std::string strError;
+};
+
+//! Number of headers hashed per GetPoWHashes call while loading.
+const size_t BLOCK_INDEX_POW_BATCH = 1024;
+
+bool CheckBlockIndexPoW(BlockIndexSlice &slice,
+                        const std::vector<size_t> &vIndex) {
+    std::vector<CBlockHeader> headers;
+    std::vector<int> heights;
+    headers.reserve(vIndex.size());
+    heights.reserve(vIndex.size());
+    for (size_t i : vIndex) {
+        headers.push_back(slice.entries[i].GetBlockHeader());
+        heights.push_back(slice.entries[i].nHeight);
+    }
+
+    std::vector<uint256> powHashes =
+        CBlockHeader::GetPoWHashes(headers, heights);
+    for (size_t i = 0; i < vIndex.size(); i++) {
+        const CDiskBlockIndex &diskindex = slice.entries[vIndex[i]];
+        if (!CheckProofOfWork(powHashes[i], diskindex.nBits,
+                              Params().GetConsensus())) {
+            // The entry is not in the index yet and has no phashBlock, so
+            // its ToString cannot be used.
+            slice.strError = strprintf(
+                "CheckProofOfWork failed: block %s at height %d",
+                slice.hashes[vIndex[i]].ToString(), diskindex.nHeight);
+            return false;
         }
+    }
+    slice.nPoWChecked += vIndex.size();
+    return true;
+}
+
+/**
+ * Decode the block index entries whose hash starts with a byte in
+ * [nBegin, nEnd), computing their hashes and checking proof of work for those
+ * above nPoWTrustedHeight. Stops early once fAbort is set by another slice.
+ */
+void LoadBlockIndexSlice(CBlockTreeDB &db, int nBegin, int nEnd,
+                         int nPoWTrustedHeight, BlockIndexSlice &slice,
+                         std::atomic<bool> &fAbort) {
+    try {
+        std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+        uint256 start;
+        *start.begin() = nBegin;
+        pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, start));
+
+        std::vector<size_t> vUnchecked;
+        while (pcursor->Valid() && !fAbort) {
+            std::pair<char, uint256> key;
+            if (!pcursor->GetKey(key) || key.first != DB_BLOCK_INDEX ||
+                *key.second.begin() >= nEnd) {
+                break;
+            }
+
+            slice.entries.emplace_back();
+            CDiskBlockIndex &diskindex = slice.entries.back();
+            if (!pcursor->GetValue(diskindex)) {
+                slice.strError = "failed to read value";
+                break;
+            }
+            slice.hashes.push_back(diskindex.GetBlockHash());
+
+            if (diskindex.nHeight > nPoWTrustedHeight) {
+                vUnchecked.push_back(slice.entries.size() - 1);
+                if (vUnchecked.size() == BLOCK_INDEX_POW_BATCH) {
+                    if (!CheckBlockIndexPoW(slice, vUnchecked)) break;
+                    vUnchecked.clear();
+                }
+            }
 
-        CDiskBlockIndex diskindex;
-        if (!pcursor->GetValue(diskindex)) {
-            return error("LoadBlockIndex() : failed to read value");
+            pcursor->Next();
         }
 
+        if (slice.strError.empty() && !vUnchecked.empty()) {
+            CheckBlockIndexPoW(slice, vUnchecked);
+        }
+    } catch (const std::exception &e) {
+        slice.strError = e.what();
+    }
+
+    if (!slice.strError.empty()) {
+        fAbort = true;
+    }
+}
+
+} // namespace
+
+bool CBlockTreeDB::LoadBlockIndexGuts(
+    std::function<CBlockIndex *(const uint256 &)> insertBlockIndex,
+    int nPoWTrustedHeight, int nThreads) {
+    int64_t nStart = GetTimeMillis();
+
+    // Block hashes are uniformly distributed, so splitting the key space on
+    // the first byte of the hash gives every worker a similar share.
+    nThreads = std::max(1, std::min(nThreads, 256));
+    std::vector<BlockIndexSlice> slices(nThreads);
+    std::atomic<bool> fAbort(false);
+    std::vector<std::thread> workers;
+    for (int i = 1; i < nThreads; i++) {
+        workers.emplace_back(LoadBlockIndexSlice, std::ref(*this),
+                             256 * i / nThreads, 256 * (i + 1) / nThreads,
+                             nPoWTrustedHeight, std::ref(slices[i]),
+                             std::ref(fAbort));
+    }
+    LoadBlockIndexSlice(*this, 0, 256 / nThreads, nPoWTrustedHeight, slices[0],
+                        fAbort);
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+
+    int64_t nDecoded = GetTimeMillis();
+    int nPoWChecked = 0;
+    for (const BlockIndexSlice &slice : slices) {
+        if (!slice.strError.empty()) {
+            return error("LoadBlockIndex(): %s", slice.strError);
+        }
+        nPoWChecked += slice.nPoWChecked;
+    }
+
+    // Hand the entries over in height order, so parents are created before
+    // their children and the index ends up laid out along the chain.
+    std::vector<std::pair<int, std::pair<const CDiskBlockIndex *,
+                                         const uint256 *>>> vSorted;
+    for (const BlockIndexSlice &slice : slices) {
+        for (size_t i = 0; i < slice.entries.size(); i++) {
+            vSorted.push_back(std::make_pair(
+                slice.entries[i].nHeight,
+                std::make_pair(&slice.entries[i], &slice.hashes[i])));
+        }
+    }
+    std::sort(vSorted.begin(), vSorted.end());
+
+    // Load mapBlockIndex
+    for (const auto &item : vSorted) {
+        boost::this_thread::interruption_point();
+        const CDiskBlockIndex &diskindex = *item.second.first;
+
         // Construct block index object
-        CBlockIndex *pindexNew = insertBlockIndex(diskindex.GetBlockHash());
+        CBlockIndex *pindexNew = insertBlockIndex(*item.second.second);
         pindexNew->pprev = insertBlockIndex(diskindex.hashPrev);
         pindexNew->nHeight = diskindex.nHeight;
         pindexNew->nFile = diskindex.nFile;
@@ -252,15 +662,14 @@ bool CBlockTreeDB::LoadBlockIndexGuts(
         pindexNew->nNonce = diskindex.nNonce;
         pindexNew->nStatus = diskindex.nStatus;
         pindexNew->nTx = diskindex.nTx;
-
-        if (!CheckProofOfWork(pindexNew->GetBlockPoWHash(), pindexNew->nBits,
-                              Params().GetConsensus()))
-            return error("LoadBlockIndex(): CheckProofOfWork failed: %s",
-                         pindexNew->ToString());
-
-        pcursor->Next();
     }
+    int nLoaded = vSorted.size();
 
+    LogPrintf("LoadBlockIndexGuts: loaded %d entries, checked proof of work "
+              "for %d (trusted up to height %d)\n",
+              nLoaded, nPoWChecked, nPoWTrustedHeight);
+    LogPrintf("LoadBlockIndexGuts: decode %dms on %d threads, insert %dms\n",
+              nDecoded - nStart, nThreads, GetTimeMillis() - nDecoded);
     return true;
 }
 
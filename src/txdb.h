@@ -10,8 +10,12 @@
 #include "coins.h"
 #include "dbwrapper.h"
 
+#include <condition_variable>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -68,6 +72,10 @@ class CCoinsViewDB : public CCoinsView {
 protected:
     CDBWrapper db;
 
+    //! Commitment waiting to be written with the coins of hashCommitment.
+    uint256 hashCommitment;
+    CCoinsCommitment commitment;
+
 public:
     CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
@@ -75,12 +83,93 @@ public:
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool BatchWriteSnapshot(const CCoinsMap &mapCoins,
+                            const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
+    std::vector<std::unique_ptr<CCoinsViewCursor>>
+    RangeCursors(size_t nRanges) const override;
+    void SetCommitment(const uint256 &hashBlock,
+                       const CCoinsCommitment &commitmentIn) override;
+    bool GetCommitment(CCoinsCommitment &commitmentOut) const override;
+
+    /**
+     * Write a chunk of the coins of a UTXO snapshot taken at hashBlock
+     * straight to the database, in key order. Until FinishSnapshot is called
+     * the database is marked as holding a partly loaded snapshot.
+     */
+    bool WriteSnapshotCoins(const uint256 &hashBlock,
+                            std::vector<std::pair<COutPoint, Coin>> &vCoins);
+    //! Make hashBlock the best block once all coins of its snapshot are in.
+    bool FinishSnapshot(const uint256 &hashBlock,
+                        const CCoinsCommitment &commitmentIn);
+    //! Whether a snapshot was left partly loaded.
+    bool IsLoadingSnapshot() const;
 
     //! Attempt to update from an older database format.
     //! Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
+
+    const CDBWrapper &GetDB() const { return db; }
+};
+
+/**
+ * CCoinsView that writes the changes flushed into it to its base from a
+ * background thread.
+ *
+ * BatchWrite takes over the entries and returns without waiting for them to
+ * be written, so that the cache above can go on connecting blocks from an
+ * empty map. The entries stay readable here until they are on disk. Only one
+ * batch is written at a time: the next BatchWrite, and anything that reads
+ * the base directly, waits for the previous one. The best block is written in
+ * the same database batch as the coins, so after a crash the database is at
+ * either the previous or the new best block.
+ */
+class CCoinsViewBackgroundFlush : public CCoinsViewBacked {
+private:
+    mutable std::mutex mutex;
+    mutable std::condition_variable cond;
+    //! The batch being written, if any, and the best block it is written with.
+    std::unique_ptr<CCoinsMap> pending;
+    uint256 hashPending;
+    size_t nPendingUsage;
+    //! Number of batches written through this view so far.
+    uint64_t nWrites;
+    //! A write failed; its batch is kept so that reads stay correct.
+    bool fFailed;
+    bool fStop;
+    std::thread thread;
+
+    void ThreadFlush();
+    void WaitForPending(std::unique_lock<std::mutex> &lock) const;
+
+public:
+    explicit CCoinsViewBackgroundFlush(CCoinsView *viewIn);
+    ~CCoinsViewBackgroundFlush();
+
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    bool HaveCoin(const COutPoint &outpoint) const override;
+    uint256 GetBestBlock() const override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool BatchWriteSnapshot(const CCoinsMap &mapCoins,
+                            const uint256 &hashBlock) override;
+    CCoinsViewCursor *Cursor() const override;
+    std::vector<std::unique_ptr<CCoinsViewCursor>>
+    RangeCursors(size_t nRanges) const override;
+    void SetCommitment(const uint256 &hashBlock,
+                       const CCoinsCommitment &commitment) override;
+    bool GetCommitment(CCoinsCommitment &commitment) const override;
+
+    //! Wait until the batch being written is on disk. Returns false if any
+    //! write has failed.
+    bool Sync() const;
+
+    //! Memory used by the batch being written.
+    size_t PendingMemoryUsage() const;
+
+    //! Number of batches written so far. Coins read from this view while
+    //! it stays the same are still current.
+    uint64_t GetWriteCount() const;
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -96,10 +185,22 @@ public:
     void Next();
 
 private:
-    CCoinsViewDBCursor(CDBIterator *pcursorIn, const uint256 &hashBlockIn)
-        : CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn) {}
+    CCoinsViewDBCursor(
+        CDBIterator *pcursorIn, const uint256 &hashBlockIn,
+        const std::shared_ptr<const leveldb::Snapshot> &snapshotIn = nullptr,
+        int nEndByteIn = 256)
+        : CCoinsViewCursor(hashBlockIn), snapshot(snapshotIn),
+          pcursor(pcursorIn), nEndByte(nEndByteIn) {}
+    //! Outlives pcursor, which may be reading from it.
+    std::shared_ptr<const leveldb::Snapshot> snapshot;
     std::unique_ptr<CDBIterator> pcursor;
     std::pair<char, COutPoint> keyTmp;
+    //! The cursor stops at the first txid starting with this byte.
+    int nEndByte;
+
+    //! Cache the key at the current position, or invalidate the cursor if
+    //! it has run out of coins or past its range.
+    void CacheKey();
 
     friend class CCoinsViewDB;
 };
@@ -125,8 +226,19 @@ public:
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>> &list);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
+    //! Block the chainstate was loaded from a UTXO snapshot at, if any.
+    bool WriteSnapshotBase(const uint256 &hash);
+    bool ReadSnapshotBase(uint256 &hash);
+    /**
+     * Load every block index entry. Proof of work is checked again for
+     * entries above nPoWTrustedHeight; pass -1 to check all of them.
+     * Decoding, hashing and proof of work checks are spread over nThreads
+     * workers, each scanning its own slice of the key space; the entries are
+     * then handed to insertBlockIndex in height order on the calling thread.
+     */
     bool LoadBlockIndexGuts(
-        std::function<CBlockIndex *(const uint256 &)> insertBlockIndex);
+        std::function<CBlockIndex *(const uint256 &)> insertBlockIndex,
+        int nPoWTrustedHeight = -1, int nThreads = 1);
 };
 
 #endif // BITCOIN_TXDB_H
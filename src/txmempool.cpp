@@ -21,6 +21,8 @@
 
 #include <boost/range/adaptor/reversed.hpp>
 
+#include <algorithm>
+
 CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef &_tx, const Amount _nFee,
                                  int64_t _nTime, double _entryPriority,
                                  unsigned int _entryHeight,
@@ -47,6 +49,8 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef &_tx, const Amount _nFee,
     nSizeWithAncestors = GetTxSize();
     nModFeesWithAncestors = nFee;
     nSigOpCountWithAncestors = sigOpCount;
+
+    nEpoch = 0;
 }
 
 CTxMemPoolEntry::CTxMemPoolEntry(const CTxMemPoolEntry &other) {
@@ -74,44 +78,50 @@ void CTxMemPoolEntry::UpdateLockPoints(const LockPoints &lp) {
 }
 
 // Update the given tx for any in-mempool descendants.
-// Assumes that setMemPoolChildren is correct for the given tx and all
+// Assumes that the child links are correct for the given tx and all
 // descendants.
 void CTxMemPool::UpdateForDescendants(txiter updateIt,
                                       cacheMap &cachedDescendants,
                                       const std::set<uint256> &setExclude) {
-    setEntries stageEntries, setAllDescendants;
-    stageEntries = GetMemPoolChildren(updateIt);
+    const uint64_t epoch = NewEpoch();
+    std::vector<txiter> stageEntries, vAllDescendants;
+    for (const CTxMemPoolEntry *child : updateIt->children) {
+        Visit(*child, epoch);
+        stageEntries.push_back(GetIter(child));
+    }
 
     while (!stageEntries.empty()) {
-        const txiter cit = *stageEntries.begin();
-        setAllDescendants.insert(cit);
-        stageEntries.erase(cit);
-        const setEntries &setChildren = GetMemPoolChildren(cit);
-        for (const txiter childEntry : setChildren) {
+        const txiter cit = stageEntries.back();
+        vAllDescendants.push_back(cit);
+        stageEntries.pop_back();
+        for (const CTxMemPoolEntry *child : cit->children) {
+            const txiter childEntry = GetIter(child);
             cacheMap::iterator cacheIt = cachedDescendants.find(childEntry);
             if (cacheIt != cachedDescendants.end()) {
                 // We've already calculated this one, just add the entries for
                 // this set but don't traverse again.
                 for (const txiter cacheEntry : cacheIt->second) {
-                    setAllDescendants.insert(cacheEntry);
+                    if (!Visit(*cacheEntry, epoch)) {
+                        vAllDescendants.push_back(cacheEntry);
+                    }
                 }
-            } else if (!setAllDescendants.count(childEntry)) {
+            } else if (!Visit(*child, epoch)) {
                 // Schedule for later processing
-                stageEntries.insert(childEntry);
+                stageEntries.push_back(childEntry);
             }
         }
     }
-    // setAllDescendants now contains all in-mempool descendants of updateIt.
-    // Update and add to cached descendant map
+    // vAllDescendants now contains all in-mempool descendants of updateIt,
+    // each once. Update and add to cached descendant map
     int64_t modifySize = 0;
     Amount modifyFee = 0;
     int64_t modifyCount = 0;
-    for (txiter cit : setAllDescendants) {
+    for (txiter cit : vAllDescendants) {
         if (!setExclude.count(cit->GetTx().GetId())) {
             modifySize += cit->GetTxSize();
             modifyFee += cit->GetModifiedFee();
             modifyCount++;
-            cachedDescendants[updateIt].insert(cit);
+            cachedDescendants[updateIt].push_back(cit);
             // Update ancestor state for each descendant
             mapTx.modify(cit,
                          update_ancestor_state(updateIt->GetTxSize(),
@@ -144,7 +154,7 @@ void CTxMemPool::UpdateTransactionsFromBlock(
     // Iterate in reverse, so that whenever we are looking at at a transaction
     // we are sure that all in-mempool descendants have already been processed.
     // This maximizes the benefit of the descendant cache and guarantees that
-    // setMemPoolChildren will be updated, an assumption made in
+    // the child links will be updated, an assumption made in
     // UpdateForDescendants.
     for (const uint256 &hash : boost::adaptors::reverse(vHashesToUpdate)) {
         // we cache the in-mempool children to avoid duplicate updates
@@ -155,8 +165,8 @@ void CTxMemPool::UpdateTransactionsFromBlock(
             continue;
         }
         auto iter = mapNextTx.lower_bound(COutPoint(hash, 0));
-        // First calculate the children, and update setMemPoolChildren to
-        // include them, and update their setMemPoolParents to include this tx.
+        // First calculate the children, and update the child links to include
+        // them, and update their parent links to include this tx.
         for (; iter != mapNextTx.end() && iter->first->hash == hash; ++iter) {
             const uint256 &childHash = iter->second->GetId();
             txiter childIter = mapTx.find(childHash);
@@ -181,7 +191,9 @@ bool CTxMemPool::CalculateMemPoolAncestors(
     std::string &errString, bool fSearchForParents /* = true */) const {
     LOCK(cs);
 
-    setEntries parentHashes;
+    // Ancestors are added to setAncestors as they are found, and staged until
+    // their own parents have been looked at.
+    std::vector<txiter> stage;
     const CTransaction &tx = entry.GetTx();
 
     if (fSearchForParents) {
@@ -190,9 +202,9 @@ bool CTxMemPool::CalculateMemPoolAncestors(
         // iterate mapTx to find parents.
         for (unsigned int i = 0; i < tx.vin.size(); i++) {
             txiter piter = mapTx.find(tx.vin[i].prevout.hash);
-            if (piter != mapTx.end()) {
-                parentHashes.insert(piter);
-                if (parentHashes.size() + 1 > limitAncestorCount) {
+            if (piter != mapTx.end() && setAncestors.insert(piter).second) {
+                stage.push_back(piter);
+                if (setAncestors.size() + 1 > limitAncestorCount) {
                     errString =
                         strprintf("too many unconfirmed parents [limit: %u]",
                                   limitAncestorCount);
@@ -203,17 +215,18 @@ bool CTxMemPool::CalculateMemPoolAncestors(
     } else {
         // If we're not searching for parents, we require this to be an entry in
         // the mempool already.
-        txiter it = mapTx.iterator_to(entry);
-        parentHashes = GetMemPoolParents(it);
+        for (const CTxMemPoolEntry *parent : entry.parents) {
+            txiter piter = GetIter(parent);
+            setAncestors.insert(piter);
+            stage.push_back(piter);
+        }
     }
 
     size_t totalSizeWithAncestors = entry.GetTxSize();
 
-    while (!parentHashes.empty()) {
-        txiter stageit = *parentHashes.begin();
-
-        setAncestors.insert(stageit);
-        parentHashes.erase(stageit);
+    while (!stage.empty()) {
+        txiter stageit = stage.back();
+        stage.pop_back();
         totalSizeWithAncestors += stageit->GetTxSize();
 
         if (stageit->GetSizeWithDescendants() + entry.GetTxSize() >
@@ -234,14 +247,13 @@ bool CTxMemPool::CalculateMemPoolAncestors(
             return false;
         }
 
-        const setEntries &setMemPoolParents = GetMemPoolParents(stageit);
-        for (const txiter &phash : setMemPoolParents) {
+        for (const CTxMemPoolEntry *parent : stageit->parents) {
             // If this is a new ancestor, add it.
-            if (setAncestors.count(phash) == 0) {
-                parentHashes.insert(phash);
+            txiter piter = GetIter(parent);
+            if (setAncestors.insert(piter).second) {
+                stage.push_back(piter);
             }
-            if (parentHashes.size() + setAncestors.size() + 1 >
-                limitAncestorCount) {
+            if (setAncestors.size() + 1 > limitAncestorCount) {
                 errString =
                     strprintf("too many unconfirmed ancestors [limit: %u]",
                               limitAncestorCount);
@@ -255,10 +267,9 @@ bool CTxMemPool::CalculateMemPoolAncestors(
 
 void CTxMemPool::UpdateAncestorsOf(bool add, txiter it,
                                    setEntries &setAncestors) {
-    setEntries parentIters = GetMemPoolParents(it);
     // add or remove this tx as a child of each parent
-    for (txiter piter : parentIters) {
-        UpdateChild(piter, it, add);
+    for (const CTxMemPoolEntry *parent : it->parents) {
+        UpdateChild(GetIter(parent), it, add);
     }
     const int64_t updateCount = (add ? 1 : -1);
     const int64_t updateSize = updateCount * it->GetTxSize();
@@ -285,9 +296,8 @@ void CTxMemPool::UpdateEntryForAncestors(txiter it,
 }
 
 void CTxMemPool::UpdateChildrenForRemoval(txiter it) {
-    const setEntries &setMemPoolChildren = GetMemPoolChildren(it);
-    for (txiter updateIt : setMemPoolChildren) {
-        UpdateParent(updateIt, it, false);
+    for (const CTxMemPoolEntry *child : it->children) {
+        UpdateParent(GetIter(child), it, false);
     }
 }
 
@@ -295,21 +305,20 @@ void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove,
                                             bool updateDescendants) {
     // For each entry, walk back all ancestors and decrement size associated
     // with this transaction.
-    const uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+    std::vector<txiter> vRelatives;
     if (updateDescendants) {
         // updateDescendants should be true whenever we're not recursively
         // removing a tx and all its descendants, eg when a transaction is
-        // confirmed in a block. Here we only update statistics and not data in
-        // mapLinks (which we need to preserve until we're finished with all
-        // operations that need to traverse the mempool).
+        // confirmed in a block. Here we only update statistics and not the
+        // links between entries (which we need to preserve until we're
+        // finished with all operations that need to traverse the mempool).
         for (txiter removeIt : entriesToRemove) {
-            setEntries setDescendants;
-            CalculateDescendants(removeIt, setDescendants);
-            setDescendants.erase(removeIt); // don't update state for self
+            vRelatives.clear();
+            GetDescendants(removeIt, vRelatives);
             int64_t modifySize = -((int64_t)removeIt->GetTxSize());
             Amount modifyFee = -1 * removeIt->GetModifiedFee();
             int modifySigOps = -removeIt->GetSigOpCount();
-            for (txiter dit : setDescendants) {
+            for (txiter dit : vRelatives) {
                 mapTx.modify(dit, update_ancestor_state(modifySize, modifyFee,
                                                         -1, modifySigOps));
             }
@@ -317,35 +326,38 @@ void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove,
     }
 
     for (txiter removeIt : entriesToRemove) {
-        setEntries setAncestors;
-        const CTxMemPoolEntry &entry = *removeIt;
-        std::string dummy;
-        // Since this is a tx that is already in the mempool, we can call CMPA
-        // with fSearchForParents = false.  If the mempool is in a consistent
-        // state, then using true or false should both be correct, though false
-        // should be a bit faster.
+        // Walk the parent links rather than searching the inputs of the
+        // transaction. If the mempool is in a consistent state, then both
+        // give the same ancestors, though the links are faster.
         // However, if we happen to be in the middle of processing a reorg, then
         // the mempool can be in an inconsistent state. In this case, the set of
-        // ancestors reachable via mapLinks will be the same as the set of
+        // ancestors reachable via the links will be the same as the set of
         // ancestors whose packages include this transaction, because when we
         // add a new transaction to the mempool in addUnchecked(), we assume it
         // has no children, and in the case of a reorg where that assumption is
         // false, the in-mempool children aren't linked to the in-block tx's
         // until UpdateTransactionsFromBlock() is called. So if we're being
         // called during a reorg, ie before UpdateTransactionsFromBlock() has
-        // been called, then mapLinks[] will differ from the set of mempool
+        // been called, then the links will differ from the set of mempool
         // parents we'd calculate by searching, and it's important that we use
-        // the mapLinks[] notion of ancestor transactions as the set of things
-        // to update for removal.
-        CalculateMemPoolAncestors(entry, setAncestors, nNoLimit, nNoLimit,
-                                  nNoLimit, nNoLimit, dummy, false);
-        // Note that UpdateAncestorsOf severs the child links that point to
-        // removeIt in the entries for the parents of removeIt.
-        UpdateAncestorsOf(false, removeIt, setAncestors);
+        // the links as the set of things to update for removal.
+        vRelatives.clear();
+        GetAncestors(removeIt, vRelatives);
+        // Sever the child links that point to removeIt in the entries for the
+        // parents of removeIt.
+        for (const CTxMemPoolEntry *parent : removeIt->parents) {
+            UpdateChild(GetIter(parent), removeIt, false);
+        }
+        const int64_t modifySize = -((int64_t)removeIt->GetTxSize());
+        const Amount modifyFee = -1 * removeIt->GetModifiedFee();
+        for (txiter ancestorIt : vRelatives) {
+            mapTx.modify(ancestorIt,
+                         update_descendant_state(modifySize, modifyFee, -1));
+        }
     }
     // After updating all the ancestor sizes, we can now sever the link between
     // each transaction being removed and any mempool children (ie, update
-    // setMemPoolParents for each direct child of a transaction being removed).
+    // the parent links of each direct child of a transaction being removed).
     for (txiter removeIt : entriesToRemove) {
         UpdateChildrenForRemoval(removeIt);
     }
@@ -374,7 +386,7 @@ void CTxMemPoolEntry::UpdateAncestorState(int64_t modifySize, Amount modifyFee,
 }
 
 CTxMemPool::CTxMemPool(const CFeeRate &_minReasonableRelayFee)
-    : nTransactionsUpdated(0) {
+    : nTransactionsUpdated(0), nEpoch(0) {
     // lock free clear
     _clear();
 
@@ -407,12 +419,10 @@ void CTxMemPool::AddTransactionsUpdated(unsigned int n) {
 
 bool CTxMemPool::addUnchecked(const uint256 &hash, const CTxMemPoolEntry &entry,
                               setEntries &setAncestors, bool validFeeEstimate) {
-    NotifyEntryAdded(entry.GetSharedTx());
     // Add to memory pool without checking anything.
     // Used by AcceptToMemoryPool(), which DOES do all the appropriate checks.
     LOCK(cs);
     indexed_transaction_set::iterator newit = mapTx.insert(entry).first;
-    mapLinks.insert(make_pair(newit, TxLinks()));
 
     // Update transaction for any feeDelta created by PrioritiseTransaction
     // TODO: refactor so that the fee delta is calculated before inserting into
@@ -461,6 +471,8 @@ bool CTxMemPool::addUnchecked(const uint256 &hash, const CTxMemPoolEntry &entry,
     vTxHashes.emplace_back(tx.GetHash(), newit);
     newit->vTxHashesIdx = vTxHashes.size() - 1;
 
+    // Listeners see the entry once it is linked to its parents.
+    NotifyEntryAdded(entry.GetSharedTx());
     return true;
 }
 
@@ -482,9 +494,8 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason) {
 
     totalTxSize -= it->GetTxSize();
     cachedInnerUsage -= it->DynamicMemoryUsage();
-    cachedInnerUsage -= memusage::DynamicUsage(mapLinks[it].parents) +
-                        memusage::DynamicUsage(mapLinks[it].children);
-    mapLinks.erase(it);
+    cachedInnerUsage -= memusage::DynamicUsage(it->parents) +
+                        memusage::DynamicUsage(it->children);
     mapTx.erase(it);
     nTransactionsUpdated++;
     minerPolicyEstimator->removeTx(txid);
@@ -492,30 +503,66 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason) {
 
 // Calculates descendants of entry that are not already in setDescendants, and
 // adds to setDescendants. Assumes entryit is already a tx in the mempool and
-// setMemPoolChildren is correct for tx and all descendants. Also assumes that
+// the child links are correct for tx and all descendants. Also assumes that
 // if an entry is in setDescendants already, then all in-mempool descendants of
 // it are already in setDescendants as well, so that we can save time by not
 // iterating over those entries.
 void CTxMemPool::CalculateDescendants(txiter entryit,
-                                      setEntries &setDescendants) {
-    setEntries stage;
-    if (setDescendants.count(entryit) == 0) {
-        stage.insert(entryit);
+                                      setEntries &setDescendants) const {
+    if (!setDescendants.insert(entryit).second) {
+        return;
     }
     // Traverse down the children of entry, only adding children that are not
     // accounted for in setDescendants already (because those children have
     // either already been walked, or will be walked in this iteration).
+    std::vector<txiter> stage(1, entryit);
     while (!stage.empty()) {
-        txiter it = *stage.begin();
-        setDescendants.insert(it);
-        stage.erase(it);
-
-        const setEntries &setChildren = GetMemPoolChildren(it);
-        for (const txiter &childiter : setChildren) {
-            if (!setDescendants.count(childiter)) {
-                stage.insert(childiter);
+        txiter it = stage.back();
+        stage.pop_back();
+        for (const CTxMemPoolEntry *child : it->children) {
+            txiter childiter = GetIter(child);
+            if (setDescendants.insert(childiter).second) {
+                stage.push_back(childiter);
+            }
+        }
+    }
+}
+
+void CTxMemPool::GetAncestors(txiter it,
+                              std::vector<txiter> &vAncestors) const {
+    // vAncestors doubles as the queue of entries whose parents are still to
+    // be looked at.
+    const uint64_t epoch = NewEpoch();
+    size_t nNext = vAncestors.size();
+    Visit(*it, epoch);
+    for (const CTxMemPoolEntry *entry = &*it;;) {
+        for (const CTxMemPoolEntry *parent : entry->parents) {
+            if (!Visit(*parent, epoch)) {
+                vAncestors.push_back(GetIter(parent));
             }
         }
+        if (nNext == vAncestors.size()) {
+            break;
+        }
+        entry = &*vAncestors[nNext++];
+    }
+}
+
+void CTxMemPool::GetDescendants(txiter it,
+                                std::vector<txiter> &vDescendants) const {
+    const uint64_t epoch = NewEpoch();
+    size_t nNext = vDescendants.size();
+    Visit(*it, epoch);
+    for (const CTxMemPoolEntry *entry = &*it;;) {
+        for (const CTxMemPoolEntry *child : entry->children) {
+            if (!Visit(*child, epoch)) {
+                vDescendants.push_back(GetIter(child));
+            }
+        }
+        if (nNext == vDescendants.size()) {
+            break;
+        }
+        entry = &*vDescendants[nNext++];
     }
 }
 
@@ -648,7 +695,6 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef> &vtx,
 }
 
 void CTxMemPool::_clear() {
-    mapLinks.clear();
     mapTx.clear();
     mapNextTx.clear();
     vTxHashes.clear();
@@ -689,11 +735,8 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const {
         checkTotal += it->GetTxSize();
         innerUsage += it->DynamicMemoryUsage();
         const CTransaction &tx = it->GetTx();
-        txlinksMap::const_iterator linksiter = mapLinks.find(it);
-        assert(linksiter != mapLinks.end());
-        const TxLinks &links = linksiter->second;
-        innerUsage += memusage::DynamicUsage(links.parents) +
-                      memusage::DynamicUsage(links.children);
+        innerUsage += memusage::DynamicUsage(it->parents) +
+                      memusage::DynamicUsage(it->children);
         bool fDependsWait = false;
         setEntries setParentCheck;
         int64_t parentSizes = 0;
@@ -722,7 +765,11 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const {
             assert(it3->second == &tx);
             i++;
         }
-        assert(setParentCheck == GetMemPoolParents(it));
+        // The links hold no duplicates, so this checks they match the set.
+        assert(setParentCheck.size() == it->parents.size());
+        for (const CTxMemPoolEntry *parent : it->parents) {
+            assert(setParentCheck.count(GetIter(parent)));
+        }
         // Verify ancestor state is correct.
         setEntries setAncestors;
         uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
@@ -759,7 +806,10 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const {
                 childSizes += childit->GetTxSize();
             }
         }
-        assert(setChildrenCheck == GetMemPoolChildren(it));
+        assert(setChildrenCheck.size() == it->children.size());
+        for (const CTxMemPoolEntry *child : it->children) {
+            assert(setChildrenCheck.count(GetIter(child)));
+        }
         // Also check to make sure size is greater than sum with immediate
         // children. Just a sanity check, not definitive that this calc is
         // correct...
@@ -967,20 +1017,16 @@ void CTxMemPool::PrioritiseTransaction(const uint256 hash,
         if (it != mapTx.end()) {
             mapTx.modify(it, update_fee_delta(deltas.second));
             // Now update all ancestors' modified fees with descendants
-            setEntries setAncestors;
-            uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
-            std::string dummy;
-            CalculateMemPoolAncestors(*it, setAncestors, nNoLimit, nNoLimit,
-                                      nNoLimit, nNoLimit, dummy, false);
-            for (txiter ancestorIt : setAncestors) {
+            std::vector<txiter> vAncestors;
+            GetAncestors(it, vAncestors);
+            for (txiter ancestorIt : vAncestors) {
                 mapTx.modify(ancestorIt,
                              update_descendant_state(0, nFeeDelta, 0));
             }
             // Now update all descendants' modified fees with ancestors
-            setEntries setDescendants;
-            CalculateDescendants(it, setDescendants);
-            setDescendants.erase(it);
-            for (txiter descendantIt : setDescendants) {
+            std::vector<txiter> vDescendants;
+            GetDescendants(it, vDescendants);
+            for (txiter descendantIt : vDescendants) {
                 mapTx.modify(descendantIt,
                              update_ancestor_state(0, nFeeDelta, 0, 0));
             }
@@ -1046,7 +1092,6 @@ size_t CTxMemPool::DynamicMemoryUsage() const {
                mapTx.size() +
            memusage::DynamicUsage(mapNextTx) +
            memusage::DynamicUsage(mapDeltas) +
-           memusage::DynamicUsage(mapLinks) +
            memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
 }
 
@@ -1087,38 +1132,44 @@ bool CTxMemPool::addUnchecked(const uint256 &hash, const CTxMemPoolEntry &entry,
     return addUnchecked(hash, entry, setAncestors, validFeeEstimate);
 }
 
-void CTxMemPool::UpdateChild(txiter entry, txiter child, bool add) {
-    setEntries s;
-    if (add && mapLinks[entry].children.insert(child).second) {
-        cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
-    } else if (!add && mapLinks[entry].children.erase(child)) {
-        cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
+/**
+ * Add an entry to links if it is not there yet, or remove it. The order of the
+ * links does not matter, so the last one takes the place of a removed one.
+ */
+static void UpdateLinks(CTxMemPoolEntry::Links &links,
+                        const CTxMemPoolEntry *entry, bool add) {
+    CTxMemPoolEntry::Links::iterator it =
+        std::find(links.begin(), links.end(), entry);
+    if (add && it == links.end()) {
+        links.push_back(entry);
+    } else if (!add && it != links.end()) {
+        *it = links.back();
+        links.pop_back();
     }
 }
 
+void CTxMemPool::UpdateChild(txiter entry, txiter child, bool add) {
+    cachedInnerUsage -= memusage::DynamicUsage(entry->children);
+    UpdateLinks(entry->children, &*child, add);
+    cachedInnerUsage += memusage::DynamicUsage(entry->children);
+}
+
 void CTxMemPool::UpdateParent(txiter entry, txiter parent, bool add) {
-    setEntries s;
-    if (add && mapLinks[entry].parents.insert(parent).second) {
-        cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
-    } else if (!add && mapLinks[entry].parents.erase(parent)) {
-        cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
-    }
+    cachedInnerUsage -= memusage::DynamicUsage(entry->parents);
+    UpdateLinks(entry->parents, &*parent, add);
+    cachedInnerUsage += memusage::DynamicUsage(entry->parents);
 }
 
-const CTxMemPool::setEntries &
+const CTxMemPoolEntry::Links &
 CTxMemPool::GetMemPoolParents(txiter entry) const {
     assert(entry != mapTx.end());
-    txlinksMap::const_iterator it = mapLinks.find(entry);
-    assert(it != mapLinks.end());
-    return it->second.parents;
+    return entry->parents;
 }
 
-const CTxMemPool::setEntries &
+const CTxMemPoolEntry::Links &
 CTxMemPool::GetMemPoolChildren(txiter entry) const {
     assert(entry != mapTx.end());
-    txlinksMap::const_iterator it = mapLinks.find(entry);
-    assert(it != mapLinks.end());
-    return it->second.children;
+    return entry->children;
 }
 
 CFeeRate CTxMemPool::GetMinFee(size_t sizelimit) const {
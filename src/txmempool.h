@@ -16,6 +16,7 @@
 #include "amount.h"
 #include "coins.h"
 #include "indirectmap.h"
+#include "prevector.h"
 #include "primitives/transaction.h"
 #include "random.h"
 #include "sync.h"
@@ -78,9 +79,17 @@ class CTxMemPool;
  * nTxSize/nFee+feeDelta. (This can potentially happen during a reorg, where we
  * limit the amount of work we're willing to do to avoid consuming too much
  * CPU.)
+ *
+ * The entry also holds its links to its in-mempool parents and children, which
+ * are maintained by the CTxMemPool it is in.
  */
 
 class CTxMemPoolEntry {
+public:
+    //! In-mempool parents or children of an entry. Most transactions have only
+    //! a few, which are kept inline.
+    typedef prevector<4, const CTxMemPoolEntry *> Links;
+
 private:
     CTransactionRef tx;
     //!< Cached to avoid expensive parent-transaction lookups
@@ -127,6 +136,14 @@ private:
     Amount nModFeesWithAncestors;
     int64_t nSigOpCountWithAncestors;
 
+    // The mempool links entries and walks the links while the entries are in
+    // its multi_index, where they cannot be modified otherwise.
+    friend class CTxMemPool;
+    mutable Links parents;
+    mutable Links children;
+    //!< Last traversal of the mempool that visited this entry
+    mutable uint64_t nEpoch;
+
 public:
     CTxMemPoolEntry(const CTransactionRef &_tx, const Amount _nFee,
                     int64_t _nTime, double _entryPriority,
@@ -176,6 +193,9 @@ public:
         return nSigOpCountWithAncestors;
     }
 
+    const Links &GetMemPoolParents() const { return parents; }
+    const Links &GetMemPoolChildren() const { return children; }
+
     //!< Index in mempool's vTxHashes
     mutable size_t vTxHashesIdx;
 };
@@ -419,8 +439,9 @@ public:
  *
  * In order for the feerate sort to remain correct, we must update transactions
  * in the mempool when new descendants arrive. To facilitate this, we track the
- * set of in-mempool direct parents and direct children in mapLinks. Within each
- * CTxMemPoolEntry, we track the size and fees of all descendants.
+ * in-mempool direct parents and direct children of each CTxMemPoolEntry, in the
+ * entry itself. Within each CTxMemPoolEntry, we also track the size and fees of
+ * all descendants.
  *
  * Usually when a new transaction is added to the mempool, it has no in-mempool
  * children (because any such children would be an orphan). So in
@@ -452,7 +473,7 @@ public:
  * state, to account for in-mempool, out-of-block descendants for all the
  * in-block transactions by calling UpdateTransactionsFromBlock(). Note that
  * until this is called, the mempool state is not consistent, and in particular
- * mapLinks may not be correct (and therefore functions like
+ * the parent and child links may not be correct (and therefore functions like
  * CalculateMemPoolAncestors() and CalculateDescendants() that rely on them to
  * walk the mempool are not generally safe to use).
  *
@@ -536,23 +557,48 @@ public:
     };
     typedef std::set<txiter, CompareIteratorByHash> setEntries;
 
-    const setEntries &GetMemPoolParents(txiter entry) const;
-    const setEntries &GetMemPoolChildren(txiter entry) const;
+    const CTxMemPoolEntry::Links &GetMemPoolParents(txiter entry) const;
+    const CTxMemPoolEntry::Links &GetMemPoolChildren(txiter entry) const;
+    txiter GetIter(const CTxMemPoolEntry *entry) const {
+        return mapTx.iterator_to(*entry);
+    }
 
 private:
-    typedef std::map<txiter, setEntries, CompareIteratorByHash> cacheMap;
-
-    struct TxLinks {
-        setEntries parents;
-        setEntries children;
-    };
+    typedef std::map<txiter, std::vector<txiter>, CompareIteratorByHash>
+        cacheMap;
 
-    typedef std::map<txiter, TxLinks, CompareIteratorByHash> txlinksMap;
-    txlinksMap mapLinks;
+    //!< Counter for the traversals of the links between entries
+    mutable uint64_t nEpoch;
 
     void UpdateParent(txiter entry, txiter parent, bool add);
     void UpdateChild(txiter entry, txiter child, bool add);
 
+    /**
+     * Start a new traversal of the links between entries. Entries are marked
+     * as visited by it with Visit(), which replaces a set of the entries seen
+     * so far. Traversals cannot be nested.
+     */
+    uint64_t NewEpoch() const { return ++nEpoch; }
+    /** Mark an entry visited, returning whether it had been already. */
+    static bool Visit(const CTxMemPoolEntry &entry, uint64_t epoch) {
+        if (entry.nEpoch == epoch) {
+            return true;
+        }
+        entry.nEpoch = epoch;
+        return false;
+    }
+
+    /**
+     * Collect all in-mempool ancestors of an entry in the mempool by following
+     * the parent links, without limits, in no particular order.
+     */
+    void GetAncestors(txiter it, std::vector<txiter> &vAncestors) const;
+    /**
+     * Collect all in-mempool descendants of an entry, not including itself, in
+     * no particular order.
+     */
+    void GetDescendants(txiter it, std::vector<txiter> &vDescendants) const;
+
     std::vector<indexed_transaction_set::const_iterator>
     GetSortedDepthAndScore() const;
 
@@ -650,8 +696,8 @@ public:
      *  limitDescendantSize = max size of descendants any ancestor can have
      *  errString = populated with error reason if any limits are hit
      * fSearchForParents = whether to search a tx's vin for in-mempool parents,
-     * or look up parents from mapLinks. Must be true for entries not in the
-     * mempool
+     * or look up the parent links of the entry. Must be true for entries not in
+     * the mempool
      */
     bool CalculateMemPoolAncestors(
         const CTxMemPoolEntry &entry, setEntries &setAncestors,
@@ -663,7 +709,7 @@ public:
      * Populate setDescendants with all in-mempool descendants of hash.
      * Assumes that setDescendants includes all in-mempool descendants of
      * anything already in it.  */
-    void CalculateDescendants(txiter it, setEntries &setDescendants);
+    void CalculateDescendants(txiter it, setEntries &setDescendants) const;
 
     /**
      * The minimum fee to get into the mempool, which may itself not be enough
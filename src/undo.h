@@ -18,13 +18,28 @@ class CBlockIndex;
 class CCoinsViewCache;
 class CValidationState;
 
+/**
+ * Stream version flag selecting the compact encoding of spent coins, which
+ * leaves out the dummy value kept for older versions.
+ */
+static const int SERIALIZE_UNDO_COMPACT = 0x40000000;
+
+/**
+ * Undo data in the compact encoding starts with UNDO_FORMAT_MARKER followed by
+ * the format version. Undo data in the original encoding starts with the
+ * number of transactions, which is never large enough to begin with the
+ * marker, so both can be told apart and read.
+ */
+static const uint8_t UNDO_FORMAT_MARKER = 0xff;
+static const uint8_t UNDO_FORMAT_VERSION = 1;
+
 /**
  * Undo information for a CTxIn
  *
  * Contains the prevout's CTxOut being spent, and its metadata as well (coinbase
- * or not, height). The serialization contains a dummy value of zero. This is be
- * compatible with older versions which expect to see the transaction version
- * there.
+ * or not, height). Unless SERIALIZE_UNDO_COMPACT is set, the serialization
+ * contains a dummy value of zero. This is be compatible with older versions
+ * which expect to see the transaction version there.
  */
 class TxInUndoSerializer {
     const Coin *pcoin;
@@ -35,7 +50,8 @@ public:
     template <typename Stream> void Serialize(Stream &s) const {
         ::Serialize(
             s, VARINT(pcoin->GetHeight() * 2 + (pcoin->IsCoinBase() ? 1 : 0)));
-        if (pcoin->GetHeight() > 0) {
+        if (pcoin->GetHeight() > 0 &&
+            !(s.GetVersion() & SERIALIZE_UNDO_COMPACT)) {
             // Required to maintain compatibility with older undo format.
             ::Serialize(s, uint8_t(0));
         }
@@ -54,7 +70,7 @@ public:
         ::Unserialize(s, VARINT(nCode));
         uint32_t nHeight = nCode / 2;
         bool fCoinBase = nCode & 1;
-        if (nHeight > 0) {
+        if (nHeight > 0 && !(s.GetVersion() & SERIALIZE_UNDO_COMPACT)) {
             // Old versions stored the version number for the last spend of a
             // transaction's outputs. Non-final spends were indicated with
             // height = 0.
@@ -115,6 +131,20 @@ public:
     }
 };
 
+/** Append blockundo to vData in the current undo format. */
+void SerializeBlockUndo(const CBlockUndo &blockundo,
+                        std::vector<uint8_t> &vData);
+
+/** Size of blockundo in the current undo format. */
+size_t GetBlockUndoSize(const CBlockUndo &blockundo);
+
+/**
+ * Read undo data in the current or the original format. Throws
+ * std::ios_base::failure if the data is malformed.
+ */
+void UnserializeBlockUndo(CBlockUndo &blockundo, const uint8_t *pbegin,
+                          const uint8_t *pend);
+
 enum DisconnectResult {
     // All good.
     DISCONNECT_OK,
@@ -129,10 +159,12 @@ enum DisconnectResult {
  * @param undo The Coin to be restored.
  * @param view The coins view to which to apply the changes.
  * @param out The out point that corresponds to the tx input.
+ * @param pcommitment If set, the commitment to update with the changes.
  * @return A DisconnectResult
  */
 DisconnectResult UndoCoinSpend(const Coin &undo, CCoinsViewCache &view,
-                               const COutPoint &out);
+                               const COutPoint &out,
+                               CCoinsCommitment *pcommitment = nullptr);
 
 /**
  * Undo a block from the block and the undoblock data.
@@ -140,6 +172,7 @@ DisconnectResult UndoCoinSpend(const Coin &undo, CCoinsViewCache &view,
  */
 DisconnectResult ApplyBlockUndo(const CBlockUndo &blockUndo,
                                 const CBlock &block, const CBlockIndex *pindex,
-                                CCoinsViewCache &coins);
+                                CCoinsViewCache &coins,
+                                CCoinsCommitment *pcommitment = nullptr);
 
 #endif // BITCOIN_UNDO_H
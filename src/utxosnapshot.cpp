@@ -0,0 +1,77 @@
+// Copyright (c) 2018 The Title Network developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "utxosnapshot.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+
+static FILE *OpenSnapshot(const boost::filesystem::path &path) {
+    FILE *filestr = fopen(path.string().c_str(), "rb");
+    if (!filestr) {
+        throw std::ios_base::failure("Unable to open " + path.string());
+    }
+    return filestr;
+}
+
+CSnapshotWriter::CSnapshotWriter(const boost::filesystem::path &pathIn,
+                                 const CSnapshotMetadata &metadataIn)
+    : writer(pathIn, pathIn.string() + ".incomplete", SNAPSHOT_CHUNK_COINS,
+             metadataIn) {}
+
+CSnapshotReader::CSnapshotReader(const boost::filesystem::path &path)
+    : reader(OpenSnapshot(path), SNAPSHOT_CHUNK_COINS, "UTXO snapshot") {
+    ReadHeader();
+}
+
+void CSnapshotReader::ReadHeader() {
+    reader.ReadHeader(metadata);
+    hashUTXOSet.SetNull();
+}
+
+void CSnapshotReader::Rewind() {
+    reader.Rewind();
+    ReadHeader();
+}
+
+bool CSnapshotReader::ReadChunk(SnapshotChunk &vCoins) {
+    if (!reader.ReadChunk(vCoins, hashUTXOSet)) {
+        return false;
+    }
+    for (const std::pair<COutPoint, Coin> &entry : vCoins) {
+        if (entry.second.IsSpent()) {
+            throw std::ios_base::failure("Spent coin in UTXO snapshot");
+        }
+    }
+    return true;
+}
+
+void AddSnapshotChunk(CCoinsCommitment &commitment, const SnapshotChunk &vCoins,
+                      int nThreads) {
+    // Hashing a coin into the set takes a few microseconds, so only large
+    // chunks are worth the threads.
+    nThreads = std::max<int>(1, std::min<int>(nThreads, vCoins.size() / 1024));
+
+    std::vector<CCoinsCommitment> vCommitment(nThreads);
+    auto worker = [&](int nThread) {
+        size_t nBegin = vCoins.size() * nThread / nThreads;
+        size_t nEnd = vCoins.size() * (nThread + 1) / nThreads;
+        for (size_t i = nBegin; i < nEnd; i++) {
+            vCommitment[nThread].Add(vCoins[i].first, vCoins[i].second);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < nThreads; i++) {
+        threads.emplace_back(worker, i);
+    }
+    worker(0);
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    for (const CCoinsCommitment &part : vCommitment) {
+        commitment.Combine(part);
+    }
+}
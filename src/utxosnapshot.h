@@ -0,0 +1,134 @@
+// Copyright (c) 2018 The Title Network developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UTXOSNAPSHOT_H
+#define BITCOIN_UTXOSNAPSHOT_H
+
+#include "chunkedfile.h"
+#include "coins.h"
+#include "primitives/transaction.h"
+#include "protocol.h"
+#include "serialize.h"
+#include "streams.h"
+#include "uint256.h"
+
+#include <cstdint>
+#include <cstring>
+#include <ios>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+/** Coins per chunk of a UTXO snapshot file. */
+static const uint32_t SNAPSHOT_CHUNK_COINS = 1 << 16;
+
+/** The coins of one chunk of a UTXO snapshot file. */
+typedef std::vector<std::pair<COutPoint, Coin>> SnapshotChunk;
+
+/** Bytes a UTXO snapshot file starts with. */
+static const uint8_t SNAPSHOT_MAGIC[] = {'u', 't', 'x', 'o', 0xff};
+
+/**
+ * Header of a UTXO snapshot file, describing the UTXO set it holds. It is
+ * followed by the coins in chunks of up to SNAPSHOT_CHUNK_COINS, as written by
+ * CChunkedFileWriter, with the MuHash of the whole set as the trailer.
+ */
+class CSnapshotMetadata {
+public:
+    static const uint16_t CURRENT_VERSION = 1;
+
+    uint16_t nVersion;
+    CMessageHeader::MessageStartChars pchMessageStart;
+    //! Block the UTXO set was taken at.
+    uint256 hashBlock;
+    //! Number of transactions from genesis up to and including that block.
+    int64_t nChainTx;
+
+    CSnapshotMetadata() : nVersion(CURRENT_VERSION), nChainTx(0) {
+        memset(pchMessageStart, 0, sizeof(pchMessageStart));
+    }
+
+    template <typename Stream> void Serialize(Stream &s) const {
+        s.write((const char *)SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+        s << nVersion;
+        s.write((const char *)pchMessageStart, sizeof(pchMessageStart));
+        s << hashBlock;
+        s << nChainTx;
+    }
+
+    template <typename Stream> void Unserialize(Stream &s) {
+        uint8_t magic[sizeof(SNAPSHOT_MAGIC)];
+        s.read((char *)magic, sizeof(magic));
+        if (memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0) {
+            throw std::ios_base::failure("Not a UTXO snapshot file");
+        }
+        s >> nVersion;
+        if (nVersion != CURRENT_VERSION) {
+            throw std::ios_base::failure("Unsupported UTXO snapshot version");
+        }
+        s.read((char *)pchMessageStart, sizeof(pchMessageStart));
+        s >> hashBlock;
+        s >> nChainTx;
+    }
+};
+
+/**
+ * Writes a UTXO snapshot file. The file is written next to its final path and
+ * only moved there by Finish, so that an interrupted dump leaves nothing that
+ * looks like a snapshot. Errors are thrown as std::ios_base::failure.
+ */
+class CSnapshotWriter {
+private:
+    CChunkedFileWriter writer;
+
+public:
+    CSnapshotWriter(const boost::filesystem::path &pathIn,
+                    const CSnapshotMetadata &metadataIn);
+
+    void Add(const COutPoint &outpoint, const Coin &coin) {
+        writer.Add(outpoint, coin);
+    }
+    //! Write the last chunk and the MuHash of the set, and move the file into
+    //! place.
+    void Finish(const uint256 &hashUTXOSet) { writer.Finish(hashUTXOSet); }
+
+    uint64_t GetCoinsWritten() const { return writer.GetRecordsWritten(); }
+};
+
+/**
+ * Reads a UTXO snapshot file, verifying each chunk as it goes. Errors,
+ * including corruption, are thrown as std::ios_base::failure.
+ */
+class CSnapshotReader {
+private:
+    CChunkedFileReader reader;
+    CSnapshotMetadata metadata;
+    uint256 hashUTXOSet;
+
+    void ReadHeader();
+
+public:
+    explicit CSnapshotReader(const boost::filesystem::path &path);
+
+    const CSnapshotMetadata &GetMetadata() const { return metadata; }
+
+    //! Read the next chunk into vCoins. Returns false at the end of the file.
+    bool ReadChunk(SnapshotChunk &vCoins);
+    //! Go back to the first chunk.
+    void Rewind();
+
+    uint64_t GetCoinsRead() const { return reader.GetRecordsRead(); }
+    //! The MuHash of the set recorded at the end of the file, once ReadChunk
+    //! has returned false.
+    const uint256 &GetUTXOSetHash() const { return hashUTXOSet; }
+    //! The checksum of the last chunk read, which covers all before it.
+    const uint256 &GetChecksum() const { return reader.GetChecksum(); }
+};
+
+/** Add the coins of a chunk to a commitment, spread over nThreads threads. */
+void AddSnapshotChunk(CCoinsCommitment &commitment, const SnapshotChunk &vCoins,
+                      int nThreads);
+
+#endif // BITCOIN_UTXOSNAPSHOT_H
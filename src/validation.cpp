@@ -7,6 +7,7 @@
 #include "validation.h"
 
 #include "arith_uint256.h"
+#include "blockfilemap.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
@@ -14,8 +15,11 @@
 #include "consensus/consensus.h"
 #include "consensus/merkle.h"
 #include "consensus/validation.h"
+#include "crypto/common.h"
 #include "hash.h"
 #include "init.h"
+#include "mempooldump.h"
+#include "memusage.h"
 #include "policy/fees.h"
 #include "policy/policy.h"
 #include "pow.h"
@@ -35,12 +39,16 @@
 #include "util.h"
 #include "utilmoneystr.h"
 #include "utilstrencodings.h"
+#include "utxosnapshot.h"
 #include "validationinterface.h"
 #include "versionbits.h"
 #include "warnings.h"
 
 #include <atomic>
+#include <limits>
 #include <sstream>
+#include <thread>
+#include <unordered_set>
 
 #include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string/replace.hpp>
@@ -61,20 +69,25 @@
 CCriticalSection cs_main;
 
 BlockMap mapBlockIndex;
+//! Storage for the entries of mapBlockIndex. Protected by cs_main.
+static CBlockIndexArena blockIndexArena;
 CChain chainActive;
 CBlockIndex *pindexBestHeader = nullptr;
+CBlockIndex *pindexSnapshotBase = nullptr;
 CWaitableCriticalSection csBestBlock;
 CConditionVariable cvBlockChange;
 int nScriptCheckThreads = 0;
 std::atomic_bool fImporting(false);
 bool fReindex = false;
 bool fTxIndex = false;
+bool fCoinsCommitment = DEFAULT_UTXO_COMMITMENT;
 bool fHavePruned = false;
 bool fPruneMode = false;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
 bool fRequireStandard = true;
 bool fCheckBlockIndex = false;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
+bool fCheckBlockIndexPoW = DEFAULT_CHECKBLOCKINDEXPOW;
 size_t nCoinCacheUsage = 5000 * 300;
 uint64_t nPruneTarget = 0;
 int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
@@ -211,9 +224,19 @@ CBlockIndex *FindForkInGlobalIndex(const CChain &chain,
     return chain.Genesis();
 }
 
+CCoinsViewDB *pcoinsdbview = nullptr;
 CCoinsViewCache *pcoinsTip = nullptr;
+CCoinsViewBackgroundFlush *pcoinsFlusher = nullptr;
 CBlockTreeDB *pblocktree = nullptr;
 
+/**
+ * Commitment to the coins in pcoinsTip, kept up to date as blocks are
+ * connected and disconnected. Only valid once fHaveCoinsTipCommitment is set
+ * by LoadCoinsCommitment. Protected by cs_main.
+ */
+static CCoinsCommitment coinsTipCommitment;
+static bool fHaveCoinsTipCommitment = false;
+
 enum FlushStateMode {
     FLUSH_STATE_NONE,
     FLUSH_STATE_IF_NEEDED,
@@ -751,14 +774,72 @@ static bool CheckInputsFromMempoolAndCache(const CTransaction &tx,
                        txdata);
 }
 
-static bool AcceptToMemoryPoolWorker(
+namespace {
+
+/**
+ * A transaction on its way into the mempool: what the checks before its
+ * scripts work out, kept for the script checks and for the commit.
+ */
+struct MempoolAcceptWork {
+    CTransactionRef ptx;
+    CCoinsView viewDummy;
+    //! The coins spent by ptx, with the dummy as backend once they are in.
+    CCoinsViewCache view;
+    std::unique_ptr<CTxMemPoolEntry> pentry;
+    CTxMemPool::setEntries setAncestors;
+    //! The in-mempool transactions ptx spends.
+    std::vector<uint256> vMemPoolParents;
+    uint32_t scriptVerifyFlags;
+    PrecomputedTransactionData txdata;
+
+    //! Outcome of the script checks when they run on the mempool check queue.
+    bool fScriptsValid;
+    CValidationState stateScripts;
+
+    explicit MempoolAcceptWork(const CTransactionRef &ptxIn)
+        : ptx(ptxIn), view(&viewDummy), scriptVerifyFlags(SCRIPT_VERIFY_NONE),
+          fScriptsValid(false) {}
+};
+
+} // namespace
+
+static bool
+CalculateMemPoolAncestorsWithLimits(CTxMemPool &pool,
+                                    const CTxMemPoolEntry &entry,
+                                    CTxMemPool::setEntries &setAncestors,
+                                    std::string &errString) {
+    size_t nLimitAncestors =
+        GetArg("-limitancestorcount", DEFAULT_ANCESTOR_LIMIT);
+    size_t nLimitAncestorSize =
+        GetArg("-limitancestorsize", DEFAULT_ANCESTOR_SIZE_LIMIT) * 1000;
+    size_t nLimitDescendants =
+        GetArg("-limitdescendantcount", DEFAULT_DESCENDANT_LIMIT);
+    size_t nLimitDescendantSize =
+        GetArg("-limitdescendantsize", DEFAULT_DESCENDANT_SIZE_LIMIT) * 1000;
+    return pool.CalculateMemPoolAncestors(
+        entry, setAncestors, nLimitAncestors, nLimitAncestorSize,
+        nLimitDescendants, nLimitDescendantSize, errString);
+}
+
+static Amount GetMempoolRejectFee(CTxMemPool &pool, unsigned int nSize) {
+    return pool.GetMinFee(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) *
+                          1000000)
+        .GetFee(nSize)
+        .GetSatoshis();
+}
+
+/**
+ * Everything AcceptToMemoryPool checks before the scripts of the transaction:
+ * fills in ws up to the script verification flags.
+ */
+static bool AcceptToMemoryPoolPreChecks(
     const Config &config, CTxMemPool &pool, CValidationState &state,
-    const CTransactionRef &ptx, bool fLimitFree, bool *pfMissingInputs,
-    int64_t nAcceptTime, std::list<CTransactionRef> *plTxnReplaced,
-    bool fOverrideMempoolLimit, const Amount nAbsurdFee,
+    MempoolAcceptWork &ws, bool fLimitFree, bool *pfMissingInputs,
+    int64_t nAcceptTime, const Amount nAbsurdFee,
     std::vector<COutPoint> &coins_to_uncache) {
     AssertLockHeld(cs_main);
 
+    const CTransactionRef &ptx = ws.ptx;
     const CTransaction &tx = *ptx;
     const uint256 txid = tx.GetId();
     if (pfMissingInputs) {
@@ -810,282 +891,275 @@ static bool AcceptToMemoryPoolWorker(
         }
     }
 
+    CCoinsViewCache &view = ws.view;
+
+    Amount nValueIn = 0;
+    LockPoints lp;
     {
-        CCoinsView dummy;
-        CCoinsViewCache view(&dummy);
+        LOCK(pool.cs);
+        CCoinsViewMemPool viewMemPool(pcoinsTip, pool);
+        view.SetBackend(viewMemPool);
+
+        // Do we already have it?
+        for (size_t out = 0; out < tx.vout.size(); out++) {
+            COutPoint outpoint(txid, out);
+            bool had_coin_in_cache = pcoinsTip->HaveCoinInCache(outpoint);
+            if (view.HaveCoin(outpoint)) {
+                if (!had_coin_in_cache) {
+                    coins_to_uncache.push_back(outpoint);
+                }
 
-        Amount nValueIn = 0;
-        LockPoints lp;
-        {
-            LOCK(pool.cs);
-            CCoinsViewMemPool viewMemPool(pcoinsTip, pool);
-            view.SetBackend(viewMemPool);
-
-            // Do we already have it?
-            for (size_t out = 0; out < tx.vout.size(); out++) {
-                COutPoint outpoint(txid, out);
-                bool had_coin_in_cache = pcoinsTip->HaveCoinInCache(outpoint);
-                if (view.HaveCoin(outpoint)) {
-                    if (!had_coin_in_cache) {
-                        coins_to_uncache.push_back(outpoint);
-                    }
+                return state.Invalid(false, REJECT_ALREADY_KNOWN,
+                                     "txn-already-known");
+            }
+        }
 
-                    return state.Invalid(false, REJECT_ALREADY_KNOWN,
-                                         "txn-already-known");
-                }
+        // Do all inputs exist?
+        for (const CTxIn txin : tx.vin) {
+            if (!pcoinsTip->HaveCoinInCache(txin.prevout)) {
+                coins_to_uncache.push_back(txin.prevout);
             }
 
-            // Do all inputs exist?
-            for (const CTxIn txin : tx.vin) {
-                if (!pcoinsTip->HaveCoinInCache(txin.prevout)) {
-                    coins_to_uncache.push_back(txin.prevout);
+            if (!view.HaveCoin(txin.prevout)) {
+                if (pfMissingInputs) {
+                    *pfMissingInputs = true;
                 }
 
-                if (!view.HaveCoin(txin.prevout)) {
-                    if (pfMissingInputs) {
-                        *pfMissingInputs = true;
-                    }
-
-                    // fMissingInputs and !state.IsInvalid() is used to detect
-                    // this condition, don't set state.Invalid()
-                    return false;
-                }
+                // fMissingInputs and !state.IsInvalid() is used to detect
+                // this condition, don't set state.Invalid()
+                return false;
             }
 
-            // Are the actual inputs available?
-            if (!view.HaveInputs(tx)) {
-                return state.Invalid(false, REJECT_DUPLICATE,
-                                     "bad-txns-inputs-spent");
+            if (pool.exists(txin.prevout.hash)) {
+                ws.vMemPoolParents.push_back(txin.prevout.hash);
             }
+        }
 
-            // Bring the best block into scope.
-            view.GetBestBlock();
+        // Are the actual inputs available?
+        if (!view.HaveInputs(tx)) {
+            return state.Invalid(false, REJECT_DUPLICATE,
+                                 "bad-txns-inputs-spent");
+        }
 
-            nValueIn = view.GetValueIn(tx);
+        // Bring the best block into scope.
+        view.GetBestBlock();
 
-            // We have all inputs cached now, so switch back to dummy, so we
-            // don't need to keep lock on mempool.
-            view.SetBackend(dummy);
+        nValueIn = view.GetValueIn(tx);
 
-            // Only accept BIP68 sequence locked transactions that can be mined
-            // in the next block; we don't want our mempool filled up with
-            // transactions that can't be mined yet. Must keep pool.cs for this
-            // unless we change CheckSequenceLocks to take a CoinsViewCache
-            // instead of create its own.
-            if (!CheckSequenceLocks(tx, STANDARD_LOCKTIME_VERIFY_FLAGS, &lp)) {
-                return state.DoS(0, false, REJECT_NONSTANDARD,
-                                 "non-BIP68-final");
-            }
-        }
+        // We have all inputs cached now, so switch back to dummy, so we
+        // don't need to keep lock on mempool.
+        view.SetBackend(ws.viewDummy);
 
-        // Check for non-standard pay-to-script-hash in inputs
-        if (fRequireStandard && !AreInputsStandard(tx, view)) {
-            return state.Invalid(false, REJECT_NONSTANDARD,
-                                 "bad-txns-nonstandard-inputs");
+        // Only accept BIP68 sequence locked transactions that can be mined
+        // in the next block; we don't want our mempool filled up with
+        // transactions that can't be mined yet. Must keep pool.cs for this
+        // unless we change CheckSequenceLocks to take a CoinsViewCache
+        // instead of create its own.
+        if (!CheckSequenceLocks(tx, STANDARD_LOCKTIME_VERIFY_FLAGS, &lp)) {
+            return state.DoS(0, false, REJECT_NONSTANDARD, "non-BIP68-final");
         }
+    }
 
-        int64_t nSigOpsCount =
-            GetTransactionSigOpCount(tx, view, STANDARD_SCRIPT_VERIFY_FLAGS);
+    // Check for non-standard pay-to-script-hash in inputs
+    if (fRequireStandard && !AreInputsStandard(tx, view)) {
+        return state.Invalid(false, REJECT_NONSTANDARD,
+                             "bad-txns-nonstandard-inputs");
+    }
 
-        Amount nValueOut = tx.GetValueOut();
-        Amount nFees = nValueIn - nValueOut;
-        // nModifiedFees includes any fee deltas from PrioritiseTransaction
-        Amount nModifiedFees = nFees;
-        double nPriorityDummy = 0;
-        pool.ApplyDeltas(txid, nPriorityDummy, nModifiedFees);
+    int64_t nSigOpsCount =
+        GetTransactionSigOpCount(tx, view, STANDARD_SCRIPT_VERIFY_FLAGS);
 
-        Amount inChainInputValue;
-        double dPriority =
-            view.GetPriority(tx, chainActive.Height(), inChainInputValue);
+    Amount nValueOut = tx.GetValueOut();
+    Amount nFees = nValueIn - nValueOut;
+    // nModifiedFees includes any fee deltas from PrioritiseTransaction
+    Amount nModifiedFees = nFees;
+    double nPriorityDummy = 0;
+    pool.ApplyDeltas(txid, nPriorityDummy, nModifiedFees);
 
-        // Keep track of transactions that spend a coinbase, which we re-scan
-        // during reorgs to ensure COINBASE_MATURITY is still met.
-        bool fSpendsCoinbase = false;
-        for (const CTxIn &txin : tx.vin) {
-            const Coin &coin = view.AccessCoin(txin.prevout);
-            if (coin.IsCoinBase()) {
-                fSpendsCoinbase = true;
-                break;
-            }
+    Amount inChainInputValue;
+    double dPriority =
+        view.GetPriority(tx, chainActive.Height(), inChainInputValue);
+
+    // Keep track of transactions that spend a coinbase, which we re-scan
+    // during reorgs to ensure COINBASE_MATURITY is still met.
+    bool fSpendsCoinbase = false;
+    for (const CTxIn &txin : tx.vin) {
+        const Coin &coin = view.AccessCoin(txin.prevout);
+        if (coin.IsCoinBase()) {
+            fSpendsCoinbase = true;
+            break;
         }
+    }
 
-        CTxMemPoolEntry entry(ptx, nFees.GetSatoshis(), nAcceptTime, dPriority,
-                              chainActive.Height(),
-                              inChainInputValue.GetSatoshis(), fSpendsCoinbase,
-                              nSigOpsCount, lp);
-        unsigned int nSize = entry.GetTxSize();
-
-        // Check that the transaction doesn't have an excessive number of
-        // sigops, making it impossible to mine. Since the coinbase transaction
-        // itself can contain sigops MAX_STANDARD_TX_SIGOPS is less than
-        // MAX_BLOCK_SIGOPS_PER_MB; we still consider this an invalid rather
-        // than merely non-standard transaction.
-        if (nSigOpsCount > MAX_STANDARD_TX_SIGOPS) {
-            return state.DoS(0, false, REJECT_NONSTANDARD,
-                             "bad-txns-too-many-sigops", false,
-                             strprintf("%d", nSigOpsCount));
-        }
-
-        Amount mempoolRejectFee =
-            pool.GetMinFee(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) *
-                           1000000)
-                .GetFee(nSize)
-                .GetSatoshis();
-        if (mempoolRejectFee > 0 && nModifiedFees < mempoolRejectFee) {
+    ws.pentry.reset(new CTxMemPoolEntry(
+        ptx, nFees.GetSatoshis(), nAcceptTime, dPriority, chainActive.Height(),
+        inChainInputValue.GetSatoshis(), fSpendsCoinbase, nSigOpsCount, lp));
+    const CTxMemPoolEntry &entry = *ws.pentry;
+    unsigned int nSize = entry.GetTxSize();
+
+    // Check that the transaction doesn't have an excessive number of
+    // sigops, making it impossible to mine. Since the coinbase transaction
+    // itself can contain sigops MAX_STANDARD_TX_SIGOPS is less than
+    // MAX_BLOCK_SIGOPS_PER_MB; we still consider this an invalid rather
+    // than merely non-standard transaction.
+    if (nSigOpsCount > MAX_STANDARD_TX_SIGOPS) {
+        return state.DoS(0, false, REJECT_NONSTANDARD,
+                         "bad-txns-too-many-sigops", false,
+                         strprintf("%d", nSigOpsCount));
+    }
+
+    Amount mempoolRejectFee = GetMempoolRejectFee(pool, nSize);
+    if (mempoolRejectFee > 0 && nModifiedFees < mempoolRejectFee) {
+        return state.DoS(0, false, REJECT_INSUFFICIENTFEE,
+                         "mempool min fee not met", false,
+                         strprintf("%d < %d", nFees, mempoolRejectFee));
+    }
+
+    if (GetBoolArg("-relaypriority", DEFAULT_RELAYPRIORITY) &&
+        nModifiedFees < ::minRelayTxFee.GetFee(nSize) &&
+        !AllowFree(entry.GetPriority(chainActive.Height() + 1))) {
+        // Require that free transactions have sufficient priority to be
+        // mined in the next block.
+        return state.DoS(0, false, REJECT_INSUFFICIENTFEE,
+                         "insufficient priority");
+    }
+
+    // Continuously rate-limit free (really, very-low-fee) transactions.
+    // This mitigates 'penny-flooding' -- sending thousands of free
+    // transactions just to be annoying or make others' transactions take
+    // longer to confirm.
+    if (fLimitFree && nModifiedFees < ::minRelayTxFee.GetFee(nSize)) {
+        static CCriticalSection csFreeLimiter;
+        static double dFreeCount;
+        static int64_t nLastTime;
+        int64_t nNow = GetTime();
+
+        LOCK(csFreeLimiter);
+
+        // Use an exponentially decaying ~10-minute window:
+        dFreeCount *= pow(1.0 - 1.0 / 600.0, double(nNow - nLastTime));
+        nLastTime = nNow;
+        // -limitfreerelay unit is thousand-bytes-per-minute
+        // At default rate it would take over a month to fill 1GB
+        if (dFreeCount + nSize >=
+            GetArg("-limitfreerelay", DEFAULT_LIMITFREERELAY) * 10 * 1000) {
             return state.DoS(0, false, REJECT_INSUFFICIENTFEE,
-                             "mempool min fee not met", false,
-                             strprintf("%d < %d", nFees, mempoolRejectFee));
+                             "rate limited free transaction");
         }
 
-        if (GetBoolArg("-relaypriority", DEFAULT_RELAYPRIORITY) &&
-            nModifiedFees < ::minRelayTxFee.GetFee(nSize) &&
-            !AllowFree(entry.GetPriority(chainActive.Height() + 1))) {
-            // Require that free transactions have sufficient priority to be
-            // mined in the next block.
-            return state.DoS(0, false, REJECT_INSUFFICIENTFEE,
-                             "insufficient priority");
-        }
-
-        // Continuously rate-limit free (really, very-low-fee) transactions.
-        // This mitigates 'penny-flooding' -- sending thousands of free
-        // transactions just to be annoying or make others' transactions take
-        // longer to confirm.
-        if (fLimitFree && nModifiedFees < ::minRelayTxFee.GetFee(nSize)) {
-            static CCriticalSection csFreeLimiter;
-            static double dFreeCount;
-            static int64_t nLastTime;
-            int64_t nNow = GetTime();
-
-            LOCK(csFreeLimiter);
-
-            // Use an exponentially decaying ~10-minute window:
-            dFreeCount *= pow(1.0 - 1.0 / 600.0, double(nNow - nLastTime));
-            nLastTime = nNow;
-            // -limitfreerelay unit is thousand-bytes-per-minute
-            // At default rate it would take over a month to fill 1GB
-            if (dFreeCount + nSize >=
-                GetArg("-limitfreerelay", DEFAULT_LIMITFREERELAY) * 10 * 1000) {
-                return state.DoS(0, false, REJECT_INSUFFICIENTFEE,
-                                 "rate limited free transaction");
-            }
+        LogPrint(BCLog::MEMPOOL, "Rate limit dFreeCount: %g => %g\n",
+                 dFreeCount, dFreeCount + nSize);
+        dFreeCount += nSize;
+    }
 
-            LogPrint(BCLog::MEMPOOL, "Rate limit dFreeCount: %g => %g\n",
-                     dFreeCount, dFreeCount + nSize);
-            dFreeCount += nSize;
-        }
-
-        if (nAbsurdFee != 0 && nFees > nAbsurdFee) {
-            return state.Invalid(false, REJECT_HIGHFEE, "absurdly-high-fee",
-                                 strprintf("%d > %d", nFees, nAbsurdFee));
-        }
-
-        // Calculate in-mempool ancestors, up to a limit.
-        CTxMemPool::setEntries setAncestors;
-        size_t nLimitAncestors =
-            GetArg("-limitancestorcount", DEFAULT_ANCESTOR_LIMIT);
-        size_t nLimitAncestorSize =
-            GetArg("-limitancestorsize", DEFAULT_ANCESTOR_SIZE_LIMIT) * 1000;
-        size_t nLimitDescendants =
-            GetArg("-limitdescendantcount", DEFAULT_DESCENDANT_LIMIT);
-        size_t nLimitDescendantSize =
-            GetArg("-limitdescendantsize", DEFAULT_DESCENDANT_SIZE_LIMIT) *
-            1000;
-        std::string errString;
-        if (!pool.CalculateMemPoolAncestors(
-                entry, setAncestors, nLimitAncestors, nLimitAncestorSize,
-                nLimitDescendants, nLimitDescendantSize, errString)) {
-            return state.DoS(0, false, REJECT_NONSTANDARD,
-                             "too-long-mempool-chain", false, errString);
-        }
-
-        // Set extraFlags as a set of flags that needs to be activated.
-        uint32_t extraFlags = SCRIPT_VERIFY_NONE;
-        if (IsReplayProtectionEnabledForCurrentBlock(config)) {
-            extraFlags |= SCRIPT_ENABLE_REPLAY_PROTECTION;
-        }
-
-        // Check inputs based on the set of flags we activate.
-        uint32_t scriptVerifyFlags = STANDARD_SCRIPT_VERIFY_FLAGS;
-        if (!config.GetChainParams().RequireStandard()) {
-            scriptVerifyFlags =
-                SCRIPT_ENABLE_SIGHASH_FORKID |
-                gArgs.GetArg("-promiscuousmempoolflags", scriptVerifyFlags);
-        }
-
-        // Make sure whatever we need to activate is actually activated.
-        scriptVerifyFlags |= extraFlags;
-
-        // Check against previous transactions. This is done last to help
-        // prevent CPU exhaustion denial-of-service attacks.
-        PrecomputedTransactionData txdata(tx);
-        if (!CheckInputs(tx, state, view, true, scriptVerifyFlags, true, false,
-                         txdata)) {
-            // State filled in by CheckInputs.
-            return false;
-        }
+    if (nAbsurdFee != 0 && nFees > nAbsurdFee) {
+        return state.Invalid(false, REJECT_HIGHFEE, "absurdly-high-fee",
+                             strprintf("%d > %d", nFees, nAbsurdFee));
+    }
 
-        // Check again against the current block tip's script verification flags
-        // to cache our script execution flags. This is, of course, useless if
-        // the next block has different script flags from the previous one, but
-        // because the cache tracks script flags for us it will auto-invalidate
-        // and we'll just have a few blocks of extra misses on soft-fork
-        // activation.
-        //
-        // This is also useful in case of bugs in the standard flags that cause
-        // transactions to pass as valid when they're actually invalid. For
-        // instance the STRICTENC flag was incorrectly allowing certain CHECKSIG
-        // NOT scripts to pass, even though they were invalid.
-        //
-        // There is a similar check in CreateNewBlock() to prevent creating
-        // invalid blocks (using TestBlockValidity), however allowing such
-        // transactions into the mempool can be exploited as a DoS attack.
-        uint32_t currentBlockScriptVerifyFlags =
-            GetBlockScriptFlags(config, chainActive.Tip());
-        if (!CheckInputsFromMempoolAndCache(tx, state, view, pool,
-                                            currentBlockScriptVerifyFlags, true,
-                                            txdata)) {
-            // If we're using promiscuousmempoolflags, we may hit this normally.
-            // Check if current block has some flags that scriptVerifyFlags does
-            // not before printing an ominous warning.
-            if (!(~scriptVerifyFlags & currentBlockScriptVerifyFlags)) {
-                return error(
-                    "%s: BUG! PLEASE REPORT THIS! ConnectInputs failed against "
-                    "MANDATORY but not STANDARD flags %s, %s",
-                    __func__, txid.ToString(), FormatStateMessage(state));
-            }
+    // Calculate in-mempool ancestors, up to a limit.
+    std::string errString;
+    if (!CalculateMemPoolAncestorsWithLimits(pool, entry, ws.setAncestors,
+                                             errString)) {
+        return state.DoS(0, false, REJECT_NONSTANDARD, "too-long-mempool-chain",
+                         false, errString);
+    }
 
-            if (!CheckInputs(tx, state, view, true,
-                             MANDATORY_SCRIPT_VERIFY_FLAGS, true, false,
-                             txdata)) {
-                return error(
-                    "%s: ConnectInputs failed against MANDATORY but not "
-                    "STANDARD flags due to promiscuous mempool %s, %s",
-                    __func__, txid.ToString(), FormatStateMessage(state));
-            }
+    // Set extraFlags as a set of flags that needs to be activated.
+    uint32_t extraFlags = SCRIPT_VERIFY_NONE;
+    if (IsReplayProtectionEnabledForCurrentBlock(config)) {
+        extraFlags |= SCRIPT_ENABLE_REPLAY_PROTECTION;
+    }
+
+    // Check inputs based on the set of flags we activate.
+    ws.scriptVerifyFlags = STANDARD_SCRIPT_VERIFY_FLAGS;
+    if (!config.GetChainParams().RequireStandard()) {
+        ws.scriptVerifyFlags =
+            SCRIPT_ENABLE_SIGHASH_FORKID |
+            gArgs.GetArg("-promiscuousmempoolflags", ws.scriptVerifyFlags);
+    }
+
+    // Make sure whatever we need to activate is actually activated.
+    ws.scriptVerifyFlags |= extraFlags;
+
+    ws.txdata = PrecomputedTransactionData(tx);
+    return true;
+}
+
+/**
+ * Add a transaction whose scripts passed with ws.scriptVerifyFlags to the
+ * mempool, after checking it against the flags of the current tip.
+ */
+static bool AcceptToMemoryPoolFinalize(const Config &config, CTxMemPool &pool,
+                                       CValidationState &state,
+                                       MempoolAcceptWork &ws,
+                                       bool fOverrideMempoolLimit) {
+    AssertLockHeld(cs_main);
+
+    const CTransaction &tx = *ws.ptx;
+    const uint256 txid = tx.GetId();
 
-            LogPrintf("Warning: -promiscuousmempool flags set to not include "
-                      "currently enforced soft forks, this may break mining or "
-                      "otherwise cause instability!\n");
+    // Check again against the current block tip's script verification flags
+    // to cache our script execution flags. This is, of course, useless if
+    // the next block has different script flags from the previous one, but
+    // because the cache tracks script flags for us it will auto-invalidate
+    // and we'll just have a few blocks of extra misses on soft-fork
+    // activation.
+    //
+    // This is also useful in case of bugs in the standard flags that cause
+    // transactions to pass as valid when they're actually invalid. For
+    // instance the STRICTENC flag was incorrectly allowing certain CHECKSIG
+    // NOT scripts to pass, even though they were invalid.
+    //
+    // There is a similar check in CreateNewBlock() to prevent creating
+    // invalid blocks (using TestBlockValidity), however allowing such
+    // transactions into the mempool can be exploited as a DoS attack.
+    uint32_t currentBlockScriptVerifyFlags =
+        GetBlockScriptFlags(config, chainActive.Tip());
+    if (!CheckInputsFromMempoolAndCache(tx, state, ws.view, pool,
+                                        currentBlockScriptVerifyFlags, true,
+                                        ws.txdata)) {
+        // If we're using promiscuousmempoolflags, we may hit this normally.
+        // Check if current block has some flags that scriptVerifyFlags does
+        // not before printing an ominous warning.
+        if (!(~ws.scriptVerifyFlags & currentBlockScriptVerifyFlags)) {
+            return error(
+                "%s: BUG! PLEASE REPORT THIS! ConnectInputs failed against "
+                "MANDATORY but not STANDARD flags %s, %s",
+                __func__, txid.ToString(), FormatStateMessage(state));
         }
 
-        // This transaction should only count for fee estimation if
-        // the node is not behind and it is not dependent on any other
-        // transactions in the mempool.
-        bool validForFeeEstimation =
-            IsCurrentForFeeEstimation() && pool.HasNoInputsOf(tx);
+        if (!CheckInputs(tx, state, ws.view, true,
+                         MANDATORY_SCRIPT_VERIFY_FLAGS, true, false,
+                         ws.txdata)) {
+            return error(
+                "%s: ConnectInputs failed against MANDATORY but not "
+                "STANDARD flags due to promiscuous mempool %s, %s",
+                __func__, txid.ToString(), FormatStateMessage(state));
+        }
 
-        // Store transaction in memory.
-        pool.addUnchecked(txid, entry, setAncestors, validForFeeEstimation);
+        LogPrintf("Warning: -promiscuousmempool flags set to not include "
+                  "currently enforced soft forks, this may break mining or "
+                  "otherwise cause instability!\n");
+    }
 
-        // Trim mempool and check if tx was trimmed.
-        if (!fOverrideMempoolLimit) {
-            LimitMempoolSize(
-                pool, GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000,
-                GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
-            if (!pool.exists(txid)) {
-                return state.DoS(0, false, REJECT_INSUFFICIENTFEE,
-                                 "mempool full");
-            }
+    // This transaction should only count for fee estimation if
+    // the node is not behind and it is not dependent on any other
+    // transactions in the mempool.
+    bool validForFeeEstimation =
+        IsCurrentForFeeEstimation() && pool.HasNoInputsOf(tx);
+
+    // Store transaction in memory.
+    pool.addUnchecked(txid, *ws.pentry, ws.setAncestors,
+                      validForFeeEstimation);
+
+    // Trim mempool and check if tx was trimmed.
+    if (!fOverrideMempoolLimit) {
+        LimitMempoolSize(
+            pool, GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000,
+            GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
+        if (!pool.exists(txid)) {
+            return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool full");
         }
     }
 
@@ -1095,6 +1169,33 @@ static bool AcceptToMemoryPoolWorker(
     return true;
 }
 
+static bool AcceptToMemoryPoolWorker(
+    const Config &config, CTxMemPool &pool, CValidationState &state,
+    const CTransactionRef &ptx, bool fLimitFree, bool *pfMissingInputs,
+    int64_t nAcceptTime, std::list<CTransactionRef> *plTxnReplaced,
+    bool fOverrideMempoolLimit, const Amount nAbsurdFee,
+    std::vector<COutPoint> &coins_to_uncache) {
+    AssertLockHeld(cs_main);
+
+    MempoolAcceptWork ws(ptx);
+    if (!AcceptToMemoryPoolPreChecks(config, pool, state, ws, fLimitFree,
+                                     pfMissingInputs, nAcceptTime, nAbsurdFee,
+                                     coins_to_uncache)) {
+        return false;
+    }
+
+    // Check against previous transactions. This is done last to help
+    // prevent CPU exhaustion denial-of-service attacks.
+    if (!CheckInputs(*ptx, state, ws.view, true, ws.scriptVerifyFlags, true,
+                     false, ws.txdata)) {
+        // State filled in by CheckInputs.
+        return false;
+    }
+
+    return AcceptToMemoryPoolFinalize(config, pool, state, ws,
+                                      fOverrideMempoolLimit);
+}
+
 static bool AcceptToMemoryPoolWithTime(
     const Config &config, CTxMemPool &pool, CValidationState &state,
     const CTransactionRef &tx, bool fLimitFree, bool *pfMissingInputs,
@@ -1216,20 +1317,62 @@ bool WriteBlockToDisk(const CBlock &block, CDiskBlockPos &pos,
     return true;
 }
 
+static CBlockFileMapCache blockFileMapCache;
+
+void InitBlockFileMapping(size_t nMaxFiles) {
+    blockFileMapCache.SetMaxFiles(nMaxFiles);
+}
+
+/**
+ * Deserialize the block at pos straight from a mapping of its block file.
+ * Returns false, leaving the caller to read it through stdio, if mapping is
+ * disabled or the file cannot be mapped.
+ */
+static bool ReadBlockFromMappedFile(CBlock &block, const CDiskBlockPos &pos) {
+    // The block is preceded by the network magic and its size.
+    if (!blockFileMapCache.IsEnabled() || pos.nPos < 8) {
+        return false;
+    }
+
+    boost::filesystem::path path = GetBlockPosFilename(pos, "blk");
+    std::shared_ptr<const CMappedFile> file =
+        blockFileMapCache.Get(pos.nFile, path, pos.nPos);
+    if (!file) {
+        return false;
+    }
+
+    uint64_t nEnd = uint64_t(pos.nPos) + ReadLE32(file->data() + pos.nPos - 4);
+    if (nEnd > file->size()) {
+        // The file has grown since it was mapped.
+        file = blockFileMapCache.Get(pos.nFile, path, nEnd);
+        if (!file) {
+            return false;
+        }
+    }
+
+    CBufferReader reader(SER_DISK, CLIENT_VERSION, file->data() + pos.nPos,
+                         file->data() + nEnd);
+    reader >> block;
+    return true;
+}
+
 bool ReadBlockFromDisk(CBlock &block, const CDiskBlockPos &pos,
                        const int nHeight,
                        const Consensus::Params &consensusParams) {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s",
-                     pos.ToString());
-
     // Read block
     try {
-        filein >> block;
+        if (!ReadBlockFromMappedFile(block, pos)) {
+            // Open history file to read
+            CAutoFile filein(OpenBlockFile(pos, true), SER_DISK,
+                             CLIENT_VERSION);
+            if (filein.IsNull())
+                return error("ReadBlockFromDisk: OpenBlockFile failed for %s",
+                             pos.ToString());
+
+            filein >> block;
+        }
     } catch (const std::exception &e) {
         return error("%s: Deserialize or I/O error - %s at %s", __func__,
                      e.what(), pos.ToString());
@@ -1454,7 +1597,8 @@ static void InvalidBlockFound(CBlockIndex *pindex,
 }
 
 void UpdateCoins(const CTransaction &tx, CCoinsViewCache &inputs,
-                 CTxUndo &txundo, int nHeight) {
+                 CTxUndo &txundo, int nHeight,
+                 CCoinsCommitment *pcommitment) {
     // Mark inputs spent.
     if (!tx.IsCoinBase()) {
         txundo.vprevout.reserve(tx.vin.size());
@@ -1463,6 +1607,27 @@ void UpdateCoins(const CTransaction &tx, CCoinsViewCache &inputs,
             bool is_spent =
                 inputs.SpendCoin(txin.prevout, &txundo.vprevout.back());
             assert(is_spent);
+            if (pcommitment) {
+                pcommitment->Remove(txin.prevout, txundo.vprevout.back());
+            }
+        }
+    }
+
+    if (pcommitment) {
+        const uint256 &txid = tx.GetId();
+        for (size_t i = 0; i < tx.vout.size(); i++) {
+            if (tx.vout[i].scriptPubKey.IsUnspendable()) {
+                continue;
+            }
+            COutPoint out(txid, i);
+            if (tx.IsCoinBase()) {
+                // Only coinbases may overwrite an existing coin.
+                const Coin &coin = inputs.AccessCoin(out);
+                if (!coin.IsSpent()) {
+                    pcommitment->Remove(out, coin);
+                }
+            }
+            pcommitment->Add(out, Coin(tx.vout[i], nHeight, tx.IsCoinBase()));
         }
     }
 
@@ -1548,43 +1713,15 @@ bool CheckTxInputs(const CTransaction &tx, CValidationState &state,
 }
 } // namespace Consensus
 
-bool CheckInputs(const CTransaction &tx, CValidationState &state,
-                 const CCoinsViewCache &inputs, bool fScriptChecks,
-                 uint32_t flags, bool sigCacheStore, bool scriptCacheStore,
-                 const PrecomputedTransactionData &txdata,
-                 std::vector<CScriptCheck> *pvChecks) {
-    assert(!tx.IsCoinBase());
-
-    if (!Consensus::CheckTxInputs(tx, state, inputs, GetSpendHeight(inputs))) {
-        return false;
-    }
-
-    if (pvChecks) {
-        pvChecks->reserve(tx.vin.size());
-    }
-
-    // The first loop above does all the inexpensive checks. Only if ALL inputs
-    // pass do we perform expensive ECDSA signature checks. Helps prevent CPU
-    // exhaustion attacks.
-
-    // Skip script verification when connecting blocks under the assumedvalid
-    // block. Assuming the assumedvalid block is valid this is safe because
-    // block merkle hashes are still computed and checked, of course, if an
-    // assumed valid block is invalid due to false scriptSigs this optimization
-    // would allow an invalid chain to be accepted.
-    if (!fScriptChecks) {
-        return true;
-    }
-
-    // First check if script executions have been cached with the same flags.
-    // Note that this assumes that the inputs provided are correct (ie that the
-    // transaction hash which is in tx's prevouts properly commits to the
-    // scriptPubKey in the inputs view of that transaction).
-    uint256 hashCacheEntry = GetScriptCacheKey(tx, flags);
-    if (IsKeyInScriptCache(hashCacheEntry, !scriptCacheStore)) {
-        return true;
-    }
-
+/**
+ * Run or queue the script checks of every input of tx, which CheckInputs does
+ * once the inputs themselves have been checked.
+ */
+static bool CheckInputScripts(const CTransaction &tx, CValidationState &state,
+                              const CCoinsViewCache &inputs, uint32_t flags,
+                              bool sigCacheStore,
+                              const PrecomputedTransactionData &txdata,
+                              std::vector<CScriptCheck> *pvChecks) {
     for (size_t i = 0; i < tx.vin.size(); i++) {
         const COutPoint &prevout = tx.vin[i].prevout;
         const Coin &coin = inputs.AccessCoin(prevout);
@@ -1635,6 +1772,51 @@ bool CheckInputs(const CTransaction &tx, CValidationState &state,
         }
     }
 
+    return true;
+}
+
+bool CheckInputs(const CTransaction &tx, CValidationState &state,
+                 const CCoinsViewCache &inputs, bool fScriptChecks,
+                 uint32_t flags, bool sigCacheStore, bool scriptCacheStore,
+                 const PrecomputedTransactionData &txdata,
+                 std::vector<CScriptCheck> *pvChecks) {
+    assert(!tx.IsCoinBase());
+
+    if (!Consensus::CheckTxInputs(tx, state, inputs, GetSpendHeight(inputs))) {
+        return false;
+    }
+
+    if (pvChecks) {
+        pvChecks->reserve(tx.vin.size());
+    }
+
+    // The first loop above does all the inexpensive checks. Only if ALL inputs
+    // pass do we perform expensive ECDSA signature checks. Helps prevent CPU
+    // exhaustion attacks.
+
+    // Skip script verification when connecting blocks under the assumedvalid
+    // block. Assuming the assumedvalid block is valid this is safe because
+    // block merkle hashes are still computed and checked, of course, if an
+    // assumed valid block is invalid due to false scriptSigs this optimization
+    // would allow an invalid chain to be accepted.
+    if (!fScriptChecks) {
+        return true;
+    }
+
+    // First check if script executions have been cached with the same flags.
+    // Note that this assumes that the inputs provided are correct (ie that the
+    // transaction hash which is in tx's prevouts properly commits to the
+    // scriptPubKey in the inputs view of that transaction).
+    uint256 hashCacheEntry = GetScriptCacheKey(tx, flags);
+    if (IsKeyInScriptCache(hashCacheEntry, !scriptCacheStore)) {
+        return true;
+    }
+
+    if (!CheckInputScripts(tx, state, inputs, flags, sigCacheStore, txdata,
+                           pvChecks)) {
+        return false;
+    }
+
     if (scriptCacheStore && !pvChecks) {
         // We executed all of the provided scripts, and were told to cache the
         // result. Do so now.
@@ -1644,59 +1826,199 @@ bool CheckInputs(const CTransaction &tx, CValidationState &state,
     return true;
 }
 
+void SerializeBlockUndo(const CBlockUndo &blockundo,
+                        std::vector<uint8_t> &vData) {
+    CVectorWriter(SER_DISK, CLIENT_VERSION | SERIALIZE_UNDO_COMPACT, vData,
+                  vData.size(), UNDO_FORMAT_MARKER, UNDO_FORMAT_VERSION,
+                  blockundo);
+}
+
+size_t GetBlockUndoSize(const CBlockUndo &blockundo) {
+    return 2 + ::GetSerializeSize(blockundo, SER_DISK,
+                                  CLIENT_VERSION | SERIALIZE_UNDO_COMPACT);
+}
+
+void UnserializeBlockUndo(CBlockUndo &blockundo, const uint8_t *pbegin,
+                          const uint8_t *pend) {
+    int nVersion = CLIENT_VERSION;
+    if (pbegin != pend && *pbegin == UNDO_FORMAT_MARKER) {
+        if (pend - pbegin < 2 || pbegin[1] != UNDO_FORMAT_VERSION) {
+            throw std::ios_base::failure("Unknown undo format");
+        }
+        pbegin += 2;
+        nVersion |= SERIALIZE_UNDO_COMPACT;
+    }
+    CBufferReader reader(SER_DISK, nVersion, pbegin, pend);
+    reader >> blockundo;
+    if (!reader.empty()) {
+        throw std::ios_base::failure("Trailing undo data");
+    }
+}
+
 namespace {
 
+/**
+ * Undo data waiting to be written to the undo files. Instead of opening,
+ * seeking in and writing to the undo file for every connected block, records
+ * that follow each other in one file are collected here and written together
+ * once there is MAX_UNDO_BATCH_SIZE of them, once a record for another place
+ * comes in, or once FlushBlockFile is about to commit the undo file. The block
+ * index is written after FlushBlockFile, so it never points at undo data that
+ * is not on disk yet.
+ */
+class CUndoBatch {
+private:
+    CCriticalSection cs;
+    int nFile;
+    //! Position of the first byte of vData in the file.
+    unsigned int nPos;
+    std::vector<uint8_t> vData;
+
+    bool WriteLocked() {
+        if (vData.empty()) {
+            return true;
+        }
+        FILE *file = OpenUndoFile(CDiskBlockPos(nFile, nPos));
+        if (!file) {
+            return error("%s: OpenUndoFile failed", __func__);
+        }
+        size_t nWritten = fwrite(vData.data(), 1, vData.size(), file);
+        if (fclose(file) != 0 || nWritten != vData.size()) {
+            return error("%s: Failed to write to rev%05u.dat", __func__,
+                         nFile);
+        }
+        vData.clear();
+        return true;
+    }
+
+public:
+    CUndoBatch() : nFile(-1), nPos(0) {}
+
+    /** Add the undo record that belongs at pos. */
+    bool Append(const CDiskBlockPos &pos, const std::vector<uint8_t> &vRecord) {
+        LOCK(cs);
+        if (pos.nFile != nFile || pos.nPos != nPos + vData.size()) {
+            if (!WriteLocked()) {
+                return false;
+            }
+            nFile = pos.nFile;
+            nPos = pos.nPos;
+        }
+        vData.insert(vData.end(), vRecord.begin(), vRecord.end());
+        return vData.size() < MAX_UNDO_BATCH_SIZE || WriteLocked();
+    }
+
+    bool Write() {
+        LOCK(cs);
+        return WriteLocked();
+    }
+
+    /**
+     * Copy the undo data at pos and its checksum to vRecord, if the record is
+     * still in the batch.
+     */
+    bool Read(const CDiskBlockPos &pos, std::vector<uint8_t> &vRecord) {
+        LOCK(cs);
+        // The undo data is preceded by the network magic and its size.
+        if (pos.nFile != nFile || pos.nPos < nPos + 8 ||
+            pos.nPos - nPos > vData.size()) {
+            return false;
+        }
+        size_t nOffset = pos.nPos - nPos;
+        size_t nEnd =
+            nOffset + ReadLE32(vData.data() + nOffset - 4) + sizeof(uint256);
+        if (nEnd > vData.size()) {
+            return false;
+        }
+        vRecord.assign(vData.begin() + nOffset, vData.begin() + nEnd);
+        return true;
+    }
+
+    /** Forget the batch without writing it. */
+    void Clear() {
+        LOCK(cs);
+        nFile = -1;
+        vData.clear();
+    }
+};
+
+CUndoBatch undoBatch;
+
 bool UndoWriteToDisk(const CBlockUndo &blockundo, CDiskBlockPos &pos,
                      const uint256 &hashBlock,
                      const CMessageHeader::MessageStartChars &messageStart) {
-    // Open history file to append
-    CAutoFile fileout(OpenUndoFile(pos), SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull()) return error("%s: OpenUndoFile failed", __func__);
-
-    // Write index header
-    unsigned int nSize = GetSerializeSize(fileout, blockundo);
-    fileout << FLATDATA(messageStart) << nSize;
+    // Index header, undo data and checksum, serialized once.
+    std::vector<uint8_t> vRecord;
+    CVectorWriter(SER_DISK, CLIENT_VERSION, vRecord, 0,
+                  FLATDATA(messageStart), uint32_t(0));
+    const size_t nHeaderSize = vRecord.size();
+    SerializeBlockUndo(blockundo, vRecord);
+    WriteLE32(vRecord.data() + nHeaderSize - 4,
+              uint32_t(vRecord.size() - nHeaderSize));
 
-    // Write undo data
-    long fileOutPos = ftell(fileout.Get());
-    if (fileOutPos < 0) return error("%s: ftell failed", __func__);
-    pos.nPos = (unsigned int)fileOutPos;
-    fileout << blockundo;
-
-    // calculate & write checksum
     CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
     hasher << hashBlock;
-    hasher << blockundo;
-    fileout << hasher.GetHash();
+    hasher.write((const char *)vRecord.data() + nHeaderSize,
+                 vRecord.size() - nHeaderSize);
+    uint256 hashChecksum = hasher.GetHash();
+    vRecord.insert(vRecord.end(), hashChecksum.begin(), hashChecksum.end());
 
+    if (!undoBatch.Append(pos, vRecord)) {
+        return false;
+    }
+    pos.nPos += nHeaderSize;
     return true;
 }
 
 bool UndoReadFromDisk(CBlockUndo &blockundo, const CDiskBlockPos &pos,
                       const uint256 &hashBlock) {
-    // Open history file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull()) {
-        return error("%s: OpenUndoFile failed", __func__);
-    }
-
-    // Read block
-    uint256 hashChecksum;
-    // We need a CHashVerifier as reserializing may lose data
-    CHashVerifier<CAutoFile> verifier(&filein);
-    try {
-        verifier << hashBlock;
-        verifier >> blockundo;
-        filein >> hashChecksum;
-    } catch (const std::exception &e) {
-        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    // Undo data followed by its checksum.
+    std::vector<uint8_t> vRecord;
+    if (!undoBatch.Read(pos, vRecord)) {
+        // Open history file to read, at the size in the index header
+        if (pos.nPos < 4) {
+            return error("%s: Invalid undo position", __func__);
+        }
+        CAutoFile filein(
+            OpenUndoFile(CDiskBlockPos(pos.nFile, pos.nPos - 4), true),
+            SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull()) {
+            return error("%s: OpenUndoFile failed", __func__);
+        }
+        try {
+            uint32_t nSize;
+            filein >> nSize;
+            {
+                LOCK(cs_LastBlockFile);
+                if (size_t(pos.nFile) >= vinfoBlockFile.size() ||
+                    uint64_t(pos.nPos) + nSize + sizeof(uint256) >
+                        vinfoBlockFile[pos.nFile].nUndoSize) {
+                    return error("%s: Undo data out of range", __func__);
+                }
+            }
+            vRecord.resize(nSize + sizeof(uint256));
+            filein.read((char *)vRecord.data(), vRecord.size());
+        } catch (const std::exception &e) {
+            return error("%s: I/O error - %s", __func__, e.what());
+        }
     }
 
     // Verify checksum
-    if (hashChecksum != verifier.GetHash()) {
+    const uint8_t *pend = vRecord.data() + vRecord.size() - sizeof(uint256);
+    CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
+    hasher << hashBlock;
+    hasher.write((const char *)vRecord.data(), pend - vRecord.data());
+    uint256 hashChecksum = hasher.GetHash();
+    if (!std::equal(hashChecksum.begin(), hashChecksum.end(), pend)) {
         return error("%s: Checksum mismatch", __func__);
     }
 
+    try {
+        UnserializeBlockUndo(blockundo, vRecord.data(), pend);
+    } catch (const std::exception &e) {
+        return error("%s: Deserialize error - %s", __func__, e.what());
+    }
+
     return true;
 }
 
@@ -1724,12 +2046,19 @@ bool AbortNode(CValidationState &state, const std::string &strMessage,
 
 /** Restore the UTXO in a Coin at a given COutPoint. */
 DisconnectResult UndoCoinSpend(const Coin &undo, CCoinsViewCache &view,
-                               const COutPoint &out) {
+                               const COutPoint &out,
+                               CCoinsCommitment *pcommitment) {
     bool fClean = true;
 
     if (view.HaveCoin(out)) {
         // Overwriting transaction output.
         fClean = false;
+        if (pcommitment) {
+            const Coin &coin = view.AccessCoin(out);
+            if (!coin.IsSpent()) {
+                pcommitment->Remove(out, coin);
+            }
+        }
     }
 
     if (undo.GetHeight() == 0) {
@@ -1750,6 +2079,9 @@ DisconnectResult UndoCoinSpend(const Coin &undo, CCoinsViewCache &view,
                                         alternate.IsCoinBase());
     }
 
+    if (pcommitment && !undo.GetTxOut().scriptPubKey.IsUnspendable()) {
+        pcommitment->Add(out, undo);
+    }
     view.AddCoin(out, undo, undo.IsCoinBase());
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
@@ -1759,9 +2091,9 @@ DisconnectResult UndoCoinSpend(const Coin &undo, CCoinsViewCache &view,
  * by coins. When UNCLEAN or FAILED is returned, view is left in an
  * indeterminate state.
  */
-static DisconnectResult DisconnectBlock(const CBlock &block,
-                                        const CBlockIndex *pindex,
-                                        CCoinsViewCache &view) {
+static DisconnectResult
+DisconnectBlock(const CBlock &block, const CBlockIndex *pindex,
+                CCoinsViewCache &view, CCoinsCommitment *pcommitment = nullptr) {
     assert(pindex->GetBlockHash() == view.GetBestBlock());
 
     CBlockUndo blockUndo;
@@ -1776,12 +2108,13 @@ static DisconnectResult DisconnectBlock(const CBlock &block,
         return DISCONNECT_FAILED;
     }
 
-    return ApplyBlockUndo(blockUndo, block, pindex, view);
+    return ApplyBlockUndo(blockUndo, block, pindex, view, pcommitment);
 }
 
 DisconnectResult ApplyBlockUndo(const CBlockUndo &blockUndo,
                                 const CBlock &block, const CBlockIndex *pindex,
-                                CCoinsViewCache &view) {
+                                CCoinsViewCache &view,
+                                CCoinsCommitment *pcommitment) {
     bool fClean = true;
 
     if (blockUndo.vtxundo.size() + 1 != block.vtx.size()) {
@@ -1809,6 +2142,9 @@ DisconnectResult ApplyBlockUndo(const CBlockUndo &blockUndo,
                 // transaction output mismatch
                 fClean = false;
             }
+            if (pcommitment && is_spent && !coin.IsSpent()) {
+                pcommitment->Remove(out, coin);
+            }
         }
 
         // Restore inputs.
@@ -1826,7 +2162,8 @@ DisconnectResult ApplyBlockUndo(const CBlockUndo &blockUndo,
         for (size_t j = tx.vin.size(); j-- > 0;) {
             const COutPoint &out = tx.vin[j].prevout;
             const Coin &undo = txundo.vprevout[j];
-            DisconnectResult res = UndoCoinSpend(undo, view, out);
+            DisconnectResult res =
+                UndoCoinSpend(undo, view, out, pcommitment);
             if (res == DISCONNECT_FAILED) {
                 return DISCONNECT_FAILED;
             }
@@ -1840,15 +2177,19 @@ DisconnectResult ApplyBlockUndo(const CBlockUndo &blockUndo,
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
 
-static void FlushBlockFile(bool fFinalize = false) {
+static bool FlushBlockFile(bool fFinalize = false) {
     LOCK(cs_LastBlockFile);
 
+    bool fUndoWritten = undoBatch.Write();
+
     CDiskBlockPos posOld(nLastBlockFile, 0);
 
     FILE *fileOld = OpenBlockFile(posOld);
     if (fileOld) {
-        if (fFinalize)
+        if (fFinalize) {
+            blockFileMapCache.Invalidate(nLastBlockFile);
             TruncateFile(fileOld, vinfoBlockFile[nLastBlockFile].nSize);
+        }
         FileCommit(fileOld);
         fclose(fileOld);
     }
@@ -1860,6 +2201,8 @@ static void FlushBlockFile(bool fFinalize = false) {
         FileCommit(fileOld);
         fclose(fileOld);
     }
+
+    return fUndoWritten;
 }
 
 bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos,
@@ -1872,6 +2215,377 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+namespace {
+
+/**
+ * Closure representing the proof of work check for a run of block headers.
+ * The headers are hashed together so that Blake2b can use several lanes.
+ */
+class CHeaderPoWCheck {
+private:
+    std::vector<CBlockHeader> headers;
+    std::vector<int> heights;
+    const Consensus::Params *params;
+
+public:
+    CHeaderPoWCheck() : params(nullptr) {}
+    CHeaderPoWCheck(std::vector<CBlockHeader> headersIn,
+                    std::vector<int> heightsIn,
+                    const Consensus::Params &paramsIn)
+        : headers(std::move(headersIn)), heights(std::move(heightsIn)),
+          params(&paramsIn) {}
+
+    bool operator()() {
+        std::vector<uint256> hashes =
+            CBlockHeader::GetPoWHashes(headers, heights);
+        for (size_t i = 0; i < headers.size(); i++) {
+            if (!CheckProofOfWork(hashes[i], headers[i].nBits, *params)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void swap(CHeaderPoWCheck &check) {
+        headers.swap(check.headers);
+        heights.swap(check.heights);
+        std::swap(params, check.params);
+    }
+};
+
+} // namespace
+
+//! Number of headers in each proof of work check queued for a headers message.
+static const size_t HEADER_POW_CHECK_BATCH = 16;
+
+static CCheckQueue<CHeaderPoWCheck> headercheckqueue(128);
+
+void ThreadHeaderCheck() {
+    RenameThread("bitcoin-headerch");
+    headercheckqueue.Thread();
+}
+
+namespace {
+
+/**
+ * Closure representing the script checks of one transaction on its way into
+ * the mempool. A failure is kept with that transaction, so the closure itself
+ * always succeeds and the rest of the batch is checked regardless.
+ */
+class CMempoolScriptCheck {
+private:
+    MempoolAcceptWork *pws;
+
+public:
+    CMempoolScriptCheck() : pws(nullptr) {}
+    explicit CMempoolScriptCheck(MempoolAcceptWork &ws) : pws(&ws) {}
+
+    bool operator()() {
+        pws->fScriptsValid =
+            CheckInputScripts(*pws->ptx, pws->stateScripts, pws->view,
+                              pws->scriptVerifyFlags, true, pws->txdata,
+                              nullptr);
+        return true;
+    }
+
+    void swap(CMempoolScriptCheck &check) { std::swap(pws, check.pws); }
+};
+
+} // namespace
+
+static CCheckQueue<CMempoolScriptCheck> mempoolcheckqueue(8);
+//! Callers of AcceptToMemoryPoolParallel take turns at the queue.
+static CCriticalSection cs_mempoolcheckqueue;
+
+void ThreadMempoolScriptCheck() {
+    RenameThread("bitcoin-mempoolch");
+    mempoolcheckqueue.Thread();
+}
+
+/**
+ * Whether what the checks of ws saw in the mempool still holds, so that the
+ * transaction can be committed without checking it again. Recomputes its
+ * ancestors, which may have changed while the scripts were checked.
+ */
+static bool IsMempoolAcceptStillValid(CTxMemPool &pool,
+                                      MempoolAcceptWork &ws) {
+    AssertLockHeld(cs_main);
+    LOCK(pool.cs);
+
+    const CTransaction &tx = *ws.ptx;
+    if (pool.exists(tx.GetId())) {
+        return false;
+    }
+    for (const CTxIn &txin : tx.vin) {
+        if (pool.mapNextTx.count(txin.prevout)) {
+            return false;
+        }
+    }
+    for (const uint256 &hash : ws.vMemPoolParents) {
+        if (!pool.exists(hash)) {
+            return false;
+        }
+    }
+
+    ws.setAncestors.clear();
+    std::string errString;
+    if (!CalculateMemPoolAncestorsWithLimits(pool, *ws.pentry, ws.setAncestors,
+                                             errString)) {
+        return false;
+    }
+
+    Amount nModifiedFees = ws.pentry->GetFee();
+    double nPriorityDummy = 0;
+    pool.ApplyDeltas(tx.GetId(), nPriorityDummy, nModifiedFees);
+    Amount mempoolRejectFee = GetMempoolRejectFee(pool, ws.pentry->GetTxSize());
+    return mempoolRejectFee == 0 || nModifiedFees >= mempoolRejectFee;
+}
+
+/**
+ * One round of AcceptToMemoryPoolParallel and AcceptToMemoryPoolBatch: check
+ * the submissions at vPending against the chain and mempool as they are, their
+ * scripts on the mempool check queue and commit them in order.
+ *
+ * @return The txids that were added to the mempool.
+ */
+static std::set<uint256> AcceptToMemoryPoolRound(
+    const Config &config, CTxMemPool &pool,
+    std::vector<MempoolSubmission> &vSubmissions,
+    const std::vector<size_t> &vPending, bool fLimitFree,
+    bool fOverrideMempoolLimit, const Amount nAbsurdFee,
+    std::vector<std::vector<COutPoint>> &vCoinsToUncache) {
+    std::vector<std::unique_ptr<MempoolAcceptWork>> vWork(vPending.size());
+    std::vector<CMempoolScriptCheck> vChecks;
+    const CBlockIndex *pindexChecked;
+
+    // Everything but the scripts, against the chain and mempool as they are
+    // now.
+    {
+        LOCK(cs_main);
+        pindexChecked = chainActive.Tip();
+        int64_t nNow = GetTime();
+        for (size_t i = 0; i < vPending.size(); i++) {
+            MempoolSubmission &sub = vSubmissions[vPending[i]];
+            sub.state = CValidationState();
+            sub.fAccepted = false;
+            std::unique_ptr<MempoolAcceptWork> pws(
+                new MempoolAcceptWork(sub.tx));
+            if (!AcceptToMemoryPoolPreChecks(
+                    config, pool, sub.state, *pws, fLimitFree,
+                    &sub.fMissingInputs,
+                    sub.nAcceptTime ? sub.nAcceptTime : nNow, nAbsurdFee,
+                    vCoinsToUncache[vPending[i]]) ||
+                !Consensus::CheckTxInputs(*sub.tx, sub.state, pws->view,
+                                          GetSpendHeight(pws->view))) {
+                continue;
+            }
+
+            // Like CheckInputs, skip scripts that already passed with the
+            // same flags.
+            if (IsKeyInScriptCache(
+                    GetScriptCacheKey(*sub.tx, pws->scriptVerifyFlags),
+                    true)) {
+                pws->fScriptsValid = true;
+            } else {
+                vChecks.emplace_back(*pws);
+            }
+            vWork[i] = std::move(pws);
+        }
+    }
+
+    // The scripts, without cs_main. Each transaction carries its own coins,
+    // so nothing else is needed.
+    if (!vChecks.empty()) {
+        LOCK(cs_mempoolcheckqueue);
+        CCheckQueueControl<CMempoolScriptCheck> control(&mempoolcheckqueue);
+        control.Add(vChecks);
+        control.Wait();
+    }
+
+    // Commit in the order given. Whatever lost a race while the scripts were
+    // checked, such as a double spend in the same round, goes through
+    // AcceptToMemoryPool again, which finds its signatures in the cache and
+    // reports why it does not get in. The free relay limit is not applied
+    // again, as the checks above already charged the transaction to it.
+    std::set<uint256> setAccepted;
+    LOCK(cs_main);
+    bool fTipChanged = chainActive.Tip() != pindexChecked;
+    for (size_t i = 0; i < vPending.size(); i++) {
+        MempoolAcceptWork *pws = vWork[i].get();
+        MempoolSubmission &sub = vSubmissions[vPending[i]];
+        if (!pws) {
+            continue;
+        }
+        if (!pws->fScriptsValid) {
+            sub.state = pws->stateScripts;
+        } else if (!fTipChanged && IsMempoolAcceptStillValid(pool, *pws)) {
+            sub.fAccepted = AcceptToMemoryPoolFinalize(
+                config, pool, sub.state, *pws, fOverrideMempoolLimit);
+        } else {
+            sub.state = CValidationState();
+            sub.fAccepted = AcceptToMemoryPoolWorker(
+                config, pool, sub.state, sub.tx, false, &sub.fMissingInputs,
+                sub.nAcceptTime ? sub.nAcceptTime : GetTime(), nullptr,
+                fOverrideMempoolLimit, nAbsurdFee,
+                vCoinsToUncache[vPending[i]]);
+        }
+        if (sub.fAccepted) {
+            setAccepted.insert(sub.tx->GetId());
+        }
+    }
+    return setAccepted;
+}
+
+/**
+ * Drop the coins that the submissions which did not get in brought into the
+ * coins cache, as AcceptToMemoryPool does for a single transaction.
+ */
+static void UncacheRejectedSubmissions(
+    const std::vector<MempoolSubmission> &vSubmissions,
+    const std::vector<std::vector<COutPoint>> &vCoinsToUncache) {
+    LOCK(cs_main);
+    for (size_t i = 0; i < vSubmissions.size(); i++) {
+        if (!vSubmissions[i].fAccepted) {
+            for (const COutPoint &outpoint : vCoinsToUncache[i]) {
+                pcoinsTip->Uncache(outpoint);
+            }
+        }
+    }
+
+    // After we've (potentially) uncached entries, ensure our coins cache is
+    // still within its size limits
+    CValidationState stateDummy;
+    FlushStateToDisk(stateDummy, FLUSH_STATE_PERIODIC);
+}
+
+void AcceptToMemoryPoolParallel(const Config &config, CTxMemPool &pool,
+                                std::vector<MempoolSubmission> &vSubmissions,
+                                bool fLimitFree) {
+    std::vector<std::vector<COutPoint>> vCoinsToUncache(vSubmissions.size());
+    std::vector<size_t> vPending;
+    for (size_t i = 0; i < vSubmissions.size(); i++) {
+        vPending.push_back(i);
+    }
+
+    while (!vPending.empty()) {
+        std::set<uint256> setAccepted =
+            AcceptToMemoryPoolRound(config, pool, vSubmissions, vPending,
+                                    fLimitFree, false, Amount(0),
+                                    vCoinsToUncache);
+
+        // Give transactions that were missing inputs another round if one of
+        // their parents just got in, or may get in the next round.
+        if (setAccepted.empty()) {
+            break;
+        }
+        std::set<uint256> setParents(setAccepted);
+        for (size_t n : vPending) {
+            if (vSubmissions[n].fMissingInputs) {
+                setParents.insert(vSubmissions[n].tx->GetId());
+            }
+        }
+        std::vector<size_t> vRetry;
+        for (size_t n : vPending) {
+            const MempoolSubmission &sub = vSubmissions[n];
+            if (!sub.fMissingInputs) {
+                continue;
+            }
+            for (const CTxIn &txin : sub.tx->vin) {
+                if (setParents.count(txin.prevout.hash)) {
+                    vRetry.push_back(n);
+                    break;
+                }
+            }
+        }
+        vPending.swap(vRetry);
+    }
+
+    UncacheRejectedSubmissions(vSubmissions, vCoinsToUncache);
+}
+
+/**
+ * Order a batch so that every submission comes after the ones it spends from,
+ * grouped into levels whose members only depend on earlier levels. Within a
+ * level, submissions keep the order they were given in.
+ */
+static std::vector<std::vector<size_t>>
+SortSubmissionsByDepth(const std::vector<MempoolSubmission> &vSubmissions) {
+    // The first submission with a given txid is the one others depend on.
+    std::map<uint256, size_t> mapIndex;
+    for (size_t i = 0; i < vSubmissions.size(); i++) {
+        mapIndex.emplace(vSubmissions[i].tx->GetId(), i);
+    }
+
+    // Count the distinct parents of each submission in the batch, and note
+    // who waits for whom.
+    std::vector<size_t> vParents(vSubmissions.size(), 0);
+    std::vector<std::vector<size_t>> vChildren(vSubmissions.size());
+    for (size_t i = 0; i < vSubmissions.size(); i++) {
+        std::set<size_t> setParents;
+        for (const CTxIn &txin : vSubmissions[i].tx->vin) {
+            auto it = mapIndex.find(txin.prevout.hash);
+            if (it != mapIndex.end() && it->second != i) {
+                setParents.insert(it->second);
+            }
+        }
+        vParents[i] = setParents.size();
+        for (size_t n : setParents) {
+            vChildren[n].push_back(i);
+        }
+    }
+
+    // Peel off the submissions whose parents are all in earlier levels.
+    std::vector<std::vector<size_t>> vLevels;
+    std::vector<size_t> vLevel;
+    for (size_t i = 0; i < vSubmissions.size(); i++) {
+        if (vParents[i] == 0) {
+            vLevel.push_back(i);
+        }
+    }
+    while (!vLevel.empty()) {
+        std::vector<size_t> vNext;
+        for (size_t n : vLevel) {
+            for (size_t c : vChildren[n]) {
+                if (--vParents[c] == 0) {
+                    vNext.push_back(c);
+                }
+            }
+        }
+        std::sort(vNext.begin(), vNext.end());
+        vLevels.push_back(std::move(vLevel));
+        vLevel.swap(vNext);
+    }
+    return vLevels;
+}
+
+void AcceptToMemoryPoolBatch(const Config &config, CTxMemPool &pool,
+                             std::vector<MempoolSubmission> &vSubmissions,
+                             bool fLimitFree, const Amount nAbsurdFee) {
+    std::vector<std::vector<COutPoint>> vCoinsToUncache(vSubmissions.size());
+    for (const std::vector<size_t> &vLevel :
+         SortSubmissionsByDepth(vSubmissions)) {
+        AcceptToMemoryPoolRound(config, pool, vSubmissions, vLevel, fLimitFree,
+                                true, nAbsurdFee, vCoinsToUncache);
+    }
+
+    // Trim once for the whole batch, and report what did not survive it.
+    {
+        LOCK(cs_main);
+        LimitMempoolSize(
+            pool, GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000,
+            GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
+        for (MempoolSubmission &sub : vSubmissions) {
+            if (sub.fAccepted && !pool.exists(sub.tx->GetId())) {
+                sub.fAccepted = false;
+                sub.state.DoS(0, false, REJECT_INSUFFICIENTFEE,
+                              "mempool full");
+            }
+        }
+    }
+
+    UncacheRejectedSubmissions(vSubmissions, vCoinsToUncache);
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -1948,55 +2662,243 @@ static uint32_t GetBlockScriptFlags(const Config &config,
     if ((pChainTip->nHeight + 1) >= consensusparams.BIP65Height) {
         flags |= SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY;
     }
-
-    // Start enforcing BIP112 (CHECKSEQUENCEVERIFY) using versionbits logic.
-    if (VersionBitsState(pChainTip, consensusparams, Consensus::DEPLOYMENT_CSV,
-                         versionbitscache) == THRESHOLD_ACTIVE) {
-        flags |= SCRIPT_VERIFY_CHECKSEQUENCEVERIFY;
+
+    // Start enforcing BIP112 (CHECKSEQUENCEVERIFY) using versionbits logic.
+    if (VersionBitsState(pChainTip, consensusparams, Consensus::DEPLOYMENT_CSV,
+                         versionbitscache) == THRESHOLD_ACTIVE) {
+        flags |= SCRIPT_VERIFY_CHECKSEQUENCEVERIFY;
+    }
+
+    // If the UAHF is enabled, we start accepting replay protected txns
+    if (IsUAHFenabled(config, pChainTip)) {
+        flags |= SCRIPT_VERIFY_STRICTENC;
+        flags |= SCRIPT_ENABLE_SIGHASH_FORKID;
+    }
+
+    // If the Core HF is enabled, we start rejecting transaction that use a high
+    // s in their signature. We also make sure that signature that are supposed
+    // to fail (for instance in multisig or other forms of smart contracts) are
+    // null.
+    //if (IsCoreHFEnabled(config, pChainTip)) {
+    //    flags |= SCRIPT_VERIFY_LOW_S;
+    //    flags |= SCRIPT_VERIFY_NULLFAIL;
+    //}
+
+    // We make sure this node will have replay protection during the next hard
+    // fork.
+    if (IsReplayProtectionEnabled(config, pChainTip)) {
+        flags |= SCRIPT_ENABLE_REPLAY_PROTECTION;
+    }
+
+    return flags;
+}
+
+static int64_t nTimeCheck = 0;
+static int64_t nTimeForks = 0;
+static int64_t nTimeVerify = 0;
+static int64_t nTimeConnect = 0;
+static int64_t nTimeIndex = 0;
+static int64_t nTimeCallbacks = 0;
+static int64_t nTimeTotal = 0;
+static int64_t nTimePrefetch = 0;
+
+/**
+ * The block that follows the one being connected, read ahead of time by
+ * PrefetchNextBlock. Protected by cs_main.
+ */
+static std::pair<const CBlockIndex *, std::shared_ptr<const CBlock>>
+    prefetchedBlock;
+
+//! Coins read by each thread of a prefetch, at least.
+static const size_t PREFETCH_COINS_PER_THREAD = 64;
+//! Prefetching waits on the disk rather than the CPU, so it can use more
+//! threads than there are cores, to keep more reads in flight.
+static const size_t MAX_PREFETCH_THREADS = 16;
+
+/**
+ * Read the coins for vOutpoints from view, which must allow reads from
+ * several threads, in parallel. Coins that view does not have are left
+ * spent.
+ */
+static void ReadCoinsParallel(const CCoinsView &view,
+                              const std::vector<COutPoint> &vOutpoints,
+                              std::vector<Coin> &vCoins) {
+    vCoins.clear();
+    vCoins.resize(vOutpoints.size());
+    size_t nThreads = std::min(
+        MAX_PREFETCH_THREADS,
+        (vOutpoints.size() + PREFETCH_COINS_PER_THREAD - 1) /
+            PREFETCH_COINS_PER_THREAD);
+    auto readRange = [&](size_t nThread) {
+        size_t nBegin = vOutpoints.size() * nThread / nThreads;
+        size_t nEnd = vOutpoints.size() * (nThread + 1) / nThreads;
+        for (size_t i = nBegin; i < nEnd; i++) {
+            if (!view.GetCoin(vOutpoints[i], vCoins[i])) {
+                vCoins[i].Clear();
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < nThreads; i++) {
+        threads.emplace_back(readRange, i);
+    }
+    if (nThreads > 0) {
+        readRange(0);
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+/**
+ * Pull the coins spent by vtx that pcoinsTip does not have yet into it,
+ * reading them from pcoinsFlusher in parallel and without holding cs_main, so
+ * that validating vtx afterwards does not wait on the disk for each input in
+ * turn. If phashPrevBlock is given, vtx is a block, which is only worth it if
+ * the block builds on the tip; otherwise inputs from the mempool are skipped.
+ * The outpoints of the coins added are appended to pvAdded, if given.
+ */
+static void FetchCoinsAhead(const std::vector<CTransactionRef> &vtx,
+                            const uint256 *phashPrevBlock,
+                            std::vector<COutPoint> *pvAdded = nullptr) {
+    int64_t nTimeStart = GetTimeMicros();
+    std::vector<COutPoint> vOutpoints;
+    CCoinsViewBackgroundFlush *pview;
+    uint64_t nWrites;
+    {
+        LOCK(cs_main);
+        if (!pcoinsTip || !pcoinsFlusher || !chainActive.Tip()) {
+            return;
+        }
+        if (phashPrevBlock &&
+            *phashPrevBlock != chainActive.Tip()->GetBlockHash()) {
+            return;
+        }
+        // Outputs created by the block itself are not in the database.
+        std::unordered_set<uint256, SaltedTxidHasher> setTxids;
+        if (phashPrevBlock) {
+            for (const auto &tx : vtx) {
+                setTxids.insert(tx->GetId());
+            }
+        }
+        for (const auto &tx : vtx) {
+            if (tx->IsCoinBase()) {
+                continue;
+            }
+            for (const CTxIn &txin : tx->vin) {
+                const uint256 &txid = txin.prevout.hash;
+                if (pcoinsTip->HaveCoinInCache(txin.prevout) ||
+                    setTxids.count(txid) ||
+                    (!phashPrevBlock && mempool.exists(txid))) {
+                    continue;
+                }
+                vOutpoints.push_back(txin.prevout);
+            }
+        }
+        pview = pcoinsFlusher;
+        nWrites = pview->GetWriteCount();
+    }
+    if (vOutpoints.empty()) {
+        return;
     }
 
-    // If the UAHF is enabled, we start accepting replay protected txns
-    if (IsUAHFenabled(config, pChainTip)) {
-        flags |= SCRIPT_VERIFY_STRICTENC;
-        flags |= SCRIPT_ENABLE_SIGHASH_FORKID;
+    std::vector<Coin> vCoins;
+    ReadCoinsParallel(*pview, vOutpoints, vCoins);
+
+    size_t nFound = 0;
+    {
+        LOCK(cs_main);
+        // If pcoinsTip was flushed meanwhile, what was read may already be
+        // out of date.
+        if (pcoinsFlusher != pview || pview->GetWriteCount() != nWrites) {
+            return;
+        }
+        for (size_t i = 0; i < vOutpoints.size(); i++) {
+            if (!vCoins[i].IsSpent()) {
+                pcoinsTip->AddFetchedCoin(vOutpoints[i], std::move(vCoins[i]));
+                if (pvAdded) {
+                    pvAdded->push_back(vOutpoints[i]);
+                }
+                nFound++;
+            }
+        }
     }
+    LogPrint(BCLog::BENCH, "  - Prefetch %u of %u coins: %.2fms\n", nFound,
+             vOutpoints.size(), 0.001 * (GetTimeMicros() - nTimeStart));
+}
 
-    // If the Core HF is enabled, we start rejecting transaction that use a high
-    // s in their signature. We also make sure that signature that are supposed
-    // to fail (for instance in multisig or other forms of smart contracts) are
-    // null.
-    //if (IsCoreHFEnabled(config, pChainTip)) {
-    //    flags |= SCRIPT_VERIFY_LOW_S;
-    //    flags |= SCRIPT_VERIFY_NULLFAIL;
-    //}
+void PrefetchCoins(const std::vector<CTransactionRef> &vtx,
+                   std::vector<COutPoint> &vAdded) {
+    FetchCoinsAhead(vtx, nullptr, &vAdded);
+}
 
-    // We make sure this node will have replay protection during the next hard
-    // fork.
-    if (IsReplayProtectionEnabled(config, pChainTip)) {
-        flags |= SCRIPT_ENABLE_REPLAY_PROTECTION;
+void PrefetchNextBlock(const CBlockIndex *pindexNext,
+                       const std::shared_ptr<const CBlock> &pblockNext,
+                       const Consensus::Params &consensusParams) {
+    AssertLockHeld(cs_main);
+    if (prefetchedBlock.first == pindexNext) {
+        return;
     }
+    prefetchedBlock = std::make_pair(nullptr, nullptr);
 
-    return flags;
+    // The block may already be in memory, for instance when it has just been
+    // received.
+    std::shared_ptr<const CBlock> pblock;
+    if (pblockNext && pblockNext->GetHash() == pindexNext->GetBlockHash()) {
+        pblock = pblockNext;
+    } else {
+        std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+        if (!ReadBlockFromDisk(*pblockRead, pindexNext, consensusParams)) {
+            // ConnectTip will read it again and deal with the failure.
+            return;
+        }
+        pblock = pblockRead;
+    }
+    std::vector<COutPoint> vOutpoints;
+    for (const auto &tx : pblock->vtx) {
+        if (tx->IsCoinBase()) {
+            continue;
+        }
+        for (const CTxIn &txin : tx->vin) {
+            if (!pcoinsTip->HaveCoinInCache(txin.prevout)) {
+                vOutpoints.push_back(txin.prevout);
+            }
+        }
+    }
+    if (pcoinsFlusher) {
+        // cs_main keeps pcoinsTip from being flushed while the reads run.
+        std::vector<Coin> vCoins;
+        ReadCoinsParallel(*pcoinsFlusher, vOutpoints, vCoins);
+        for (size_t i = 0; i < vOutpoints.size(); i++) {
+            if (!vCoins[i].IsSpent()) {
+                pcoinsTip->AddFetchedCoin(vOutpoints[i], std::move(vCoins[i]));
+            }
+        }
+    } else {
+        for (const COutPoint &outpoint : vOutpoints) {
+            pcoinsTip->AccessCoin(outpoint);
+        }
+    }
+    prefetchedBlock = std::make_pair(pindexNext, pblock);
 }
 
-static int64_t nTimeCheck = 0;
-static int64_t nTimeForks = 0;
-static int64_t nTimeVerify = 0;
-static int64_t nTimeConnect = 0;
-static int64_t nTimeIndex = 0;
-static int64_t nTimeCallbacks = 0;
-static int64_t nTimeTotal = 0;
-
 /**
  * Apply the effects of this block (with given index) on the UTXO set
  * represented by coins. Validity checks that depend on the UTXO set are also
  * done; ConnectBlock() can fail if those validity checks fail (among other
- * reasons).
+ * reasons). If pindexNext is given, that block is prefetched while the scripts
+ * of this one are verified, from pblockNext if it holds it and from disk
+ * otherwise. If pcommitment is given, the coins spent and
+ * created by the block are removed from and added to it.
  */
 static bool ConnectBlock(const Config &config, const CBlock &block,
                          CValidationState &state, CBlockIndex *pindex,
                          CCoinsViewCache &view, const CChainParams &chainparams,
-                         bool fJustCheck = false) {
+                         bool fJustCheck = false,
+                         const CBlockIndex *pindexNext = nullptr,
+                         const std::shared_ptr<const CBlock> &pblockNext =
+                             nullptr,
+                         CCoinsCommitment *pcommitment = nullptr) {
     AssertLockHeld(cs_main);
 
     int64_t nTimeStart = GetTimeMicros();
@@ -2222,7 +3124,7 @@ static bool ConnectBlock(const Config &config, const CBlock &block,
             blockundo.vtxundo.push_back(CTxUndo());
         }
         UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(),
-                    pindex->nHeight);
+                    pindex->nHeight, pcommitment);
 
         vPos.push_back(std::make_pair(tx.GetId(), pos));
         pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
@@ -2247,6 +3149,18 @@ static bool ConnectBlock(const Config &config, const CBlock &block,
                          REJECT_INVALID, "bad-cb-amount");
     }
 
+    if (pindexNext && fScriptChecks && nScriptCheckThreads > 0) {
+        // Keep this thread busy with the next block's disk reads while the
+        // script check threads work through this one.
+        int64_t nTimePrefetchStart = GetTimeMicros();
+        PrefetchNextBlock(pindexNext, pblockNext, chainparams.GetConsensus());
+        int64_t nTimePrefetchEnd = GetTimeMicros();
+        nTimePrefetch += nTimePrefetchEnd - nTimePrefetchStart;
+        LogPrint(BCLog::BENCH, "      - Prefetch next block: %.2fms [%.2fs]\n",
+                 0.001 * (nTimePrefetchEnd - nTimePrefetchStart),
+                 nTimePrefetch * 0.000001);
+    }
+
     if (!control.Wait()) {
         return state.DoS(100, false, REJECT_INVALID, "blk-bad-inputs", false,
                          "parallel script check failed");
@@ -2271,8 +3185,7 @@ static bool ConnectBlock(const Config &config, const CBlock &block,
             CDiskBlockPos _pos;
             if (!FindUndoPos(
                     state, pindex->nFile, _pos,
-                    ::GetSerializeSize(blockundo, SER_DISK, CLIENT_VERSION) +
-                        40)) {
+                    GetBlockUndoSize(blockundo) + 40)) {
                 return error("ConnectBlock(): FindUndoPos failed");
             }
             if (!UndoWriteToDisk(blockundo, _pos, pindex->pprev->GetBlockHash(),
@@ -2369,8 +3282,12 @@ static bool FlushStateToDisk(CValidationState &state, FlushStateMode mode,
         }
         int64_t nMempoolSizeMax =
             GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
+        // A batch still being written in the background takes up memory
+        // until it is on disk.
         int64_t cacheSize =
-            pcoinsTip->DynamicMemoryUsage() * DB_PEAK_USAGE_FACTOR;
+            (pcoinsTip->DynamicMemoryUsage() +
+             (pcoinsFlusher ? pcoinsFlusher->PendingMemoryUsage() : 0)) *
+            DB_PEAK_USAGE_FACTOR;
         int64_t nTotalSpace =
             nCoinCacheUsage +
             std::max<int64_t>(nMempoolSizeMax - nMempoolUsage, 0);
@@ -2407,7 +3324,9 @@ static bool FlushStateToDisk(CValidationState &state, FlushStateMode mode,
             // Depend on nMinDiskSpace to ensure we can write block index
             if (!CheckDiskSpace(0)) return state.Error("out of disk space");
             // First make sure all block and undo data is flushed to disk.
-            FlushBlockFile();
+            if (!FlushBlockFile()) {
+                return AbortNode(state, "Failed to write undo data");
+            }
             // Then update all block file information (which may refer to block
             // and undo files).
             {
@@ -2448,9 +3367,21 @@ static bool FlushStateToDisk(CValidationState &state, FlushStateMode mode,
                 return state.Error("out of disk space");
             }
             // Flush the chainstate (which may refer to block index entries).
+            if (fHaveCoinsTipCommitment) {
+                pcoinsTip->SetCommitment(pcoinsTip->GetBestBlock(),
+                                         coinsTipCommitment);
+            }
+            // With pcoinsFlusher the coins are written in the background and
+            // the next flush waits for them. Callers that need them on disk
+            // now wait here instead, as does pruning, so that the coins never
+            // fall behind the block files that are left.
             if (!pcoinsTip->Flush()) {
                 return AbortNode(state, "Failed to write to coin database");
             }
+            if ((mode == FLUSH_STATE_ALWAYS || fFlushForPrune) &&
+                pcoinsFlusher && !pcoinsFlusher->Sync()) {
+                return AbortNode(state, "Failed to write to coin database");
+            }
             nLastFlush = nNow;
         }
         if (fDoFullFlush ||
@@ -2589,13 +3520,17 @@ static bool DisconnectTip(const Config &config, CValidationState &state,
     int64_t nStart = GetTimeMicros();
     {
         CCoinsViewCache view(pcoinsTip);
-        if (DisconnectBlock(block, pindexDelete, view) != DISCONNECT_OK) {
+        CCoinsCommitment delta;
+        if (DisconnectBlock(block, pindexDelete, view,
+                            fHaveCoinsTipCommitment ? &delta : nullptr) !=
+            DISCONNECT_OK) {
             return error("DisconnectTip(): DisconnectBlock %s failed",
                          pindexDelete->GetBlockHash().ToString());
         }
 
         bool flushed = view.Flush();
         assert(flushed);
+        coinsTipCommitment.Combine(delta);
     }
 
     LogPrint(BCLog::BENCH, "- Disconnect block: %.2fms\n",
@@ -2666,6 +3601,9 @@ struct ConnectTrace {
 /**
  * Connect a new block to chainActive. pblock is either nullptr or a pointer to
  * a CBlock corresponding to pindexNew, to bypass loading it again from disk.
+ * pindexNext, if not nullptr, is the block expected to be connected after this
+ * one; it is read ahead while this block's scripts are verified. pblockNext is
+ * either nullptr or a pointer to a CBlock that may correspond to pindexNext.
  *
  * The block is always added to connectTrace (either after loading from disk or
  * by copying pblock) - if that is not intended, care must be taken to remove
@@ -2675,12 +3613,22 @@ static bool ConnectTip(const Config &config, CValidationState &state,
                        CBlockIndex *pindexNew,
                        const std::shared_ptr<const CBlock> &pblock,
                        ConnectTrace &connectTrace,
-                       DisconnectedBlockTransactions &disconnectpool) {
+                       DisconnectedBlockTransactions &disconnectpool,
+                       const CBlockIndex *pindexNext = nullptr,
+                       const std::shared_ptr<const CBlock> &pblockNext =
+                           nullptr) {
     const CChainParams &chainparams = config.GetChainParams();
     assert(pindexNew->pprev == chainActive.Tip());
-    // Read block from disk.
+    // Read block from disk, unless it was read along with its parent.
     int64_t nTime1 = GetTimeMicros();
-    if (!pblock) {
+    std::shared_ptr<const CBlock> pblockPrefetched;
+    if (prefetchedBlock.first == pindexNew) {
+        pblockPrefetched = prefetchedBlock.second;
+    }
+    prefetchedBlock = std::make_pair(nullptr, nullptr);
+    if (!pblock && pblockPrefetched) {
+        connectTrace.blocksConnected.emplace_back(pindexNew, pblockPrefetched);
+    } else if (!pblock) {
         std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
         connectTrace.blocksConnected.emplace_back(pindexNew, pblockNew);
         if (!ReadBlockFromDisk(*pblockNew, pindexNew,
@@ -2698,8 +3646,11 @@ static bool ConnectTip(const Config &config, CValidationState &state,
              (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001);
     {
         CCoinsViewCache view(pcoinsTip);
+        CCoinsCommitment delta;
         bool rv = ConnectBlock(config, blockConnecting, state, pindexNew, view,
-                               config.GetChainParams());
+                               config.GetChainParams(), false, pindexNext,
+                               pblockNext,
+                               fHaveCoinsTipCommitment ? &delta : nullptr);
         GetMainSignals().BlockChecked(blockConnecting, state);
         if (!rv) {
             if (state.IsInvalid()) {
@@ -2714,6 +3665,7 @@ static bool ConnectTip(const Config &config, CValidationState &state,
                  (nTime3 - nTime2) * 0.001, nTimeConnectTotal * 0.000001);
         bool flushed = view.Flush();
         assert(flushed);
+        coinsTipCommitment.Combine(delta);
     }
     int64_t nTime4 = GetTimeMicros();
     nTimeFlush += nTime4 - nTime3;
@@ -2867,11 +3819,21 @@ static bool ActivateBestChainStep(const Config &config, CValidationState &state,
         // Connect new blocks.
         for (CBlockIndex *pindexConnect :
              boost::adaptors::reverse(vpindexToConnect)) {
+            // Let each block read its successor ahead, so the next disk read
+            // overlaps with script verification. pblock is pindexMostWork, so
+            // it is not read again.
+            const CBlockIndex *pindexNext =
+                pindexConnect == pindexMostWork
+                    ? nullptr
+                    : pindexMostWork->GetAncestor(pindexConnect->nHeight + 1);
             if (!ConnectTip(config, state, pindexConnect,
                             pindexConnect == pindexMostWork
                                 ? pblock
                                 : std::shared_ptr<const CBlock>(),
-                            connectTrace, disconnectpool)) {
+                            connectTrace, disconnectpool, pindexNext,
+                            pindexNext == pindexMostWork
+                                ? pblock
+                                : std::shared_ptr<const CBlock>())) {
                 if (state.IsInvalid()) {
                     // The block violates a consensus rule.
                     if (!state.CorruptionPossible())
@@ -3165,8 +4127,7 @@ CBlockIndex *AddToBlockIndex(const CBlockHeader &block) {
     if (it != mapBlockIndex.end()) return it->second;
 
     // Construct new block index object
-    CBlockIndex *pindexNew = new CBlockIndex(block);
-    assert(pindexNew);
+    CBlockIndex *pindexNew = blockIndexArena.Allocate(block);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
@@ -3198,6 +4159,42 @@ CBlockIndex *AddToBlockIndex(const CBlockHeader &block) {
     return pindexNew;
 }
 
+/**
+ * Link a block whose parents are all BLOCK_VALID_TRANSACTIONS into the chain
+ * of processed blocks, along with any descendants that were waiting on it.
+ */
+static void LinkProcessedBlock(CBlockIndex *pindexNew) {
+    std::deque<CBlockIndex *> queue;
+    queue.push_back(pindexNew);
+
+    // Recursively process any descendant blocks that now may be eligible to
+    // be connected.
+    while (!queue.empty()) {
+        CBlockIndex *pindex = queue.front();
+        queue.pop_front();
+        pindex->nChainTx =
+            (pindex->pprev ? pindex->pprev->nChainTx : 0) + pindex->nTx;
+        {
+            LOCK(cs_nBlockSequenceId);
+            pindex->nSequenceId = nBlockSequenceId++;
+        }
+        if (chainActive.Tip() == nullptr ||
+            !setBlockIndexCandidates.value_comp()(pindex, chainActive.Tip())) {
+            setBlockIndexCandidates.insert(pindex);
+        }
+        std::pair<std::multimap<CBlockIndex *, CBlockIndex *>::iterator,
+                  std::multimap<CBlockIndex *, CBlockIndex *>::iterator>
+            range = mapBlocksUnlinked.equal_range(pindex);
+        while (range.first != range.second) {
+            std::multimap<CBlockIndex *, CBlockIndex *>::iterator it =
+                range.first;
+            queue.push_back(it->second);
+            range.first++;
+            mapBlocksUnlinked.erase(it);
+        }
+    }
+}
+
 /**
  * Mark a block as having its data received and checked (up to
  * BLOCK_VALID_TRANSACTIONS).
@@ -3217,36 +4214,7 @@ bool ReceivedBlockTransactions(const CBlock &block, CValidationState &state,
     if (pindexNew->pprev == nullptr || pindexNew->pprev->nChainTx) {
         // If pindexNew is the genesis block or all parents are
         // BLOCK_VALID_TRANSACTIONS.
-        std::deque<CBlockIndex *> queue;
-        queue.push_back(pindexNew);
-
-        // Recursively process any descendant blocks that now may be eligible to
-        // be connected.
-        while (!queue.empty()) {
-            CBlockIndex *pindex = queue.front();
-            queue.pop_front();
-            pindex->nChainTx =
-                (pindex->pprev ? pindex->pprev->nChainTx : 0) + pindex->nTx;
-            {
-                LOCK(cs_nBlockSequenceId);
-                pindex->nSequenceId = nBlockSequenceId++;
-            }
-            if (chainActive.Tip() == nullptr ||
-                !setBlockIndexCandidates.value_comp()(pindex,
-                                                      chainActive.Tip())) {
-                setBlockIndexCandidates.insert(pindex);
-            }
-            std::pair<std::multimap<CBlockIndex *, CBlockIndex *>::iterator,
-                      std::multimap<CBlockIndex *, CBlockIndex *>::iterator>
-                range = mapBlocksUnlinked.equal_range(pindex);
-            while (range.first != range.second) {
-                std::multimap<CBlockIndex *, CBlockIndex *>::iterator it =
-                    range.first;
-                queue.push_back(it->second);
-                range.first++;
-                mapBlocksUnlinked.erase(it);
-            }
-        }
+        LinkProcessedBlock(pindexNew);
     } else {
         if (pindexNew->pprev && pindexNew->pprev->IsValid(BLOCK_VALID_TREE)) {
             mapBlocksUnlinked.insert(
@@ -3283,7 +4251,9 @@ bool FindBlockPos(CValidationState &state, CDiskBlockPos &pos,
             LogPrintf("Leaving block file %i: %s\n", nLastBlockFile,
                       vinfoBlockFile[nLastBlockFile].ToString());
         }
-        FlushBlockFile(!fKnown);
+        if (!FlushBlockFile(!fKnown)) {
+            return error("FindBlockPos(): failed to write undo data");
+        }
         nLastBlockFile = nFile;
     }
 
@@ -3659,7 +4629,8 @@ bool ContextualCheckBlock(const Config &config, const CBlock &block,
 }
 
 static bool AcceptBlockHeader(const Config &config, const CBlockHeader &block,
-                              CValidationState &state, CBlockIndex **ppindex) {
+                              CValidationState &state, CBlockIndex **ppindex,
+                              bool fCheckPOW = true) {
     AssertLockHeld(cs_main);
     const CChainParams &chainparams = config.GetChainParams();
 
@@ -3682,7 +4653,8 @@ static bool AcceptBlockHeader(const Config &config, const CBlockHeader &block,
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, chainparams.GetConsensus())) {
+        if (!CheckBlockHeader(block, state, chainparams.GetConsensus(),
+                              fCheckPOW)) {
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__,
                          hash.ToString(), FormatStateMessage(state));
         }
@@ -3729,17 +4701,70 @@ static bool AcceptBlockHeader(const Config &config, const CBlockHeader &block,
     return true;
 }
 
+/**
+ * Check proof of work for the leading run of headers that extend each other,
+ * spreading the work over the header check threads. Returns how many headers,
+ * counting from the first, passed. Zero is returned if any of them fails so
+ * that the serial checks find and report the offending header.
+ */
+static size_t CheckHeadersPoW(const std::vector<CBlockHeader> &headers,
+                              const Consensus::Params &params) {
+    if (headers.size() < 2) {
+        return 0;
+    }
+
+    // The proof of work hash depends on the height, which follows from the
+    // parent of the first header.
+    int nHeight;
+    {
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(headers[0].hashPrevBlock);
+        if (mi == mapBlockIndex.end()) {
+            return 0;
+        }
+        nHeight = mi->second->nHeight + 1;
+    }
+
+    std::vector<int> heights(1, nHeight);
+    uint256 hashPrev = headers[0].GetHash();
+    while (heights.size() < headers.size() &&
+           headers[heights.size()].hashPrevBlock == hashPrev) {
+        hashPrev = headers[heights.size()].GetHash();
+        heights.push_back(++nHeight);
+    }
+
+    std::vector<CHeaderPoWCheck> vChecks;
+    for (size_t i = 0; i < heights.size(); i += HEADER_POW_CHECK_BATCH) {
+        size_t nEnd = std::min(heights.size(), i + HEADER_POW_CHECK_BATCH);
+        vChecks.emplace_back(
+            std::vector<CBlockHeader>(headers.begin() + i,
+                                      headers.begin() + nEnd),
+            std::vector<int>(heights.begin() + i, heights.begin() + nEnd),
+            params);
+    }
+
+    CCheckQueueControl<CHeaderPoWCheck> control(&headercheckqueue);
+    control.Add(vChecks);
+    return control.Wait() ? heights.size() : 0;
+}
+
 // Exposed wrapper for AcceptBlockHeader
 bool ProcessNewBlockHeaders(const Config &config,
                             const std::vector<CBlockHeader> &headers,
                             CValidationState &state,
                             const CBlockIndex **ppindex) {
+    // Proof of work is context free, so check it for the whole message
+    // before taking cs_main for the contextual checks.
+    size_t nPoWChecked =
+        CheckHeadersPoW(headers, config.GetChainParams().GetConsensus());
+
     {
         LOCK(cs_main);
-        for (const CBlockHeader &header : headers) {
+        for (size_t i = 0; i < headers.size(); i++) {
             // Use a temp pindex instead of ppindex to avoid a const_cast
             CBlockIndex *pindex = nullptr;
-            if (!AcceptBlockHeader(config, header, state, &pindex)) {
+            if (!AcceptBlockHeader(config, headers[i], state, &pindex,
+                                   i >= nPoWChecked)) {
                 return false;
             }
             if (ppindex) {
@@ -3892,6 +4917,12 @@ bool ProcessNewBlock(const Config &config,
         bool ret =
             CheckBlock(config, *pblock, state, chainparams.GetConsensus());
 
+        if (ret) {
+            // Read the coins the block spends while cs_main is free, rather
+            // than one at a time from within ConnectBlock.
+            FetchCoinsAhead(pblock->vtx, &pblock->hashPrevBlock);
+        }
+
         LOCK(cs_main);
 
         if (ret) {
@@ -4011,6 +5042,7 @@ void UnlinkPrunedFiles(const std::set<int> &setFilesToPrune) {
     for (std::set<int>::iterator it = setFilesToPrune.begin();
          it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        blockFileMapCache.Invalidate(*it);
         boost::filesystem::remove(GetBlockPosFilename(pos, "blk"));
         boost::filesystem::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -4165,20 +5197,42 @@ CBlockIndex *InsertBlockIndex(uint256 hash) {
     if (mi != mapBlockIndex.end()) return (*mi).second;
 
     // Create new
-    CBlockIndex *pindexNew = new CBlockIndex();
-    if (!pindexNew)
-        throw std::runtime_error(std::string(__func__) +
-                                 ": new CBlockIndex failed");
+    CBlockIndex *pindexNew = blockIndexArena.Allocate();
     mi = mapBlockIndex.insert(std::make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
     return pindexNew;
 }
 
+int GetBlockIndexPoWTrustedHeight(const CChainParams &chainparams) {
+    // Every entry had its proof of work checked before it was first written.
+    // Hashing the whole index again on each start is only needed to catch
+    // on-disk corruption, so by default trust entries up to the last
+    // checkpoint and check the rest.
+    if (fCheckBlockIndexPoW || !fCheckpointsEnabled) {
+        return -1;
+    }
+    return Checkpoints::GetLastCheckpointHeight(chainparams.Checkpoints());
+}
+
+size_t GetBlockIndexMemoryUsage() {
+    LOCK(cs_main);
+    return blockIndexArena.DynamicMemoryUsage() +
+           memusage::DynamicUsage(mapBlockIndex);
+}
+
 static bool LoadBlockIndexDB(const CChainParams &chainparams) {
-    if (!pblocktree->LoadBlockIndexGuts(InsertBlockIndex)) return false;
+    int64_t nStart = GetTimeMillis();
+
+    int nPoWTrustedHeight = GetBlockIndexPoWTrustedHeight(chainparams);
+    int nLoadThreads = std::max(1, GetNumCores());
+    if (!pblocktree->LoadBlockIndexGuts(InsertBlockIndex, nPoWTrustedHeight,
+                                        nLoadThreads)) {
+        return false;
+    }
 
     boost::this_thread::interruption_point();
+    int64_t nGutsLoaded = GetTimeMillis();
 
     // Calculate nChainWork
     std::vector<std::pair<int, CBlockIndex *>> vSortedByHeight;
@@ -4228,6 +5282,11 @@ static bool LoadBlockIndexDB(const CChainParams &chainparams) {
             pindexBestHeader = pindex;
         }
     }
+    LogPrintf("%s: block index loaded in %dms (ordered pass %dms), %u "
+              "entries using %.1fMiB\n",
+              __func__, GetTimeMillis() - nStart, GetTimeMillis() - nGutsLoaded,
+              blockIndexArena.Size(),
+              GetBlockIndexMemoryUsage() * (1.0 / (1 << 20)));
 
     // Load block file info
     pblocktree->ReadLastBlockFile(nLastBlockFile);
@@ -4272,6 +5331,21 @@ static bool LoadBlockIndexDB(const CChainParams &chainparams) {
             "LoadBlockIndexDB(): Block files have previously been pruned\n");
     }
 
+    // Check whether the chainstate was loaded from a UTXO snapshot, in which
+    // case the blocks below it may never have been downloaded.
+    uint256 hashSnapshotBase;
+    if (pblocktree->ReadSnapshotBase(hashSnapshotBase)) {
+        BlockMap::iterator it = mapBlockIndex.find(hashSnapshotBase);
+        if (it == mapBlockIndex.end()) {
+            return error("%s: UTXO snapshot block %s not found", __func__,
+                         hashSnapshotBase.ToString());
+        }
+        pindexSnapshotBase = it->second;
+        LogPrintf("%s: chainstate was loaded from a UTXO snapshot at height "
+                  "%d\n",
+                  __func__, pindexSnapshotBase->nHeight);
+    }
+
     // Check whether we need to continue reindexing
     bool fReindexing = false;
     pblocktree->ReadReindexing(fReindexing);
@@ -4355,11 +5429,14 @@ bool CVerifyDB::VerifyDB(const Config &config, const CChainParams &chainparams,
             break;
         }
 
-        if (fPruneMode && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
-            // If pruning, only go back as far as we have data.
+        if ((fPruneMode || pindexSnapshotBase) &&
+            !(pindex->nStatus & BLOCK_HAVE_DATA)) {
+            // If pruning, or if the blocks below a UTXO snapshot were never
+            // downloaded, only go back as far as we have data.
             LogPrintf("VerifyDB(): block verification stopping at height %d "
-                      "(pruning, no data)\n",
-                      pindex->nHeight);
+                      "(%s, no data)\n",
+                      pindex->nHeight,
+                      fPruneMode ? "pruning" : "UTXO snapshot");
             break;
         }
         CBlock block;
@@ -4519,14 +5596,19 @@ bool RewindBlockIndex(const Config &config, const CChainParams &params) {
 // logic assumes a consistent block index state
 void UnloadBlockIndex() {
     LOCK(cs_main);
+    prefetchedBlock = std::make_pair(nullptr, nullptr);
+    coinsTipCommitment = CCoinsCommitment();
+    fHaveCoinsTipCommitment = false;
     setBlockIndexCandidates.clear();
     chainActive.SetTip(nullptr);
     pindexBestInvalid = nullptr;
     pindexBestHeader = nullptr;
+    pindexSnapshotBase = nullptr;
     mempool.clear();
     mapBlocksUnlinked.clear();
     vinfoBlockFile.clear();
     nLastBlockFile = 0;
+    undoBatch.Clear();
     nBlockSequenceId = 1;
     setDirtyBlockIndex.clear();
     setDirtyFileInfo.clear();
@@ -4535,13 +5617,315 @@ void UnloadBlockIndex() {
         warningcache[b].clear();
     }
 
-    for (BlockMap::value_type &entry : mapBlockIndex) {
-        delete entry.second;
-    }
     mapBlockIndex.clear();
+    blockIndexArena.Clear();
     fHavePruned = false;
 }
 
+/**
+ * Compute the commitment to all coins in view, walking slices of the key space
+ * on all cores.
+ */
+static bool ComputeCoinsCommitment(const CCoinsView &view,
+                                   CCoinsCommitment &commitment) {
+    int nThreads = std::max(1, GetNumCores());
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors =
+        view.RangeCursors(8 * nThreads);
+    if (cursors.empty()) {
+        std::unique_ptr<CCoinsViewCursor> pcursor(view.Cursor());
+        if (!pcursor) {
+            return false;
+        }
+        cursors.push_back(std::move(pcursor));
+    }
+    nThreads = std::min<int>(nThreads, cursors.size());
+
+    std::vector<CCoinsCommitment> vCommitment(nThreads);
+    std::atomic<size_t> nNextRange(0);
+    std::atomic<bool> fAbort(false);
+    auto worker = [&](int nThread) {
+        size_t nRange;
+        while (!fAbort && (nRange = nNextRange++) < cursors.size()) {
+            CCoinsViewCursor &cursor = *cursors[nRange];
+            while (cursor.Valid() && !fAbort) {
+                COutPoint key;
+                Coin coin;
+                if (!cursor.GetKey(key) || !cursor.GetValue(coin)) {
+                    fAbort = true;
+                    break;
+                }
+                vCommitment[nThread].Add(key, coin);
+                cursor.Next();
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < nThreads; i++) {
+        threads.emplace_back(worker, i);
+    }
+    worker(0);
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    if (fAbort) {
+        return false;
+    }
+
+    commitment = CCoinsCommitment();
+    for (const CCoinsCommitment &part : vCommitment) {
+        commitment.Combine(part);
+    }
+    return true;
+}
+
+bool LoadCoinsCommitment() {
+    LOCK(cs_main);
+    fHaveCoinsTipCommitment = false;
+    coinsTipCommitment = CCoinsCommitment();
+    if (!fCoinsCommitment) {
+        // Any stored commitment is erased by the next flush, so it is
+        // computed again if the commitment is turned back on.
+        return true;
+    }
+    if (pcoinsTip->GetBestBlock().IsNull()) {
+        // An empty chainstate commits to the empty set.
+    } else if (!pcoinsTip->GetCommitment(coinsTipCommitment)) {
+        // Written by a version that did not maintain the commitment.
+        LogPrintf("Computing UTXO set commitment...\n");
+        int64_t nStart = GetTimeMillis();
+        if (!ComputeCoinsCommitment(*pcoinsTip, coinsTipCommitment)) {
+            return error("%s: unable to read the coin database", __func__);
+        }
+        LogPrintf(" UTXO set commitment computed in %dms\n",
+                  GetTimeMillis() - nStart);
+    }
+    fHaveCoinsTipCommitment = true;
+    return true;
+}
+
+bool GetCoinsTipCommitment(CCoinsCommitment &commitment) {
+    AssertLockHeld(cs_main);
+    if (!fHaveCoinsTipCommitment) {
+        return false;
+    }
+    commitment = coinsTipCommitment;
+    return true;
+}
+
+/**
+ * Find the block of a UTXO snapshot, checking that the chainstate can still be
+ * replaced by it. The block has to be buried in the best header chain, as the
+ * blocks below it can never be disconnected.
+ */
+static bool CheckSnapshotBase(const CSnapshotMetadata &metadata,
+                              CBlockIndex *&pindexBase,
+                              CValidationState &state) {
+    AssertLockHeld(cs_main);
+    if (pindexSnapshotBase) {
+        return state.Error("A UTXO snapshot has already been loaded");
+    }
+    if (chainActive.Height() != 0) {
+        return state.Error("UTXO snapshots can only be loaded while the "
+                           "chain tip is the genesis block");
+    }
+    BlockMap::iterator it = mapBlockIndex.find(metadata.hashBlock);
+    if (it == mapBlockIndex.end()) {
+        return state.Error("The header of the UTXO snapshot block has not "
+                           "been received yet");
+    }
+    pindexBase = it->second;
+    if (pindexBase->nHeight == 0 ||
+        (pindexBase->nStatus & BLOCK_FAILED_MASK)) {
+        return state.Error("The UTXO snapshot block is not valid");
+    }
+    if (pindexBestHeader->GetAncestor(pindexBase->nHeight) != pindexBase) {
+        return state.Error("The UTXO snapshot block is not in the best header "
+                           "chain");
+    }
+    if (pindexBestHeader->nHeight - pindexBase->nHeight <
+        MIN_SNAPSHOT_BASE_DEPTH) {
+        return state.Error(strprintf("The UTXO snapshot block needs %d headers "
+                                     "on top of it",
+                                     MIN_SNAPSHOT_BASE_DEPTH));
+    }
+    return true;
+}
+
+/**
+ * Mark the blocks up to pindexBase as connected, the way the blocks below a
+ * pruned tip are. The ones never received are given transaction counts that
+ * add up to nChainTx, the snapshot's count up to pindexBase, so that progress
+ * estimates stay right.
+ */
+static void MarkSnapshotBlocks(CBlockIndex *pindexBase, int64_t nChainTx) {
+    std::vector<CBlockIndex *> vBlocks;
+    int64_t nMissing = 0;
+    int64_t nKnownTx = 0;
+    for (CBlockIndex *pindex = pindexBase; pindex; pindex = pindex->pprev) {
+        vBlocks.push_back(pindex);
+        if (pindex->nTx == 0) {
+            nMissing++;
+        } else {
+            nKnownTx += pindex->nTx;
+        }
+    }
+
+    int64_t nSpare = std::min<int64_t>(
+        std::max<int64_t>(nChainTx - nKnownTx - nMissing, 0),
+        std::numeric_limits<unsigned int>::max() - 1);
+    for (CBlockIndex *pindex : boost::adaptors::reverse(vBlocks)) {
+        if (pindex->nTx == 0) {
+            pindex->nTx = 1;
+            // Blocks are visited from the genesis block up, so the spare
+            // transactions end up on the highest missing one.
+            if (--nMissing == 0) {
+                pindex->nTx += nSpare;
+            }
+        }
+        pindex->RaiseValidity(BLOCK_VALID_SCRIPTS);
+        setDirtyBlockIndex.insert(pindex);
+        if (pindex->nChainTx == 0) {
+            LinkProcessedBlock(pindex);
+        }
+    }
+}
+
+bool LoadUTXOSnapshot(const CChainParams &chainparams, CSnapshotReader &reader,
+                      CValidationState &state) {
+    const CSnapshotMetadata &metadata = reader.GetMetadata();
+    const uint256 &hashBase = metadata.hashBlock;
+    if (memcmp(metadata.pchMessageStart, chainparams.MessageStart(),
+               sizeof(metadata.pchMessageStart)) != 0) {
+        return state.Error("The UTXO snapshot is for another network");
+    }
+    MapSnapshots::const_iterator itPinned =
+        chainparams.Snapshots().find(hashBase);
+    bool fPinned = itPinned != chainparams.Snapshots().end();
+    if (!fPinned && !GetBoolArg("-allowunpinnedsnapshot",
+                                DEFAULT_ALLOW_UNPINNED_SNAPSHOT)) {
+        return state.Error("The UTXO snapshot block is not one of the "
+                           "snapshots known to this version");
+    }
+    if (fPinned && itPinned->second.nChainTx != metadata.nChainTx) {
+        return state.Error("The UTXO snapshot has the wrong transaction count");
+    }
+
+    int nBaseHeight;
+    {
+        LOCK(cs_main);
+        CBlockIndex *pindexBase;
+        if (!CheckSnapshotBase(metadata, pindexBase, state)) {
+            return false;
+        }
+        nBaseHeight = pindexBase->nHeight;
+    }
+
+    // Verify the whole file before touching the chainstate. This takes most
+    // of the time, so it is done without holding cs_main.
+    LogPrintf("Verifying UTXO snapshot of block %s...\n", hashBase.ToString());
+    int64_t nStart = GetTimeMillis();
+    int nThreads = std::max(1, GetNumCores());
+    CCoinsCommitment commitment;
+    SnapshotChunk vCoins;
+    try {
+        while (reader.ReadChunk(vCoins)) {
+            for (const std::pair<COutPoint, Coin> &entry : vCoins) {
+                if (entry.second.GetHeight() > uint32_t(nBaseHeight)) {
+                    return state.Error("The UTXO snapshot holds a coin from "
+                                       "after its block");
+                }
+            }
+            AddSnapshotChunk(commitment, vCoins, nThreads);
+            if (ShutdownRequested()) {
+                return state.Error("Shutting down");
+            }
+        }
+    } catch (const std::exception &e) {
+        return state.Error(
+            strprintf("Unable to read the UTXO snapshot: %s", e.what()));
+    }
+    if (commitment.GetHash() != reader.GetUTXOSetHash() ||
+        (fPinned && commitment.GetHash() != itPinned->second.hashUTXOSet)) {
+        return state.Error("The UTXO snapshot does not match its hash");
+    }
+    const uint256 hashChecksum = reader.GetChecksum();
+    const uint64_t nCoins = reader.GetCoinsRead();
+    LogPrintf("Verified UTXO snapshot of %u coins in %dms\n", nCoins,
+              GetTimeMillis() - nStart);
+
+    CBlockIndex *pindexBase;
+    CBlockIndex *pindexGenesis;
+    {
+        LOCK(cs_main);
+        if (!CheckSnapshotBase(metadata, pindexBase, state)) {
+            return false;
+        }
+        pindexGenesis = chainActive.Genesis();
+        // The coins go straight to the database, under everything cached.
+        if (!FlushStateToDisk(state, FLUSH_STATE_ALWAYS)) {
+            return false;
+        }
+        std::unique_ptr<CCoinsViewCursor> pcursor(pcoinsdbview->Cursor());
+        if (pcursor->Valid()) {
+            return state.Error("The coin database is not empty");
+        }
+        pcursor.reset();
+        mempool.clear();
+
+        // From here on the coin database is marked as holding a partly loaded
+        // snapshot until FinishSnapshot, so any failure is fatal.
+        nStart = GetTimeMillis();
+        try {
+            reader.Rewind();
+            while (reader.ReadChunk(vCoins)) {
+                if (!pcoinsdbview->WriteSnapshotCoins(hashBase, vCoins)) {
+                    return AbortNode(state, "Failed to write to coin database");
+                }
+            }
+        } catch (const std::exception &e) {
+            return AbortNode(state, strprintf("Unable to read UTXO snapshot: %s",
+                                              e.what()));
+        }
+        if (reader.GetChecksum() != hashChecksum) {
+            return AbortNode(state, "UTXO snapshot changed while loading");
+        }
+
+        // The block index has to know about the snapshot before the chainstate
+        // moves to its block.
+        MarkSnapshotBlocks(pindexBase, metadata.nChainTx);
+        pindexSnapshotBase = pindexBase;
+        if (!pblocktree->WriteSnapshotBase(hashBase)) {
+            return AbortNode(state, "Failed to write to block index database");
+        }
+        if (!FlushStateToDisk(state, FLUSH_STATE_ALWAYS)) {
+            return false;
+        }
+        if (!pcoinsdbview->FinishSnapshot(hashBase, commitment)) {
+            return AbortNode(state, "Failed to write to coin database");
+        }
+        pcoinsTip->SetBestBlock(hashBase);
+        coinsTipCommitment = commitment;
+        fHaveCoinsTipCommitment = fCoinsCommitment;
+
+        chainActive.SetTip(pindexBase);
+        PruneBlockIndexCandidates();
+        mempool.AddTransactionsUpdated(1);
+        cvBlockChange.notify_all();
+        CheckBlockIndex(chainparams.GetConsensus());
+
+        LogPrintf("Loaded UTXO snapshot of %u coins in %dms: new best=%s "
+                  "height=%d tx=%lu\n",
+                  nCoins, GetTimeMillis() - nStart, hashBase.ToString(),
+                  pindexBase->nHeight, (unsigned long)pindexBase->nChainTx);
+    }
+
+    bool fInitialDownload = IsInitialBlockDownload();
+    GetMainSignals().UpdatedBlockTip(pindexBase, pindexGenesis,
+                                     fInitialDownload);
+    uiInterface.NotifyBlockTip(fInitialDownload, pindexBase);
+    return true;
+}
+
 bool LoadBlockIndex(const CChainParams &chainparams) {
     // Load block index from databases
     if (!fReindex && !LoadBlockIndexDB(chainparams)) {
@@ -4861,8 +6245,9 @@ static void CheckBlockIndex(const Consensus::Params &consensusParams) {
         }
         // VALID_TRANSACTIONS is equivalent to nTx > 0 for all nodes (whether or
         // not pruning has occurred). HAVE_DATA is only equivalent to nTx > 0
-        // (or VALID_TRANSACTIONS) if no pruning has occurred.
-        if (!fHavePruned) {
+        // (or VALID_TRANSACTIONS) if no pruning has occurred. The blocks below
+        // a UTXO snapshot are treated as pruned.
+        if (!fHavePruned && pindexSnapshotBase == nullptr) {
             // If we've never pruned, then HAVE_DATA should be equivalent to nTx
             // > 0
             assert(!(pindex->nStatus & BLOCK_HAVE_DATA) == (pindex->nTx == 0));
@@ -4972,8 +6357,8 @@ static void CheckBlockIndex(const Consensus::Params &consensusParams) {
             pindexFirstMissing != nullptr) {
             // We HAVE_DATA for this block, have received data for all parents
             // at some point, but we're currently missing data for some parent.
-            // We must have pruned.
-            assert(fHavePruned);
+            // We must have pruned, or started from a UTXO snapshot.
+            assert(fHavePruned || pindexSnapshotBase != nullptr);
             // This block may have entered mapBlocksUnlinked if:
             //  - it has a descendant that at some point had more work than the
             //    tip, and
@@ -5087,15 +6472,12 @@ int VersionBitsTipStateSinceHeight(const Consensus::Params &params,
                                        versionbitscache);
 }
 
-static const uint64_t MEMPOOL_DUMP_VERSION = 1;
-
 bool LoadMempool(const Config &config) {
     int64_t nExpiryTimeout =
         GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60;
     FILE *filestr =
         fopen((GetDataDir() / "mempool.dat").string().c_str(), "rb");
-    CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
-    if (file.IsNull()) {
+    if (!filestr) {
         LogPrintf(
             "Failed to open mempool file from disk. Continuing anyway.\n");
         return false;
@@ -5107,47 +6489,54 @@ bool LoadMempool(const Config &config) {
     int64_t nNow = GetTime();
 
     try {
-        uint64_t version;
-        file >> version;
-        if (version != MEMPOOL_DUMP_VERSION) {
-            return false;
-        }
-        uint64_t num;
-        file >> num;
+        CMempoolDumpReader reader(filestr);
         double prioritydummy = 0;
-        while (num--) {
-            CTransactionRef tx;
-            int64_t nTime;
-            int64_t nFeeDelta;
-            file >> tx;
-            file >> nTime;
-            file >> nFeeDelta;
-
-            Amount amountdelta = nFeeDelta;
-            if (amountdelta != 0) {
-                mempool.PrioritiseTransaction(tx->GetId(),
-                                              tx->GetId().ToString(),
-                                              prioritydummy, amountdelta);
+        std::vector<MempoolDumpEntry> vEntries;
+        // Each chunk goes in as one batch, with the scripts of its
+        // transactions checked in parallel before they are added in order.
+        // Parents come before their children in the file, so those in earlier
+        // chunks are in the mempool already.
+        while (reader.ReadChunk(vEntries)) {
+            std::vector<MempoolSubmission> vSubmissions;
+            std::vector<CTransactionRef> vtx;
+            for (const MempoolDumpEntry &entry : vEntries) {
+                Amount amountdelta = entry.nFeeDelta;
+                if (amountdelta != 0) {
+                    mempool.PrioritiseTransaction(
+                        entry.tx->GetId(), entry.tx->GetId().ToString(),
+                        prioritydummy, amountdelta);
+                }
+                if (entry.nTime + nExpiryTimeout > nNow) {
+                    vSubmissions.emplace_back(entry.tx, entry.nTime);
+                    vtx.push_back(entry.tx);
+                } else {
+                    ++skipped;
+                }
             }
-            CValidationState state;
-            if (nTime + nExpiryTimeout > nNow) {
-                LOCK(cs_main);
-                AcceptToMemoryPoolWithTime(config, mempool, state, tx, true,
-                                           nullptr, nTime);
-                if (state.IsValid()) {
+
+            std::vector<COutPoint> vPrefetched;
+            PrefetchCoins(vtx, vPrefetched);
+            AcceptToMemoryPoolBatch(config, mempool, vSubmissions, true);
+
+            std::set<COutPoint> setPrefetched(vPrefetched.begin(),
+                                              vPrefetched.end());
+            LOCK(cs_main);
+            for (const MempoolSubmission &sub : vSubmissions) {
+                if (sub.fAccepted) {
                     ++count;
-                } else {
-                    ++failed;
+                    continue;
+                }
+                ++failed;
+                for (const CTxIn &txin : sub.tx->vin) {
+                    if (setPrefetched.count(txin.prevout)) {
+                        pcoinsTip->Uncache(txin.prevout);
+                    }
                 }
-            } else {
-                ++skipped;
             }
             if (ShutdownRequested()) return false;
         }
-        std::map<uint256, Amount> mapDeltas;
-        file >> mapDeltas;
 
-        for (const auto &i : mapDeltas) {
+        for (const auto &i : reader.GetDeltas()) {
             mempool.PrioritiseTransaction(i.first, i.first.ToString(),
                                           prioritydummy, i.second);
         }
@@ -5165,6 +6554,10 @@ bool LoadMempool(const Config &config) {
 }
 
 void DumpMempool(void) {
+    // The scheduler and shutdown may both get here.
+    static CCriticalSection cs_dump;
+    LOCK(cs_dump);
+
     int64_t start = GetTimeMicros();
 
     std::map<uint256, Amount> mapDeltas;
@@ -5181,30 +6574,13 @@ void DumpMempool(void) {
     int64_t mid = GetTimeMicros();
 
     try {
-        FILE *filestr =
-            fopen((GetDataDir() / "mempool.dat.new").string().c_str(), "wb");
-        if (!filestr) {
-            return;
-        }
-
-        CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
-
-        uint64_t version = MEMPOOL_DUMP_VERSION;
-        file << version;
-
-        file << (uint64_t)vinfo.size();
+        CMempoolDumpWriter writer(GetDataDir() / "mempool.dat");
         for (const auto &i : vinfo) {
-            file << *(i.tx);
-            file << (int64_t)i.nTime;
-            file << (int64_t)i.nFeeDelta.GetSatoshis();
+            writer.Add(MempoolDumpEntry(i.tx, i.nTime,
+                                        i.nFeeDelta.GetSatoshis()));
             mapDeltas.erase(i.tx->GetId());
         }
-
-        file << mapDeltas;
-        FileCommit(file.Get());
-        file.fclose();
-        RenameOver(GetDataDir() / "mempool.dat.new",
-                   GetDataDir() / "mempool.dat");
+        writer.Finish(mapDeltas);
         int64_t last = GetTimeMicros();
         LogPrintf("Dumped mempool: %gs to copy, %gs to dump\n",
                   (mid - start) * 0.000001, (last - mid) * 0.000001);
@@ -5236,9 +6612,7 @@ public:
     CMainCleanup() {}
     ~CMainCleanup() {
         // block headers
-        BlockMap::iterator it1 = mapBlockIndex.begin();
-        for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
         mapBlockIndex.clear();
+        blockIndexArena.Clear();
     }
 } instance_of_cmaincleanup;
@@ -14,6 +14,7 @@
 #include "amount.h"
 #include "chain.h"
 #include "coins.h"
+#include "consensus/validation.h"
 #include "protocol.h" // For CMessageHeader::MessageStartChars
 #include "script/script_error.h"
 #include "sync.h"
@@ -35,16 +36,18 @@
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CCoinsViewBackgroundFlush;
+class CCoinsViewDB;
 class CBloomFilter;
 class CChainParams;
 class CConnman;
 class CInv;
 class Config;
 class CScriptCheck;
+class CSnapshotReader;
 class CTxMemPool;
 class CTxUndo;
 class CValidationInterface;
-class CValidationState;
 struct ChainTxData;
 
 struct PrecomputedTransactionData;
@@ -79,6 +82,9 @@ static const unsigned int DEFAULT_DESCENDANT_SIZE_LIMIT = 101;
 /** Default for -mempoolexpiry, expiration time for mempool transactions in
  * hours */
 static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 336;
+/** Default for -mempooldumpinterval, minutes between saves of the mempool to
+ * disk */
+static const unsigned int DEFAULT_MEMPOOL_DUMP_INTERVAL = 15;
 /** Maximum kilobytes for transactions to store for processing during reorg */
 static const unsigned int MAX_DISCONNECTED_TX_POOL_SIZE = 20000;
 /** The maximum size of a blk?????.dat file (since 0.8) */
@@ -87,6 +93,8 @@ static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 static const unsigned int BLOCKFILE_CHUNK_SIZE = 0x1000000; // 16 MiB
 /** The pre-allocation chunk size for rev?????.dat files (since 0.8) */
 static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
+/** Maximum amount of undo data kept in memory before writing it out */
+static const unsigned int MAX_UNDO_BATCH_SIZE = 0x100000; // 1 MiB
 
 /** Maximum number of script-checking threads allowed */
 static const int MAX_SCRIPTCHECK_THREADS = 16;
@@ -154,7 +162,19 @@ static const int64_t MAX_FEE_ESTIMATION_TIP_AGE = 3 * 60 * 60;
 /** Default for -permitbaremultisig */
 static const bool DEFAULT_PERMIT_BAREMULTISIG = true;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
+/** Default for -checkblockindexpow */
+static const bool DEFAULT_CHECKBLOCKINDEXPOW = false;
+/** Default for -blockmmapfiles; mapping is left off where address space is
+ * scarce */
+static const int DEFAULT_BLOCK_MMAP_FILES = sizeof(void *) >= 8 ? 16 : 0;
 static const bool DEFAULT_TXINDEX = false;
+/** Default for -utxocommitment; off, as hashing every coin spent and created
+ * makes connecting a block much slower */
+static const bool DEFAULT_UTXO_COMMITMENT = false;
+/** Default for -allowunpinnedsnapshot */
+static const bool DEFAULT_ALLOW_UNPINNED_SNAPSHOT = false;
+/** Headers needed on top of a UTXO snapshot block before it can be loaded */
+static const int MIN_SNAPSHOT_BASE_DEPTH = 6;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 
 /** Default for using fee filter */
@@ -187,10 +207,17 @@ extern std::atomic_bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
+/** Whether the commitment to the UTXO set is maintained at the tip. */
+extern bool fCoinsCommitment;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
+/**
+ * Re-check proof of work for every block index entry at startup, including
+ * those at or below the last checkpoint.
+ */
+extern bool fCheckBlockIndexPoW;
 extern size_t nCoinCacheUsage;
 
 /** A fee rate smaller than this is considered zero fee (for relaying, mining
@@ -211,6 +238,10 @@ extern uint256 hashAssumeValid;
  * points). */
 extern CBlockIndex *pindexBestHeader;
 
+/** Block the chainstate was loaded from a UTXO snapshot at, if any. The blocks
+ * below it may never have been downloaded. (protected by cs_main) */
+extern CBlockIndex *pindexSnapshotBase;
+
 /** Minimum disk space required - used in CheckDiskSpace() */
 static const uint64_t nMinDiskSpace = 52428800;
 
@@ -265,6 +296,31 @@ bool ProcessNewBlock(const Config &config,
                      const std::shared_ptr<const CBlock> pblock,
                      bool fForceProcessing, bool *fNewBlock);
 
+/**
+ * Read the coins spent by vtx that are not in pcoinsTip yet from the
+ * database, in parallel, and add them to it, so that accepting vtx to the
+ * mempool afterwards does not wait on the disk. Inputs from the mempool are
+ * skipped. The outpoints of the coins added are appended to vAdded, so that
+ * they can be uncached again if vtx is rejected.
+ *
+ * Call without cs_main held.
+ */
+void PrefetchCoins(const std::vector<CTransactionRef> &vtx,
+                   std::vector<COutPoint> &vAdded);
+
+/**
+ * Read the block that will be connected after the current one and pull the
+ * coins it spends into pcoinsTip, so that neither has to wait on the disk once
+ * its turn comes. The block is taken from pblockNext if that holds it, and
+ * read from disk otherwise. Called while the current block's scripts are
+ * verified on the check queue.
+ *
+ * Call with cs_main held.
+ */
+void PrefetchNextBlock(const CBlockIndex *pindexNext,
+                       const std::shared_ptr<const CBlock> &pblockNext,
+                       const Consensus::Params &consensusParams);
+
 /**
  * Process incoming block headers.
  *
@@ -291,6 +347,8 @@ FILE *OpenUndoFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 /** Translation to a filesystem path */
 boost::filesystem::path GetBlockPosFilename(const CDiskBlockPos &pos,
                                             const char *prefix);
+/** Keep up to nMaxFiles block files memory mapped for reading blocks */
+void InitBlockFileMapping(size_t nMaxFiles);
 /** Import blocks from an external file */
 bool LoadExternalBlockFile(const Config &config, FILE *fileIn,
                            CDiskBlockPos *dbp = nullptr);
@@ -298,10 +356,40 @@ bool LoadExternalBlockFile(const Config &config, FILE *fileIn,
 bool InitBlockIndex(const Config &config);
 /** Load the block tree and coins database from disk */
 bool LoadBlockIndex(const CChainParams &chainparams);
+/**
+ * Height up to which block index entries are loaded without checking their
+ * proof of work again, or -1 to check all of them (-checkblockindexpow, or
+ * -checkpoints=0).
+ */
+int GetBlockIndexPoWTrustedHeight(const CChainParams &chainparams);
 /** Unload database information */
 void UnloadBlockIndex();
+/** Memory used by the block index entries and mapBlockIndex */
+size_t GetBlockIndexMemoryUsage();
+/**
+ * Load the commitment to the UTXO set in pcoinsTip, computing it from the coins
+ * if it was not stored with them.
+ */
+bool LoadCoinsCommitment();
+/**
+ * Get the commitment to the UTXO set as of the chain tip. Returns false if it
+ * has not been loaded. (protected by cs_main)
+ */
+bool GetCoinsTipCommitment(CCoinsCommitment &commitment);
+/**
+ * Replace a chainstate that is still at the genesis block by the UTXO set in a
+ * snapshot, making the snapshot's block the tip. The whole file is verified
+ * against its MuHash, and the one pinned in the chain parameters, before the
+ * chainstate is touched. The block must have a known header.
+ */
+bool LoadUTXOSnapshot(const CChainParams &chainparams, CSnapshotReader &reader,
+                      CValidationState &state);
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the header proof of work checking thread */
+void ThreadHeaderCheck();
+/** Run an instance of the mempool script checking thread */
+void ThreadMempoolScriptCheck();
 /** Check whether we are doing an initial block download (synchronizing from
  * disk or network) */
 bool IsInitialBlockDownload();
@@ -389,6 +477,50 @@ bool AcceptToMemoryPool(const Config &config, CTxMemPool &pool,
                         bool fOverrideMempoolLimit = false,
                         const Amount nAbsurdFee = Amount(0));
 
+/**
+ * A transaction handed to AcceptToMemoryPoolParallel or
+ * AcceptToMemoryPoolBatch, and what became of it.
+ */
+struct MempoolSubmission {
+    CTransactionRef tx;
+    CValidationState state;
+    //! When the transaction entered the mempool, or 0 for when it is added.
+    int64_t nAcceptTime;
+    bool fMissingInputs;
+    bool fAccepted;
+
+    explicit MempoolSubmission(const CTransactionRef &txIn,
+                               int64_t nAcceptTimeIn = 0)
+        : tx(txIn), nAcceptTime(nAcceptTimeIn), fMissingInputs(false),
+          fAccepted(false) {}
+};
+
+/**
+ * Add several transactions to the memory pool, as AcceptToMemoryPool would
+ * one after the other, with their scripts checked in parallel on the mempool
+ * script check threads and cs_main released meanwhile. A transaction missing
+ * inputs is tried again once one of them has been added from the same batch.
+ *
+ * Call without cs_main held.
+ */
+void AcceptToMemoryPoolParallel(const Config &config, CTxMemPool &pool,
+                                std::vector<MempoolSubmission> &vSubmissions,
+                                bool fLimitFree);
+
+/**
+ * Add a batch of transactions, such as a package of dependent ones, to the
+ * memory pool. The batch is sorted so that parents go before their children,
+ * each depth of it is checked as one round of AcceptToMemoryPoolParallel, and
+ * the mempool is trimmed to its limit once at the end. Each submission holds
+ * the outcome for its transaction.
+ *
+ * Call without cs_main held.
+ */
+void AcceptToMemoryPoolBatch(const Config &config, CTxMemPool &pool,
+                             std::vector<MempoolSubmission> &vSubmissions,
+                             bool fLimitFree,
+                             const Amount nAbsurdFee = Amount(0));
+
 /** Convert CValidationState to a human-readable message for logging */
 std::string FormatStateMessage(const CValidationState &state);
 
@@ -449,10 +581,15 @@ bool CheckInputs(const CTransaction &tx, CValidationState &state,
                  const PrecomputedTransactionData &txdata,
                  std::vector<CScriptCheck> *pvChecks = nullptr);
 
-/** Apply the effects of this transaction on the UTXO set represented by view */
+/**
+ * Apply the effects of this transaction on the UTXO set represented by view.
+ * If pcommitment is set, the coins spent and created are also removed from and
+ * added to it.
+ */
 void UpdateCoins(const CTransaction &tx, CCoinsViewCache &inputs, int nHeight);
 void UpdateCoins(const CTransaction &tx, CCoinsViewCache &inputs,
-                 CTxUndo &txundo, int nHeight);
+                 CTxUndo &txundo, int nHeight,
+                 CCoinsCommitment *pcommitment = nullptr);
 
 /** Transaction validation functions */
 
@@ -645,6 +782,15 @@ extern CChain chainActive;
  */
 extern CCoinsViewCache *pcoinsTip;
 
+/** Global variable that points to the coins database (protected by cs_main) */
+extern CCoinsViewDB *pcoinsdbview;
+
+/**
+ * The layer below pcoinsTip that writes its flushes to disk in the background,
+ * if any (protected by cs_main)
+ */
+extern CCoinsViewBackgroundFlush *pcoinsFlusher;
+
 /** Global variable that points to the active block tree (protected by cs_main)
  */
 extern CBlockTreeDB *pblocktree;